@@ -627,11 +627,37 @@ typedef enum {
   SIPE_SETTING_EMAIL_PASSWORD,
   SIPE_SETTING_GROUPCHAT_USER,
   SIPE_SETTING_USER_AGENT,
+  SIPE_SETTING_HTTP_CONNECTIONS,
+  SIPE_SETTING_BUFFER_HIGH_WATER,
   SIPE_SETTING_LAST
 } sipe_setting;
 const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
 				  sipe_setting type);
 
+/**
+ * Persistent per-account storage for secrets created by the core, e.g. the
+ * key of an encrypted cache file. The backend should keep them in the same
+ * place as the account password, never in a file owned by the core.
+ *
+ * @param sipe_public Sipe core public data structure
+ * @param name        name of the secret
+ *
+ * @return secret or @c NULL if it hasn't been stored. Must be g_free()'d.
+ */
+gchar *sipe_backend_secret_get(struct sipe_core_public *sipe_public,
+			       const gchar *name);
+
+/**
+ * @param sipe_public Sipe core public data structure
+ * @param name        name of the secret
+ * @param secret      secret, printable ASCII
+ *
+ * @return @c FALSE if the backend can't store secrets
+ */
+gboolean sipe_backend_secret_set(struct sipe_core_public *sipe_public,
+				 const gchar *name,
+				 const gchar *secret);
+
 /** STATUS *******************************************************************/
 
 guint sipe_backend_status(struct sipe_core_public *sipe_public);
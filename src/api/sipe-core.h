@@ -63,10 +63,43 @@ struct sipe_transport_connection {
 	gchar *buffer;
 	gsize buffer_used;        /* 0 < buffer_used < buffer_length */
 	gsize buffer_length;      /* read-only */
+	gsize buffer_high_water;  /* read-only, 0: SIPE_TRANSPORT_BUFFER_HIGH_WATER */
 	guint type;               /* read-only */
 	guint client_port;        /* read-only */
 };
 
+/**
+ * Transport input buffer sizes
+ *
+ * The buffer starts with SIPE_TRANSPORT_BUFFER_INITIAL bytes and doubles
+ * its size when more space is needed. An empty buffer that has grown larger
+ * than the high-water mark is shrunk back to the initial size. The core sets
+ * the high-water mark of a connection from SIPE_SETTING_BUFFER_HIGH_WATER.
+ */
+#define SIPE_TRANSPORT_BUFFER_INITIAL    4096
+#define SIPE_TRANSPORT_BUFFER_HIGH_WATER (64 * 1024)
+
+/**
+ * Make space for incoming data in the transport input buffer
+ *
+ * @param conn    transport connection
+ * @param minimum number of bytes the caller wants to add
+ *
+ * @return number of bytes available after buffer_used. The space for the
+ *         string terminator is not included.
+ */
+gsize sipe_core_transport_buffer_reserve(struct sipe_transport_connection *conn,
+					 gsize minimum);
+
+/**
+ * Release memory of an idle transport input buffer
+ *
+ * Backends should call this after the core has processed the input.
+ *
+ * @param conn transport connection
+ */
+void sipe_core_transport_buffer_release(struct sipe_transport_connection *conn);
+
 /**
  * Opaque data type for chat session
  */
@@ -189,6 +222,15 @@ void sipe_core_schedule_execute(gpointer data);
 void sipe_core_update_calendar(struct sipe_core_public *sipe_public);
 void sipe_core_reset_status(struct sipe_core_public *sipe_public);
 
+/**
+ * Memory used by the buddy list (debug command)
+ *
+ * @param sipe_public Sipe core public data structure
+ *
+ * @return report text. Must be g_free()'d after use.
+ */
+gchar *sipe_core_buddy_memory_usage(struct sipe_core_public *sipe_public);
+
 /* access levels */
 void sipe_core_change_access_level_from_container(struct sipe_core_public *sipe_public,
 						  gpointer parameter);
@@ -287,6 +329,37 @@ void sipe_core_buddy_remove(struct sipe_core_public *sipe_public,
 			    const gchar *uri,
 			    const gchar *group_name);
 
+/**
+ * Progress of the initial presence subscription for all buddies
+ *
+ * @param sipe_public Sipe core public data structure
+ * @param pending     buddies waiting to be subscribed
+ * @param inflight    buddies in SUBSCRIBEs without response
+ * @param failed      buddies which couldn't be subscribed
+ */
+void sipe_core_presence_subscriptions(struct sipe_core_public *sipe_public,
+				      guint *pending,
+				      guint *inflight,
+				      guint *failed);
+
+/**
+ * Time from connect until the first successful registration
+ *
+ * @param sipe_public Sipe core public data structure
+ *
+ * @return milliseconds or 0 if not registered yet
+ */
+guint sipe_core_time_to_registered(struct sipe_core_public *sipe_public);
+
+/**
+ * Time from connection loss until registration on the new connection
+ *
+ * @param sipe_public Sipe core public data structure
+ *
+ * @return milliseconds for the last warm reconnect or 0 if there was none
+ */
+guint sipe_core_reconnect_latency(struct sipe_core_public *sipe_public);
+
 void sipe_core_contact_allow_deny(struct sipe_core_public *sipe_public,
 				  const gchar *who,
 				  gboolean allow);
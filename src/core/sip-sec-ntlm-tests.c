@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-12 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2010 pier11 <pier11@operamail.com>
  * Copyright (C) 2008 Novell, Inc.
  *
@@ -120,7 +120,7 @@ gboolean sip_sec_ntlm_tests(void)
 	guint32 mac [4];
 	guchar text_enc [18 + 12];
 	struct sipmsg *msg;
-	struct sipmsg_breakdown msgbd;
+	GString *msg_buffer = g_string_new("");
 	gchar *msg_str;
 	const char *password2;
 	const char *user2;
@@ -494,13 +494,10 @@ Response:
 	msg2 = "SIP/2.0 200 OK\r\nms-keep-alive: UAS; tcp=no; hop-hop=yes; end-end=no; timeout=300\r\nAuthentication-Info: NTLM rspauth=\"0100000000000000BF2E52667DDF6DED\", srand=\"0878F41B\", snum=\"1\", opaque=\"4452DFB0\", qop=\"auth\", targetname=\"ocs1.ocs.provo.novell.com\", realm=\"SIP Communications Service\"\r\nFrom: \"Gabriel Burt\"<sip:gabriel@ocs.provo.novell.com>;tag=2947328781;epid=1234567890\r\nTo: <sip:gabriel@ocs.provo.novell.com>;tag=B816D65C2300A32CFA6D371F2AF537FD\r\nCall-ID: 8592g5DCBa1694i5887m0D0Bt2247b3F38xAE9Fx\r\nCSeq: 3 REGISTER\r\nVia: SIP/2.0/TLS 164.99.194.49:10409;branch=z9hG4bKE0E37DBAF252C3255BAD;received=164.99.195.20;ms-received-port=10409;ms-received-cid=1E00\r\nContact: <sip:164.99.195.20:10409;transport=tls;ms-received-cid=1E00>;expires=900\r\nExpires: 900\r\nAllow-Events: vnd-microsoft-provisioning,vnd-microsoft-roaming-contacts,vnd-microsoft-roaming-ACL,presence,presence.wpending,vnd-microsoft-roaming-self,vnd-microsoft-provisioning-v2\r\nSupported: adhoclist\r\nServer: RTC/3.0\r\nSupported: com.microsoft.msrtc.presence\r\nContent-Length: 0\r\n\r\n";
 	msg = sipmsg_parse_msg(msg2);
 
-	memset(&msgbd, 0, sizeof(struct sipmsg_breakdown));
-	msgbd.msg = msg;
-	sipmsg_breakdown_parse(&msgbd, "SIP Communications Service", "ocs1.ocs.provo.novell.com", NULL);
-	msg_str = sipmsg_breakdown_get_string(2, &msgbd);
+	sipe_sign_input(msg_buffer, 2, msg, NULL, "SIP Communications Service", "ocs1.ocs.provo.novell.com", NULL, NULL);
+	msg_str = msg_buffer->str;
 	sip_sec_ntlm_sipe_signature_make (NEGOTIATE_FLAGS_CONNLESS & ~NTLMSSP_NEGOTIATE_EXTENDED_SESSIONSECURITY,
 		msg_str, 0, exported_session_key2, exported_session_key2, mac);
-	sipmsg_breakdown_free(&msgbd);
 	assert_equal ("0100000000000000BF2E52667DDF6DED", mac, 16, TRUE);
 	/* sig = buff_to_hex_str((guint8 *)mac, 16); */
 	}
@@ -752,26 +749,20 @@ Message (length 352):
 
 	printf ("\n\nTesting (NTLMv2 / OC 2007 R2) Message Parsing, Signing, and Verification\nClient request\n(Authentication Protocol version 4)\n");
 	msg = sipmsg_parse_msg(request);
-	memset(&msgbd, 0, sizeof(struct sipmsg_breakdown));
-	msgbd.msg = msg;
-	sipmsg_breakdown_parse(&msgbd, "SIP Communications Service", "cosmo-ocs-r2.cosmo.local", NULL);
-	msg_str = sipmsg_breakdown_get_string(4, &msgbd);
+	sipe_sign_input(msg_buffer, 4, msg, NULL, "SIP Communications Service", "cosmo-ocs-r2.cosmo.local", NULL, NULL);
+	msg_str = msg_buffer->str;
 	assert_equal (request_sig, (guchar *)msg_str, strlen(request_sig), FALSE);
 	sip_sec_ntlm_sipe_signature_make (flags, msg_str, 0, client_sign_key, client_seal_key, mac);
-	sipmsg_breakdown_free(&msgbd);
 	assert_equal ("0100000029618e9651b65a7764000000", mac, 16, TRUE);
 	/* sig = buff_to_hex_str((guint8 *)mac, 16); */
 
 	printf ("\n\nTesting (NTLMv2 / OC 2007 R2) Message Parsing, Signing, and Verification\nServer response\n(Authentication Protocol version 4)\n");
 	msg = sipmsg_parse_msg(response);
-	memset(&msgbd, 0, sizeof(struct sipmsg_breakdown));
-	msgbd.msg = msg;
-	sipmsg_breakdown_parse(&msgbd, "SIP Communications Service", "cosmo-ocs-r2.cosmo.local", NULL);
-	msg_str = sipmsg_breakdown_get_string(4, &msgbd);
+	sipe_sign_input(msg_buffer, 4, msg, NULL, "SIP Communications Service", "cosmo-ocs-r2.cosmo.local", NULL, NULL);
+	msg_str = msg_buffer->str;
 	assert_equal (response_sig, (guchar *)msg_str, strlen(response_sig), FALSE);
 	// server keys here
 	sip_sec_ntlm_sipe_signature_make (flags, msg_str, 0, server_sign_key, server_seal_key, mac);
-	sipmsg_breakdown_free(&msgbd);
 	assert_equal ("01000000E615438A917661BE64000000", mac, 16, TRUE);
 	/* sig = buff_to_hex_str((guint8 *)mac, 16); */
 
@@ -851,14 +842,11 @@ Message (length 352):
 	response_sig = "<NTLM><1B6D47A1><11><SIP Communications Service><LOC-COMPANYT-FE03.COMPANY.COM><41CEg82ECa0AC8i3DD7mE673t9CF4b19DAxF780x><1><INVITE><sip:sender@company.com><2420628112><sip:recipient@company.com><7aee15546a><SIP:recipient@company.com><><><180>";
 
 	msg = sipmsg_parse_msg(response_symbian);
-	memset(&msgbd, 0, sizeof(struct sipmsg_breakdown));
-	msgbd.msg = msg;
-	sipmsg_breakdown_parse(&msgbd, "SIP Communications Service", "LOC-COMPANYT-FE03.COMPANY.COM", NULL);
-	msg_str = sipmsg_breakdown_get_string(4, &msgbd);
+	sipe_sign_input(msg_buffer, 4, msg, NULL, "SIP Communications Service", "LOC-COMPANYT-FE03.COMPANY.COM", NULL, NULL);
+	msg_str = msg_buffer->str;
 
 	assert_equal (response_sig, (guchar *)msg_str, strlen(response_sig), FALSE);
 
-	sipmsg_breakdown_free(&msgbd);
 	}
 
 ////// UUID tests ///////
@@ -878,6 +866,7 @@ Message (length 352):
 
 	printf ("\nFinished With Tests; %d successs %d failures\n", successes, failures);
 
+	g_string_free(msg_buffer, TRUE);
 	sip_sec_destroy__ntlm();
 
 	return(failures == 0);
@@ -427,6 +427,9 @@ DESL (const unsigned char *k, const unsigned char *d, unsigned char * results)
 #define RC4K(key, key_len, plain, plain_len, encrypted) \
 	sipe_crypt_rc4((key), (key_len), (plain), (plain_len), (encrypted))
 
+/* avoids memory allocation in MAC() for typical SIP message signatures */
+#define NTLM_MAC_STACK_BUFFER 1024
+
 /* out 16 bytes */
 #define MD4(d, len, result) sipe_digest_md4((d), (len), (result))
 
@@ -873,7 +876,11 @@ MAC (guint32 flags,
 
 		unsigned char seal_key_ [16];
 		guchar hmac[16];
-		guint32 *tmp = g_malloc(4 + buf_len);
+		/* ConcatenationOf(SeqNum, Message): SIP signature input fits on the stack */
+		guint32 stack[NTLM_MAC_STACK_BUFFER / sizeof(guint32)];
+		guint32 *tmp = (4 + buf_len <= sizeof(stack)) ?
+			stack :
+			g_malloc(4 + buf_len);
 
 		/* SealingKey' = MD5(ConcatenationOf(SealingKey, SequenceNumber))
 		   RC4Init(Handle, SealingKey')
@@ -899,7 +906,8 @@ MAC (guint32 flags,
 		memcpy(tmp+1, buf, buf_len);
 
 		HMAC_MD5(sign_key, sign_key_len, (guchar *)tmp, 4 + buf_len, hmac);
-		g_free(tmp);
+		if (tmp != stack)
+			g_free(tmp);
 
 		if (IS_FLAG(flags, NTLMSSP_NEGOTIATE_KEY_EXCH)) {
 			SIPE_DEBUG_INFO_NOFORMAT("NTLM MAC(): Key Exchange");
@@ -1295,13 +1303,13 @@ sip_sec_ntlm_sipe_signature_make(guint32 flags,
 				 unsigned char *seal_key,
 				 guint32 *result)
 {
-	char *res;
-
 	MAC(flags, msg, strlen(msg), sign_key, 16, seal_key, 16, random_pad, 100, result);
 
-	res = buff_to_hex_str((guint8 *)result, 16);
-	SIPE_DEBUG_INFO("NTLM calculated MAC: %s", res);
-	g_free(res);
+	if (sipe_backend_debug_enabled()) {
+		char *res = buff_to_hex_str((guint8 *)result, 16);
+		SIPE_DEBUG_INFO("NTLM calculated MAC: %s", res);
+		g_free(res);
+	}
 }
 
 #endif /* !_SIPE_COMPILING_ANALYZER */
@@ -1896,8 +1904,13 @@ sip_sec_verify_signature__ntlm(SipSecContext context,
 {
 	context_ntlm ctx = (context_ntlm) context;
 	guint32 mac[4];
-	/* SipSecBuffer.value is g_malloc()'d: use (void *) to remove guint8 alignment */
-	guint32 random_pad = GUINT32_FROM_LE(((guint32 *)((void *)signature.value))[1]);
+	guint32 random_pad;
+
+	if (signature.length != sizeof(mac))
+		return(FALSE);
+
+	/* SipSecBuffer.value is guint32 aligned: use (void *) to remove guint8 alignment */
+	random_pad = GUINT32_FROM_LE(((guint32 *)((void *)signature.value))[1]);
 
 	sip_sec_ntlm_sipe_signature_make(ctx->flags,
 					 message,
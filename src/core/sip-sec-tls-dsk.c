@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -157,24 +157,23 @@ sip_sec_verify_signature__tls_dsk(SipSecContext context,
 				  SipSecBuffer signature)
 {
 	context_tls_dsk ctx = (context_tls_dsk) context;
-	SipSecBuffer mac    = { 0, NULL };
-	gboolean result     = FALSE;
+	/* large enough for all supported algorithms */
+	guchar mac[SIPE_DIGEST_HMAC_SHA1_LENGTH];
+	gsize mac_length    = 0;
 
 	switch (ctx->algorithm) {
 	case SIPE_TLS_DIGEST_ALGORITHM_MD5:
-		mac.length = SIPE_DIGEST_HMAC_MD5_LENGTH;
-		mac.value  = g_malloc0(mac.length);
+		mac_length = SIPE_DIGEST_HMAC_MD5_LENGTH;
 		sipe_digest_hmac_md5(ctx->server_key, ctx->key_length,
 				     (guchar *) message, strlen(message),
-				     mac.value);
+				     mac);
 		break;
 
 	case SIPE_TLS_DIGEST_ALGORITHM_SHA1:
-		mac.length = SIPE_DIGEST_HMAC_SHA1_LENGTH;
-		mac.value  = g_malloc0(mac.length);
+		mac_length = SIPE_DIGEST_HMAC_SHA1_LENGTH;
 		sipe_digest_hmac_sha1(ctx->server_key, ctx->key_length,
 				      (guchar *) message, strlen(message),
-				      mac.value);
+				      mac);
 		break;
 
 	default:
@@ -182,12 +181,9 @@ sip_sec_verify_signature__tls_dsk(SipSecContext context,
 		break;
 	}
 
-	if (mac.value) {
-		result = memcmp(signature.value, mac.value, mac.length) == 0;
-		g_free(mac.value);
-	}
-
-	return(result);
+	return(mac_length &&
+	       (signature.length == mac_length) &&
+	       (memcmp(signature.value, mac, mac_length) == 0));
 }
 
 static void
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2009 pier11 <pier11@operamail.com>
  *
  *
@@ -103,6 +103,9 @@
 #define sip_sec_create_context__TLS_DSK    sip_sec_create_context__tls_dsk
 #define sip_sec_password__TLS_DSK          sip_sec_password__tls_dsk
 
+/* large enough for NTLM, TLS-DSK and Kerberos signatures */
+#define SIP_SEC_SIGNATURE_BUFFER 128
+
 /* Dummy initialization hook */
 static SipSecContext
 sip_sec_create_context__NONE(SIPE_UNUSED_PARAMETER guint type)
@@ -254,8 +257,11 @@ gboolean sip_sec_verify_signature(SipSecContext context,
 				  const gchar *message,
 				  const gchar *signature_hex)
 {
+	/* guint32 for alignment, see sip_sec_verify_signature__ntlm() */
+	guint32 buffer[SIP_SEC_SIGNATURE_BUFFER / sizeof(guint32)];
 	SipSecBuffer signature;
-	gboolean res;
+	gboolean res = FALSE;
+	gsize i;
 
 	SIPE_DEBUG_INFO("sip_sec_verify_signature: message is:%s signature to verify is:%s",
 			message ? message : "", signature_hex ? signature_hex : "");
@@ -263,9 +269,27 @@ gboolean sip_sec_verify_signature(SipSecContext context,
 	if (!message || !signature_hex)
 		return FALSE;
 
-	signature.length = hex_str_to_buff(signature_hex, &signature.value);
-	res = (*context->verify_signature_func)(context, message, signature);
-	g_free(signature.value);
+	/* decode into stack buffer, mechanism compares binary signatures */
+	signature.length = strlen(signature_hex) / 2;
+	signature.value  = (signature.length > sizeof(buffer)) ?
+		g_malloc(signature.length) :
+		(guint8 *) buffer;
+	for (i = 0; i < signature.length; i++) {
+		gint high = g_ascii_xdigit_value(signature_hex[2 * i]);
+		gint low  = g_ascii_xdigit_value(signature_hex[2 * i + 1]);
+
+		if ((high < 0) || (low < 0))
+			break;
+		signature.value[i] = (high << 4) | low;
+	}
+
+	if (i == signature.length)
+		res = (*context->verify_signature_func)(context, message, signature);
+	else
+		SIPE_DEBUG_ERROR_NOFORMAT("sip_sec_verify_signature: signature is not a hex string");
+
+	if (signature.value != (guint8 *) buffer)
+		g_free(signature.value);
 	return res;
 }
 
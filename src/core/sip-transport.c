@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -105,10 +105,13 @@ struct sip_transport {
 
 	gchar *user_agent;
 
-	GSList *transactions;
+	GHashTable *transactions;    /* transaction_key -> transaction */
 
 	struct sip_auth registrar;
 	struct sip_auth proxy;
+	GString *sign_buffer;        /* signature input, reused for all messages */
+	GString *send_buffer;        /* outbound messages, see send_sip_message() */
+	guint send_corked;           /* > 0: hold back outbound messages */
 
 	guint cseq;
 	guint register_attempt;
@@ -116,6 +119,12 @@ struct sip_transport {
 	guint keepalive_timeout;
 	time_t last_message;
 
+	/* incremental receive state: offsets into connection->buffer */
+	struct sipmsg *input_msg;    /* parsed header waiting for its body */
+	gsize input_read;            /* first unprocessed byte */
+	gsize input_scanned;         /* header scan resumes here */
+	gsize input_body;            /* start of body for input_msg */
+
 	gboolean processing_input;   /* whether full header received */
 	gboolean auth_incomplete;    /* whether authentication not completed */
 	gboolean auth_retry;         /* whether next authentication should be tried */
@@ -123,6 +132,7 @@ struct sip_transport {
 	gboolean reauthenticate_set; /* whether reauthenticate timer set */
 	gboolean subscribed;         /* whether subscribed to events, except buddies presence */
 	gboolean deregister;         /* whether in deregistration */
+	gboolean reconnecting;       /* whether warm reconnect not yet registered */
 };
 
 /* Keep in sync with sipe_transport_type! */
@@ -163,26 +173,29 @@ static void sipe_make_signature(struct sipe_core_private *sipe_private,
 {
 	struct sip_transport *transport = sipe_private->transport;
 	if (sip_sec_context_is_ready(transport->registrar.gssapi_context)) {
-		struct sipmsg_breakdown msgbd;
-		gchar *signature_input_str;
-		msgbd.msg = msg;
-		sipmsg_breakdown_parse(&msgbd, transport->registrar.realm, transport->registrar.target,
-				       transport->registrar.protocol);
-		msgbd.rand = g_strdup_printf("%08x", g_random_int());
+		gchar rand[9];
+		gchar num[12];
+
+		g_snprintf(rand, sizeof(rand), "%08x", g_random_int());
 		transport->registrar.ntlm_num++;
-		msgbd.num = g_strdup_printf("%d", transport->registrar.ntlm_num);
-		signature_input_str = sipmsg_breakdown_get_string(transport->registrar.version, &msgbd);
-		if (signature_input_str != NULL) {
-			char *signature_hex = sip_sec_make_signature(transport->registrar.gssapi_context, signature_input_str);
+		g_snprintf(num, sizeof(num), "%d", transport->registrar.ntlm_num);
+		if (sipe_sign_input(transport->sign_buffer,
+				    transport->registrar.version,
+				    msg,
+				    transport->registrar.protocol,
+				    transport->registrar.realm,
+				    transport->registrar.target,
+				    rand,
+				    num)) {
+			char *signature_hex = sip_sec_make_signature(transport->registrar.gssapi_context,
+								     transport->sign_buffer->str);
 			g_free(msg->signature);
 			msg->signature = signature_hex;
 			g_free(msg->rand);
-			msg->rand = g_strdup(msgbd.rand);
+			msg->rand = g_strdup(rand);
 			g_free(msg->num);
-			msg->num = g_strdup(msgbd.num);
-			g_free(signature_input_str);
+			msg->num = g_strdup(num);
 		}
-		sipmsg_breakdown_free(&msgbd);
 	}
 }
 
@@ -552,18 +565,69 @@ static const gchar *sip_transport_user_agent(struct sipe_core_private *sipe_priv
 	return(transport->user_agent);
 }
 
+/*
+ * Outbound messages are serialized directly into the send buffer.
+ *
+ * While the transport is corked, i.e. during input processing and while
+ * scheduled actions are executed, messages accumulate in the buffer. A
+ * burst of messages is then handed to the backend in one piece, i.e. it
+ * costs one write and TLS record instead of one per message.
+ */
+#define SIP_TRANSPORT_SEND_MAX (64 * 1024) /* send earlier if exceeded */
+
+static void sip_transport_send(struct sip_transport *transport)
+{
+	if (transport->send_buffer->len) {
+		sipe_backend_transport_message(transport->connection,
+					       transport->send_buffer->str);
+		g_string_truncate(transport->send_buffer, 0);
+	}
+}
+
+void sip_transport_cork(struct sipe_core_private *sipe_private)
+{
+	struct sip_transport *transport = sipe_private->transport;
+	if (transport)
+		transport->send_corked++;
+}
+
+void sip_transport_uncork(struct sipe_core_private *sipe_private)
+{
+	struct sip_transport *transport = sipe_private->transport;
+
+	/* transport might have been replaced while corked */
+	if (transport && transport->send_corked)
+		if (--transport->send_corked == 0)
+			sip_transport_send(transport);
+}
+
 /*
  * NOTE: Do *NOT* call sipe_backend_transport_message(...) directly!
  *
  * All SIP messages must pass through this function in order to update
  * the timestamp for keepalive tracking.
+ *
+ * @param start offset of the new message in the send buffer
  */
 static void send_sip_message(struct sip_transport *transport,
-			     const gchar *string)
+			     gsize start)
 {
-	sipe_utils_message_debug("SIP", string, NULL, TRUE);
+	GString *buffer = transport->send_buffer;
+
+	sipe_utils_message_debug("SIP", buffer->str + start, NULL, TRUE);
 	transport->last_message = time(NULL);
-	sipe_backend_transport_message(transport->connection, string);
+
+	if (!transport->send_corked ||
+	    (buffer->len >= SIP_TRANSPORT_SEND_MAX))
+		sip_transport_send(transport);
+}
+
+static void send_sip_msg(struct sip_transport *transport,
+			 const struct sipmsg *msg)
+{
+	gsize start = transport->send_buffer->len;
+	sipmsg_serialize(msg, transport->send_buffer);
+	send_sip_message(transport, start);
 }
 
 static void start_keepalive_timer(struct sipe_core_private *sipe_private,
@@ -576,8 +640,10 @@ static void keepalive_timeout(struct sipe_core_private *sipe_private,
 		guint since_last = time(NULL) - transport->last_message;
 		guint restart    = transport->keepalive_timeout;
 		if (since_last >= restart) {
+			gsize start = transport->send_buffer->len;
 			SIPE_DEBUG_INFO("keepalive_timeout: expired %d", restart);
-			send_sip_message(transport, "\r\n\r\n");
+			g_string_append(transport->send_buffer, "\r\n\r\n");
+			send_sip_message(transport, start);
 		} else {
 			/* timeout not reached since last message -> reschedule */
 			restart -= since_last;
@@ -603,9 +669,9 @@ void sip_transport_response(struct sipe_core_private *sipe_private,
 			    const char *text,
 			    const char *body)
 {
-	gchar *name;
-	gchar *value;
-	GString *outstr = g_string_new("");
+	struct sip_transport *transport = sipe_private->transport;
+	GString *outstr = transport->send_buffer;
+	gsize start = outstr->len;
 	gchar *contact;
 	GSList *tmp;
 	static const gchar *keepers[] = { "To", "From", "Call-ID", "CSeq", "Via", "Record-Route", NULL };
@@ -634,27 +700,125 @@ void sip_transport_response(struct sipe_core_private *sipe_private,
 	sign_outgoing_message(sipe_private, msg);
 
 	g_string_append_printf(outstr, "SIP/2.0 %d %s\r\n", code, text);
-	tmp = msg->headers;
-	while (tmp) {
-		name = ((struct sipnameval*) (tmp->data))->name;
-		value = ((struct sipnameval*) (tmp->data))->value;
-
-		g_string_append_printf(outstr, "%s: %s\r\n", name, value);
-		tmp = g_slist_next(tmp);
+	for (tmp = msg->headers; tmp; tmp = g_slist_next(tmp)) {
+		const struct sipnameval *elem = tmp->data;
+		g_string_append(outstr, elem->name);
+		g_string_append(outstr, ": ");
+		g_string_append(outstr, elem->value);
+		g_string_append(outstr, "\r\n");
 	}
-	g_string_append_printf(outstr, "\r\n%s", body ? body : "");
-	send_sip_message(sipe_private->transport, outstr->str);
-	g_string_free(outstr, TRUE);
+	g_string_append(outstr, "\r\n");
+	if (body)
+		g_string_append(outstr, body);
+	send_sip_message(transport, start);
+}
+
+/*
+ * Transactions are matched on (Call-ID, CSeq number, CSeq method).
+ *
+ * The key used for lookups points directly into the header values of the
+ * received message, i.e. finding a transaction doesn't allocate anything.
+ * The key stored in the table owns a copy of the strings, allocated in one
+ * block together with the key itself.
+ */
+struct transaction_key {
+	const gchar *call_id;
+	gsize call_id_length;
+	const gchar *method;
+	gsize method_length;
+	guint cseq;
+};
+
+static guint transaction_key_hash(gconstpointer data)
+{
+	const struct transaction_key *key = data;
+	guint hash = key->cseq;
+	gsize i;
+
+	/* case-insensitive to match the old g_ascii_strcasecmp() lookup */
+	for (i = 0; i < key->call_id_length; i++)
+		hash = (hash << 5) + hash + g_ascii_tolower(key->call_id[i]);
+	for (i = 0; i < key->method_length; i++)
+		hash = (hash << 5) + hash + g_ascii_tolower(key->method[i]);
+
+	return(hash);
+}
+
+static gboolean transaction_key_equal(gconstpointer a, gconstpointer b)
+{
+	const struct transaction_key *key1 = a;
+	const struct transaction_key *key2 = b;
+
+	return((key1->cseq           == key2->cseq)           &&
+	       (key1->call_id_length == key2->call_id_length) &&
+	       (key1->method_length  == key2->method_length)  &&
+	       (g_ascii_strncasecmp(key1->call_id,
+				    key2->call_id,
+				    key1->call_id_length) == 0) &&
+	       (g_ascii_strncasecmp(key1->method,
+				    key2->method,
+				    key1->method_length) == 0));
+}
+
+/* fills key with pointers into the message header values */
+static gboolean transaction_key_from_message(struct transaction_key *key,
+					     struct sipmsg *msg)
+{
+	const gchar *call_id = sipmsg_find_header(msg, "Call-ID");
+	const gchar *cseq    = sipmsg_find_header(msg, "CSeq");
+	const gchar *method;
+	gchar *end;
+
+	if (!call_id || !cseq)
+		return(FALSE);
+
+	key->call_id        = call_id;
+	key->call_id_length = strlen(call_id);
+	key->cseq           = strtoul(cseq, &end, 10);
+	if (end == cseq)
+		return(FALSE);
+
+	while (*end == ' ' || *end == '\t') end++;
+	method = end;
+	while (*end && *end != ' ' && *end != '\t') end++;
+	key->method        = method;
+	key->method_length = end - method;
+
+	return(TRUE);
+}
+
+static struct transaction_key *transaction_key_new(const gchar *call_id,
+						   guint cseq,
+						   const gchar *method)
+{
+	gsize call_id_length = strlen(call_id);
+	gsize method_length  = strlen(method);
+	struct transaction_key *key = g_malloc(sizeof(struct transaction_key) +
+					       call_id_length + method_length + 2);
+	gchar *strings = (gchar *) (key + 1);
+
+	memcpy(strings, call_id, call_id_length + 1);
+	memcpy(strings + call_id_length + 1, method, method_length + 1);
+	key->call_id        = strings;
+	key->call_id_length = call_id_length;
+	key->method         = strings + call_id_length + 1;
+	key->method_length  = method_length;
+	key->cseq           = cseq;
+
+	return(key);
 }
 
 static void transactions_remove(struct sipe_core_private *sipe_private,
 				struct transaction *trans)
 {
 	struct sip_transport *transport = sipe_private->transport;
-	if (transport->transactions) {
-		transport->transactions = g_slist_remove(transport->transactions,
-							 trans);
-		SIPE_DEBUG_INFO("SIP transactions count:%d after removal", g_slist_length(transport->transactions));
+	if (trans->hash_key &&
+	    (g_hash_table_lookup(transport->transactions,
+				 trans->hash_key) == trans)) {
+		/* frees trans->hash_key */
+		g_hash_table_remove(transport->transactions, trans->hash_key);
+		SIPE_DEBUG_INFO("SIP transactions count:%d after removal",
+				g_hash_table_size(transport->transactions));
 
 		if (trans->msg) sipmsg_free(trans->msg);
 		if (trans->payload) {
@@ -662,7 +826,6 @@ static void transactions_remove(struct sipe_core_private *sipe_private,
 				(*trans->payload->destroy)(trans->payload->data);
 			g_free(trans->payload);
 		}
-		g_free(trans->key);
 		if (trans->timeout_key) {
 			sipe_schedule_cancel(sipe_private, trans->timeout_key);
 			g_free(trans->timeout_key);
@@ -674,28 +837,14 @@ static void transactions_remove(struct sipe_core_private *sipe_private,
 static struct transaction *transactions_find(struct sip_transport *transport,
 					     struct sipmsg *msg)
 {
-	GSList *transactions = transport->transactions;
-	const gchar *call_id = sipmsg_find_header(msg, "Call-ID");
-	const gchar *cseq = sipmsg_find_header(msg, "CSeq");
-	gchar *key;
+	struct transaction_key key;
 
-	if (!call_id || !cseq) {
+	if (!transaction_key_from_message(&key, msg)) {
 		SIPE_DEBUG_ERROR_NOFORMAT("transaction_find: no Call-ID or CSeq!");
 		return NULL;
 	}
 
-	key = g_strdup_printf("<%s><%s>", call_id, cseq);
-	while (transactions) {
-		struct transaction *trans = transactions->data;
-		if (!g_ascii_strcasecmp(trans->key, key)) {
-			g_free(key);
-			return trans;
-		}
-		transactions = transactions->next;
-	}
-	g_free(key);
-
-	return NULL;
+	return(g_hash_table_lookup(transport->transactions, &key));
 }
 
 static void transaction_timeout_cb(struct sipe_core_private *sipe_private,
@@ -809,18 +958,17 @@ struct transaction *sip_transport_request_timeout(struct sipe_core_private *sipe
 	/* The authentication scheme is not ready so we can't send the message.
 	   This should only happen for REGISTER messages. */
 	if (!transport->auth_incomplete) {
-		buf = sipmsg_to_string(msg);
-
 		/* add to ongoing transactions */
 		/* ACK isn't supposed to be answered ever. So we do not keep transaction for it. */
 		if (!sipe_strequal(method, "ACK")) {
 			trans = g_new0(struct transaction, 1);
 			trans->callback = callback;
 			trans->msg = msg;
-			trans->key = g_strdup_printf("<%s><%d %s>", callid, cseq, method);
+			trans->hash_key = transaction_key_new(callid, cseq, method);
 			if (timeout_callback) {
 				trans->timeout_callback = timeout_callback;
-				trans->timeout_key = g_strdup_printf("<transaction timeout>%s", trans->key);
+				trans->timeout_key = g_strdup_printf("<transaction timeout><%s><%d %s>",
+								     callid, cseq, method);
 				sipe_schedule_seconds(sipe_private,
 						      trans->timeout_key,
 						      trans,
@@ -828,13 +976,30 @@ struct transaction *sip_transport_request_timeout(struct sipe_core_private *sipe
 						      transaction_timeout_cb,
 						      NULL);
 			}
-			transport->transactions = g_slist_append(transport->transactions,
-								 trans);
-			SIPE_DEBUG_INFO("SIP transactions count:%d after addition", g_slist_length(transport->transactions));
+			{
+				struct transaction *old = g_hash_table_lookup(transport->transactions,
+									      trans->hash_key);
+				if (old) {
+					SIPE_DEBUG_ERROR("sip_transport_request_timeout: replacing duplicate transaction <%s><%d %s>",
+							 callid, cseq, method);
+					transactions_remove(sipe_private, old);
+				}
+			}
+			g_hash_table_insert(transport->transactions,
+					    trans->hash_key,
+					    trans);
+			SIPE_DEBUG_INFO("SIP transactions count:%d after addition",
+					g_hash_table_size(transport->transactions));
 		}
 
-		send_sip_message(transport, buf);
-		g_free(buf);
+		/* transactions are sent by sip_transport_resend() after registration */
+		if (transport->reconnecting &&
+		    !sipe_strequal(method, "REGISTER"))
+			SIPE_DEBUG_INFO("sip_transport_request_timeout: %s %s while reconnecting",
+					trans ? "holding back" : "dropping",
+					method);
+		else
+			send_sip_msg(transport, msg);
 	}
 
 	if (!trans) sipmsg_free(msg);
@@ -863,6 +1028,40 @@ struct transaction *sip_transport_request(struct sipe_core_private *sipe_private
 					     NULL);
 }
 
+/* keep requests in the same dialog in CSeq order */
+static gint transaction_compare(gconstpointer a, gconstpointer b)
+{
+	const struct transaction_key *key1 = ((const struct transaction *) a)->hash_key;
+	const struct transaction_key *key2 = ((const struct transaction *) b)->hash_key;
+	gint result = g_ascii_strcasecmp(key1->call_id, key2->call_id);
+
+	if (result == 0)
+		result = (key1->cseq > key2->cseq) - (key1->cseq < key2->cseq);
+
+	return(result);
+}
+
+/* send requests again which were held back or lost during reconnect */
+static void sip_transport_resend(struct sipe_core_private *sipe_private)
+{
+	struct sip_transport *transport = sipe_private->transport;
+	GList *transactions = g_list_sort(g_hash_table_get_values(transport->transactions),
+					  transaction_compare);
+	GList *entry;
+
+	for (entry = transactions; entry; entry = entry->next) {
+		struct transaction *trans = entry->data;
+
+		if (!sipe_strequal(trans->msg->method, "REGISTER")) {
+			/* new security association -> new signature */
+			sipmsg_remove_header_now(trans->msg, "Authorization");
+			sign_outgoing_message(sipe_private, trans->msg);
+			send_sip_msg(transport, trans->msg);
+		}
+	}
+	g_list_free(transactions);
+}
+
 static void sip_transport_simple_request(struct sipe_core_private *sipe_private,
 					 const gchar *method,
 					 struct sip_dialog *dialog)
@@ -1184,6 +1383,24 @@ static gboolean process_register_response(struct sipe_core_private *sipe_private
                                         hdr = g_slist_next(hdr);
                                 }
 
+				if (!sipe_private->time_to_registered) {
+					sipe_private->time_to_registered = MAX((g_get_monotonic_time() -
+										sipe_private->connect_start) / 1000,
+									       1);
+					SIPE_DEBUG_INFO("process_register_response: registered %u ms after connect",
+							sipe_private->time_to_registered);
+				}
+				if (transport->reconnecting) {
+					transport->reconnecting = FALSE;
+					sipe_private->reconnect_latency = MAX((g_get_monotonic_time() -
+									       sipe_private->reconnect_start) / 1000,
+									      1);
+					SIPE_DEBUG_INFO("process_register_response: registered %u ms after connection loss (%u pending requests)",
+							sipe_private->reconnect_latency,
+							g_hash_table_size(transport->transactions) - 1);
+					sip_transport_resend(sipe_private);
+					sipe_subscriptions_check(sipe_private);
+				}
 				sipe_backend_connection_completed(SIPE_CORE_PUBLIC);
 
 				/* rejoin open chats to be able to use them by continue to send messages */
@@ -1483,6 +1700,7 @@ static void do_register(struct sipe_core_private *sipe_private,
 		/* Make sure that all messages are pushed to the server
 		   before the connection gets shut down */
 		SIPE_DEBUG_INFO_NOFORMAT("De-register from server. Flushing outstanding messages.");
+		sip_transport_send(transport);
 		sipe_backend_transport_flush(transport->connection);
 	}
 }
@@ -1507,10 +1725,18 @@ void sip_transport_disconnect(struct sipe_core_private *sipe_private)
 		g_free(transport->server_version);
 		g_free(transport->user_agent);
 
-		while (transport->transactions)
-			transactions_remove(sipe_private,
-					    transport->transactions->data);
+		if (transport->transactions) {
+			GList *transactions = g_hash_table_get_values(transport->transactions);
+			GList *entry;
+			for (entry = transactions; entry; entry = entry->next)
+				transactions_remove(sipe_private, entry->data);
+			g_list_free(transactions);
+			g_hash_table_destroy(transport->transactions);
+		}
 
+		sipmsg_free(transport->input_msg);
+		g_string_free(transport->sign_buffer, TRUE);
+		g_string_free(transport->send_buffer, TRUE);
 		g_free(transport);
 	}
 
@@ -1535,6 +1761,16 @@ guint sip_transport_port(struct sipe_core_private *sipe_private)
 	return sipe_private->transport->server_port;
 }
 
+guint sipe_core_time_to_registered(struct sipe_core_public *sipe_public)
+{
+	return(SIPE_CORE_PRIVATE->time_to_registered);
+}
+
+guint sipe_core_reconnect_latency(struct sipe_core_public *sipe_public)
+{
+	return(SIPE_CORE_PRIVATE->reconnect_latency);
+}
+
 static void process_input_message(struct sipe_core_private *sipe_private,
 				  struct sipmsg *msg)
 {
@@ -1596,8 +1832,6 @@ static void process_input_message(struct sipe_core_private *sipe_private,
 					transport->registrar.retries++;
 					SIPE_DEBUG_INFO("process_input_message: RE-REGISTER CSeq: %d", transport->cseq);
 				} else {
-					gchar *resend;
-
 					/* Are we registered? */
 					if (transport->reregister_set) {
 						SIPE_DEBUG_INFO_NOFORMAT("process_input_message: 401 response to non-REGISTER message. Retrying with new authentication.");
@@ -1614,9 +1848,7 @@ static void process_input_message(struct sipe_core_private *sipe_private,
 					}
 
 					/* Resend request */
-					resend = sipmsg_to_string(trans->msg);
-					send_sip_message(sipe_private->transport, resend);
-					g_free(resend);
+					send_sip_msg(transport, trans->msg);
 
 					/* Transaction not yet completed */
 					trans = NULL;
@@ -1654,17 +1886,13 @@ static void process_input_message(struct sipe_core_private *sipe_private,
 						}
 
 						if (auth) {
-							gchar *resend;
-
 							/* replace old proxy authentication with new one */
 							sipmsg_remove_header_now(trans->msg, "Proxy-Authorization");
 							sipmsg_add_header_now(trans->msg, "Proxy-Authorization", auth);
 							g_free(auth);
 
 							/* resend request with proxy authentication */
-							resend = sipmsg_to_string(trans->msg);
-							send_sip_message(sipe_private->transport, resend);
-							g_free(resend);
+							send_sip_msg(transport, trans->msg);
 
 							/* Transaction not yet completed */
 							trans = NULL;
@@ -1694,7 +1922,7 @@ static void process_input_message(struct sipe_core_private *sipe_private,
 				 * Redirect case: sipe_private->transport is
 				 * the new transport with empty queue
 				 */
-				if (sipe_private->transport->transactions) {
+				if (g_hash_table_size(sipe_private->transport->transactions)) {
 					SIPE_DEBUG_INFO("process_input_message: removing CSeq %d", transport->cseq);
 					transactions_remove(sipe_private, trans);
 				}
@@ -1710,53 +1938,122 @@ static void process_input_message(struct sipe_core_private *sipe_private,
 	}
 }
 
+/*
+ * Incremental receive
+ *
+ * The connection buffer is consumed through a read cursor. Scanning for the
+ * end of the header resumes where the previous scan stopped and a parsed
+ * header is kept until its body has been received completely. A message
+ * split over many reads is therefore scanned and parsed only once.
+ *
+ * Unprocessed data is moved to the start of the buffer at most once per
+ * input event, not after every message.
+ */
+static struct sipmsg *sip_transport_input_message(struct sip_transport *transport)
+{
+	struct sipe_transport_connection *conn = transport->connection;
+	gchar *buffer = conn->buffer;
+	struct sipmsg *msg = transport->input_msg;
+	gchar *body;
+	gsize body_end;
+
+	if (!msg) {
+		gchar *start = buffer + transport->input_read;
+		gchar *end;
+
+		/* according to the RFC remove CRLF at the beginning */
+		while (*start == '\r' || *start == '\n') {
+			start++;
+		}
+		transport->input_read = start - buffer;
+		if (transport->input_scanned < transport->input_read)
+			transport->input_scanned = transport->input_read;
+
+		/* Received a full Header? */
+		end = strstr(buffer + transport->input_scanned, "\r\n\r\n");
+		if (!end) {
+			/* next scan must include a partial terminator */
+			if (conn->buffer_used > transport->input_read + 3)
+				transport->input_scanned = conn->buffer_used - 3;
+			return(NULL);
+		}
+
+		end[2] = '\0';
+		msg = sipmsg_parse_header(start);
+		end[2] = '\r';
+
+		/* corrupted header: retry with more data */
+		if (!msg)
+			return(NULL);
+
+		transport->input_msg     = msg;
+		transport->input_body    = end + 4 - buffer;
+		transport->input_scanned = transport->input_body;
+	}
+
+	/* Received the full body? */
+	if ((msg->bodylen < 0) ||
+	    (conn->buffer_used - transport->input_body < (gsize) msg->bodylen)) {
+		SIPE_DEBUG_INFO("sip_transport_input_message: body too short (%" G_GSIZE_FORMAT " < %d) - waiting for more data",
+				conn->buffer_used - transport->input_body,
+				msg->bodylen);
+		return(NULL);
+	}
+
+	body     = buffer + transport->input_body;
+	body_end = transport->input_body + msg->bodylen;
+	if (body_end == conn->buffer_used) {
+		/* body is already terminated by the buffer terminator */
+		msg->body          = body;
+		msg->body_borrowed = TRUE;
+	} else {
+		msg->body = g_malloc(msg->bodylen + 1);
+		memcpy(msg->body, body, msg->bodylen);
+		msg->body[msg->bodylen] = '\0';
+	}
+
+	/* header without the terminating empty line */
+	body[-2] = '\0';
+	sipe_utils_message_debug("SIP",
+				 buffer + transport->input_read,
+				 msg->body,
+				 FALSE);
+	body[-2] = '\r';
+
+	transport->input_msg     = NULL;
+	transport->input_read    = body_end;
+	transport->input_scanned = body_end;
+
+	return(msg);
+}
+
+static void sip_transport_input_compact(struct sip_transport *transport)
+{
+	gsize read = transport->input_read;
+
+	if (read) {
+		struct sipe_transport_connection *conn = transport->connection;
+
+		sipe_utils_shrink_buffer(conn, conn->buffer + read);
+		transport->input_read     = 0;
+		transport->input_scanned -= read;
+		if (transport->input_msg)
+			transport->input_body -= read;
+	}
+}
+
 static void sip_transport_input(struct sipe_transport_connection *conn)
 {
 	struct sipe_core_private *sipe_private = conn->user_data;
 	struct sip_transport *transport = sipe_private->transport;
-	gchar *cur = conn->buffer;
+	struct sipmsg *msg;
 
-	/* according to the RFC remove CRLF at the beginning */
-	while (*cur == '\r' || *cur == '\n') {
-		cur++;
-	}
-	if (cur != conn->buffer)
-		sipe_utils_shrink_buffer(conn, cur);
+	/* send all responses & requests triggered by this input at once */
+	sip_transport_cork(sipe_private);
 
-	/* Received a full Header? */
 	transport->processing_input = TRUE;
 	while (transport->processing_input &&
-	       ((cur = strstr(conn->buffer, "\r\n\r\n")) != NULL)) {
-		struct sipmsg *msg;
-		guint remainder;
-
-		cur += 2;
-		cur[0] = '\0';
-		msg = sipmsg_parse_header(conn->buffer);
-
-		cur += 2;
-		remainder = conn->buffer_used - (cur - conn->buffer);
-		if (msg && remainder >= (guint) msg->bodylen) {
-			char *dummy = g_malloc(msg->bodylen + 1);
-			memcpy(dummy, cur, msg->bodylen);
-			dummy[msg->bodylen] = '\0';
-			msg->body = dummy;
-			cur += msg->bodylen;
-			sipe_utils_message_debug("SIP",
-						 conn->buffer,
-						 msg->body,
-						 FALSE);
-			sipe_utils_shrink_buffer(conn, cur);
-		} else {
-			if (msg) {
-				SIPE_DEBUG_INFO("sipe_transport_input: body too short (%d < %d, strlen %d) - ignoring message", remainder, msg->bodylen, (int)strlen(conn->buffer));
-				sipmsg_free(msg);
-                        }
-
-			/* restore header for next try */
-			cur[-2] = '\r';
-			return;
-		}
+	       ((msg = sip_transport_input_message(transport)) != NULL)) {
 
 		/* Fatal header parse error? */
 		if (msg->response == SIPMSG_RESPONSE_FATAL_ERROR) {
@@ -1768,13 +2065,18 @@ static void sip_transport_input(struct sipe_transport_connection *conn)
 
 		/* Verify the signature before processing it */
 		} else if (sip_sec_context_is_ready(transport->registrar.gssapi_context)) {
-			struct sipmsg_breakdown msgbd;
-			gchar *signature_input_str;
+			const gchar *signature_input_str = NULL;
 			gchar *rspauth;
-			msgbd.msg = msg;
-			sipmsg_breakdown_parse(&msgbd, transport->registrar.realm, transport->registrar.target,
-					       transport->registrar.protocol);
-			signature_input_str = sipmsg_breakdown_get_string(transport->registrar.version, &msgbd);
+
+			if (sipe_sign_input(transport->sign_buffer,
+					    transport->registrar.version,
+					    msg,
+					    transport->registrar.protocol,
+					    transport->registrar.realm,
+					    transport->registrar.target,
+					    NULL,
+					    NULL))
+				signature_input_str = transport->sign_buffer->str;
 
 			rspauth = sipmsg_find_part_of_header(sipmsg_find_header(msg, "Authentication-Info"), "rspauth=\"", "\"", NULL);
 
@@ -1805,20 +2107,20 @@ static void sip_transport_input(struct sipe_transport_connection *conn)
 				}
 				SIPE_DEBUG_INFO_NOFORMAT("sip_transport_input: message without authentication data - ignoring");
 			}
-			g_free(signature_input_str);
-
 			g_free(rspauth);
-			sipmsg_breakdown_free(&msgbd);
 		} else {
 			process_input_message(sipe_private, msg);
 		}
 
 		sipmsg_free(msg);
 
-		/* Redirect: old content of "transport" & "conn" is no longer valid */
+		/* Redirect: old content of "transport" is no longer valid */
 		transport = sipe_private->transport;
-		conn      = transport->connection;
 	}
+
+	sip_transport_input_compact(transport);
+
+	sip_transport_uncork(sipe_private);
 }
 
 static void sip_transport_connected(struct sipe_transport_connection *conn)
@@ -1829,6 +2131,8 @@ static void sip_transport_connected(struct sipe_transport_connection *conn)
 	sipe_private->service_data = NULL;
 	sipe_private->address_data = NULL;
 
+	sipe_utils_buffer_high_water(sipe_private, conn);
+
 	/*
 	 * Initial keepalive timeout during REGISTER phase
 	 *
@@ -1844,10 +2148,90 @@ static void resolve_next_service(struct sipe_core_private *sipe_private,
 				 const struct sip_service_data *start);
 static void resolve_next_address(struct sipe_core_private *sipe_private,
 				 gboolean initial);
+static void sip_transport_error(struct sipe_transport_connection *conn,
+				const gchar *msg);
+
+/*
+ * Warm reconnect
+ *
+ * Losing the connection after a successful registration doesn't end the
+ * session. We connect again to the same server, i.e. without DNS lookups,
+ * and register. The registration uses the same Call-ID, so the server sees
+ * a refresh of the existing registration.
+ *
+ * The security association belongs to the connection and is negotiated
+ * again. This is cheap, because the TLS-DSK certificate and the web tickets
+ * are cached.
+ *
+ * Everything else is kept: buddies and their presence, subscription dialogs
+ * and their refresh timers. Requests without response and requests made
+ * while reconnecting stay in the transaction table and are sent again after
+ * the registration.
+ *
+ * The server may have dropped subscription dialogs during the outage. After
+ * the registration every dialog is refreshed and the ones the server no
+ * longer knows are subscribed again, see sipe_subscriptions_check().
+ *
+ * If the new connection fails before it is registered, we fall back to the
+ * normal connection error handling.
+ */
+static void sip_transport_reconnect(struct sipe_core_private *sipe_private)
+{
+	struct sip_transport *transport = sipe_private->transport;
+	sipe_connect_setup setup = {
+		transport->connection->type,
+		transport->server_name,
+		transport->server_port,
+		sipe_private,
+		sip_transport_connected,
+		sip_transport_input,
+		sip_transport_error
+	};
+	GList *transactions = g_hash_table_get_values(transport->transactions);
+	GList *entry;
+
+	sipe_private->reconnect_start = g_get_monotonic_time();
+	transport->reconnecting       = TRUE;
+
+	sipe_schedule_cancel(sipe_private, "<registration>");
+	sipe_schedule_cancel(sipe_private, "<+reauthentication>");
+	sipe_schedule_cancel(sipe_private, "<+keepalive-timeout>");
+
+	/* do_register() starts a new REGISTER transaction */
+	for (entry = transactions; entry; entry = entry->next) {
+		struct transaction *trans = entry->data;
+		if (sipe_strequal(trans->msg->method, "REGISTER"))
+			transactions_remove(sipe_private, trans);
+	}
+	g_list_free(transactions);
+
+	sipe_auth_free(&transport->registrar);
+	sipe_auth_free(&transport->proxy);
+	transport->auth_retry         = TRUE;
+	transport->reregister_set     = FALSE;
+	transport->reauthenticate_set = FALSE;
+	transport->register_attempt   = 0;
+
+	/* unsent requests are in the transaction table */
+	g_string_truncate(transport->send_buffer, 0);
+
+	sipmsg_free(transport->input_msg);
+	transport->input_msg        = NULL;
+	transport->input_read       = 0;
+	transport->input_scanned    = 0;
+	transport->input_body       = 0;
+	transport->processing_input = FALSE;
+
+	sipe_backend_transport_disconnect(transport->connection);
+	transport->connection = sipe_backend_transport_connect(SIPE_CORE_PUBLIC,
+							       &setup);
+}
+
 static void sip_transport_error(struct sipe_transport_connection *conn,
 				const gchar *msg)
 {
 	struct sipe_core_private *sipe_private = conn->user_data;
+	struct sip_transport *transport = sipe_private->transport;
 
 	/* This failed attempt was based on a DNS SRV record */
 	if (sipe_private->service_data) {
@@ -1855,6 +2239,16 @@ static void sip_transport_error(struct sipe_transport_connection *conn,
 	/* This failed attempt was based on a DNS A record */
 	} else if (sipe_private->address_data) {
 		resolve_next_address(sipe_private, FALSE);
+	/* Registered connection was lost */
+	} else if (transport &&
+		   transport->subscribed &&
+		   !transport->reconnecting &&
+		   !transport->deregister) {
+		SIPE_DEBUG_INFO("sip_transport_error: %s - reconnecting to %s:%u",
+				msg,
+				transport->server_name,
+				transport->server_port);
+		sip_transport_reconnect(sipe_private);
 	} else {
 		sipe_backend_connection_error(SIPE_CORE_PUBLIC,
 					      SIPE_CONNECTION_ERROR_NETWORK,
@@ -1881,6 +2275,12 @@ static void sipe_server_register(struct sipe_core_private *sipe_private,
 	struct sip_transport *transport = g_new0(struct sip_transport, 1);
 
 	transport->auth_retry   = TRUE;
+	transport->sign_buffer  = g_string_sized_new(512);
+	transport->send_buffer  = g_string_sized_new(4096);
+	transport->transactions = g_hash_table_new_full(transaction_key_hash,
+							transaction_key_equal,
+							g_free,
+							NULL);
 	transport->server_name  = server_name;
 	transport->server_port  = setup.server_port;
 	transport->connection   = sipe_backend_transport_connect(SIPE_CORE_PUBLIC,
@@ -2076,6 +2476,9 @@ void sipe_core_transport_sip_connect(struct sipe_core_public *sipe_public,
 {
 	struct sipe_core_private *sipe_private = SIPE_CORE_PRIVATE;
 
+	/* includes certificate initialization */
+	sipe_private->connect_start = g_get_monotonic_time();
+
 	/* backend initialization is complete */
 	sipe_core_backend_initialized(sipe_private, authentication);
 
@@ -2117,14 +2520,48 @@ const gchar *sipe_core_transport_sip_server_name(struct sipe_core_public *sipe_p
 	return(transport ? transport->server_name : NULL);
 }
 
-int sip_transaction_cseq(struct transaction *trans)
+gsize sipe_core_transport_buffer_reserve(struct sipe_transport_connection *conn,
+					 gsize minimum)
+{
+	/* +1 for the string terminator */
+	gsize needed = conn->buffer_used + minimum + 1;
+
+	if (conn->buffer_length < needed) {
+		gsize length = MAX(conn->buffer_length,
+				   SIPE_TRANSPORT_BUFFER_INITIAL);
+
+		while (length < needed)
+			length *= 2;
+
+		conn->buffer        = g_realloc(conn->buffer, length);
+		conn->buffer_length = length;
+		SIPE_DEBUG_INFO("sipe_core_transport_buffer_reserve: new buffer length %" G_GSIZE_FORMAT,
+				length);
+	}
+
+	return(conn->buffer_length - conn->buffer_used - 1);
+}
+
+void sipe_core_transport_buffer_release(struct sipe_transport_connection *conn)
 {
-	int cseq;
+	gsize high_water = conn->buffer_high_water ?
+		conn->buffer_high_water : SIPE_TRANSPORT_BUFFER_HIGH_WATER;
+
+	if ((conn->buffer_used == 0) &&
+	    (conn->buffer_length > high_water)) {
+		g_free(conn->buffer);
+		conn->buffer        = g_malloc(SIPE_TRANSPORT_BUFFER_INITIAL);
+		conn->buffer_length = SIPE_TRANSPORT_BUFFER_INITIAL;
+		conn->buffer[0]     = '\0';
+		SIPE_DEBUG_INFO_NOFORMAT("sipe_core_transport_buffer_release: buffer shrunk");
+	}
+}
 
-	g_return_val_if_fail(trans && trans->key, 0);
+int sip_transaction_cseq(struct transaction *trans)
+{
+	g_return_val_if_fail(trans && trans->hash_key, 0);
 
-	sscanf(trans->key, "<%*[a-zA-Z0-9]><%d INVITE>", &cseq);
-	return cseq;
+	return(trans->hash_key->cseq);
 }
 
 /*
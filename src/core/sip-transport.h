@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,6 +25,7 @@ struct sipmsg;
 struct sip_dialog;
 struct sipe_core_private;
 struct transaction;
+struct transaction_key;
 
 /* Transaction that can be associated with a SIP request */
 typedef gboolean (*TransCallback) (struct sipe_core_private *,
@@ -40,12 +41,12 @@ struct transaction {
 	TransCallback callback;
 	TransCallback timeout_callback;
 
+	gchar *timeout_key;
 	/** Not yet perfect, but surely better then plain CSeq
-	 * Format is: <Call-ID><CSeq>
+	 * Matches on Call-ID, CSeq number and CSeq method
 	 * (RFC3261 17.2.3 for matching server transactions: Request-URI, To tag, From tag, Call-ID, CSeq, and top Via)
 	 */
-	gchar *key;
-	gchar *timeout_key;
+	struct transaction_key *hash_key; /* private to sip-transport.c */
         struct sipmsg *msg;
 	struct transaction_payload *payload;
 };
@@ -115,6 +116,10 @@ void sip_transport_deregister(struct sipe_core_private *sipe_private);
 void sip_transport_disconnect(struct sipe_core_private *sipe_private);
 void sip_transport_authentication_completed(struct sipe_core_private *sipe_private);
 
+/* Hold back outbound messages, uncork sends them in one piece (nestable) */
+void sip_transport_cork(struct sipe_core_private *sipe_private);
+void sip_transport_uncork(struct sipe_core_private *sipe_private);
+
 int sip_transaction_cseq(struct transaction *trans);
 
 /*
@@ -66,6 +66,9 @@ struct sipe_buddies {
 	GHashTable *uri;
 	GHashTable *exchange_key;
 
+	/* Strings shared by all buddies */
+	struct sipe_string_pool *strings;
+
 	/* Pending photo download HTTP requests */
 	GSList *pending_photo_requests;
 };
@@ -79,12 +82,47 @@ struct photo_response_data {
 	gchar *who;
 	gchar *photo_hash;
 	struct sipe_http_request *request;
+	GByteArray *photo; /* streamed photo data */
 };
 
 static void buddy_fetch_photo(struct sipe_core_private *sipe_private,
 			      const gchar *uri);
 static void photo_response_data_free(struct photo_response_data *data);
 
+void sipe_buddy_set_string(struct sipe_core_private *sipe_private,
+			   const gchar **field,
+			   const gchar *value)
+{
+	struct sipe_string_pool *strings = sipe_private->buddies->strings;
+	const gchar *old = *field;
+
+	/* take new reference first, value may be the same string */
+	*field = sipe_string_pool_ref(strings, value);
+	sipe_string_pool_unref(strings, old);
+}
+
+struct sipe_buddy_calendar *sipe_buddy_calendar(struct sipe_buddy *buddy)
+{
+	if (!buddy->cal)
+		buddy->cal = g_new0(struct sipe_buddy_calendar, 1);
+	return(buddy->cal);
+}
+
+static void buddy_calendar_free(struct sipe_core_private *sipe_private,
+				struct sipe_buddy_calendar *cal)
+{
+	if (cal) {
+		struct sipe_string_pool *strings = sipe_private->buddies->strings;
+
+		g_free(cal->meeting_subject);
+		g_free(cal->meeting_location);
+		g_free(cal->free_busy);
+		sipe_cal_free_working_hours(cal->working_hours);
+		sipe_string_pool_unref(strings, cal->last_non_cal_activity);
+		g_free(cal);
+	}
+}
+
 void sipe_buddy_add_keys(struct sipe_core_private *sipe_private,
 			 struct sipe_buddy *buddy,
 			 const gchar *exchange_key,
@@ -363,7 +401,8 @@ void sipe_buddy_foreach(struct sipe_core_private *sipe_private,
 			     callback_data);
 }
 
-static void buddy_free(struct sipe_buddy *buddy)
+static void buddy_free(struct sipe_core_private *sipe_private,
+		       struct sipe_buddy *buddy)
 {
 #ifndef _WIN32
 	 /*
@@ -383,28 +422,19 @@ static void buddy_free(struct sipe_buddy *buddy)
 #endif
 	g_free(buddy->exchange_key);
 	g_free(buddy->change_key);
-	g_free(buddy->activity);
-	g_free(buddy->meeting_subject);
-	g_free(buddy->meeting_location);
+	sipe_string_pool_unref(sipe_private->buddies->strings, buddy->activity);
 	g_free(buddy->note);
-
-	g_free(buddy->cal_start_time);
-	g_free(buddy->cal_free_busy_base64);
-	g_free(buddy->cal_free_busy);
-	g_free(buddy->last_non_cal_activity);
-
-	sipe_cal_free_working_hours(buddy->cal_working_hours);
-
-	g_free(buddy->device_name);
+	buddy_calendar_free(sipe_private, buddy->cal);
+	sipe_string_pool_unref(sipe_private->buddies->strings, buddy->device_name);
 	sipe_utils_slist_free_full(buddy->groups, buddy_group_free);
 	g_free(buddy);
 }
 
 static gboolean buddy_free_cb(SIPE_UNUSED_PARAMETER gpointer key,
 			      gpointer buddy,
-			      SIPE_UNUSED_PARAMETER gpointer user_data)
+			      gpointer user_data)
 {
-	buddy_free(buddy);
+	buddy_free(user_data, buddy);
 	/* We must return TRUE as the key/value have already been deleted */
 	return(TRUE);
 }
@@ -415,7 +445,7 @@ void sipe_buddy_free(struct sipe_core_private *sipe_private)
 
 	g_hash_table_foreach_steal(buddies->uri,
 				   buddy_free_cb,
-				   NULL);
+				   sipe_private);
 
 	/* core is being deallocated, remove all its pending photo requests */
 	while (buddies->pending_photo_requests) {
@@ -428,6 +458,7 @@ void sipe_buddy_free(struct sipe_core_private *sipe_private)
 
 	g_hash_table_destroy(buddies->uri);
 	g_hash_table_destroy(buddies->exchange_key);
+	sipe_string_pool_free(buddies->strings);
 	g_free(buddies);
 	sipe_private->buddies = NULL;
 }
@@ -479,7 +510,7 @@ static gboolean buddy_check_obsolete_flag(SIPE_UNUSED_PARAMETER gpointer key,
 		}
 		g_slist_free(buddies);
 
-		buddy_free(buddy);
+		buddy_free(sipe_private, buddy);
 		/* return TRUE as the key/value have already been deleted */
 		return(TRUE);
 
@@ -694,7 +725,7 @@ void sipe_buddy_remove(struct sipe_core_private *sipe_private,
 		g_hash_table_remove(buddies->exchange_key,
 				    buddy->exchange_key);
 
-	buddy_free(buddy);
+	buddy_free(sipe_private, buddy);
 }
 
 /**
@@ -805,8 +836,10 @@ void sipe_core_buddy_tooltip_info(struct sipe_core_public *sipe_public,
 			is_oof_note = sbuddy->is_oof_note;
 			activity = sbuddy->activity;
 			calendar = sipe_cal_get_description(sbuddy);
-			meeting_subject = sbuddy->meeting_subject;
-			meeting_location = sbuddy->meeting_location;
+			if (sbuddy->cal) {
+				meeting_subject = sbuddy->cal->meeting_subject;
+				meeting_location = sbuddy->cal->meeting_location;
+			}
 		}
 		if (SIPE_CORE_PRIVATE_FLAG_IS(OCS2007)) {
 			gboolean is_group_access = FALSE;
@@ -1774,6 +1807,8 @@ static void photo_response_data_free(struct photo_response_data *data)
 	if (data->request) {
 		sipe_http_request_cancel(data->request);
 	}
+	if (data->photo)
+		g_byte_array_free(data->photo, TRUE);
 	g_free(data);
 }
 
@@ -1786,31 +1821,36 @@ static void photo_response_data_remove(struct sipe_core_private *sipe_private,
 	photo_response_data_free(data);
 }
 
+static void process_buddy_photo_body(SIPE_UNUSED_PARAMETER struct sipe_core_private *sipe_private,
+				     const gchar *data,
+				     gsize length,
+				     gpointer callback_data)
+{
+	struct photo_response_data *rdata = callback_data;
+
+	if (!rdata->photo)
+		rdata->photo = g_byte_array_new();
+	g_byte_array_append(rdata->photo, (const guint8 *) data, length);
+}
+
 static void process_buddy_photo_response(struct sipe_core_private *sipe_private,
 					 guint status,
-					 GSList *headers,
-					 const char *body,
+					 SIPE_UNUSED_PARAMETER GSList *headers,
+					 SIPE_UNUSED_PARAMETER const char *body,
 					 gpointer data)
 {
 	struct photo_response_data *rdata = (struct photo_response_data *) data;
 
-	if (status == SIPE_HTTP_STATUS_OK) {
-		const gchar *len_str = sipe_utils_nameval_find(headers,
-							       "Content-Length");
-		if (len_str) {
-			gsize photo_size = atoi(len_str);
-			gpointer photo = g_new(char, photo_size);
-
-			if (photo) {
-				memcpy(photo, body, photo_size);
-
-				sipe_backend_buddy_set_photo(SIPE_CORE_PUBLIC,
-							     rdata->who,
-							     photo,
-							     photo_size,
-							     rdata->photo_hash);
-			}
-		}
+	if ((status == SIPE_HTTP_STATUS_OK) && rdata->photo) {
+		gsize photo_size = rdata->photo->len;
+
+		/* backend frees "photo" */
+		sipe_backend_buddy_set_photo(SIPE_CORE_PUBLIC,
+					     rdata->who,
+					     g_byte_array_free(rdata->photo, FALSE),
+					     photo_size,
+					     rdata->photo_hash);
+		rdata->photo = NULL;
 	}
 
 	photo_response_data_remove(sipe_private, rdata);
@@ -1987,6 +2027,11 @@ void sipe_buddy_update_photo(struct sipe_core_private *sipe_private,
 							      headers,
 							      process_buddy_photo_response,
 							      data);
+			if (data->request) {
+				sipe_http_request_allow_pipelining(data->request);
+				sipe_http_request_stream_body(data->request,
+							      process_buddy_photo_body);
+			}
 		}
 
 		photo_response_data_finalize(sipe_private,
@@ -2406,42 +2451,89 @@ guint sipe_buddy_count(struct sipe_core_private *sipe_private)
 	return(g_hash_table_size(sipe_private->buddies->uri));
 }
 
-static guint sipe_ht_hash_nick(const char *nick)
-{
-	char *lc = g_utf8_strdown(nick, -1);
-	guint bucket = g_str_hash(lc);
-	g_free(lc);
+struct buddy_memory {
+	guint buddies;
+	guint calendars;
+	gsize bytes;
+	gsize free_busy;
+};
 
-	return bucket;
+static gsize buddy_memory_string(const gchar *string)
+{
+	return(string ? strlen(string) + 1 : 0);
 }
 
-static gboolean sipe_ht_equals_nick(const char *nick1, const char *nick2)
+static void buddy_memory_cb(SIPE_UNUSED_PARAMETER gpointer key,
+			    gpointer value,
+			    gpointer user_data)
 {
-	char *nick1_norm = NULL;
-	char *nick2_norm = NULL;
-	gboolean equal;
+	const struct sipe_buddy *buddy = value;
+	const struct sipe_buddy_calendar *cal = buddy->cal;
+	struct buddy_memory *memory = user_data;
 
-	if (nick1 == NULL && nick2 == NULL) return TRUE;
-	if (nick1 == NULL || nick2 == NULL    ||
-	    !g_utf8_validate(nick1, -1, NULL) ||
-	    !g_utf8_validate(nick2, -1, NULL)) return FALSE;
+	/* shared strings are accounted for by the string pool */
+	memory->buddies++;
+	memory->bytes += sizeof(struct sipe_buddy) +
+		buddy_memory_string(buddy->name) +
+		buddy_memory_string(buddy->exchange_key) +
+		buddy_memory_string(buddy->change_key) +
+		buddy_memory_string(buddy->note) +
+		g_slist_length(buddy->groups) *
+		(sizeof(GSList) + sizeof(struct buddy_group_data));
 
-	nick1_norm = g_utf8_casefold(nick1, -1);
-	nick2_norm = g_utf8_casefold(nick2, -1);
-	equal = g_utf8_collate(nick1_norm, nick2_norm) == 0;
-	g_free(nick2_norm);
-	g_free(nick1_norm);
+	if (cal) {
+		memory->calendars++;
+		gsize free_busy = (cal->free_busy_slots + 3) / 4;
 
-	return equal;
+		memory->free_busy += free_busy;
+		memory->bytes += sizeof(struct sipe_buddy_calendar) +
+			buddy_memory_string(cal->meeting_subject) +
+			buddy_memory_string(cal->meeting_location) +
+			free_busy +
+			sipe_cal_working_hours_size(cal->working_hours);
+	}
+}
+
+gchar *sipe_core_buddy_memory_usage(struct sipe_core_public *sipe_public)
+{
+	struct sipe_core_private *sipe_private = SIPE_CORE_PRIVATE;
+	struct sipe_buddies *buddies = sipe_private->buddies;
+	struct buddy_memory memory;
+	guint strings, references;
+	gsize string_bytes, total;
+	gchar *report;
+
+	memset(&memory, 0, sizeof(memory));
+	g_hash_table_foreach(buddies->uri, buddy_memory_cb, &memory);
+	sipe_string_pool_stats(buddies->strings,
+			       &strings,
+			       &string_bytes,
+			       &references);
+	total = memory.bytes + string_bytes;
+
+	/* debug command: not translated */
+	report = g_strdup_printf("buddies: %u\n"
+				 "with calendar data: %u (%" G_GSIZE_FORMAT " bytes free/busy)\n"
+				 "shared strings: %u (%" G_GSIZE_FORMAT " bytes, %u references)\n"
+				 "total: %" G_GSIZE_FORMAT " bytes (%" G_GSIZE_FORMAT " bytes/buddy)",
+				 memory.buddies,
+				 memory.calendars, memory.free_busy,
+				 strings, string_bytes, references,
+				 total,
+				 memory.buddies ? total / memory.buddies : 0);
+	SIPE_DEBUG_INFO("sipe_core_buddy_memory_usage:\n%s", report);
+
+	return(report);
 }
 
 void sipe_buddy_init(struct sipe_core_private *sipe_private)
 {
 	struct sipe_buddies *buddies = g_new0(struct sipe_buddies, 1);
-	buddies->uri          = g_hash_table_new((GHashFunc)  sipe_ht_hash_nick,
-						 (GEqualFunc) sipe_ht_equals_nick);
+	buddies->uri          = g_hash_table_new(sipe_utils_uri_hash,
+						 sipe_utils_uri_equal);
 	buddies->exchange_key = g_hash_table_new(g_str_hash,
 						 g_str_equal);
+	buddies->strings      = sipe_string_pool_new();
 	sipe_private->buddies = buddies;
 }
 
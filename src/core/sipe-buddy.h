@@ -26,44 +26,87 @@ struct sipe_cal_working_hours;
 struct sipe_core_private;
 struct sipe_group;
 
+/**
+ * Rarely used buddy data, allocated on first use.
+ *
+ * Only buddies with calendar information, meetings or OCS2005 presence
+ * need this part.
+ */
+struct sipe_buddy_calendar {
+	gchar *meeting_subject;
+	gchar *meeting_location;
+
+	time_t start_time;
+	int granularity;
+	/* free/busy bitmap, see sipe-free-busy.h */
+	guchar *free_busy;
+	gsize free_busy_slots;
+	time_t free_busy_published;
+	struct sipe_cal_working_hours *working_hours;
+
+	/* for 2005 systems */
+	int user_avail;
+	time_t user_avail_since;
+	time_t activity_since;
+	const char *last_non_cal_status_id;
+	/* shared string, see sipe_buddy_set_string() */
+	const gchar *last_non_cal_activity;
+};
+
 struct sipe_buddy {
 	gchar *name;
 	gchar *exchange_key;
 	gchar *change_key;
-	gchar *activity;
-	gchar *meeting_subject;
-	gchar *meeting_location;
+	/* shared string, see sipe_buddy_set_string() */
+	const gchar *activity;
 	/* Sipe internal format for Note is HTML.
 	 * All incoming plain text should be html-escaped
 	 * for example by g_markup_escape_text()
 	 */
 	gchar *note;
-	gboolean is_oof_note;
-	gboolean is_mobile;
 	time_t note_since;
 
-	/* Calendar related fields */
-	gchar *cal_start_time;
-	int cal_granularity;
-	gchar *cal_free_busy_base64;
-	gchar *cal_free_busy;
-	time_t cal_free_busy_published;
-	/* for 2005 systems */
-	int user_avail;
-	time_t user_avail_since;
-	time_t activity_since;
-	const char *last_non_cal_status_id;
-	gchar *last_non_cal_activity;
+	/* shared string, see sipe_buddy_set_string() */
+	const gchar *device_name;
+	GSList *groups;
 
-	struct sipe_cal_working_hours *cal_working_hours;
+	/* may be NULL, see sipe_buddy_calendar() */
+	struct sipe_buddy_calendar *cal;
 
-	gchar *device_name;
-	GSList *groups;
+	guint is_oof_note : 1;
+	guint is_mobile : 1;
 	 /** flag to control sending 'context' element in 2007 subscriptions */
-	gboolean just_added;
-	gboolean is_obsolete;
+	guint just_added : 1;
+	guint is_obsolete : 1;
 };
 
+/**
+ * Replace a shared string in a @c sipe_buddy structure
+ *
+ * Values that repeat across many buddies, e.g. activity or device name,
+ * are stored only once per account. Fields marked as "shared string"
+ * must not be g_free()'d or assigned directly.
+ *
+ * @param sipe_private SIPE core data
+ * @param field        pointer to the buddy field
+ * @param value        new value (may be @c NULL)
+ */
+void sipe_buddy_set_string(struct sipe_core_private *sipe_private,
+			   const gchar **field,
+			   const gchar *value);
+
+/**
+ * Returns the calendar part of a @c sipe_buddy structure
+ *
+ * Allocates it if the buddy doesn't have one yet. Use @c buddy->cal
+ * directly for read-only access, it is @c NULL if there is no data.
+ *
+ * @param buddy sipe_buddy data structure
+ *
+ * @return @c sipe_buddy_calendar structure
+ */
+struct sipe_buddy_calendar *sipe_buddy_calendar(struct sipe_buddy *buddy);
+
 /**
  * Adds UCS Exchange/Change keys to a @c sipe_buddy structure
  *
@@ -37,6 +37,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-cal.h"
+#include "sipe-free-busy.h"
 #include "sipe-http.h"
 #include "sipe-nls.h"
 #include "sipe-ocs2005.h"
@@ -343,6 +344,25 @@ sipe_cal_free_working_hours(struct sipe_cal_working_hours *wh)
 	g_free(wh);
 }
 
+#define SIPE_CAL_STRING_SIZE(s) ((s) ? strlen(s) + 1 : 0)
+gsize
+sipe_cal_working_hours_size(const struct sipe_cal_working_hours *wh)
+{
+	if (!wh) return 0;
+
+	return sizeof(struct sipe_cal_working_hours) +
+		SIPE_CAL_STRING_SIZE(wh->std.time) +
+		SIPE_CAL_STRING_SIZE(wh->std.day_of_week) +
+		SIPE_CAL_STRING_SIZE(wh->std.year) +
+		SIPE_CAL_STRING_SIZE(wh->dst.time) +
+		SIPE_CAL_STRING_SIZE(wh->dst.day_of_week) +
+		SIPE_CAL_STRING_SIZE(wh->dst.year) +
+		SIPE_CAL_STRING_SIZE(wh->days_of_week) +
+		SIPE_CAL_STRING_SIZE(wh->tz) +
+		SIPE_CAL_STRING_SIZE(wh->tz_std) +
+		SIPE_CAL_STRING_SIZE(wh->tz_dst);
+}
+
 /**
  * Returns time_t of daylight savings time start/end
  * in the provided timezone or otherwise
@@ -459,6 +479,7 @@ sipe_cal_parse_working_hours(const sipe_xml *xn_working_hours,
 	time_t now = time(NULL);
 	struct sipe_cal_std_dst* std;
 	struct sipe_cal_std_dst* dst;
+	struct sipe_buddy_calendar *cal;
 
 	if (!xn_working_hours) return;
 /*
@@ -476,66 +497,67 @@ sipe_cal_parse_working_hours(const sipe_xml *xn_working_hours,
   </WorkingPeriodArray>
 </WorkingHours>
 */
-	sipe_cal_free_working_hours(buddy->cal_working_hours);
-	buddy->cal_working_hours = g_new0(struct sipe_cal_working_hours, 1);
+	cal = sipe_buddy_calendar(buddy);
+	sipe_cal_free_working_hours(cal->working_hours);
+	cal->working_hours = g_new0(struct sipe_cal_working_hours, 1);
 
 	xn_timezone = sipe_xml_child(xn_working_hours, "TimeZone");
 	xn_bias = sipe_xml_child(xn_timezone, "Bias");
 	if (xn_bias) {
-		buddy->cal_working_hours->bias = atoi(tmp = sipe_xml_data(xn_bias));
+		cal->working_hours->bias = atoi(tmp = sipe_xml_data(xn_bias));
 		g_free(tmp);
 	}
 
 	xn_standard_time = sipe_xml_child(xn_timezone, "StandardTime");
 	xn_daylight_time = sipe_xml_child(xn_timezone, "DaylightTime");
 
-	std = &((*buddy->cal_working_hours).std);
-	dst = &((*buddy->cal_working_hours).dst);
+	std = &((*cal->working_hours).std);
+	dst = &((*cal->working_hours).dst);
 	sipe_cal_parse_std_dst(xn_standard_time, std);
 	sipe_cal_parse_std_dst(xn_daylight_time, dst);
 
 	xn_working_period = sipe_xml_child(xn_working_hours, "WorkingPeriodArray/WorkingPeriod");
 	if (xn_working_period) {
 		/* NOTE: this can be NULL! */
-		buddy->cal_working_hours->days_of_week =
+		cal->working_hours->days_of_week =
 			sipe_xml_data(sipe_xml_child(xn_working_period, "DayOfWeek"));
 
-		buddy->cal_working_hours->start_time =
+		cal->working_hours->start_time =
 			atoi(tmp = sipe_xml_data(sipe_xml_child(xn_working_period, "StartTimeInMinutes")));
 		g_free(tmp);
 
-		buddy->cal_working_hours->end_time =
+		cal->working_hours->end_time =
 			atoi(tmp = sipe_xml_data(sipe_xml_child(xn_working_period, "EndTimeInMinutes")));
 		g_free(tmp);
 	}
 
-	std->switch_time = sipe_cal_get_std_dst_time(now, buddy->cal_working_hours->bias, std, dst);
-	dst->switch_time = sipe_cal_get_std_dst_time(now, buddy->cal_working_hours->bias, dst, std);
+	std->switch_time = sipe_cal_get_std_dst_time(now, cal->working_hours->bias, std, dst);
+	dst->switch_time = sipe_cal_get_std_dst_time(now, cal->working_hours->bias, dst, std);
 
 	/* TST8TDT7,M3.2.0/02:00:00,M11.1.0/02:00:00 */
-	buddy->cal_working_hours->tz =
+	cal->working_hours->tz =
 		g_strdup_printf("TST%dTDT%d,M%d.%d.%d/%s,M%d.%d.%d/%s",
-				(buddy->cal_working_hours->bias + buddy->cal_working_hours->std.bias) / 60,
-				(buddy->cal_working_hours->bias + buddy->cal_working_hours->dst.bias) / 60,
-
-				buddy->cal_working_hours->dst.month,
-				buddy->cal_working_hours->dst.day_order,
-				sipe_cal_get_wday(buddy->cal_working_hours->dst.day_of_week),
-				buddy->cal_working_hours->dst.time,
-
-				buddy->cal_working_hours->std.month,
-				buddy->cal_working_hours->std.day_order,
-				sipe_cal_get_wday(buddy->cal_working_hours->std.day_of_week),
-				buddy->cal_working_hours->std.time
+				(cal->working_hours->bias + cal->working_hours->std.bias) / 60,
+				(cal->working_hours->bias + cal->working_hours->dst.bias) / 60,
+
+				cal->working_hours->dst.month,
+				cal->working_hours->dst.day_order,
+				sipe_cal_get_wday(cal->working_hours->dst.day_of_week),
+				cal->working_hours->dst.time,
+
+				cal->working_hours->std.month,
+				cal->working_hours->std.day_order,
+				sipe_cal_get_wday(cal->working_hours->std.day_of_week),
+				cal->working_hours->std.time
 				);
 	/* TST8 */
-	buddy->cal_working_hours->tz_std =
+	cal->working_hours->tz_std =
 		g_strdup_printf("TST%d",
-				(buddy->cal_working_hours->bias + buddy->cal_working_hours->std.bias) / 60);
+				(cal->working_hours->bias + cal->working_hours->std.bias) / 60);
 	/* TDT7 */
-	buddy->cal_working_hours->tz_dst =
+	cal->working_hours->tz_dst =
 		g_strdup_printf("TDT%d",
-				(buddy->cal_working_hours->bias + buddy->cal_working_hours->dst.bias) / 60);
+				(cal->working_hours->bias + cal->working_hours->dst.bias) / 60);
 }
 
 struct sipe_cal_event*
@@ -572,122 +594,55 @@ sipe_cal_get_event(GSList *cal_events,
 	return res;
 }
 
-static int
-sipe_cal_get_status0(const gchar *free_busy,
-		     time_t cal_start,
-		     int granularity,
-		     time_t time_in_question,
-		     int *index)
-{
-	int res = SIPE_CAL_NO_DATA;
-	int shift;
-	time_t cal_end = cal_start + strlen(free_busy)*granularity*60 - 1;
-
-	if (!(time_in_question >= cal_start && time_in_question <= cal_end)) return res;
-
-	shift = (time_in_question - cal_start) / (granularity*60);
-	if (index) {
-		*index = shift;
-	}
-
-	res = free_busy[shift] - '0';
-
-	return res;
-}
-
 /**
- * Returns time when current calendar state started
+ * Returns free/busy slot for the time in question or
+ * -1 if there is no free/busy data for that time.
  */
-static time_t
-sipe_cal_get_since_time(const gchar *free_busy,
-			time_t calStart,
-			int granularity,
-			int index,
-			int current_state)
+static gssize
+sipe_cal_get_slot(const struct sipe_buddy_calendar *cal,
+		  time_t time_in_question)
 {
-	int i;
+	gsize slot;
 
-	if ((index < 0) || ((size_t)(index + 1) > strlen(free_busy))) return 0;
+	if (time_in_question < cal->start_time) return -1;
 
-	for (i = index; i >= 0; i--) {
-		int temp_status = free_busy[i] - '0';
-
-		if (current_state != temp_status) {
-			return calStart + (i + 1)*granularity*60;
-		}
-	}
-
-	return calStart;
+	slot = (time_in_question - cal->start_time) / (cal->granularity * 60);
+	return (slot < cal->free_busy_slots) ? (gssize) slot : -1;
 }
 
-static char*
-sipe_cal_get_free_busy(struct sipe_buddy *buddy);
-
 int
 sipe_cal_get_status(struct sipe_buddy *buddy,
 		    time_t time_in_question,
 		    time_t *since)
 {
-	time_t cal_start;
-	const char* free_busy;
+	const struct sipe_buddy_calendar *cal = buddy ? buddy->cal : NULL;
 	int ret = SIPE_CAL_NO_DATA;
-	time_t state_since;
-	int index = -1;
+	time_t state_since = 0;
+	gssize slot;
 
-	if (!buddy || !buddy->cal_start_time || !buddy->cal_granularity) {
+	if (!cal || !cal->start_time || !cal->granularity) {
 		SIPE_DEBUG_INFO("sipe_cal_get_status: no calendar data1 for %s, exiting",
 				  buddy ? (buddy->name ? buddy->name : "") : "");
 		return SIPE_CAL_NO_DATA;
 	}
 
-	if (!(free_busy = sipe_cal_get_free_busy(buddy))) {
+	if (!cal->free_busy) {
 		SIPE_DEBUG_INFO("sipe_cal_get_status: no calendar data2 for %s, exiting", buddy->name);
 		return SIPE_CAL_NO_DATA;
 	}
-	SIPE_DEBUG_INFO("sipe_cal_get_description: buddy->cal_free_busy=\n%s", free_busy);
-
-	cal_start = sipe_utils_str_to_time(buddy->cal_start_time);
-
-	ret = sipe_cal_get_status0(free_busy,
-				   cal_start,
-				   buddy->cal_granularity,
-				   time_in_question,
-				   &index);
-	state_since = sipe_cal_get_since_time(free_busy,
-					      cal_start,
-					      buddy->cal_granularity,
-					      index,
-					      ret);
-
-	if (since) *since = state_since;
-	return ret;
-}
-
-static time_t
-sipe_cal_get_switch_time(const gchar *free_busy,
-			 time_t calStart,
-			 int granularity,
-			 int index,
-			 int current_state,
-			 int *to_state)
-{
-	size_t i;
-	time_t ret = TIME_NULL;
-
-	if ((index < 0) || ((size_t) (index + 1) > strlen(free_busy))) {
-		*to_state = SIPE_CAL_NO_DATA;
-		return ret;
-	}
 
-	for (i = index + 1; i < strlen(free_busy); i++) {
-		int temp_status = free_busy[i] - '0';
-
-		if (current_state != temp_status) {
-			*to_state = temp_status;
-			return calStart + i*granularity*60;
-		}
+	slot = sipe_cal_get_slot(cal, time_in_question);
+	if (slot >= 0) {
+		ret = sipe_free_busy_status(cal->free_busy,
+					    cal->free_busy_slots,
+					    slot);
+		state_since = cal->start_time +
+			sipe_free_busy_start(cal->free_busy,
+					     cal->free_busy_slots,
+					     slot) * cal->granularity * 60;
 	}
 
+	if (since) *since = state_since;
 	return ret;
 }
 
@@ -816,77 +771,6 @@ sipe_cal_get_until(const time_t now,
 	return ret;
 }
 
-static char*
-sipe_cal_get_free_busy(struct sipe_buddy *buddy)
-{
-/* do lazy decode if necessary */
-	if (!buddy->cal_free_busy && buddy->cal_free_busy_base64) {
-		gsize cal_dec64_len;
-		guchar *cal_dec64;
-		gsize i;
-		int j = 0;
-
-		cal_dec64 = g_base64_decode(buddy->cal_free_busy_base64, &cal_dec64_len);
-
-		buddy->cal_free_busy = g_malloc0(cal_dec64_len * 4 + 1);
-/*
-   http://msdn.microsoft.com/en-us/library/dd941537%28office.13%29.aspx
-		00, Free (Fr)
-		01, Tentative (Te)
-		10, Busy (Bu)
-		11, Out of facility (Oo)
-
-   http://msdn.microsoft.com/en-us/library/aa566048.aspx
-		0  Free
-		1  Tentative
-		2  Busy
-		3  Out of Office (OOF)
-		4  No data
-*/
-		for (i = 0; i < cal_dec64_len; i++) {
-#define TWO_BIT_MASK	0x03
-			char tmp = cal_dec64[i];
-			buddy->cal_free_busy[j++] = (tmp & TWO_BIT_MASK) + '0';
-			buddy->cal_free_busy[j++] = ((tmp >> 2) & TWO_BIT_MASK) + '0';
-			buddy->cal_free_busy[j++] = ((tmp >> 4) & TWO_BIT_MASK) + '0';
-			buddy->cal_free_busy[j++] = ((tmp >> 6) & TWO_BIT_MASK) + '0';
-		}
-		buddy->cal_free_busy[j++] = '\0';
-		g_free(cal_dec64);
-	}
-
-	return buddy->cal_free_busy;
-}
-
-char *
-sipe_cal_get_freebusy_base64(const char* freebusy_hex)
-{
-	guint i = 0;
-	guint j = 0;
-	guint shift_factor = 0;
-	guint len, res_len;
-	guchar *res;
-	gchar *res_base64;
-
-	if (!freebusy_hex) return NULL;
-
-	len = strlen(freebusy_hex);
-	res_len = len / 4 + 1;
-	res = g_malloc0(res_len);
-	while (i < len) {
-		res[j] |= (freebusy_hex[i++] - '0') << shift_factor;
-		shift_factor += 2;
-		if (shift_factor == 8) {
-			shift_factor = 0;
-			j++;
-		}
-	}
-
-	res_base64 = g_base64_encode(res, shift_factor ? res_len : res_len - 1);
-	g_free(res);
-	return res_base64;
-}
-
 char *
 sipe_cal_get_description(struct sipe_buddy *buddy)
 {
@@ -900,59 +784,71 @@ sipe_cal_get_description(struct sipe_buddy *buddy)
 	time_t switch_time;
 	int to_state = SIPE_CAL_NO_DATA;
 	time_t until = TIME_NULL;
-	int index = 0;
-	gboolean has_working_hours = (buddy->cal_working_hours != NULL);
-	const char *free_busy;
+	const struct sipe_buddy_calendar *cal = buddy->cal;
+	struct sipe_cal_working_hours *wh;
+	gboolean has_working_hours;
+	gssize slot;
+	gsize next;
 	const char *cal_states[] = {_("Free"),
 				    _("Tentative"),
 				    _("Busy"),
 				    _("Out of office"),
 				    _("No data")};
 
-	if (buddy->cal_granularity != 15) {
-		SIPE_DEBUG_INFO("sipe_cal_get_description: granularity %d is unsupported, exiting.", buddy->cal_granularity);
+	if (!cal) {
+		SIPE_DEBUG_INFO_NOFORMAT("sipe_cal_get_description: no calendar data, exiting");
 		return NULL;
 	}
+	wh = cal->working_hours;
+	has_working_hours = (wh != NULL);
 
-	/* to lazy load if needed */
-	free_busy = sipe_cal_get_free_busy(buddy);
-	SIPE_DEBUG_INFO("sipe_cal_get_description: buddy->cal_free_busy=\n%s", free_busy ? free_busy : "");
+	if (cal->granularity != 15) {
+		SIPE_DEBUG_INFO("sipe_cal_get_description: granularity %d is unsupported, exiting.", cal->granularity);
+		return NULL;
+	}
 
-	if (!buddy->cal_free_busy || !buddy->cal_granularity || !buddy->cal_start_time) {
+	if (!cal->free_busy || !cal->granularity || !cal->start_time) {
 		SIPE_DEBUG_INFO_NOFORMAT("sipe_cal_get_description: no calendar data, exiting");
 		return NULL;
 	}
 
-	cal_start = sipe_utils_str_to_time(buddy->cal_start_time);
-	cal_end = cal_start + 60 * (buddy->cal_granularity) * strlen(buddy->cal_free_busy);
+	cal_start = cal->start_time;
+	cal_end = cal_start + 60 * (cal->granularity) * cal->free_busy_slots;
 
-	current_cal_state = sipe_cal_get_status0(free_busy, cal_start, buddy->cal_granularity, time(NULL), &index);
-	if (current_cal_state == SIPE_CAL_NO_DATA) {
+	slot = sipe_cal_get_slot(cal, now);
+	if (slot < 0) {
 		SIPE_DEBUG_INFO_NOFORMAT("sipe_cal_get_description: calendar is undefined for present moment, exiting.");
 		return NULL;
 	}
+	current_cal_state = sipe_free_busy_status(cal->free_busy, cal->free_busy_slots, slot);
 
-	switch_time = sipe_cal_get_switch_time(free_busy, cal_start, buddy->cal_granularity, index, current_cal_state, &to_state);
+	next = sipe_free_busy_next(cal->free_busy, cal->free_busy_slots, slot);
+	if (next < cal->free_busy_slots) {
+		to_state = sipe_free_busy_status(cal->free_busy, cal->free_busy_slots, next);
+		switch_time = cal_start + next * cal->granularity * 60;
+	} else {
+		switch_time = TIME_NULL;
+	}
 
 	SIPE_DEBUG_INFO_NOFORMAT("\n* Calendar *");
-	if (buddy->cal_working_hours) {
-		sipe_cal_get_today_work_hours(buddy->cal_working_hours, &start, &end, &next_start);
+	if (wh) {
+		sipe_cal_get_today_work_hours(wh, &start, &end, &next_start);
 
-		SIPE_DEBUG_INFO("Remote now timezone : %s", sipe_cal_get_tz(buddy->cal_working_hours, now));
+		SIPE_DEBUG_INFO("Remote now timezone : %s", sipe_cal_get_tz(wh, now));
 		SIPE_DEBUG_INFO("std.switch_time(GMT): %s",
-				IS((*buddy->cal_working_hours).std.switch_time) ? sipe_utils_time_to_debug_str(gmtime(&((*buddy->cal_working_hours).std.switch_time))) : "");
+				IS((*wh).std.switch_time) ? sipe_utils_time_to_debug_str(gmtime(&((*wh).std.switch_time))) : "");
 		SIPE_DEBUG_INFO("dst.switch_time(GMT): %s",
-				IS((*buddy->cal_working_hours).dst.switch_time) ? sipe_utils_time_to_debug_str(gmtime(&((*buddy->cal_working_hours).dst.switch_time))) : "");
+				IS((*wh).dst.switch_time) ? sipe_utils_time_to_debug_str(gmtime(&((*wh).dst.switch_time))) : "");
 		SIPE_DEBUG_INFO("Remote now time     : %s",
-			sipe_utils_time_to_debug_str(sipe_localtime_tz(&now, sipe_cal_get_tz(buddy->cal_working_hours, now))));
+			sipe_utils_time_to_debug_str(sipe_localtime_tz(&now, sipe_cal_get_tz(wh, now))));
 		SIPE_DEBUG_INFO("Remote start time   : %s",
-			IS(start) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&start, sipe_cal_get_tz(buddy->cal_working_hours, start))) : "");
+			IS(start) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&start, sipe_cal_get_tz(wh, start))) : "");
 		SIPE_DEBUG_INFO("Remote end time     : %s",
-			IS(end) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&end, sipe_cal_get_tz(buddy->cal_working_hours, end))) : "");
+			IS(end) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&end, sipe_cal_get_tz(wh, end))) : "");
 		SIPE_DEBUG_INFO("Rem. next_start time: %s",
-			IS(next_start) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&next_start, sipe_cal_get_tz(buddy->cal_working_hours, next_start))) : "");
+			IS(next_start) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&next_start, sipe_cal_get_tz(wh, next_start))) : "");
 		SIPE_DEBUG_INFO("Remote switch time  : %s",
-			IS(switch_time) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&switch_time, sipe_cal_get_tz(buddy->cal_working_hours, switch_time))) : "");
+			IS(switch_time) ? sipe_utils_time_to_debug_str(sipe_localtime_tz(&switch_time, sipe_cal_get_tz(wh, switch_time))) : "");
 	} else {
 		SIPE_DEBUG_INFO("Local now time      : %s",
 			sipe_utils_time_to_debug_str(localtime(&now)));
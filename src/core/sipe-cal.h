@@ -80,8 +80,9 @@ struct sipe_calendar {
 	struct sipe_http_request *request;
 
 	time_t fb_start;
-	/* hex form */
-	char *free_busy;
+	/* free/busy bitmap, see sipe-free-busy.h */
+	guchar *free_busy;
+	gsize free_busy_slots;
 	char *working_hours_xml_str;
 	GSList *cal_events;
 };
@@ -124,16 +125,6 @@ time_t
 sipe_mktime_tz(struct tm *tm,
 	       const char* tz);
 
-/**
- * Converts hex representation of freebusy string as
- * returned by Exchange Web Services to
- * condenced and base64 encoded form
- *
- * Must be g_free()'d after use.
- */
-char *
-sipe_cal_get_freebusy_base64(const char* freebusy_hex);
-
 /** Contains buddy's working hours information */
 struct sipe_cal_working_hours;
 
@@ -151,6 +142,12 @@ sipe_cal_parse_working_hours(const struct _sipe_xml *xn_working_hours,
 void
 sipe_cal_free_working_hours(struct sipe_cal_working_hours *wh);
 
+/**
+ * Returns memory used by struct sipe_cal_working_hours
+ */
+gsize
+sipe_cal_working_hours_size(const struct sipe_cal_working_hours *wh);
+
 /**
  * Returns user calendar information in text form.
  * Example: "Currently Busy. Free at 13:00"
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-2012 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -28,6 +28,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 
 #ifdef HAVE_VALGRIND
@@ -47,6 +49,7 @@
 #include "cryptohi.h"
 #include "keyhi.h"
 #include "pk11pub.h"
+#include "secasn1.h"
 
 #include "sipe-backend.h"
 #include "sipe-cert-crypto.h"
@@ -143,6 +146,126 @@ void sipe_cert_crypto_free(struct sipe_cert_crypto *scc)
 	}
 }
 
+struct sipe_cert_crypto *sipe_cert_crypto_restore(const gchar *base64,
+						  const gchar *secret,
+						  const gchar *certificate)
+{
+	struct sipe_cert_crypto *scc = NULL;
+	PK11SlotInfo *slot = PK11_GetInternalKeySlot();
+	PRArenaPool *arena = PORT_NewArena(DER_DEFAULT_CHUNKSIZE);
+	gsize length;
+	guchar *raw = g_base64_decode(certificate, &length);
+	CERTCertificate *cert = CERT_DecodeCertFromPackage((char *) raw, length);
+	SECKEYPublicKey *public = cert ? CERT_ExtractPublicKey(cert) : NULL;
+
+	if (slot && arena && public) {
+		SECKEYEncryptedPrivateKeyInfo epki;
+		SECItem der;
+
+		memset(&epki, 0, sizeof(epki));
+		der.type = siBuffer;
+		der.data = g_base64_decode(base64, &length);
+		der.len  = length;
+
+		if (SEC_QuickDERDecodeItem(arena,
+					   &epki,
+					   SEC_ASN1_GET(SECKEY_EncryptedPrivateKeyInfoTemplate),
+					   &der) == SECSuccess) {
+			SECKEYPrivateKey *private = NULL;
+			SECItem pwitem;
+
+			pwitem.type = siBuffer;
+			pwitem.data = (guchar *) secret;
+			pwitem.len  = strlen(secret);
+
+			/* key pair must match the certificate */
+			if (PK11_ImportEncryptedPrivateKeyInfoAndReturnKey(slot,
+									   &epki,
+									   &pwitem,
+									   NULL,
+									   &public->u.rsa.modulus,
+									   PR_FALSE, /* not permanent */
+									   PR_TRUE,  /* sensitive */
+									   rsaKey,
+									   KU_ALL,
+									   &private,
+									   NULL) == SECSuccess) {
+				scc = g_new0(struct sipe_cert_crypto, 1);
+				scc->private = private;
+				scc->public  = public;
+				public       = NULL;
+				SIPE_DEBUG_INFO_NOFORMAT("sipe_cert_crypto_restore: key pair restored");
+			} else {
+				SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_restore: can't decrypt private key");
+			}
+		} else {
+			SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_restore: can't ASN.1 decode private key");
+		}
+
+		g_free(der.data);
+	}
+
+	if (public)
+		SECKEY_DestroyPublicKey(public);
+	if (cert)
+		CERT_DestroyCertificate(cert);
+	g_free(raw);
+	if (arena)
+		PORT_FreeArena(arena, PR_FALSE);
+	if (slot)
+		PK11_FreeSlot(slot);
+
+	return(scc);
+}
+
+gchar *sipe_cert_crypto_export(struct sipe_cert_crypto *scc,
+			       const gchar *secret)
+{
+	PK11SlotInfo *slot;
+	gchar *base64 = NULL;
+
+	if (!scc || !secret)
+		return(NULL);
+
+	if ((slot = PK11_GetInternalKeySlot()) != NULL) {
+		SECKEYEncryptedPrivateKeyInfo *epki;
+		SECItem pwitem;
+
+		pwitem.type = siBuffer;
+		pwitem.data = (guchar *) secret;
+		pwitem.len  = strlen(secret);
+
+		/* cipher instead of PBE algorithm selects PBES2/PBKDF2 */
+		epki = PK11_ExportEncryptedPrivKeyInfo(slot,
+						       SEC_OID_AES_256_CBC,
+						       &pwitem,
+						       scc->private,
+						       SIPE_CERT_CRYPTO_EXPORT_ITERATIONS,
+						       NULL);
+		if (epki) {
+			SECItem *der = SEC_ASN1EncodeItem(NULL,
+							  NULL,
+							  epki,
+							  SEC_ASN1_GET(SECKEY_EncryptedPrivateKeyInfoTemplate));
+
+			if (der) {
+				base64 = g_base64_encode(der->data, der->len);
+				SECITEM_FreeItem(der, PR_TRUE);
+			} else {
+				SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_export: can't ASN.1 encode private key");
+			}
+
+			SECKEY_DestroyEncryptedPrivateKeyInfo(epki, PR_TRUE);
+		} else {
+			SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_export: can't encrypt private key");
+		}
+
+		PK11_FreeSlot(slot);
+	}
+
+	return(base64);
+}
+
 static gchar *sign_cert_or_certreq(CERTCertificate *cert,
 				   CERTCertificateRequest *certreq,
 				   SECKEYPrivateKey *private)
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -24,10 +24,14 @@
  * Certificate routines implementation based on OpenSSL.
  */
 
+#include <openssl/bio.h>
 #include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/pkcs12.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
 
+#include <string.h>
 #include <time.h>
 
 #include <glib.h>
@@ -91,6 +95,106 @@ void sipe_cert_crypto_free(struct sipe_cert_crypto *scc)
 	}
 }
 
+struct sipe_cert_crypto *sipe_cert_crypto_restore(const gchar *base64,
+						  const gchar *secret,
+						  const gchar *certificate)
+{
+	struct sipe_cert_crypto *scc = NULL;
+	gsize length;
+	guchar *der = g_base64_decode(base64, &length);
+	BIO *bio    = BIO_new_mem_buf(der, length);
+
+	if (bio) {
+		EVP_PKEY *pkey = d2i_PKCS8PrivateKey_bio(bio,
+							 NULL,
+							 NULL,
+							 (void *) secret);
+
+		if (pkey) {
+			guchar *raw = g_base64_decode(certificate, &length);
+			const guchar *tmp = raw;
+			/* NOTE: d2i_X509(NULL, &in, len) autoincrements "in" */
+			X509 *x509 = d2i_X509(NULL, &tmp, length);
+
+			/* make sure the key pair matches the certificate */
+			if (x509 && X509_check_private_key(x509, pkey)) {
+				scc = g_new0(struct sipe_cert_crypto, 1);
+				scc->key = EVP_PKEY_get1_RSA(pkey);
+				SIPE_DEBUG_INFO_NOFORMAT("sipe_cert_crypto_restore: key pair restored");
+			} else {
+				SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_restore: key pair doesn't match certificate");
+			}
+
+			if (x509)
+				X509_free(x509);
+			g_free(raw);
+			EVP_PKEY_free(pkey);
+		} else {
+			SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_restore: can't decrypt private key");
+		}
+
+		BIO_free(bio);
+	}
+	g_free(der);
+
+	return(scc);
+}
+
+gchar *sipe_cert_crypto_export(struct sipe_cert_crypto *scc,
+			       const gchar *secret)
+{
+	gchar *base64 = NULL;
+	EVP_PKEY *pkey;
+
+	if (!scc || !secret)
+		return(NULL);
+
+	if ((pkey = EVP_PKEY_new()) != NULL) {
+		PKCS8_PRIV_KEY_INFO *p8inf;
+
+		EVP_PKEY_set1_RSA(pkey, scc->key);
+
+		if ((p8inf = EVP_PKEY2PKCS8(pkey)) != NULL) {
+			/* PBE NID -1 & cipher selects PBES2/PBKDF2 */
+			X509_SIG *p8 = PKCS8_encrypt(-1,
+						     EVP_aes_256_cbc(),
+						     secret,
+						     strlen(secret),
+						     NULL,
+						     0,
+						     SIPE_CERT_CRYPTO_EXPORT_ITERATIONS,
+						     p8inf);
+			BIO *bio;
+
+			if (p8 && ((bio = BIO_new(BIO_s_mem())) != NULL)) {
+				if (i2d_PKCS8_bio(bio, p8)) {
+					BUF_MEM *mem;
+
+					BIO_get_mem_ptr(bio, &mem);
+					base64 = g_base64_encode((guchar *) mem->data,
+								 mem->length);
+				}
+				BIO_free(bio);
+			}
+
+			if (!base64)
+				SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_export: can't encrypt private key");
+
+			if (p8)
+				X509_SIG_free(p8);
+			PKCS8_PRIV_KEY_INFO_free(p8inf);
+		} else {
+			SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_export: can't convert private key");
+		}
+
+		EVP_PKEY_free(pkey);
+	} else {
+		SIPE_DEBUG_ERROR_NOFORMAT("sipe_cert_crypto_export: can't create private key data structure");
+	}
+
+	return(base64);
+}
+
 
 gchar *sipe_cert_crypto_request(struct sipe_cert_crypto *scc,
 				const gchar *subject)
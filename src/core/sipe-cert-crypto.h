@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-12 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -35,6 +35,13 @@
 /* Forward declarations */
 struct sipe_cert_crypto;
 
+/*
+ * PBKDF2 iteration count for @sipe_cert_crypto_export()
+ *
+ * The secret is random, i.e. there is nothing to gain from key stretching.
+ */
+#define SIPE_CERT_CRYPTO_EXPORT_ITERATIONS 2048
+
 /**
  * Free certificate crypto backend data
  *
@@ -49,6 +56,36 @@ struct sipe_cert_crypto *sipe_cert_crypto_init(void);
  */
 void sipe_cert_crypto_free(struct sipe_cert_crypto *scc);
 
+/**
+ * Restore certificate crypto backend data from exported key pair
+ *
+ * Unlike @sipe_cert_crypto_init() this doesn't generate a new key pair.
+ *
+ * @param base64      Base64 encoded key pair from @sipe_cert_crypto_export()
+ * @param secret      secret the key pair was exported with
+ * @param certificate Base64 encoded DER certificate issued for the key pair
+ *
+ * @return opaque pointer to backend private data or @c NULL
+ */
+struct sipe_cert_crypto *sipe_cert_crypto_restore(const gchar *base64,
+						  const gchar *secret,
+						  const gchar *certificate);
+
+/**
+ * Export key pair as encrypted PKCS#8 structure
+ *
+ * Both backends use PBES2 with PBKDF2 and AES-256-CBC, so that the
+ * exported data can be restored by either of them.
+ *
+ * @param scc    opaque pointer to backend private data
+ * @param secret random secret to encrypt the private key with. Never
+ *               use a user supplied password here.
+ *
+ * @return Base64 encoded DER data. Must be @g_free()'d.
+ */
+gchar *sipe_cert_crypto_export(struct sipe_cert_crypto *scc,
+			       const gchar *secret);
+
 /**
  * Create a certificate request as Base64 encoded string
  *
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-12 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -27,6 +27,20 @@
  *   - [MS-OCAUTHWS]: http://msdn.microsoft.com/en-us/library/ff595592.aspx
  *   - MS Tech-Ed Europe 2010 "UNC310: Microsoft Lync 2010 Technology Explained"
  *     http://ecn.channel9.msdn.com/o9/te/Europe/2010/pptx/unc310.pptx
+ *
+ *
+ * Certificate store
+ *
+ * The issued certificates and their key pairs are stored per account in an
+ * encrypted store file (see sipe-store.h). The crypto backends can only
+ * export a private key as encrypted PKCS#8 structure, so each save also
+ * generates a random export secret which is kept inside the store file.
+ * At the next login the key pairs and the still valid certificates are
+ * restored, i.e. no key pair generation and no round-trip to the
+ * Certificate Provisioning Service is needed.
+ *
+ * Certificates are renewed in the background before they expire. Each
+ * renewal uses a newly generated key pair.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -45,25 +59,50 @@
 #include "sipe-certificate.h"
 #include "sipe-cert-crypto.h"
 #include "sipe-nls.h"
+#include "sipe-schedule.h"
+#include "sipe-store.h"
 #include "sipe-svc.h"
+#include "sipe-tls.h"
+#include "sipe-utils.h"
 #include "sipe-webticket.h"
 #include "sipe-xml.h"
 
+/* certificate must be valid for this long to be used for authentication */
+#define CERTIFICATE_VALID_MIN      (60 * 60)
+/* start background renewal this long before the certificate expires */
+#define CERTIFICATE_RENEWAL_MARGIN (2 * 60 * 60)
+
+#define STORE_MAGIC         "SIPECS01"
+#define STORE_GROUP_KEY     "Key"
+#define STORE_SECRET        "certificate_store_key"
+#define STORE_EXPORT_LENGTH 32
+
 struct sipe_certificate {
 	GHashTable *certificates;
-	struct sipe_cert_crypto *backend;
+	GHashTable *uris;         /* target -> Certificate Provisioning URI */
+	GHashTable *keys;         /* target -> key pair of the certificate */
+	GSList *retired;          /* replaced certificates */
+	GSList *key_pairs;        /* owns all key pairs */
+	struct sipe_cert_crypto *backend; /* key pair for new requests */
+	guchar *store_key;
 };
 
 struct certificate_callback_data {
 	gchar *target;
+	gchar *uri;
 	struct sipe_svc_session *session;
+	struct sipe_cert_crypto *backend; /* owned for renewal */
+	gboolean renewal;
 };
 
 static void callback_data_free(struct certificate_callback_data *ccd)
 {
 	if (ccd) {
 		sipe_svc_session_close(ccd->session);
+		if (ccd->renewal)
+			sipe_cert_crypto_free(ccd->backend);
 		g_free(ccd->target);
+		g_free(ccd->uri);
 		g_free(ccd);
 	}
 }
@@ -74,49 +113,261 @@ void sipe_certificate_free(struct sipe_core_private *sipe_private)
 
 	if (sc) {
 		g_hash_table_destroy(sc->certificates);
-		sipe_cert_crypto_free(sc->backend);
+		g_hash_table_destroy(sc->uris);
+		g_hash_table_destroy(sc->keys);
+		sipe_utils_slist_free_full(sc->retired,
+					   sipe_cert_crypto_destroy);
+		/* certificates reference their key pair */
+		sipe_utils_slist_free_full(sc->key_pairs,
+					   (GDestroyNotify) sipe_cert_crypto_free);
+		sipe_store_key_free(sc->store_key);
 		g_free(sc);
 	}
 }
 
+struct store_data {
+	struct sipe_certificate *sc;
+	GKeyFile *keyfile;
+	const gchar *secret;
+};
+
+static void store_certificate(gpointer key,
+			      gpointer value,
+			      gpointer user_data)
+{
+	const gchar *target = key;
+	gpointer certificate = value;
+	struct store_data *sd = user_data;
+
+	if (sipe_cert_crypto_valid(certificate, CERTIFICATE_VALID_MIN)) {
+		gchar *pkcs8 = sipe_cert_crypto_export(g_hash_table_lookup(sd->sc->keys,
+									   target),
+						       sd->secret);
+
+		if (pkcs8) {
+			gchar *base64 = g_base64_encode(sipe_cert_crypto_raw(certificate),
+							sipe_cert_crypto_raw_length(certificate));
+			g_key_file_set_string(sd->keyfile, target, "pkcs8", pkcs8);
+			g_key_file_set_string(sd->keyfile, target, "certificate", base64);
+			g_key_file_set_string(sd->keyfile, target, "uri",
+					      g_hash_table_lookup(sd->sc->uris,
+								  target));
+			g_free(base64);
+			g_free(pkcs8);
+		}
+	}
+}
+
+static void store_save(struct sipe_core_private *sipe_private)
+{
+	struct sipe_certificate *sc = sipe_private->certificate;
+	struct sipe_tls_random random;
+	struct store_data sd;
+	gchar *secret;
+	gchar *data;
+	gsize length;
+
+	if (!sc->store_key)
+		return;
+
+	/* new export secret for every save */
+	sipe_tls_fill_random(&random, STORE_EXPORT_LENGTH * 8);
+	secret = buff_to_hex_str(random.buffer, STORE_EXPORT_LENGTH);
+	memset(random.buffer, 0, random.length);
+	sipe_tls_free_random(&random);
+
+	sd.sc      = sc;
+	sd.keyfile = g_key_file_new();
+	sd.secret  = secret;
+	g_key_file_set_string(sd.keyfile, STORE_GROUP_KEY, "secret", secret);
+	g_hash_table_foreach(sc->certificates, store_certificate, &sd);
+	memset(secret, 0, strlen(secret));
+	g_free(secret);
+
+	data = g_key_file_to_data(sd.keyfile, &length, NULL);
+	g_key_file_free(sd.keyfile);
+
+	if (data) {
+		gchar *filename = sipe_store_filename(sipe_private, "certificate");
+
+		sipe_store_save(filename, STORE_MAGIC, sc->store_key,
+				data, length);
+
+		g_free(filename);
+		memset(data, 0, length);
+		g_free(data);
+	}
+}
+
+static void certificate_renewal_cb(struct sipe_core_private *sipe_private,
+				   gpointer data);
+static void add_certificate(struct sipe_core_private *sipe_private,
+			    const gchar *target,
+			    const gchar *uri,
+			    struct sipe_cert_crypto *key_pair,
+			    gpointer certificate)
+{
+	struct sipe_certificate *sc = sipe_private->certificate;
+	guint expires = sipe_cert_crypto_expires(certificate);
+	gpointer old_target, old_certificate;
+	gchar *name;
+
+	/* a TLS-DSK context might still reference the old certificate */
+	if (g_hash_table_lookup_extended(sc->certificates,
+					 target,
+					 &old_target,
+					 &old_certificate)) {
+		g_hash_table_steal(sc->certificates, target);
+		g_free(old_target);
+		sc->retired = g_slist_prepend(sc->retired, old_certificate);
+	}
+
+	g_hash_table_insert(sc->certificates, g_strdup(target), certificate);
+	g_hash_table_replace(sc->uris, g_strdup(target), g_strdup(uri));
+	g_hash_table_replace(sc->keys, g_strdup(target), key_pair);
+
+	name = g_strdup_printf("<+certificate-renewal><%s>", target);
+	sipe_schedule_seconds(sipe_private,
+			      name,
+			      g_strdup(target),
+			      expires > CERTIFICATE_RENEWAL_MARGIN ?
+			      expires - CERTIFICATE_RENEWAL_MARGIN : 1,
+			      certificate_renewal_cb,
+			      g_free);
+	g_free(name);
+}
+
+static void store_load(struct sipe_core_private *sipe_private)
+{
+	struct sipe_certificate *sc = sipe_private->certificate;
+	gchar *filename = sipe_store_filename(sipe_private, "certificate");
+	gchar *data     = sipe_store_load(filename, STORE_MAGIC, sc->store_key);
+
+	if (data) {
+		GKeyFile *keyfile = g_key_file_new();
+
+		if (g_key_file_load_from_data(keyfile,
+					      data,
+					      strlen(data),
+					      G_KEY_FILE_NONE,
+					      NULL)) {
+			gchar *secret = g_key_file_get_string(keyfile,
+							      STORE_GROUP_KEY,
+							      "secret",
+							      NULL);
+			gchar **groups = g_key_file_get_groups(keyfile, NULL);
+			guint i;
+
+			for (i = 0; secret && groups[i]; i++) {
+				const gchar *target = groups[i];
+				gchar *pkcs8 = g_key_file_get_string(keyfile,
+								     target,
+								     "pkcs8",
+								     NULL);
+				gchar *base64 = g_key_file_get_string(keyfile,
+								      target,
+								      "certificate",
+								      NULL);
+				gchar *uri = g_key_file_get_string(keyfile,
+								   target,
+								   "uri",
+								   NULL);
+				struct sipe_cert_crypto *key_pair = NULL;
+
+				if (pkcs8 && base64 && uri)
+					key_pair = sipe_cert_crypto_restore(pkcs8,
+									    secret,
+									    base64);
+
+				if (key_pair) {
+					gpointer certificate = sipe_cert_crypto_decode(key_pair,
+										       base64);
+
+					if (sipe_cert_crypto_valid(certificate,
+								   CERTIFICATE_VALID_MIN)) {
+						SIPE_DEBUG_INFO("store_load: certificate for target '%s' restored",
+								target);
+						sc->key_pairs = g_slist_prepend(sc->key_pairs,
+										key_pair);
+						add_certificate(sipe_private,
+								target,
+								uri,
+								key_pair,
+								certificate);
+						sc->backend = key_pair;
+					} else {
+						sipe_cert_crypto_destroy(certificate);
+						sipe_cert_crypto_free(key_pair);
+					}
+				}
+
+				g_free(uri);
+				g_free(base64);
+				g_free(pkcs8);
+			}
+			g_strfreev(groups);
+			if (secret) {
+				memset(secret, 0, strlen(secret));
+				g_free(secret);
+			}
+		}
+
+		g_key_file_free(keyfile);
+		memset(data, 0, strlen(data));
+		g_free(data);
+	}
+	g_free(filename);
+}
+
 gboolean sipe_certificate_init(struct sipe_core_private *sipe_private)
 {
 	struct sipe_certificate *sc;
-	struct sipe_cert_crypto *ssc;
 
 	if (sipe_private->certificate)
 		return(TRUE);
 
-	ssc = sipe_cert_crypto_init();
-	if (!ssc) {
-		SIPE_DEBUG_ERROR_NOFORMAT("sipe_certificate_init: crypto backend init FAILED!");
-		return(FALSE);
-	}
-
 	sc = g_new0(struct sipe_certificate, 1);
 	sc->certificates = g_hash_table_new_full(g_str_hash, g_str_equal,
 						 g_free,
 						 sipe_cert_crypto_destroy);
-	sc->backend = ssc;
+	sc->uris         = g_hash_table_new_full(g_str_hash, g_str_equal,
+						 g_free,
+						 g_free);
+	sc->keys         = g_hash_table_new_full(g_str_hash, g_str_equal,
+						 g_free,
+						 NULL);
+	sipe_private->certificate = sc;
+
+	/* reuse key pairs & certificates from last login... */
+	sc->store_key = sipe_store_key(sipe_private, STORE_SECRET);
+	if (sc->store_key)
+		store_load(sipe_private);
+
+	/* ... or generate a new key pair */
+	if (!sc->backend) {
+		sc->backend = sipe_cert_crypto_init();
+		if (!sc->backend) {
+			SIPE_DEBUG_ERROR_NOFORMAT("sipe_certificate_init: crypto backend init FAILED!");
+			sipe_certificate_free(sipe_private);
+			sipe_private->certificate = NULL;
+			return(FALSE);
+		}
+		sc->key_pairs = g_slist_prepend(sc->key_pairs, sc->backend);
+	}
 
 	SIPE_DEBUG_INFO_NOFORMAT("sipe_certificate_init: DONE");
 
-	sipe_private->certificate = sc;
 	return(TRUE);
 }
 
-static gchar *create_certreq(struct sipe_core_private *sipe_private,
+static gchar *create_certreq(struct sipe_cert_crypto *key_pair,
 			     const gchar *subject)
 {
 	gchar *base64;
 
-	if (!sipe_certificate_init(sipe_private))
-		return(NULL);
-
 	SIPE_DEBUG_INFO_NOFORMAT("create_req: generating new certificate request");
 
-	base64 = sipe_cert_crypto_request(sipe_private->certificate->backend,
-					  subject);
+	base64 = sipe_cert_crypto_request(key_pair, subject);
 	if (base64) {
 		GString *format = g_string_new(NULL);
 		gsize count     = strlen(base64);
@@ -143,14 +394,6 @@ static gchar *create_certreq(struct sipe_core_private *sipe_private,
 	return(base64);
 }
 
-static void add_certificate(struct sipe_core_private *sipe_private,
-			    const gchar *target,
-			    gpointer certificate)
-{
-	struct sipe_certificate *sc = sipe_private->certificate;
-	g_hash_table_insert(sc->certificates, g_strdup(target), certificate);
-}
-
 gpointer sipe_certificate_tls_dsk_find(struct sipe_core_private *sipe_private,
 				       const gchar *target)
 {
@@ -163,7 +406,7 @@ gpointer sipe_certificate_tls_dsk_find(struct sipe_core_private *sipe_private,
 	certificate = g_hash_table_lookup(sc->certificates, target);
 
 	/* Let's make sure the certificate is still valid for another hour */
-	if (!sipe_cert_crypto_valid(certificate, 60 * 60)) {
+	if (!sipe_cert_crypto_valid(certificate, CERTIFICATE_VALID_MIN)) {
 		SIPE_DEBUG_ERROR("sipe_certificate_tls_dsk_find: certificate for '%s' is invalid",
 				 target);
 		return(NULL);
@@ -173,6 +416,7 @@ gpointer sipe_certificate_tls_dsk_find(struct sipe_core_private *sipe_private,
 }
 
 static void certificate_failure(struct sipe_core_private *sipe_private,
+				struct certificate_callback_data *ccd,
 				const gchar *format,
 				const gchar *parameter,
 				const gchar *failure_info)
@@ -183,9 +427,15 @@ static void certificate_failure(struct sipe_core_private *sipe_private,
 		g_free(tmp);
 		tmp = tmp2;
 	}
-	sipe_backend_connection_error(SIPE_CORE_PUBLIC,
-				      SIPE_CONNECTION_ERROR_AUTHENTICATION_FAILED,
-				      tmp);
+
+	/* the current certificate is still valid: retry at next authentication */
+	if (ccd->renewal)
+		SIPE_DEBUG_ERROR("certificate_failure: renewal for target '%s' failed: %s",
+				 ccd->target, tmp);
+	else
+		sipe_backend_connection_error(SIPE_CORE_PUBLIC,
+					      SIPE_CONNECTION_ERROR_AUTHENTICATION_FAILED,
+					      tmp);
 	g_free(tmp);
 }
 
@@ -206,20 +456,35 @@ static void get_and_publish_cert(struct sipe_core_private *sipe_private,
 				uri);
 
 		if (cert_base64) {
-			gpointer opaque = sipe_cert_crypto_decode(sipe_private->certificate->backend,
+			gpointer opaque = sipe_cert_crypto_decode(ccd->backend,
 								  cert_base64);
 
 			SIPE_DEBUG_INFO_NOFORMAT("get_and_publish_cert: found certificate");
 
 			if (opaque) {
+				struct sipe_certificate *sc = sipe_private->certificate;
+				struct sipe_cert_crypto *key_pair = ccd->backend;
+
+				/* new key pair from renewal: use it from now on */
+				if (ccd->renewal) {
+					sc->key_pairs = g_slist_prepend(sc->key_pairs,
+									key_pair);
+					sc->backend   = key_pair;
+					ccd->backend  = NULL;
+				}
+
 				add_certificate(sipe_private,
 						ccd->target,
+						ccd->uri,
+						key_pair,
 						opaque);
+				store_save(sipe_private);
 				SIPE_DEBUG_INFO("get_and_publish_cert: certificate for target '%s' added",
 						ccd->target);
 
 				/* Let's try this again... */
-				sip_transport_authentication_completed(sipe_private);
+				if (!ccd->renewal)
+					sip_transport_authentication_completed(sipe_private);
 				success = TRUE;
 			}
 
@@ -230,6 +495,7 @@ static void get_and_publish_cert(struct sipe_core_private *sipe_private,
 
 	if (!success) {
 		certificate_failure(sipe_private,
+				    ccd,
 				    _("Certificate request to %s failed"),
 				    uri,
 				    NULL);
@@ -249,7 +515,7 @@ static void certprov_webticket(struct sipe_core_private *sipe_private,
 
 	if (wsse_security) {
 		/* Got a Web Ticket for Certificate Provisioning Service */
-		gchar *certreq_base64 = create_certreq(sipe_private,
+		gchar *certreq_base64 = create_certreq(ccd->backend,
 						       sipe_private->username);
 
 		SIPE_DEBUG_INFO("certprov_webticket: got ticket for %s",
@@ -274,6 +540,7 @@ static void certprov_webticket(struct sipe_core_private *sipe_private,
 
 	        if (ccd) {
 			certificate_failure(sipe_private,
+					    ccd,
 					    _("Certificate request to %s failed"),
 					    base_uri,
 					    NULL);
@@ -281,6 +548,7 @@ static void certprov_webticket(struct sipe_core_private *sipe_private,
 
 	} else if (auth_uri) {
 		certificate_failure(sipe_private,
+				    ccd,
 				    _("Web ticket request to %s failed"),
 				    base_uri,
 				    failure_msg);
@@ -290,31 +558,70 @@ static void certprov_webticket(struct sipe_core_private *sipe_private,
 		callback_data_free(ccd);
 }
 
-gboolean sipe_certificate_tls_dsk_generate(struct sipe_core_private *sipe_private,
-					   const gchar *target,
-					   const gchar *uri)
+static gboolean certificate_request(struct sipe_core_private *sipe_private,
+				    const gchar *target,
+				    const gchar *uri,
+				    gboolean renewal)
 {
-	struct certificate_callback_data *ccd = g_new0(struct certificate_callback_data, 1);
+	struct certificate_callback_data *ccd;
+	struct sipe_cert_crypto *key_pair;
 	gboolean ret;
 
+	if (!sipe_certificate_init(sipe_private))
+		return(FALSE);
+
+	/* renewal: don't reuse the key pair of the current certificate */
+	if (renewal) {
+		key_pair = sipe_cert_crypto_init();
+		if (!key_pair) {
+			SIPE_DEBUG_ERROR_NOFORMAT("certificate_request: can't generate new key pair for renewal");
+			return(FALSE);
+		}
+	} else {
+		key_pair = sipe_private->certificate->backend;
+	}
+
+	ccd = g_new0(struct certificate_callback_data, 1);
 	ccd->session = sipe_svc_session_start();
+	ccd->target  = g_strdup(target);
+	ccd->uri     = g_strdup(uri);
+	ccd->backend = key_pair;
+	ccd->renewal = renewal;
 
+	/* callback might be called before this returns, i.e. don't touch ccd */
 	ret = sipe_webticket_request(sipe_private,
 				     ccd->session,
 				     uri,
 				     "CertProvisioningServiceWebTicketProof_SHA1",
 				     certprov_webticket,
 				     ccd);
-	if (ret) {
-		ccd->target = g_strdup(target);
-
-	} else {
+	if (!ret)
 		callback_data_free(ccd);
-	}
 
 	return(ret);
 }
 
+static void certificate_renewal_cb(struct sipe_core_private *sipe_private,
+				   gpointer data)
+{
+	const gchar *target = data;
+	const gchar *uri    = g_hash_table_lookup(sipe_private->certificate->uris,
+						  target);
+
+	SIPE_DEBUG_INFO("certificate_renewal_cb: renewing certificate for target '%s'",
+			target);
+	if (!certificate_request(sipe_private, target, uri, TRUE))
+		SIPE_DEBUG_ERROR("certificate_renewal_cb: can't request certificate from %s",
+				 uri);
+}
+
+gboolean sipe_certificate_tls_dsk_generate(struct sipe_core_private *sipe_private,
+					   const gchar *target,
+					   const gchar *uri)
+{
+	return(certificate_request(sipe_private, target, uri, FALSE));
+}
+
 /*
   Local Variables:
   mode: c
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -34,6 +34,8 @@ struct sipe_groups;
 struct sipe_http;
 struct sipe_http_request;
 struct sipe_media_call_private;
+struct sipe_presence_scheduler;
+struct sipe_schedule_wheel;
 struct sipe_svc;
 struct sipe_ucs;
 struct sipe_webticket;
@@ -56,6 +58,10 @@ struct sipe_core_private {
 	const struct sip_address_data *address_data; /* autodiscovery A records */
 	guint transport_type;
 	guint authentication_type;
+	gint64 connect_start;      /* monotonic time [us] */
+	guint time_to_registered;  /* [ms], 0 until registered */
+	gint64 reconnect_start;    /* monotonic time [us] */
+	guint reconnect_latency;   /* [ms], last warm reconnect */
 
 	/* Account information */
 	gchar *username;
@@ -117,10 +123,11 @@ struct sipe_core_private {
 	gchar *ocs2005_user_states;
 
 	/* Scheduling system */
-	GSList *timeouts;
+	struct sipe_schedule_wheel *timeouts;
 
 	/* Active subscriptions */
 	GHashTable *subscriptions;
+	struct sipe_presence_scheduler *presence_scheduler;
 
 	/* Voice call */
 	GHashTable *media_calls;
@@ -370,6 +370,9 @@ void sipe_core_backend_initialized(struct sipe_core_private *sipe_private,
 		sipe_private->email_password = g_strdup(sipe_backend_setting(SIPE_CORE_PUBLIC,
 									     SIPE_SETTING_EMAIL_PASSWORD));
 	}
+
+	/* store key is kept by the backend */
+	sipe_webticket_preload(sipe_private);
 }
 
 void sipe_core_connection_cleanup(struct sipe_core_private *sipe_private)
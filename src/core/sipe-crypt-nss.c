@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2010 pier11 <pier11@operamail.com>
  *
  * This program is free software; you can redistribute it and/or modify
@@ -23,9 +23,11 @@
 
 /**
  * Cypher routines implementation based on NSS.
- * Includes: RC4, DES
+ * Includes: RC4, DES, AES
  */
 
+#include <string.h>
+
 #include "glib.h"
 
 #include "nss.h"
@@ -285,6 +287,94 @@ void sipe_crypt_tls_block(const guchar *key, gsize key_length,
 	}
 }
 
+/* AES-256-GCM for data stored by the core */
+static gboolean sipe_crypt_aead(gboolean encrypt,
+				const guchar *key,
+				const guchar *iv,
+				const guchar *aad, gsize aad_length,
+				const guchar *in, gsize length,
+				guchar *out, gsize out_length)
+{
+	PK11SlotInfo *slot = PK11_GetBestSlot(CKM_AES_GCM, NULL);
+	PK11SymKey *SymKey;
+	SECItem keyItem;
+	SECItem paramItem;
+	CK_GCM_PARAMS params;
+	unsigned int result_length = 0;
+	SECStatus status           = SECFailure;
+
+	if (!slot)
+		return(FALSE);
+
+	keyItem.type = siBuffer;
+	keyItem.data = (unsigned char *) key;
+	keyItem.len  = SIPE_CRYPT_AEAD_KEY_LENGTH;
+	SymKey = PK11_ImportSymKey(slot, CKM_AES_GCM, PK11_OriginUnwrap,
+				   encrypt ? CKA_ENCRYPT : CKA_DECRYPT,
+				   &keyItem, NULL);
+
+	if (SymKey) {
+		memset(&params, 0, sizeof(params));
+		params.pIv       = (CK_BYTE_PTR) iv;
+		params.ulIvLen   = SIPE_CRYPT_AEAD_IV_LENGTH;
+#if ((NSS_VMAJOR > 3) || (NSS_VMINOR >= 52)) && !defined(NSS_PKCS11_2_0_COMPAT)
+		/* PKCS #11 v3.0 layout: softoken rejects ulIvBits == 0 */
+		params.ulIvBits  = SIPE_CRYPT_AEAD_IV_LENGTH * 8;
+#endif
+		params.pAAD      = (CK_BYTE_PTR) aad;
+		params.ulAADLen  = aad_length;
+		params.ulTagBits = SIPE_CRYPT_AEAD_TAG_LENGTH * 8;
+
+		paramItem.type = siBuffer;
+		paramItem.data = (unsigned char *) &params;
+		paramItem.len  = sizeof(params);
+
+		/* tag is appended to/taken from the end of the encrypted data */
+		if (encrypt)
+			status = PK11_Encrypt(SymKey, CKM_AES_GCM, &paramItem,
+					      out, &result_length, out_length,
+					      in, length);
+		else
+			status = PK11_Decrypt(SymKey, CKM_AES_GCM, &paramItem,
+					      out, &result_length, out_length,
+					      in, length);
+
+		PK11_FreeSymKey(SymKey);
+	}
+	PK11_FreeSlot(slot);
+
+	return((status == SECSuccess) && (result_length == out_length));
+}
+
+gboolean sipe_crypt_aead_encrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out)
+{
+	return(sipe_crypt_aead(TRUE,
+			       key, iv,
+			       aad, aad_length,
+			       in, length,
+			       out, length + SIPE_CRYPT_AEAD_TAG_LENGTH));
+}
+
+gboolean sipe_crypt_aead_decrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out)
+{
+	if (length < SIPE_CRYPT_AEAD_TAG_LENGTH)
+		return(FALSE);
+
+	return(sipe_crypt_aead(FALSE,
+			       key, iv,
+			       aad, aad_length,
+			       in, length,
+			       out, length - SIPE_CRYPT_AEAD_TAG_LENGTH));
+}
+
 /*
   Local Variables:
   mode: c
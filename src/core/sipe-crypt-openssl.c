@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -251,6 +251,77 @@ void sipe_crypt_tls_block(const guchar *key, gsize key_length,
 	}
 }
 
+/* AES-256-GCM for data stored by the core */
+static gboolean openssl_aead(gboolean encrypt,
+			     const guchar *key,
+			     const guchar *iv,
+			     const guchar *aad, gsize aad_length,
+			     const guchar *in, gsize length,
+			     guchar *out,
+			     guchar *tag)
+{
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	gboolean result     = FALSE;
+	int tmp;
+
+	if (!ctx)
+		return(FALSE);
+
+	if (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, encrypt) &&
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN,
+				SIPE_CRYPT_AEAD_IV_LENGTH, NULL) &&
+	    EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, encrypt) &&
+	    (!aad_length ||
+	     EVP_CipherUpdate(ctx, NULL, &tmp, aad, aad_length)) &&
+	    (!length ||
+	     EVP_CipherUpdate(ctx, out, &tmp, in, length)) &&
+	    /* expected tag must be set before EVP_CipherFinal_ex() */
+	    (encrypt ||
+	     EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+				 SIPE_CRYPT_AEAD_TAG_LENGTH, tag)) &&
+	    (EVP_CipherFinal_ex(ctx, out + length, &tmp) > 0) &&
+	    (!encrypt ||
+	     EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG,
+				 SIPE_CRYPT_AEAD_TAG_LENGTH, tag)))
+		result = TRUE;
+
+	EVP_CIPHER_CTX_free(ctx);
+
+	return(result);
+}
+
+gboolean sipe_crypt_aead_encrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out)
+{
+	return(openssl_aead(TRUE,
+			    key, iv,
+			    aad, aad_length,
+			    in, length,
+			    out,
+			    out + length));
+}
+
+gboolean sipe_crypt_aead_decrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out)
+{
+	if (length < SIPE_CRYPT_AEAD_TAG_LENGTH)
+		return(FALSE);
+	length -= SIPE_CRYPT_AEAD_TAG_LENGTH;
+
+	return(openssl_aead(FALSE,
+			    key, iv,
+			    aad, aad_length,
+			    in, length,
+			    out,
+			    (guchar *) in + length));
+}
+
 /*
   Local Variables:
   mode: c
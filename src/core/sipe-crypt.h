@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -59,6 +59,29 @@ void sipe_crypt_ft_stream(gpointer context,
 			  guchar *out);
 void sipe_crypt_ft_destroy(gpointer context);
 
+/*
+ * AES-256-GCM authenticated encryption for data stored by the core
+ *
+ * encrypt: out must point to length + SIPE_CRYPT_AEAD_TAG_LENGTH bytes
+ * decrypt: length includes the tag, out must point to
+ *          length - SIPE_CRYPT_AEAD_TAG_LENGTH bytes.
+ *          Returns FALSE if the data or the additional data (aad) have
+ *          been modified or the key is wrong.
+ */
+#define SIPE_CRYPT_AEAD_KEY_LENGTH 32
+#define SIPE_CRYPT_AEAD_IV_LENGTH  12
+#define SIPE_CRYPT_AEAD_TAG_LENGTH 16
+gboolean sipe_crypt_aead_encrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out);
+gboolean sipe_crypt_aead_decrypt(const guchar *key,
+				 const guchar *iv,
+				 const guchar *aad, gsize aad_length,
+				 const guchar *in, gsize length,
+				 guchar *out);
+
 /* Stream RC4 cipher for TLS */
 gpointer sipe_crypt_tls_start(const guchar *key, gsize key_length);
 void sipe_crypt_tls_stream(gpointer context,
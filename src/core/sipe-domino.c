@@ -76,6 +76,7 @@ Similar functionality for iCalendar/CalDAV/Google would be great to implement to
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-domino.h"
+#include "sipe-free-busy.h"
 #include "sipe-http.h"
 #include "sipe-nls.h"
 #include "sipe-utils.h"
@@ -142,17 +143,19 @@ sipe_domino_get_slot_no(time_t fb_start, time_t in)
 	return (in - fb_start) / SIPE_FREE_BUSY_GRANULARITY_SEC;
 }
 
-static char *
+static guchar *
 sipe_domino_get_free_busy(time_t fb_start,
-			  GSList *cal_events)
+			  GSList *cal_events,
+			  gsize *slots)
 {
 	GSList *entry = cal_events;
-	char *res;
+	guchar *res;
 
+	*slots = 0;
 	if (!cal_events) return NULL;
 
-	res = g_strnfill(SIPE_FREE_BUSY_PERIOD_SEC / SIPE_FREE_BUSY_GRANULARITY_SEC,
-			 SIPE_CAL_FREE + '0');
+	*slots = SIPE_FREE_BUSY_PERIOD_SEC / SIPE_FREE_BUSY_GRANULARITY_SEC;
+	res = sipe_free_busy_new(*slots);
 
 	while (entry) {
 		struct sipe_cal_event *cal_event = entry->data;
@@ -161,11 +164,10 @@ sipe_domino_get_free_busy(time_t fb_start,
 		int i;
 
 		for (i = start; i <= end; i++) {
-			res[i] = SIPE_CAL_BUSY + '0';
+			sipe_free_busy_set(res, i, SIPE_CAL_BUSY);
 		}
 		entry = entry->next;
 	}
-	SIPE_DEBUG_INFO("sipe_domino_get_free_busy: res=\n%s", res);
 	return res;
 }
 
@@ -275,7 +277,9 @@ static void sipe_domino_process_calendar_response(struct sipe_core_private *sipe
 
 		/* creates FreeBusy from cal->cal_events */
 		g_free(cal->free_busy);
-		cal->free_busy = sipe_domino_get_free_busy(cal->fb_start, cal->cal_events);
+		cal->free_busy = sipe_domino_get_free_busy(cal->fb_start,
+							   cal->cal_events,
+							   &cal->free_busy_slots);
 
 		/* update SIP server */
 		cal->is_updated = TRUE;
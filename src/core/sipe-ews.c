@@ -56,6 +56,7 @@ be great to implement too.
 #include "sipe-core-private.h"
 #include "sipe-ews.h"
 #include "sipe-ews-autodiscover.h"
+#include "sipe-free-busy.h"
 #include "sipe-http.h"
 #include "sipe-utils.h"
 #include "sipe-xml.h"
@@ -174,6 +175,7 @@ static void sipe_ews_process_avail_response(SIPE_UNUSED_PARAMETER struct sipe_co
 	if ((status == SIPE_HTTP_STATUS_OK) && body) {
 		const sipe_xml *node;
 		const sipe_xml *resp;
+		gchar *tmp;
 		/** ref: [MS-OXWAVLS] */
 		sipe_xml *xml = sipe_xml_parse(body, strlen(body));
 		/*
@@ -190,7 +192,9 @@ Envelope/Body/GetUserAvailabilityResponse/FreeBusyResponseArray/FreeBusyResponse
 
 		/* MergedFreeBusy */
 		g_free(cal->free_busy);
-		cal->free_busy = sipe_xml_data(sipe_xml_child(resp, "FreeBusyView/MergedFreeBusy"));
+		tmp = sipe_xml_data(sipe_xml_child(resp, "FreeBusyView/MergedFreeBusy"));
+		cal->free_busy = sipe_free_busy_from_digits(tmp, &cal->free_busy_slots);
+		g_free(tmp);
 
 		/* WorkingHours */
 		node = sipe_xml_child(resp, "FreeBusyView/WorkingHours");
@@ -0,0 +1,350 @@
+/**
+ * @file sipe-free-busy-tests.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Tests for the free/busy bitmap functions in sipe-free-busy.c
+ *
+ * Usage: sipe_free_busy_tests [<benchmark iterations> [<buddies>]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "sipe-cal.h"
+#include "sipe-free-busy.h"
+
+/*
+ * Tester code
+ */
+static guint succeeded = 0;
+static guint failed    = 0;
+
+static void assert_equal(const gchar *label,
+			 gsize slots,
+			 gsize slot,
+			 gsize value,
+			 gsize expected)
+{
+	if (value == expected) {
+		succeeded++;
+	} else {
+		printf("%s(%" G_GSIZE_FORMAT " slots, slot %" G_GSIZE_FORMAT ") FAILED: %" G_GSIZE_FORMAT " expected: %" G_GSIZE_FORMAT "\n",
+		       label, slots, slot, value, expected);
+		failed++;
+	}
+}
+
+static void assert_string(const gchar *label,
+			  const gchar *value,
+			  const gchar *expected)
+{
+	if (g_strcmp0(value, expected) == 0) {
+		succeeded++;
+	} else {
+		printf("%s FAILED: '%s' expected: '%s'\n",
+		       label,
+		       value ? value : "(nil)",
+		       expected ? expected : "(nil)");
+		failed++;
+	}
+}
+
+/* free/busy string functions before the bitmap was introduced */
+static gchar *legacy_decode(const gchar *base64)
+{
+	gsize length, i;
+	guchar *decoded = g_base64_decode(base64, &length);
+	gchar *free_busy = g_malloc0(length * 4 + 1);
+	gchar *p = free_busy;
+
+	for (i = 0; i < length; i++) {
+		*p++ = ( decoded[i]       & 0x03) + '0';
+		*p++ = ((decoded[i] >> 2) & 0x03) + '0';
+		*p++ = ((decoded[i] >> 4) & 0x03) + '0';
+		*p++ = ((decoded[i] >> 6) & 0x03) + '0';
+	}
+	g_free(decoded);
+
+	return(free_busy);
+}
+
+static gchar *legacy_encode(const gchar *free_busy)
+{
+	guint i = 0;
+	guint j = 0;
+	guint shift_factor = 0;
+	guint len, res_len;
+	guchar *res;
+	gchar *res_base64;
+
+	len = strlen(free_busy);
+	res_len = len / 4 + 1;
+	res = g_malloc0(res_len);
+	while (i < len) {
+		res[j] |= (free_busy[i++] - '0') << shift_factor;
+		shift_factor += 2;
+		if (shift_factor == 8) {
+			shift_factor = 0;
+			j++;
+		}
+	}
+
+	res_base64 = g_base64_encode(res, shift_factor ? res_len : res_len - 1);
+	g_free(res);
+	return(res_base64);
+}
+
+static int legacy_status(const gchar *free_busy, gsize index)
+{
+	if (index >= strlen(free_busy))
+		return(SIPE_CAL_NO_DATA);
+	return(free_busy[index] - '0');
+}
+
+static gsize legacy_start(const gchar *free_busy, gsize index)
+{
+	int current = free_busy[index] - '0';
+	gsize i;
+
+	for (i = index + 1; i > 0; i--)
+		if (current != free_busy[i - 1] - '0')
+			return(i);
+	return(0);
+}
+
+static gsize legacy_next(const gchar *free_busy, gsize index)
+{
+	int current = free_busy[index] - '0';
+	gsize i;
+
+	for (i = index + 1; i < strlen(free_busy); i++)
+		if (current != free_busy[i] - '0')
+			return(i);
+	return(strlen(free_busy));
+}
+
+static gchar *random_free_busy(GRand *rand, gsize slots)
+{
+	gchar *free_busy = g_malloc(slots + 1);
+	gsize i = 0;
+
+	/* calendar entries span several slots */
+	while (i < slots) {
+		gchar status = g_rand_int_range(rand, 0, 4) + '0';
+		gsize span   = g_rand_int_range(rand, 1, 40);
+
+		while (span-- && (i < slots))
+			free_busy[i++] = status;
+	}
+	free_busy[slots] = '\0';
+
+	return(free_busy);
+}
+
+static void test_bitmap(const gchar *free_busy)
+{
+	gsize slots = strlen(free_busy);
+	gsize bitmap_slots;
+	guchar *bitmap = sipe_free_busy_from_digits(free_busy, &bitmap_slots);
+	gchar *base64 = sipe_free_busy_to_base64(bitmap, bitmap_slots);
+	gchar *expected = legacy_encode(free_busy);
+	gsize i;
+
+	assert_equal("slots", slots, 0, bitmap_slots, slots);
+	assert_string("sipe_free_busy_to_base64", base64, expected);
+
+	for (i = 0; i < slots; i++) {
+		assert_equal("sipe_free_busy_status", slots, i,
+			     sipe_free_busy_status(bitmap, slots, i),
+			     legacy_status(free_busy, i));
+		assert_equal("sipe_free_busy_start", slots, i,
+			     sipe_free_busy_start(bitmap, slots, i),
+			     legacy_start(free_busy, i));
+		assert_equal("sipe_free_busy_next", slots, i,
+			     sipe_free_busy_next(bitmap, slots, i),
+			     legacy_next(free_busy, i));
+	}
+	assert_equal("sipe_free_busy_status", slots, slots,
+		     sipe_free_busy_status(bitmap, slots, slots),
+		     SIPE_CAL_NO_DATA);
+
+	/* base64 round trip, always full bytes */
+	if (slots % 4 == 0) {
+		gsize decoded_slots;
+		guchar *decoded = sipe_free_busy_from_base64(base64, &decoded_slots);
+		gchar *legacy = legacy_decode(base64);
+
+		assert_equal("sipe_free_busy_from_base64", slots, 0,
+			     decoded_slots, slots);
+		assert_string("legacy_decode", legacy, free_busy);
+		if (decoded && !memcmp(decoded, bitmap, slots / 4)) {
+			succeeded++;
+		} else {
+			printf("sipe_free_busy_from_base64(%" G_GSIZE_FORMAT " slots) FAILED\n",
+			       slots);
+			failed++;
+		}
+		g_free(legacy);
+		g_free(decoded);
+	}
+
+	g_free(expected);
+	g_free(base64);
+	g_free(bitmap);
+}
+
+static void benchmark(guint buddies, guint iterations)
+{
+	/* 4 days, 15 minutes granularity */
+	gsize slots      = SIPE_FREE_BUSY_PERIOD_SEC / SIPE_FREE_BUSY_GRANULARITY_SEC;
+	GRand *rand      = g_rand_new_with_seed(42);
+	gchar **base64   = g_new(gchar *, buddies);
+	gchar **strings  = g_new(gchar *, buddies);
+	guchar **bitmaps = g_new(guchar *, buddies);
+	gsize legacy_sum = 0;
+	gsize bitmap_sum = 0;
+	gdouble legacy_elapsed, bitmap_elapsed;
+	GTimer *timer;
+	guint i, j;
+
+	for (i = 0; i < buddies; i++) {
+		gchar *free_busy = random_free_busy(rand, slots);
+		gsize dummy;
+		guchar *bitmap = sipe_free_busy_from_digits(free_busy, &dummy);
+		base64[i] = sipe_free_busy_to_base64(bitmap, slots);
+		g_free(bitmap);
+		g_free(free_busy);
+	}
+
+	/* legacy: decode to string once, then scan it for every query */
+	timer = g_timer_new();
+	for (i = 0; i < buddies; i++)
+		strings[i] = legacy_decode(base64[i]);
+	for (j = 0; j < iterations; j++)
+		for (i = 0; i < buddies; i++) {
+			gsize slot = (i + j) % slots;
+			legacy_sum += legacy_status(strings[i], slot);
+			legacy_sum += legacy_start(strings[i], slot);
+			legacy_sum += legacy_next(strings[i], slot);
+		}
+	legacy_elapsed = g_timer_elapsed(timer, NULL);
+
+	g_timer_start(timer);
+	for (i = 0; i < buddies; i++) {
+		gsize dummy;
+		bitmaps[i] = sipe_free_busy_from_base64(base64[i], &dummy);
+	}
+	for (j = 0; j < iterations; j++)
+		for (i = 0; i < buddies; i++) {
+			gsize slot = (i + j) % slots;
+			bitmap_sum += sipe_free_busy_status(bitmaps[i], slots, slot);
+			bitmap_sum += sipe_free_busy_start(bitmaps[i], slots, slot);
+			bitmap_sum += sipe_free_busy_next(bitmaps[i], slots, slot);
+		}
+	bitmap_elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	printf("Querying %u x %u buddies with %" G_GSIZE_FORMAT " slots:\n",
+	       iterations, buddies, slots);
+	printf("legacy %8.1f ms %6" G_GSIZE_FORMAT " bytes/buddy\n",
+	       legacy_elapsed * 1000, slots + 1);
+	printf("bitmap %8.1f ms %6" G_GSIZE_FORMAT " bytes/buddy\n",
+	       bitmap_elapsed * 1000, slots / 4);
+
+	if (legacy_sum != bitmap_sum) {
+		printf("benchmark FAILED: checksum %" G_GSIZE_FORMAT " expected: %" G_GSIZE_FORMAT "\n",
+		       bitmap_sum, legacy_sum);
+		failed++;
+	}
+
+	for (i = 0; i < buddies; i++) {
+		g_free(bitmaps[i]);
+		g_free(strings[i]);
+		g_free(base64[i]);
+	}
+	g_free(bitmaps);
+	g_free(strings);
+	g_free(base64);
+	g_rand_free(rand);
+}
+
+int main(int argc, char *argv[])
+{
+	guint iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10;
+	guint buddies    = (argc > 2) ? strtoul(argv[2], NULL, 10) : 10000;
+	GRand *rand      = g_rand_new_with_seed(4711);
+	gsize dummy;
+	gsize slots;
+
+	/* edge cases */
+	test_bitmap("0");
+	test_bitmap("3");
+	test_bitmap("0123");
+	test_bitmap("00000000000000000000000000000000");
+	test_bitmap("000000000000000000000000000000001");
+	test_bitmap("1000000000000000000000000000000000000000000000000000000000000000");
+	test_bitmap("2222222222222222222222222222222222222222222222222222222222222223");
+	assert_equal("sipe_free_busy_from_digits", 0, 0,
+		     GPOINTER_TO_SIZE(sipe_free_busy_from_digits("", &dummy)), 0);
+	assert_equal("sipe_free_busy_from_base64", 0, 0,
+		     GPOINTER_TO_SIZE(sipe_free_busy_from_base64(NULL, &dummy)), 0);
+	assert_string("sipe_free_busy_to_base64",
+		      sipe_free_busy_to_base64(NULL, 0), NULL);
+
+	/* 4 = No data can't be stored */
+	{
+		guchar *bitmap = sipe_free_busy_from_digits("24", &slots);
+		assert_equal("sipe_free_busy_status", slots, 1,
+			     sipe_free_busy_status(bitmap, slots, 1),
+			     SIPE_CAL_FREE);
+		g_free(bitmap);
+	}
+
+	/* all sizes around word boundaries */
+	for (slots = 1; slots <= 200; slots++) {
+		gchar *free_busy = random_free_busy(rand, slots);
+		test_bitmap(free_busy);
+		g_free(free_busy);
+	}
+	g_rand_free(rand);
+
+	/* compare against legacy implementation */
+	if (iterations && buddies)
+		benchmark(buddies, iterations);
+
+	printf("Result: %d PASSED %d FAILED\n", succeeded, failed);
+	return(failed);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
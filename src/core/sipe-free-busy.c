@@ -0,0 +1,243 @@
+/**
+ * @file sipe-free-busy.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * http://msdn.microsoft.com/en-us/library/dd941537%28office.13%29.aspx
+ *
+ *	00, Free (Fr)
+ *	01, Tentative (Te)
+ *	10, Busy (Bu)
+ *	11, Out of facility (Oo)
+ *
+ * http://msdn.microsoft.com/en-us/library/aa566048.aspx
+ *
+ *	0  Free
+ *	1  Tentative
+ *	2  Busy
+ *	3  Out of Office (OOF)
+ *	4  No data
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "sipe-cal.h"
+#include "sipe-free-busy.h"
+
+/*
+ * Queries work on 64-bit words, i.e. 32 slots at a time. A word is
+ * XOR'ed with the status of the slot in question repeated 32 times:
+ * every non-zero 2-bit group in the result is a slot with another status.
+ */
+#define SLOTS_PER_BYTE  4
+#define SLOTS_PER_WORD  32
+#define SLOT_MASK       0x03
+#define WORD_PATTERN(status) ((status) * G_GUINT64_CONSTANT(0x5555555555555555))
+
+#define BYTES(slots)    (((slots) + SLOTS_PER_BYTE - 1) / SLOTS_PER_BYTE)
+
+/* slots [word * 32, word * 32 + 32), slot n in bits 2n and 2n + 1 */
+static guint64 free_busy_word(const guchar *bitmap, gsize slots, gsize word)
+{
+	gsize offset = word * sizeof(guint64);
+	gsize bytes  = BYTES(slots) - offset;
+	guint64 value;
+
+	if (bytes >= sizeof(guint64)) {
+		memcpy(&value, bitmap + offset, sizeof(guint64));
+		value = GUINT64_FROM_LE(value);
+	} else {
+		gsize i;
+		value = 0;
+		for (i = 0; i < bytes; i++)
+			value |= ((guint64) bitmap[offset + i]) << (8 * i);
+	}
+
+	return(value);
+}
+
+/* bits of the slots in the word that are inside the bitmap */
+static guint64 free_busy_valid(gsize slots, gsize word)
+{
+	gsize remaining = slots - word * SLOTS_PER_WORD;
+
+	if (remaining >= SLOTS_PER_WORD)
+		return(~G_GUINT64_CONSTANT(0));
+	return((G_GUINT64_CONSTANT(1) << (2 * remaining)) - 1);
+}
+
+static guint free_busy_lowest_bit(guint64 value)
+{
+#if defined(__GNUC__)
+	return(__builtin_ctzll(value));
+#else
+	guint bit = 0;
+	while (!(value & 1)) {
+		value >>= 1;
+		bit++;
+	}
+	return(bit);
+#endif
+}
+
+static guint free_busy_highest_bit(guint64 value)
+{
+#if defined(__GNUC__)
+	return(63 - __builtin_clzll(value));
+#else
+	guint bit = 63;
+	while (!(value >> 63)) {
+		value <<= 1;
+		bit--;
+	}
+	return(bit);
+#endif
+}
+
+guchar *sipe_free_busy_new(gsize slots)
+{
+	/* SIPE_CAL_FREE is 0 */
+	return(g_malloc0(BYTES(slots)));
+}
+
+void sipe_free_busy_set(guchar *bitmap, gsize slot, guint status)
+{
+	guint shift = 2 * (slot % SLOTS_PER_BYTE);
+	guchar *byte = bitmap + slot / SLOTS_PER_BYTE;
+
+	*byte = (*byte & ~(SLOT_MASK << shift)) | ((status & SLOT_MASK) << shift);
+}
+
+guchar *sipe_free_busy_from_base64(const gchar *base64, gsize *slots)
+{
+	guchar *bitmap = NULL;
+	gsize bytes = 0;
+
+	if (base64)
+		bitmap = g_base64_decode(base64, &bytes);
+	if (!bytes) {
+		g_free(bitmap);
+		bitmap = NULL;
+	}
+	*slots = bytes * SLOTS_PER_BYTE;
+
+	return(bitmap);
+}
+
+guchar *sipe_free_busy_from_digits(const gchar *digits, gsize *slots)
+{
+	guchar *bitmap;
+	gsize length, i;
+
+	*slots = 0;
+	if (!digits || !(length = strlen(digits)))
+		return(NULL);
+
+	bitmap = sipe_free_busy_new(length);
+	for (i = 0; i < length; i++) {
+		guint status = digits[i] - '0';
+
+		/* 2 bits can't store anything else, e.g. 4 (No data) */
+		if (status > SIPE_CAL_OOF)
+			status = SIPE_CAL_FREE;
+		sipe_free_busy_set(bitmap, i, status);
+	}
+	*slots = length;
+
+	return(bitmap);
+}
+
+gchar *sipe_free_busy_to_base64(const guchar *bitmap, gsize slots)
+{
+	if (!bitmap || !slots)
+		return(NULL);
+	return(g_base64_encode(bitmap, BYTES(slots)));
+}
+
+guint sipe_free_busy_status(const guchar *bitmap, gsize slots, gsize slot)
+{
+	if (!bitmap || (slot >= slots))
+		return(SIPE_CAL_NO_DATA);
+	return((bitmap[slot / SLOTS_PER_BYTE] >> (2 * (slot % SLOTS_PER_BYTE))) & SLOT_MASK);
+}
+
+gsize sipe_free_busy_next(const guchar *bitmap, gsize slots, gsize slot)
+{
+	guint64 pattern;
+	gsize first = slot + 1;
+	gsize word;
+
+	if (!bitmap || (first >= slots))
+		return(slots);
+
+	pattern = WORD_PATTERN(sipe_free_busy_status(bitmap, slots, slot));
+	for (word = first / SLOTS_PER_WORD;
+	     word * SLOTS_PER_WORD < slots;
+	     word++) {
+		guint64 diff = (free_busy_word(bitmap, slots, word) ^ pattern) &
+			free_busy_valid(slots, word);
+
+		/* ignore slots before the first one */
+		if (word == first / SLOTS_PER_WORD)
+			diff &= ~G_GUINT64_CONSTANT(0) << (2 * (first % SLOTS_PER_WORD));
+
+		if (diff)
+			return(word * SLOTS_PER_WORD +
+			       free_busy_lowest_bit(diff) / 2);
+	}
+
+	return(slots);
+}
+
+gsize sipe_free_busy_start(const guchar *bitmap, gsize slots, gsize slot)
+{
+	guint64 pattern;
+	gsize word;
+
+	if (!bitmap || (slot >= slots))
+		return(slot);
+
+	pattern = WORD_PATTERN(sipe_free_busy_status(bitmap, slots, slot));
+	for (word = slot / SLOTS_PER_WORD + 1; word-- > 0; ) {
+		guint64 diff = free_busy_word(bitmap, slots, word) ^ pattern;
+
+		/* ignore slot in question and all slots after it */
+		if (word == slot / SLOTS_PER_WORD)
+			diff &= (G_GUINT64_CONSTANT(1) << (2 * (slot % SLOTS_PER_WORD))) - 1;
+
+		if (diff)
+			return(word * SLOTS_PER_WORD +
+			       free_busy_highest_bit(diff) / 2 + 1);
+	}
+
+	return(0);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
@@ -0,0 +1,118 @@
+/**
+ * @file sipe-free-busy.h
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Free/busy bitmap
+ *
+ * Calendar status (SIPE_CAL_FREE ... SIPE_CAL_OOF) of consecutive time
+ * slots, packed 2 bits per slot, 4 slots per byte, lowest bits first.
+ * This is the binary form of the base64 encoded free/busy data used in
+ * calendarData publications.
+ *
+ * The bitmap is a plain guchar array. Its size in slots is kept by the
+ * caller.
+ */
+
+/**
+ * Allocate a bitmap with all slots set to SIPE_CAL_FREE
+ *
+ * @param slots number of slots
+ *
+ * @return bitmap. Must be g_free()'d after use.
+ */
+guchar *sipe_free_busy_new(gsize slots);
+
+/**
+ * Set the status of one slot
+ *
+ * @param bitmap free/busy bitmap
+ * @param slot   slot index
+ * @param status SIPE_CAL_FREE ... SIPE_CAL_OOF
+ */
+void sipe_free_busy_set(guchar *bitmap, gsize slot, guint status);
+
+/**
+ * Convert base64 encoded free/busy data to a bitmap
+ *
+ * @param base64 base64 string (may be @c NULL)
+ * @param slots  (out) number of slots in the bitmap
+ *
+ * @return bitmap or @c NULL. Must be g_free()'d after use.
+ */
+guchar *sipe_free_busy_from_base64(const gchar *base64, gsize *slots);
+
+/**
+ * Convert free/busy string with one digit per slot, as returned by
+ * Exchange Web Services (MergedFreeBusy), to a bitmap
+ *
+ * @param digits free/busy string (may be @c NULL)
+ * @param slots  (out) number of slots in the bitmap
+ *
+ * @return bitmap or @c NULL. Must be g_free()'d after use.
+ */
+guchar *sipe_free_busy_from_digits(const gchar *digits, gsize *slots);
+
+/**
+ * Base64 encode a bitmap
+ *
+ * @param bitmap free/busy bitmap (may be @c NULL)
+ * @param slots  number of slots
+ *
+ * @return base64 string or @c NULL. Must be g_free()'d after use.
+ */
+gchar *sipe_free_busy_to_base64(const guchar *bitmap, gsize slots);
+
+/**
+ * Status of a slot
+ *
+ * @param bitmap free/busy bitmap
+ * @param slots  number of slots
+ * @param slot   slot index
+ *
+ * @return SIPE_CAL_FREE ... SIPE_CAL_OOF or SIPE_CAL_NO_DATA if the slot
+ *         is outside of the bitmap
+ */
+guint sipe_free_busy_status(const guchar *bitmap, gsize slots, gsize slot);
+
+/**
+ * Find the next status change after a slot
+ *
+ * @param bitmap free/busy bitmap
+ * @param slots  number of slots
+ * @param slot   slot index
+ *
+ * @return index of the first slot after @c slot with a different status
+ *         or @c slots if the status doesn't change until the end
+ */
+gsize sipe_free_busy_next(const guchar *bitmap, gsize slots, gsize slot);
+
+/**
+ * Find the start of the current status span
+ *
+ * @param bitmap free/busy bitmap
+ * @param slots  number of slots
+ * @param slot   slot index (must be less than @c slots)
+ *
+ * @return index of the first slot of the span of slots with the same
+ *         status that contains @c slot
+ */
+gsize sipe_free_busy_start(const guchar *bitmap, gsize slots, gsize slot);
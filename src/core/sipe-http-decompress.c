@@ -0,0 +1,219 @@
+/**
+ * @file sipe-http-decompress.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * RFC 7230, section 4.2: compression codings
+ *
+ *  gzip    - RFC 1952
+ *  deflate - RFC 1950 "zlib" format. Some servers (e.g. older IIS) send
+ *            raw RFC 1951 data instead. The format is detected from the
+ *            first two bytes.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-http-decompress.h"
+#include "sipe-utils.h"
+
+#if GLIB_CHECK_VERSION(2,24,0)
+
+#define SIPE_HTTP_DECOMPRESS_BUFFER 4096
+/* protection against decompression bombs */
+#define SIPE_HTTP_DECOMPRESS_MAX    (64 * 1024 * 1024)
+
+struct sipe_http_decompress {
+	GConverter *converter;  /* NULL until deflate format has been detected */
+	guchar header[2];       /* first bytes of deflate data */
+	gsize header_length;
+	gsize total;            /* decompressed bytes */
+	gboolean started;       /* compressed data has been fed */
+	gboolean finished;
+};
+
+struct sipe_http_decompress *sipe_http_decompress_new(const gchar *content_encoding)
+{
+	struct sipe_http_decompress *decompress = NULL;
+
+	if (sipe_strcase_equal(content_encoding, "gzip") ||
+	    sipe_strcase_equal(content_encoding, "x-gzip")) {
+		decompress = g_new0(struct sipe_http_decompress, 1);
+		decompress->converter = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	} else if (sipe_strcase_equal(content_encoding, "deflate")) {
+		decompress = g_new0(struct sipe_http_decompress, 1);
+	} else if (content_encoding &&
+		   !sipe_strcase_equal(content_encoding, "identity")) {
+		SIPE_DEBUG_ERROR("sipe_http_decompress_new: unsupported encoding '%s'",
+				 content_encoding);
+	}
+
+	return(decompress);
+}
+
+static gboolean sipe_http_decompress_convert(struct sipe_http_decompress *decompress,
+					     const guchar *data,
+					     gsize length,
+					     GString *output)
+{
+	while (!decompress->finished) {
+		guchar buffer[SIPE_HTTP_DECOMPRESS_BUFFER];
+		gsize bytes_read, bytes_written;
+		GError *error = NULL;
+		GConverterResult result = g_converter_convert(decompress->converter,
+							      data,
+							      length,
+							      buffer,
+							      sizeof(buffer),
+							      G_CONVERTER_NO_FLAGS,
+							      &bytes_read,
+							      &bytes_written,
+							      &error);
+
+		if (result == G_CONVERTER_ERROR) {
+			/* all input has been consumed */
+			gboolean partial = g_error_matches(error,
+							   G_IO_ERROR,
+							   G_IO_ERROR_PARTIAL_INPUT);
+			if (!partial)
+				SIPE_DEBUG_ERROR("sipe_http_decompress_convert: %s",
+						 error->message);
+			g_error_free(error);
+			return(partial);
+		}
+
+		decompress->total += bytes_written;
+		if (decompress->total > SIPE_HTTP_DECOMPRESS_MAX) {
+			SIPE_DEBUG_ERROR("sipe_http_decompress_convert: decompressed data exceeds %u bytes",
+					 SIPE_HTTP_DECOMPRESS_MAX);
+			return(FALSE);
+		}
+
+		g_string_append_len(output, (gchar *) buffer, bytes_written);
+		data   += bytes_read;
+		length -= bytes_read;
+
+		if (result == G_CONVERTER_FINISHED)
+			/* ignore trailing garbage */
+			decompress->finished = TRUE;
+		else if ((length == 0) && (bytes_written < sizeof(buffer)))
+			/* no more output pending */
+			break;
+	}
+
+	return(TRUE);
+}
+
+gboolean sipe_http_decompress_feed(struct sipe_http_decompress *decompress,
+				   const gchar *data,
+				   gsize length,
+				   GString *output)
+{
+	const guchar *input = (const guchar *) data;
+
+	if (length)
+		decompress->started = TRUE;
+
+	if (!decompress->converter) {
+		GZlibCompressorFormat format;
+
+		while (length && (decompress->header_length < 2)) {
+			decompress->header[decompress->header_length++] = *input++;
+			length--;
+		}
+		if (decompress->header_length < 2)
+			return(TRUE);
+
+		/* RFC 1950: CM = 8 and FCHECK */
+		if (((decompress->header[0] & 0x0F) == 8) &&
+		    ((((guint) decompress->header[0] << 8) | decompress->header[1]) % 31 == 0)) {
+			format = G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+		} else {
+			SIPE_DEBUG_INFO_NOFORMAT("sipe_http_decompress_feed: raw deflate data");
+			format = G_ZLIB_COMPRESSOR_FORMAT_RAW;
+		}
+		decompress->converter = G_CONVERTER(g_zlib_decompressor_new(format));
+
+		if (!sipe_http_decompress_convert(decompress,
+						  decompress->header,
+						  decompress->header_length,
+						  output))
+			return(FALSE);
+	}
+
+	return(sipe_http_decompress_convert(decompress,
+					    input,
+					    length,
+					    output));
+}
+
+gboolean sipe_http_decompress_finished(struct sipe_http_decompress *decompress)
+{
+	/* empty body, e.g. 204 or 304, is not compressed at all */
+	return(!decompress->started || decompress->finished);
+}
+
+void sipe_http_decompress_free(struct sipe_http_decompress *decompress)
+{
+	if (decompress) {
+		if (decompress->converter)
+			g_object_unref(decompress->converter);
+		g_free(decompress);
+	}
+}
+
+#else
+
+/* Accept-Encoding: isn't sent, i.e. the server doesn't compress */
+struct sipe_http_decompress *sipe_http_decompress_new(SIPE_UNUSED_PARAMETER const gchar *content_encoding)
+{
+	return(NULL);
+}
+
+gboolean sipe_http_decompress_feed(SIPE_UNUSED_PARAMETER struct sipe_http_decompress *decompress,
+				   SIPE_UNUSED_PARAMETER const gchar *data,
+				   SIPE_UNUSED_PARAMETER gsize length,
+				   SIPE_UNUSED_PARAMETER GString *output)
+{
+	return(FALSE);
+}
+
+gboolean sipe_http_decompress_finished(SIPE_UNUSED_PARAMETER struct sipe_http_decompress *decompress)
+{
+	return(TRUE);
+}
+
+void sipe_http_decompress_free(SIPE_UNUSED_PARAMETER struct sipe_http_decompress *decompress)
+{
+}
+
+#endif
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
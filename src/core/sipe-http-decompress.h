@@ -0,0 +1,89 @@
+/**
+ * @file sipe-http-decompress.h
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * HTTP Content-Encoding decompression (gzip, deflate)
+ *
+ * Compressed data can be fed in arbitrary fragments, e.g. as the chunks of
+ * a chunked response arrive. Decompressed data is appended to a GString.
+ */
+
+/*
+ * Interface dependencies:
+ *
+ * <glib.h>
+ */
+
+/* GZlibDecompressor is available since GIO 2.24.0 */
+#if GLIB_CHECK_VERSION(2,24,0)
+#define SIPE_HTTP_ACCEPT_ENCODING "Accept-Encoding: gzip, deflate\r\n"
+#else
+#define SIPE_HTTP_ACCEPT_ENCODING ""
+#endif
+
+/* Forward declarations */
+struct sipe_http_decompress;
+
+/**
+ * Create decompressor for HTTP response
+ *
+ * @param content_encoding value of Content-Encoding header (may be @c NULL)
+ *
+ * @return decompressor or @c NULL if the body doesn't need to be, or can't
+ *         be, decompressed. Must be freed with sipe_http_decompress_free().
+ */
+struct sipe_http_decompress *sipe_http_decompress_new(const gchar *content_encoding);
+
+/**
+ * Decompress next fragment of HTTP body
+ *
+ * @param decompress decompressor
+ * @param data       compressed data
+ * @param length     length of compressed data
+ * @param output     decompressed data will be appended to this string
+ *
+ * @return @c FALSE if the data is corrupt
+ */
+gboolean sipe_http_decompress_feed(struct sipe_http_decompress *decompress,
+				   const gchar *data,
+				   gsize length,
+				   GString *output);
+
+/**
+ * Check for end of compressed data
+ *
+ * Call this when the HTTP body is complete. A compressed stream that
+ * ends before its end marker has been truncated.
+ *
+ * @param decompress decompressor
+ *
+ * @return @c TRUE if the compressed data was complete
+ */
+gboolean sipe_http_decompress_finished(struct sipe_http_decompress *decompress);
+
+/**
+ * Free decompressor
+ *
+ * @param decompress decompressor (may be @c NULL)
+ */
+void sipe_http_decompress_free(struct sipe_http_decompress *decompress);
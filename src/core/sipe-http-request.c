@@ -3,7 +3,7 @@
 *
  * pidgin-sipe
  *
- * Copyright (C) 2013-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -26,7 +26,7 @@
  *  - request handling: creation, parameters, deletion, cancelling
  *  - session handling: creation, closing
  *  - client authorization handling
- *  - connection request queue handling
+ *  - connection request queue handling, pipelining
  *  - compile HTTP header contents and hand-off to transport layer
  *  - process HTTP response and hand-off to user callback
  */
@@ -46,6 +46,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-http.h"
+#include "sipe-http-decompress.h"
 
 #define _SIPE_HTTP_PRIVATE_IF_REQUEST
 #include "sipe-http-request.h"
@@ -71,15 +72,22 @@ struct sipe_http_request {
 	const gchar *password; /* not copied */
 
 	sipe_http_response_callback *cb;
+	sipe_http_body_callback *body_cb; /* NULL: collect body */
 	gpointer cb_data;
 
 	guint32 flags;
 };
 
-#define SIPE_HTTP_REQUEST_FLAG_FIRST     0x00000001
-#define SIPE_HTTP_REQUEST_FLAG_REDIRECT  0x00000002
-#define SIPE_HTTP_REQUEST_FLAG_AUTHDATA  0x00000004
-#define SIPE_HTTP_REQUEST_FLAG_HANDSHAKE 0x00000008
+#define SIPE_HTTP_REQUEST_FLAG_READY      0x00000001
+#define SIPE_HTTP_REQUEST_FLAG_REDIRECT   0x00000002
+#define SIPE_HTTP_REQUEST_FLAG_AUTHDATA   0x00000004
+#define SIPE_HTTP_REQUEST_FLAG_HANDSHAKE  0x00000008
+#define SIPE_HTTP_REQUEST_FLAG_PIPELINING 0x00000010
+#define SIPE_HTTP_REQUEST_FLAG_SENT       0x00000020 /* waiting for response */
+#define SIPE_HTTP_REQUEST_FLAG_CANCELLED  0x00000040
+
+/* maximum number of requests in flight on a pipelining connection */
+#define SIPE_HTTP_PIPELINE_DEPTH 8
 
 static void sipe_http_request_free(struct sipe_core_private *sipe_private,
 				   struct sipe_http_request *req,
@@ -107,9 +115,9 @@ static void add_cookie_cb(SIPE_UNUSED_PARAMETER const gchar *key,
 	g_string_append_printf(string, "Cookie: %s\r\n", cookie);
 }
 
-static void sipe_http_request_send(struct sipe_http_connection_public *conn_public)
+static void sipe_http_request_send(struct sipe_http_connection_public *conn_public,
+				   struct sipe_http_request *req)
 {
-	struct sipe_http_request *req = conn_public->pending_requests->data;
 	gchar *header;
 	gchar *content = NULL;
 	gchar *cookie  = NULL;
@@ -131,6 +139,7 @@ static void sipe_http_request_send(struct sipe_http_connection_public *conn_publ
 	header = g_strdup_printf("%s /%s HTTP/1.1\r\n"
 				 "Host: %s\r\n"
 				 "User-Agent: Sipe/" PACKAGE_VERSION "\r\n"
+				 SIPE_HTTP_ACCEPT_ENCODING
 				 "%s%s%s%s",
 				 content ? "POST" : "GET",
 				 req->path,
@@ -147,6 +156,7 @@ static void sipe_http_request_send(struct sipe_http_connection_public *conn_publ
 	g_free(req->authorization);
 	req->authorization = NULL;
 
+	req->flags |= SIPE_HTTP_REQUEST_FLAG_SENT;
 	sipe_http_transport_send(conn_public,
 				 header,
 				 req->body);
@@ -155,12 +165,87 @@ static void sipe_http_request_send(struct sipe_http_connection_public *conn_publ
 
 gboolean sipe_http_request_pending(struct sipe_http_connection_public *conn_public)
 {
-	return(conn_public->pending_requests != NULL);
+	return(!g_queue_is_empty(&conn_public->pending_requests));
+}
+
+guint sipe_http_request_pending_count(struct sipe_http_connection_public *conn_public)
+{
+	return(g_queue_get_length(&conn_public->pending_requests));
+}
+
+/*
+ * HTTP/1.1 pipelining (RFC 7230, section 6.3.2)
+ *
+ * Only requests that are idempotent (GET without body) and don't depend
+ * on the outcome of earlier requests (no session cookies, no ongoing
+ * authentication handshake) can be pipelined. The connection must have
+ * already delivered a successful response, i.e. it is authenticated.
+ */
+static gboolean sipe_http_request_pipelinable(struct sipe_http_connection_public *conn_public,
+					      struct sipe_http_request *req)
+{
+	return(conn_public->pipelining                           &&
+	       (req->flags & SIPE_HTTP_REQUEST_FLAG_PIPELINING) &&
+	       (req->flags & SIPE_HTTP_REQUEST_FLAG_READY)      &&
+	       !req->body                                       &&
+	       !req->session                                    &&
+	       !req->authorization);
 }
 
 void sipe_http_request_next(struct sipe_http_connection_public *conn_public)
 {
-	sipe_http_request_send(conn_public);
+	/*
+	 * Requests are sent in queue order. Requests that have been sent
+	 * are always at the head of the queue, i.e. the next response
+	 * belongs to the request at the head.
+	 */
+	GList *entry = conn_public->pending_requests.head;
+	guint depth  = 0;
+
+	while (entry && (depth < SIPE_HTTP_PIPELINE_DEPTH)) {
+		struct sipe_http_request *req = entry->data;
+
+		/* only the first request may be sent without pipelining */
+		if (depth && !sipe_http_request_pipelinable(conn_public, req))
+			break;
+
+		if (!(req->flags & SIPE_HTTP_REQUEST_FLAG_SENT))
+			sipe_http_request_send(conn_public, req);
+
+		/* never pipeline behind a request that doesn't allow it */
+		if (!sipe_http_request_pipelinable(conn_public, req))
+			break;
+
+		entry = entry->next;
+		depth++;
+	}
+}
+
+void sipe_http_request_reset(struct sipe_http_connection_public *conn_public)
+{
+	GList *entry = conn_public->pending_requests.head;
+
+	conn_public->pipelining = FALSE;
+
+	while (entry) {
+		struct sipe_http_request *req = entry->data;
+		GList *next = entry->next;
+
+		if (req->flags & SIPE_HTTP_REQUEST_FLAG_CANCELLED) {
+			/* response will never arrive, drop request now */
+			g_queue_delete_link(&conn_public->pending_requests,
+					    entry);
+			sipe_http_request_free(conn_public->sipe_private,
+					       req,
+					       SIPE_HTTP_STATUS_CANCELLED);
+		} else if (req->flags & SIPE_HTTP_REQUEST_FLAG_SENT) {
+			SIPE_DEBUG_INFO("sipe_http_request_reset: re-sending request '%s' on %s",
+					req->path, conn_public->host);
+			req->flags &= ~SIPE_HTTP_REQUEST_FLAG_SENT;
+		}
+
+		entry = next;
+	}
 }
 
 static void sipe_http_request_enqueue(struct sipe_core_private *sipe_private,
@@ -174,11 +259,7 @@ static void sipe_http_request_enqueue(struct sipe_core_private *sipe_private,
 								parsed_uri->host,
 								parsed_uri->port,
 								parsed_uri->tls);
-	if (!sipe_http_request_pending(conn_public))
-		req->flags |= SIPE_HTTP_REQUEST_FLAG_FIRST;
-
-	conn_public->pending_requests = g_slist_append(conn_public->pending_requests,
-						       req);
+	g_queue_push_tail(&conn_public->pending_requests, req);
 }
 
 static void sipe_http_request_drop_context(struct sipe_http_connection_public *conn_public)
@@ -187,6 +268,7 @@ static void sipe_http_request_drop_context(struct sipe_http_connection_public *c
 	conn_public->cached_authorization = NULL;
 	sip_sec_destroy_context(conn_public->context);
 	conn_public->context = NULL;
+	conn_public->pipelining = FALSE;
 }
 
 static void sipe_http_request_finalize_negotiate(struct sipe_http_request *req,
@@ -249,13 +331,11 @@ static gboolean sipe_http_request_response_redirection(struct sipe_core_private
 		if (parsed_uri) {
 			/* remove request from old connection */
 			struct sipe_http_connection_public *conn_public = req->connection;
-			conn_public->pending_requests = g_slist_remove(conn_public->pending_requests,
-								       req);
+			g_queue_remove(&conn_public->pending_requests, req);
 
 			/* free old request data */
 			g_free(req->path);
-			req->flags &= ~( SIPE_HTTP_REQUEST_FLAG_FIRST |
-					 SIPE_HTTP_REQUEST_FLAG_HANDSHAKE );
+			req->flags &= ~SIPE_HTTP_REQUEST_FLAG_HANDSHAKE;
 
 			/* resubmit request on other connection */
 			sipe_http_request_enqueue(sipe_private, req, parsed_uri);
@@ -467,13 +547,59 @@ static void sipe_http_request_response_callback(struct sipe_core_private *sipe_p
 	sipe_http_request_cancel(req);
 }
 
-void sipe_http_request_response(struct sipe_http_connection_public *conn_public,
-				struct sipmsg *msg)
+gboolean sipe_http_request_response(struct sipe_http_connection_public *conn_public,
+				    struct sipmsg *msg)
 {
 	struct sipe_core_private *sipe_private = conn_public->sipe_private;
-	struct sipe_http_request *req = conn_public->pending_requests->data;
+	struct sipe_http_request *req = g_queue_peek_head(&conn_public->pending_requests);
+	GList *next;
 	gboolean failed;
 
+	if (!req) {
+		SIPE_DEBUG_ERROR("sipe_http_request_response: unexpected response from %s, resetting connection",
+				 conn_public->host);
+		return(TRUE);
+	}
+	next = conn_public->pending_requests.head->next;
+
+	/* response has arrived */
+	req->flags &= ~SIPE_HTTP_REQUEST_FLAG_SENT;
+
+	if (req->flags & SIPE_HTTP_REQUEST_FLAG_CANCELLED) {
+		SIPE_DEBUG_INFO("sipe_http_request_response: discarding response for cancelled request '%s'",
+				req->path);
+
+		/* handshake of cancelled request can't be continued */
+		if (msg->response == SIPE_HTTP_STATUS_CLIENT_UNAUTHORIZED)
+			sipe_http_request_drop_context(conn_public);
+
+		g_queue_pop_head(&conn_public->pending_requests);
+		sipe_http_request_free(sipe_private,
+				       req,
+				       SIPE_HTTP_STATUS_CANCELLED);
+		return(FALSE);
+	}
+
+	if ((msg->response == SIPE_HTTP_STATUS_CLIENT_UNAUTHORIZED) &&
+	    next &&
+	    (((struct sipe_http_request *) next->data)->flags & SIPE_HTTP_REQUEST_FLAG_SENT)) {
+		/*
+		 * Authentication handshake can't be mixed with pipelined
+		 * requests. Start over on a fresh connection without
+		 * pipelining. All requests are idempotent, so it is safe
+		 * to send them again.
+		 */
+		SIPE_DEBUG_INFO("sipe_http_request_response: authentication requested on pipelining connection to %s, resetting connection",
+				conn_public->host);
+		sipe_http_request_drop_context(conn_public);
+		return(TRUE);
+	}
+
+	if ((msg->response >= 200) &&
+	    (msg->response <  SIPE_HTTP_STATUS_REDIRECTION))
+		/* connection is authenticated */
+		conn_public->pipelining = TRUE;
+
 	if ((req->flags & SIPE_HTTP_REQUEST_FLAG_REDIRECT)   &&
 	    (msg->response >= SIPE_HTTP_STATUS_REDIRECTION)  &&
 	    (msg->response <  SIPE_HTTP_STATUS_CLIENT_ERROR)) {
@@ -515,24 +641,49 @@ void sipe_http_request_response(struct sipe_http_connection_public *conn_public,
 		/* remove failed request */
 		sipe_http_request_cancel(req);
 	}
+
+	return(FALSE);
+}
+
+gboolean sipe_http_request_streaming(struct sipe_http_connection_public *conn_public,
+				     struct sipmsg *msg)
+{
+	struct sipe_http_request *req = g_queue_peek_head(&conn_public->pending_requests);
+
+	return(req                                              &&
+	       req->body_cb                                     &&
+	       !(req->flags & SIPE_HTTP_REQUEST_FLAG_CANCELLED) &&
+	       (msg->response >= 200)                           &&
+	       (msg->response <  SIPE_HTTP_STATUS_REDIRECTION));
+}
+
+void sipe_http_request_body(struct sipe_http_connection_public *conn_public,
+			    const gchar *data,
+			    gsize length)
+{
+	struct sipe_http_request *req = g_queue_peek_head(&conn_public->pending_requests);
+
+	/* request might have been cancelled by an earlier fragment */
+	if (req &&
+	    req->body_cb &&
+	    !(req->flags & SIPE_HTTP_REQUEST_FLAG_CANCELLED))
+		(*req->body_cb)(conn_public->sipe_private,
+				data,
+				length,
+				req->cb_data);
 }
 
 void sipe_http_request_shutdown(struct sipe_http_connection_public *conn_public,
 				gboolean abort)
 {
-	if (conn_public->pending_requests) {
-		GSList *entry = conn_public->pending_requests;
-		while (entry) {
-			sipe_http_request_free(conn_public->sipe_private,
-					       entry->data,
-					       abort ?
-					       SIPE_HTTP_STATUS_ABORTED :
-					       SIPE_HTTP_STATUS_FAILED);
-			entry = entry->next;
-		}
-		g_slist_free(conn_public->pending_requests);
-		conn_public->pending_requests = NULL;
-	}
+	struct sipe_http_request *req;
+
+	while ((req = g_queue_pop_head(&conn_public->pending_requests)) != NULL)
+		sipe_http_request_free(conn_public->sipe_private,
+				       req,
+				       abort ?
+				       SIPE_HTTP_STATUS_ABORTED :
+				       SIPE_HTTP_STATUS_FAILED);
 
 	if (conn_public->context) {
 		g_free(conn_public->cached_authorization);
@@ -594,10 +745,14 @@ void sipe_http_request_ready(struct sipe_http_request *request)
 {
 	struct sipe_http_connection_public *conn_public = request->connection;
 
-	/* pass first request on already opened connection through directly */
-	if ((request->flags & SIPE_HTTP_REQUEST_FLAG_FIRST) &&
-	    conn_public->connected)
-		sipe_http_request_send(conn_public);
+	request->flags |= SIPE_HTTP_REQUEST_FLAG_READY;
+
+	/*
+	 * pass request on already opened connection through directly if
+	 * the connection is idle or the request can be pipelined
+	 */
+	if (conn_public->connected)
+		sipe_http_request_next(conn_public);
 }
 
 struct sipe_http_session *sipe_http_session_start(void)
@@ -621,11 +776,22 @@ void sipe_http_session_close(struct sipe_http_session *session)
 void sipe_http_request_cancel(struct sipe_http_request *request)
 {
 	struct sipe_http_connection_public *conn_public = request->connection;
-	conn_public->pending_requests = g_slist_remove(conn_public->pending_requests,
-						       request);
 
-	/* cancelled by requester, don't use callback */
-	request->cb = NULL;
+	/* cancelled by requester, don't use callbacks */
+	request->cb      = NULL;
+	request->body_cb = NULL;
+
+	/*
+	 * Request is on the wire: keep it in the queue until its response
+	 * arrives, otherwise responses would be assigned to the wrong
+	 * requests.
+	 */
+	if (request->flags & SIPE_HTTP_REQUEST_FLAG_SENT) {
+		request->flags |= SIPE_HTTP_REQUEST_FLAG_CANCELLED;
+		return;
+	}
+
+	g_queue_remove(&conn_public->pending_requests, request);
 
 	sipe_http_request_free(conn_public->sipe_private,
 			       request,
@@ -643,6 +809,17 @@ void sipe_http_request_allow_redirect(struct sipe_http_request *request)
 	request->flags |= SIPE_HTTP_REQUEST_FLAG_REDIRECT;
 }
 
+void sipe_http_request_allow_pipelining(struct sipe_http_request *request)
+{
+	request->flags |= SIPE_HTTP_REQUEST_FLAG_PIPELINING;
+}
+
+void sipe_http_request_stream_body(struct sipe_http_request *request,
+				   sipe_http_body_callback *callback)
+{
+	request->body_cb = callback;
+}
+
 void sipe_http_request_authentication(struct sipe_http_request *request,
 				      const gchar *user,
 				      const gchar *password)
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -69,6 +69,15 @@ void sipe_http_parsed_uri_free(struct sipe_http_parsed_uri *parsed_uri);
  */
 gboolean sipe_http_request_pending(struct sipe_http_connection_public *conn_public);
 
+/**
+ * Number of requests queued on HTTP connection
+ *
+ * @param conn_public HTTP connection public data
+ *
+ * @return number of pending requests, including the active one
+ */
+guint sipe_http_request_pending_count(struct sipe_http_connection_public *conn_public);
+
 /**
  * HTTP connection is ready for next request
  *
@@ -76,14 +85,49 @@ gboolean sipe_http_request_pending(struct sipe_http_connection_public *conn_publ
  */
 void sipe_http_request_next(struct sipe_http_connection_public *conn_public);
 
+/**
+ * HTTP connection was closed
+ *
+ * Requests that were sent, but haven't received a response yet, will be
+ * sent again when the connection has been re-established.
+ *
+ * @param conn_public HTTP connection public data
+ */
+void sipe_http_request_reset(struct sipe_http_connection_public *conn_public);
+
 /**
  * HTTP response received
  *
  * @param conn_public HTTP connection public data
  * @param msg         parsed message
+ *
+ * @return @c TRUE if the connection needs to be re-established
+ */
+gboolean sipe_http_request_response(struct sipe_http_connection_public *conn_public,
+				    struct sipmsg *msg);
+
+/**
+ * Should the body of the HTTP response be streamed?
+ *
+ * @param conn_public HTTP connection public data
+ * @param msg         parsed message header
+ *
+ * @return @c TRUE if the body should be passed to @c sipe_http_request_body()
+ *         instead of being collected in the message
+ */
+gboolean sipe_http_request_streaming(struct sipe_http_connection_public *conn_public,
+				     struct sipmsg *msg);
+
+/**
+ * HTTP response body fragment received
+ *
+ * @param conn_public HTTP connection public data
+ * @param data        decoded body fragment
+ * @param length      length of body fragment
  */
-void sipe_http_request_response(struct sipe_http_connection_public *conn_public,
-				struct sipmsg *msg);
+void sipe_http_request_body(struct sipe_http_connection_public *conn_public,
+			    const gchar *data,
+			    gsize length);
 
 /**
  * HTTP connection shutdown
@@ -0,0 +1,406 @@
+/**
+ * @file sipe-http-tests.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Tests for the HTTP response decoder in sipe-http-transport.c
+ *
+ * Every response is fed to the transport input callback in one read, one
+ * byte at a time and in random splits, like a real backend would do after
+ * a read. The random seed can be given on the command line.
+ *
+ * Usage: sipe_http_tests [<seed>]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "sipe-common.h"
+#include "sipe-backend.h"
+#include "sipe-core.h"
+#include "sipe-core-private.h"
+#include "sipe-http.h"
+#include "sipe-mime.h"
+#include "sipe-schedule.h"
+#include "sipe-utils.h"
+#include "sip-sec.h"
+
+#define TEST_BUFFER_LENGTH 4096
+#define TEST_RANDOM_SPLITS   50
+#define TEST_RANDOM_MAX      16
+
+/* stub functions for backend API */
+void sipe_backend_debug_literal(SIPE_UNUSED_PARAMETER sipe_debug_level level,
+				SIPE_UNUSED_PARAMETER const gchar *msg) {}
+void sipe_backend_debug(SIPE_UNUSED_PARAMETER sipe_debug_level level,
+			SIPE_UNUSED_PARAMETER const gchar *format,
+			...) {}
+gboolean sipe_backend_debug_enabled(void)
+{
+	return FALSE;
+}
+
+const gchar *sipe_backend_setting(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				  sipe_setting type)
+{
+	/* one connection, i.e. pipelined requests share it */
+	return((type == SIPE_SETTING_HTTP_CONNECTIONS) ? "1" : NULL);
+}
+
+static struct sipe_transport_connection *connection = NULL;
+static sipe_connect_setup setup;
+
+struct sipe_transport_connection *sipe_backend_transport_connect(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+								 const sipe_connect_setup *new_setup)
+{
+	connection = g_new0(struct sipe_transport_connection, 1);
+	connection->user_data     = new_setup->user_data;
+	connection->buffer        = g_malloc0(TEST_BUFFER_LENGTH);
+	connection->buffer_length = TEST_BUFFER_LENGTH;
+	setup = *new_setup;
+	setup.connected(connection);
+	return(connection);
+}
+void sipe_backend_transport_disconnect(struct sipe_transport_connection *conn)
+{
+	g_free(conn->buffer);
+	g_free(conn);
+	connection = NULL;
+}
+void sipe_backend_transport_message(SIPE_UNUSED_PARAMETER struct sipe_transport_connection *conn,
+				    SIPE_UNUSED_PARAMETER const gchar *buffer) {}
+gchar *sipe_backend_markup_css_property(SIPE_UNUSED_PARAMETER const gchar *style,
+					SIPE_UNUSED_PARAMETER const gchar *option) { return(NULL); }
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public) { return(NULL); }
+
+/* stub functions for core API */
+void sipe_schedule_seconds(SIPE_UNUSED_PARAMETER struct sipe_core_private *sipe_private,
+			   SIPE_UNUSED_PARAMETER const gchar *name,
+			   SIPE_UNUSED_PARAMETER gpointer data,
+			   SIPE_UNUSED_PARAMETER guint timeout,
+			   SIPE_UNUSED_PARAMETER sipe_schedule_action action,
+			   SIPE_UNUSED_PARAMETER GDestroyNotify destroy) {}
+void sipe_schedule_cancel(SIPE_UNUSED_PARAMETER struct sipe_core_private *sipe_private,
+			  SIPE_UNUSED_PARAMETER const gchar *name) {}
+struct sip_sec_context *sip_sec_create_context(SIPE_UNUSED_PARAMETER guint type,
+					       SIPE_UNUSED_PARAMETER gboolean sso,
+					       SIPE_UNUSED_PARAMETER gboolean http,
+					       SIPE_UNUSED_PARAMETER const gchar *username,
+					       SIPE_UNUSED_PARAMETER const gchar *password) { return(NULL); }
+gboolean sip_sec_init_context_step(SIPE_UNUSED_PARAMETER struct sip_sec_context *context,
+				   SIPE_UNUSED_PARAMETER const gchar *target,
+				   SIPE_UNUSED_PARAMETER const gchar *input_toked_base64,
+				   SIPE_UNUSED_PARAMETER gchar **output_toked_base64,
+				   SIPE_UNUSED_PARAMETER guint *expires) { return(FALSE); }
+const gchar *sip_sec_context_name(SIPE_UNUSED_PARAMETER struct sip_sec_context *context) { return(NULL); }
+guint sip_sec_context_type(SIPE_UNUSED_PARAMETER struct sip_sec_context *context) { return(0); }
+void sip_sec_destroy_context(SIPE_UNUSED_PARAMETER struct sip_sec_context *context) {}
+gchar *sipe_get_epid(SIPE_UNUSED_PARAMETER const gchar *self_sip_uri,
+		     SIPE_UNUSED_PARAMETER const gchar *hostname,
+		     SIPE_UNUSED_PARAMETER const gchar *ip_address) { return(NULL); }
+void sipe_mime_parts_foreach(SIPE_UNUSED_PARAMETER const gchar *type,
+			     SIPE_UNUSED_PARAMETER const gchar *body,
+			     SIPE_UNUSED_PARAMETER sipe_mime_parts_cb callback,
+			     SIPE_UNUSED_PARAMETER gpointer user_data) {}
+
+/* test helpers */
+static guint succeeded = 0;
+static guint failed    = 0;
+static GString *result = NULL;
+static GRand *splits   = NULL;
+
+static void response_callback(SIPE_UNUSED_PARAMETER struct sipe_core_private *sipe_private,
+			      guint status,
+			      SIPE_UNUSED_PARAMETER GSList *headers,
+			      const gchar *body,
+			      gpointer callback_data)
+{
+	g_string_append_printf(result, "<%s:%u:%s>",
+			       (const gchar *) callback_data,
+			       status,
+			       body ? body : "(nil)");
+}
+
+static void request(struct sipe_core_private *sipe_private,
+		    const gchar *path,
+		    gboolean pipelining)
+{
+	gchar *uri = g_strdup_printf("https://localhost/%s", path);
+	struct sipe_http_request *req = sipe_http_request_get(sipe_private,
+							      uri,
+							      NULL,
+							      response_callback,
+							      (gpointer) path);
+	g_free(uri);
+	if (pipelining)
+		sipe_http_request_allow_pipelining(req);
+	sipe_http_request_ready(req);
+}
+
+/* split: 0 - one read, 1 - one byte at a time, otherwise random */
+static void input(const gchar *response, guint split)
+{
+	gsize length = strlen(response);
+
+	/* connection is dropped on fatal errors */
+	while (length && connection) {
+		gsize size = length;
+
+		if (split == 1) {
+			size = 1;
+		} else if (split) {
+			size = g_rand_int_range(splits, 1, TEST_RANDOM_MAX + 1);
+			size = MIN(size, length);
+		}
+
+		memcpy(connection->buffer + connection->buffer_used,
+		       response,
+		       size);
+		connection->buffer_used += size;
+		connection->buffer[connection->buffer_used] = '\0';
+		response += size;
+		length   -= size;
+
+		setup.input(connection);
+	}
+}
+
+/*
+ * Send warm-up request to the (new) connection. Requests for which
+ * pipelining is allowed are only pipelined after the first response.
+ */
+static void warmup(struct sipe_core_private *sipe_private, guint split)
+{
+	request(sipe_private, "warmup", FALSE);
+	input("HTTP/1.1 200 OK\r\n"
+	      "Content-Length: 2\r\n"
+	      "\r\n"
+	      "OK",
+	      split);
+	g_string_truncate(result, 0);
+}
+
+static void assert_response(struct sipe_core_private *sipe_private,
+			    const gchar *label,
+			    guint requests,
+			    const gchar *response,
+			    const gchar *expected,
+			    gboolean keep_alive)
+{
+	static const gchar * const paths[] = { "a", "b", "c" };
+	guint split;
+
+	for (split = 0; split < 2 + TEST_RANDOM_SPLITS; split++) {
+		guint i;
+
+		warmup(sipe_private, split);
+		for (i = 0; i < requests; i++)
+			request(sipe_private, paths[i], TRUE);
+		input(response, split);
+
+		if (sipe_strequal(result->str, expected)) {
+			succeeded++;
+		} else {
+			printf("[%s] split %u\nHTTP response FAILED: '%s' expected: '%s'\n",
+			       label, split, result->str, expected);
+			failed++;
+		}
+		g_string_truncate(result, 0);
+
+		/* connection must be idle or dropped after a fatal error */
+		if (keep_alive ?
+		    (connection && !connection->buffer_used) :
+		    !connection) {
+			succeeded++;
+		} else {
+			printf("[%s] split %u\nHTTP connection FAILED: %s\n",
+			       label, split,
+			       connection ?
+			       (connection->buffer_used ? connection->buffer : "up") :
+			       "dropped");
+			failed++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct sipe_core_private *sipe_private = g_new0(struct sipe_core_private, 1);
+	guint32 seed = (argc > 1) ? strtoul(argv[1], NULL, 10) : time(NULL);
+
+	printf("Random seed: %u\n", seed);
+	splits = g_rand_new_with_seed(seed);
+	result = g_string_new("");
+
+	/* no authentication */
+	SIPE_CORE_PRIVATE_FLAG_SET(SSO);
+
+	/* Content-Length */
+	assert_response(sipe_private, "content-length", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 11\r\n"
+			"\r\n"
+			"Hello World",
+			"<a:200:Hello World>",
+			TRUE);
+	assert_response(sipe_private, "content-length zero", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 0\r\n"
+			"\r\n",
+			"<a:200:>",
+			TRUE);
+	assert_response(sipe_private, "leading CRLF", 1,
+			"\r\n"
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 5\r\n"
+			"\r\n"
+			"Hello",
+			"<a:200:Hello>",
+			TRUE);
+
+	/* Transfer-Encoding: chunked */
+	assert_response(sipe_private, "chunked", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"5\r\n"
+			"Hello\r\n"
+			"6\r\n"
+			" World\r\n"
+			"0\r\n"
+			"\r\n",
+			"<a:200:Hello World>",
+			TRUE);
+	assert_response(sipe_private, "chunked hex size", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"1A\r\n"
+			"abcdefghijklmnopqrstuvwxyz\r\n"
+			"0\r\n"
+			"\r\n",
+			"<a:200:abcdefghijklmnopqrstuvwxyz>",
+			TRUE);
+	assert_response(sipe_private, "chunked zero length", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"0\r\n"
+			"\r\n",
+			"<a:200:>",
+			TRUE);
+	assert_response(sipe_private, "chunk extensions", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"5;name=value\r\n"
+			"Hello\r\n"
+			"6 ; name=\"quoted;value\"\r\n"
+			" World\r\n"
+			"0;last\r\n"
+			"\r\n",
+			"<a:200:Hello World>",
+			TRUE);
+	assert_response(sipe_private, "trailers", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"5\r\n"
+			"Hello\r\n"
+			"0\r\n"
+			"X-Trailer-1: value\r\n"
+			"X-Trailer-2: value\r\n"
+			"\r\n",
+			"<a:200:Hello>",
+			TRUE);
+	assert_response(sipe_private, "chunk without CRLF", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"5\r\n"
+			"HelloX\r\n"
+			"0\r\n"
+			"\r\n",
+			"<a:500:Hello>",
+			FALSE);
+	assert_response(sipe_private, "illegal chunk size", 1,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"XYZ\r\n"
+			"0\r\n"
+			"\r\n",
+			"<a:500:>",
+			FALSE);
+
+	/* pipelined responses in one read */
+	assert_response(sipe_private, "pipelined", 3,
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 1\r\n"
+			"\r\n"
+			"A"
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"1;ext\r\n"
+			"B\r\n"
+			"0\r\n"
+			"X-Trailer: value\r\n"
+			"\r\n"
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Length: 0\r\n"
+			"\r\n",
+			"<a:200:A><b:200:B><c:200:>",
+			TRUE);
+	assert_response(sipe_private, "pipelined zero length", 2,
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"0\r\n"
+			"\r\n"
+			"HTTP/1.1 404 Not Found\r\n"
+			"Content-Length: 0\r\n"
+			"\r\n",
+			"<a:200:><b:404:>",
+			TRUE);
+
+	sipe_http_free(sipe_private);
+	g_free(sipe_private);
+	g_string_free(result, TRUE);
+	g_rand_free(splits);
+
+	printf("Result: %d PASSED %d FAILED\n", succeeded, failed);
+	return(failed);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
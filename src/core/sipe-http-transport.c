@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013-2014 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -24,6 +24,7 @@
  * SIPE HTTP transport layer implementation
  *
  *  - connection handling: opening, closing, timeout
+ *  - connection pool: several connections per host, request dispatching
  *  - interface to backend: sending & receiving of raw messages
  *  - request queue pulling
  */
@@ -39,6 +40,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-http.h"
+#include "sipe-http-decompress.h"
 #include "sipe-schedule.h"
 #include "sipe-utils.h"
 
@@ -54,20 +56,61 @@
 #define SIPE_HTTP_TIMEOUT_ACTION  "<+http-timeout>"
 #define SIPE_HTTP_DEFAULT_TIMEOUT 60 /* in seconds */
 
+/* parallel connections per host:port, see SIPE_SETTING_HTTP_CONNECTIONS */
+#define SIPE_HTTP_DEFAULT_CONNECTIONS 4
+#define SIPE_HTTP_MAX_CONNECTIONS     16
+
+/* initial body buffer size, Content-Length: is only a hint */
+#define SIPE_HTTP_BODY_PREALLOCATE    (64 * 1024)
+
+struct sipe_http_pool;
+
+enum sipe_http_decoder_state {
+	SIPE_HTTP_DECODER_HEADER = 0,
+	SIPE_HTTP_DECODER_BODY,        /* Content-Length: body */
+	SIPE_HTTP_DECODER_CHUNK_SIZE,
+	SIPE_HTTP_DECODER_CHUNK_DATA,
+	SIPE_HTTP_DECODER_CHUNK_END,   /* CRLF after chunk data */
+	SIPE_HTTP_DECODER_TRAILER,
+	SIPE_HTTP_DECODER_COMPLETE
+};
+
+/* response that is currently being received */
+struct sipe_http_decoder {
+	enum sipe_http_decoder_state state;
+	struct sipmsg *msg;
+	gchar *header;                           /* for debugging */
+	struct sipe_http_decompress *decompress; /* NULL if not compressed */
+	GString *body;                           /* scratch buffer if streaming */
+	guint64 remaining;                       /* of body or current chunk */
+	gboolean stream;                         /* pass body to request layer */
+	gboolean corrupt;
+};
+
 struct sipe_http_connection {
 	struct sipe_http_connection_public public;
 
 	struct sipe_transport_connection *connection;
+	struct sipe_http_pool *pool;
+	struct sipe_http_decoder decoder;
 
-	gchar *host_port;
-	time_t timeout;  /* in seconds from epoch */
+	gchar *host_port; /* host:port#<number>, only used for debugging */
+	time_t timeout;   /* in seconds from epoch */
 	gboolean use_tls;
 };
 
+/* all connections to one host:port */
+struct sipe_http_pool {
+	gchar *host_port;
+	GSList *connections;
+	guint counter;
+};
+
 struct sipe_http {
-	GHashTable *connections;
+	GHashTable *connections; /* host:port -> struct sipe_http_pool */
 	GQueue *timeouts;
 	time_t next_timeout; /* in seconds from epoch, 0 if timer isn't running */
+	guint max_connections;
 	gboolean shutting_down;
 };
 
@@ -81,6 +124,7 @@ static gint timeout_compare(gconstpointer a,
 
 static void sipe_http_transport_update_timeout_queue(struct sipe_http_connection *conn,
 						     gboolean remove);
+static void sipe_http_decoder_reset(struct sipe_http_decoder *decoder);
 static void sipe_http_transport_free(gpointer data)
 {
 	struct sipe_http_connection *conn = data;
@@ -97,29 +141,47 @@ static void sipe_http_transport_free(gpointer data)
 	sipe_http_request_shutdown(SIPE_HTTP_CONNECTION_PUBLIC,
 				   conn->public.sipe_private->http->shutting_down);
 
+	sipe_http_decoder_reset(&conn->decoder);
 	g_free(conn->public.host);
 
 	g_free(conn->host_port);
 	g_free(conn);
 }
 
+static void sipe_http_pool_free(gpointer data)
+{
+	struct sipe_http_pool *pool = data;
+	GSList *connections = pool->connections;
+
+	/* detach list first, connection free calls back into user code */
+	pool->connections = NULL;
+	sipe_utils_slist_free_full(connections, sipe_http_transport_free);
+
+	g_free(pool->host_port);
+	g_free(pool);
+}
+
 static void sipe_http_transport_drop(struct sipe_http *http,
 				     struct sipe_http_connection *conn,
 				     const gchar *message)
 {
+	struct sipe_http_pool *pool = conn->pool;
+
 	SIPE_DEBUG_INFO("sipe_http_transport_drop: dropping connection '%s': %s",
 			conn->host_port,
 			message ? message : "REASON UNKNOWN");
 
-#if GLIB_CHECK_VERSION(2,30,0)
-	/* this triggers sipe_http_transport_free() */
-	g_hash_table_remove(http->connections, conn->host_port);
-#else
-	/* GLIB < 2.30 calls destroy notifiers *before* removing the entry */
-	/* which can cause a race condition with sipe_http_transport_new() */
-	g_hash_table_steal(http->connections, conn->host_port);
+	/*
+	 * Remove the connection from the pool *before* freeing it. Request
+	 * callbacks triggered by sipe_http_transport_free() may call
+	 * sipe_http_transport_new() for the same host:port again.
+	 */
+	pool->connections = g_slist_remove(pool->connections, conn);
+	if (!pool->connections)
+		/* this triggers sipe_http_pool_free() */
+		g_hash_table_remove(http->connections, pool->host_port);
+
 	sipe_http_transport_free(conn);
-#endif
 	/* conn is no longer valid */
 }
 
@@ -229,14 +291,25 @@ void sipe_http_free(struct sipe_core_private *sipe_private)
 static void sipe_http_init(struct sipe_core_private *sipe_private)
 {
 	struct sipe_http *http;
+	const gchar *setting;
 	if (sipe_private->http)
 		return;
 
 	sipe_private->http = http = g_new0(struct sipe_http, 1);
 	http->connections = g_hash_table_new_full(g_str_hash, g_str_equal,
 						  NULL,
-						  sipe_http_transport_free);
+						  sipe_http_pool_free);
 	http->timeouts = g_queue_new();
+
+	http->max_connections = SIPE_HTTP_DEFAULT_CONNECTIONS;
+	setting = sipe_backend_setting(SIPE_CORE_PUBLIC,
+				       SIPE_SETTING_HTTP_CONNECTIONS);
+	if (!is_empty(setting)) {
+		guint value = g_ascii_strtoull(setting, NULL, 10);
+		http->max_connections = CLAMP(value, 1, SIPE_HTTP_MAX_CONNECTIONS);
+	}
+	SIPE_DEBUG_INFO("sipe_http_init: up to %d connections per host",
+			http->max_connections);
 }
 
 static void sipe_http_transport_connected(struct sipe_transport_connection *connection)
@@ -248,6 +321,7 @@ static void sipe_http_transport_connected(struct sipe_transport_connection *conn
 
 	SIPE_DEBUG_INFO("sipe_http_transport_connected: %s", conn->host_port);
 	conn->public.connected = TRUE;
+	sipe_utils_buffer_high_water(sipe_private, connection);
 
 	/* add active connection to timeout queue */
 	conn->timeout = current_time + SIPE_HTTP_DEFAULT_TIMEOUT;
@@ -263,172 +337,304 @@ static void sipe_http_transport_connected(struct sipe_transport_connection *conn
 	sipe_http_request_next(SIPE_HTTP_CONNECTION_PUBLIC);
 }
 
-static void sipe_http_transport_input(struct sipe_transport_connection *connection)
+static void sipe_http_transport_connect(struct sipe_http_connection *conn);
+
+static void sipe_http_decoder_reset(struct sipe_http_decoder *decoder)
 {
-	struct sipe_http_connection *conn = SIPE_HTTP_CONNECTION;
-	char *current = connection->buffer;
+	if (decoder->msg)
+		sipmsg_free(decoder->msg);
+	g_free(decoder->header);
+	sipe_http_decompress_free(decoder->decompress);
+	if (decoder->body)
+		g_string_free(decoder->body, TRUE);
+	memset(decoder, 0, sizeof(struct sipe_http_decoder));
+}
 
-	/* according to the RFC remove CRLF at the beginning */
-	while (*current == '\r' || *current == '\n') {
-		current++;
+/* returns pointer to next CRLF or NULL */
+static const gchar *sipe_http_decoder_line_end(const gchar *start,
+					       const gchar *end)
+{
+	while ((start = memchr(start, '\r', end - start)) != NULL) {
+		if ((start + 1 < end) && (start[1] == '\n'))
+			return(start);
+		start++;
 	}
-	if (current != connection->buffer)
-		sipe_utils_shrink_buffer(connection, current);
-
-	if (conn->connection &&
-	    (current = strstr(connection->buffer, "\r\n\r\n")) != NULL) {
-		struct sipmsg *msg;
-		gboolean drop = FALSE;
-		gboolean next;
-
-		current += 2;
-		current[0] = '\0';
-		msg = sipmsg_parse_header(connection->buffer);
-		if (!msg) {
-			/* restore header for next try */
-			current[0] = '\r';
-			return;
-		}
+	return(NULL);
+}
 
+static void sipe_http_decoder_header(struct sipe_http_connection *conn,
+				     struct sipmsg *msg)
+{
+	struct sipe_http_decoder *decoder = &conn->decoder;
+
+	decoder->msg        = msg;
+	decoder->decompress = sipe_http_decompress_new(sipmsg_find_header(msg, "Content-Encoding"));
+	decoder->stream     = sipe_http_request_streaming(SIPE_HTTP_CONNECTION_PUBLIC,
+							  msg);
+
+	if (msg->response == SIPMSG_RESPONSE_FATAL_ERROR) {
+		/* fatal header parse error, ignore body */
+		decoder->body  = g_string_new("");
+		decoder->state = SIPE_HTTP_DECODER_COMPLETE;
+	} else if (msg->bodylen == SIPMSG_BODYLEN_CHUNKED) {
 		/* HTTP/1.1 Transfer-Encoding: chunked */
-		if (msg->bodylen == SIPMSG_BODYLEN_CHUNKED) {
-			gchar *start        = current + 2;
-			GSList *chunks      = NULL;
-			gboolean incomplete = TRUE;
-
-			msg->bodylen = 0;
-			while (strlen(start) > 0) {
-				gchar *tmp;
-				guint length = g_ascii_strtoll(start, &tmp, 16);
-				guint remainder;
-				struct _chunk {
-					guint length;
-					const gchar *start;
-				} *chunk;
-
-				/* Illegal number */
-				if ((length == 0) && (start == tmp))
-					break;
-				msg->bodylen += length;
+		decoder->body  = g_string_new("");
+		decoder->state = SIPE_HTTP_DECODER_CHUNK_SIZE;
+	} else {
+		decoder->remaining = MAX(msg->bodylen, 0);
+		decoder->body      = decoder->stream ?
+			g_string_new("") :
+			g_string_sized_new(MIN(decoder->remaining,
+					       SIPE_HTTP_BODY_PREALLOCATE));
+		decoder->state     = decoder->remaining ?
+			SIPE_HTTP_DECODER_BODY :
+			SIPE_HTTP_DECODER_COMPLETE;
+	}
+}
 
-				/* Chunk header not finished yet */
-				tmp = strstr(tmp, "\r\n");
-				if (tmp == NULL)
-					break;
+static void sipe_http_decoder_body(struct sipe_http_connection *conn,
+				   const gchar *data,
+				   gsize length)
+{
+	struct sipe_http_decoder *decoder = &conn->decoder;
+
+	if (decoder->decompress) {
+		/* skip the rest of a corrupt body */
+		if (!decoder->corrupt &&
+		    !sipe_http_decompress_feed(decoder->decompress,
+					       data,
+					       length,
+					       decoder->body))
+			decoder->corrupt = TRUE;
+
+		if (decoder->stream && decoder->body->len) {
+			sipe_http_request_body(SIPE_HTTP_CONNECTION_PUBLIC,
+					       decoder->body->str,
+					       decoder->body->len);
+			g_string_truncate(decoder->body, 0);
+		}
+	} else if (decoder->stream) {
+		/* directly from the connection buffer */
+		sipe_http_request_body(SIPE_HTTP_CONNECTION_PUBLIC,
+				       data,
+				       length);
+	} else {
+		g_string_append_len(decoder->body, data, length);
+	}
+}
 
-				/* Chunk not finished yet */
-				tmp += 2;
-				remainder = connection->buffer_used - (tmp - connection->buffer);
-				if (remainder < length + 2)
-					break;
+static void sipe_http_decoder_error(struct sipe_http_decoder *decoder,
+				    const gchar *reason)
+{
+	SIPE_DEBUG_ERROR("sipe_http_decoder_error: %s", reason);
+	decoder->msg->response = SIPMSG_RESPONSE_FATAL_ERROR;
+	decoder->state         = SIPE_HTTP_DECODER_COMPLETE;
+}
 
-				/* Next chunk */
-				start = tmp + length + 2;
-
-				/* Body completed */
-				if (length == 0) {
-					gchar *dummy  = g_malloc(msg->bodylen + 1);
-					gchar *p      = dummy;
-					GSList *entry = chunks;
-
-					while (entry) {
-						chunk = entry->data;
-						memcpy(p, chunk->start, chunk->length);
-						p += chunk->length;
-						entry = entry->next;
-					}
-					p[0] = '\0';
-
-					msg->body = dummy;
-					sipe_utils_message_debug("HTTP",
-								 connection->buffer,
-								 msg->body,
-								 FALSE);
-
-					current = start;
-					sipe_utils_shrink_buffer(connection,
-								 current);
-
-					incomplete = FALSE;
+/*
+ * Consume as much data from the connection buffer as possible.
+ *
+ * The decoder state is kept in the connection, i.e. data is only looked
+ * at once, regardless of how the response is split up by TCP reads.
+ *
+ * Returns FALSE if the response is not complete yet or the connection
+ * has been dropped.
+ */
+static gboolean sipe_http_decoder_input(struct sipe_transport_connection *connection)
+{
+	struct sipe_http_connection *conn = SIPE_HTTP_CONNECTION;
+	struct sipe_http_decoder *decoder = &conn->decoder;
+	const gchar *current = connection->buffer;
+	const gchar *end     = connection->buffer + connection->buffer_used;
+
+	while (decoder->state != SIPE_HTTP_DECODER_COMPLETE) {
+		const gchar *line_end;
+		gsize length;
+
+		switch (decoder->state) {
+		case SIPE_HTTP_DECODER_HEADER:
+			/* according to the RFC remove CRLF at the beginning */
+			while ((current < end) &&
+			       ((*current == '\r') || (*current == '\n')))
+				current++;
+
+			/* header ends with an empty line */
+			line_end = current;
+			while ((line_end = sipe_http_decoder_line_end(line_end, end)) != NULL) {
+				if ((line_end + 3 < end) &&
+				    (line_end[2] == '\r') &&
+				    (line_end[3] == '\n'))
 					break;
+				line_end += 2;
+			}
+			if (!line_end)
+				goto incomplete;
+
+			decoder->header = g_strndup(current, line_end + 2 - current);
+			current         = line_end + 4;
+			{
+				struct sipmsg *msg = sipmsg_parse_header(decoder->header);
+
+				if (!msg) {
+					sipe_http_transport_drop(conn->public.sipe_private->http,
+								 conn,
+								 "invalid HTTP response header");
+					/* conn is no longer valid */
+					return(FALSE);
 				}
-
-				/* Append completed chunk */
-				chunk = g_new0(struct _chunk, 1);
-				chunk->length = length;
-				chunk->start  = tmp;
-				chunks = g_slist_append(chunks, chunk);
+				sipe_http_decoder_header(conn, msg);
 			}
+			break;
+
+		case SIPE_HTTP_DECODER_BODY:
+		case SIPE_HTTP_DECODER_CHUNK_DATA:
+			length = MIN((gsize) (end - current), decoder->remaining);
+			if (!length)
+				goto incomplete;
+
+			sipe_http_decoder_body(conn, current, length);
+			current            += length;
+			decoder->remaining -= length;
 
-			if (chunks)
-				sipe_utils_slist_free_full(chunks, g_free);
+			if (!decoder->remaining)
+				decoder->state = (decoder->state == SIPE_HTTP_DECODER_BODY) ?
+					SIPE_HTTP_DECODER_COMPLETE :
+					SIPE_HTTP_DECODER_CHUNK_END;
+			break;
+
+		case SIPE_HTTP_DECODER_CHUNK_SIZE:
+			line_end = sipe_http_decoder_line_end(current, end);
+			if (!line_end)
+				goto incomplete;
+			{
+				gchar *size_end;
+				/* chunk extensions after ";" are ignored */
+				guint64 size = g_ascii_strtoull(current, &size_end, 16);
+
+				if (size_end == current) {
+					sipe_http_decoder_error(decoder, "illegal chunk size");
+					break;
+				}
+				current = line_end + 2;
 
-			if (incomplete) {
-				/* restore header for next try */
-				sipmsg_free(msg);
-				current[0] = '\r';
-				return;
+				if (size) {
+					decoder->remaining = size;
+					decoder->state     = SIPE_HTTP_DECODER_CHUNK_DATA;
+				} else {
+					decoder->state     = SIPE_HTTP_DECODER_TRAILER;
+				}
 			}
+			break;
 
-		} else {
-			guint remainder = connection->buffer_used - (current + 2 - connection->buffer);
-
-			if (remainder >= (guint) msg->bodylen) {
-				char *dummy = g_malloc(msg->bodylen + 1);
-				current += 2;
-				memcpy(dummy, current, msg->bodylen);
-				dummy[msg->bodylen] = '\0';
-				msg->body = dummy;
-				current += msg->bodylen;
-				sipe_utils_message_debug("HTTP",
-							 connection->buffer,
-							 msg->body,
-							 FALSE);
-				sipe_utils_shrink_buffer(connection, current);
-			} else {
-				SIPE_DEBUG_INFO("sipe_http_transport_input: body too short (%d < %d, strlen %" G_GSIZE_FORMAT ") - ignoring message",
-						remainder, msg->bodylen, strlen(connection->buffer));
-
-				/* restore header for next try */
-				sipmsg_free(msg);
-				current[0] = '\r';
-				return;
+		case SIPE_HTTP_DECODER_CHUNK_END:
+			if (end - current < 2)
+				goto incomplete;
+			if ((current[0] != '\r') || (current[1] != '\n')) {
+				sipe_http_decoder_error(decoder, "chunk not terminated by CRLF");
+				break;
 			}
-		}
+			current       += 2;
+			decoder->state = SIPE_HTTP_DECODER_CHUNK_SIZE;
+			break;
 
-		if (msg->response == SIPMSG_RESPONSE_FATAL_ERROR) {
-			/* fatal header parse error */
-			msg->response = SIPE_HTTP_STATUS_SERVER_ERROR;
-			drop          = TRUE;
-		} else if (sipe_strcase_equal(sipmsg_find_header(msg, "Connection"), "close")) {
-			SIPE_DEBUG_INFO("sipe_http_transport_input: server requested close '%s'",
-					conn->host_port);
-			drop          = TRUE;
-		}
+		case SIPE_HTTP_DECODER_TRAILER:
+			/* trailer headers are ignored, last chunk ends with an empty line */
+			line_end = sipe_http_decoder_line_end(current, end);
+			if (!line_end)
+				goto incomplete;
+			if (line_end == current)
+				decoder->state = SIPE_HTTP_DECODER_COMPLETE;
+			current = line_end + 2;
+			break;
 
-		sipe_http_request_response(SIPE_HTTP_CONNECTION_PUBLIC, msg);
-		next = sipe_http_request_pending(SIPE_HTTP_CONNECTION_PUBLIC);
-
-		if (drop) {
-			/* drop backend connection */
-			sipe_backend_transport_disconnect(conn->connection);
-			conn->connection       = NULL;
-			conn->public.connected = FALSE;
-
-			/* if we have pending requests we need to trigger re-connect */
-			if (next)
-				sipe_http_transport_new(conn->public.sipe_private,
-							conn->public.host,
-							conn->public.port,
-							conn->use_tls);
-
-		} else if (next) {
-			/* trigger sending of next pending request */
-			sipe_http_request_next(SIPE_HTTP_CONNECTION_PUBLIC);
+		case SIPE_HTTP_DECODER_COMPLETE:
+			break;
 		}
+	}
 
-		sipmsg_free(msg);
+	sipe_utils_shrink_buffer(connection, current);
+	return(TRUE);
+
+ incomplete:
+	/* everything up to here has been processed */
+	sipe_utils_shrink_buffer(connection, current);
+	return(FALSE);
+}
+
+/* TRUE indicates that a message was processed and the connection is still up */
+static gboolean sipe_http_transport_message(struct sipe_transport_connection *connection)
+{
+	struct sipe_http_connection *conn = SIPE_HTTP_CONNECTION;
+	struct sipe_http_decoder *decoder = &conn->decoder;
+	struct sipmsg *msg;
+	gboolean drop = FALSE;
+
+	if (!conn->connection || !sipe_http_decoder_input(connection))
+		return(FALSE);
+
+	/* response is complete: take it over from the decoder */
+	msg          = decoder->msg;
+	decoder->msg = NULL;
+	msg->bodylen = decoder->body->len;
+	msg->body    = g_string_free(decoder->body, FALSE);
+	decoder->body = NULL;
+	sipe_utils_message_debug("HTTP",
+				 decoder->header,
+				 msg->body,
+				 FALSE);
+
+	/* corrupt, oversized or truncated compressed body */
+	if (decoder->decompress &&
+	    (msg->response != SIPMSG_RESPONSE_FATAL_ERROR) &&
+	    (decoder->corrupt ||
+	     !sipe_http_decompress_finished(decoder->decompress))) {
+		SIPE_DEBUG_ERROR("sipe_http_transport_message: corrupt compressed body from '%s'",
+				 conn->host_port);
+		msg->response = SIPE_HTTP_STATUS_FAILED;
+	}
+	sipe_http_decoder_reset(decoder);
+
+	if (msg->response == SIPMSG_RESPONSE_FATAL_ERROR) {
+		/* fatal header parse error */
+		msg->response = SIPE_HTTP_STATUS_SERVER_ERROR;
+		drop          = TRUE;
+	} else if (sipe_strcase_equal(sipmsg_find_header(msg, "Connection"), "close")) {
+		SIPE_DEBUG_INFO("sipe_http_transport_message: server requested close '%s'",
+				conn->host_port);
+		drop          = TRUE;
 	}
+
+	if (sipe_http_request_response(SIPE_HTTP_CONNECTION_PUBLIC, msg))
+		drop = TRUE;
+	sipmsg_free(msg);
+
+	if (drop) {
+		/* drop backend connection */
+		sipe_backend_transport_disconnect(conn->connection);
+		conn->connection       = NULL;
+		conn->public.connected = FALSE;
+
+		/* pipelined requests are lost */
+		sipe_http_request_reset(SIPE_HTTP_CONNECTION_PUBLIC);
+
+		/* if we have pending requests we need to trigger re-connect */
+		if (sipe_http_request_pending(SIPE_HTTP_CONNECTION_PUBLIC))
+			sipe_http_transport_connect(conn);
+
+		return(FALSE);
+	}
+
+	/* trigger sending of next pending request */
+	if (sipe_http_request_pending(SIPE_HTTP_CONNECTION_PUBLIC))
+		sipe_http_request_next(SIPE_HTTP_CONNECTION_PUBLIC);
+
+	return(TRUE);
+}
+
+static void sipe_http_transport_input(struct sipe_transport_connection *connection)
+{
+	/* pipelined responses can arrive in one read */
+	while (sipe_http_transport_message(connection));
 }
 
 static void sipe_http_transport_error(struct sipe_transport_connection *connection,
@@ -441,6 +647,66 @@ static void sipe_http_transport_error(struct sipe_transport_connection *connecti
 	/* conn is no longer valid */
 }
 
+static void sipe_http_transport_connect(struct sipe_http_connection *conn)
+{
+	struct sipe_core_private *sipe_private = conn->public.sipe_private;
+	sipe_connect_setup setup = {
+		conn->use_tls ? SIPE_TRANSPORT_TLS : SIPE_TRANSPORT_TCP,
+		conn->public.host,
+		conn->public.port,
+		conn,
+		sipe_http_transport_connected,
+		sipe_http_transport_input,
+		sipe_http_transport_error
+	};
+
+	/* will be re-inserted after connect */
+	sipe_http_transport_update_timeout_queue(conn, TRUE);
+
+	/* discard partially received response */
+	sipe_http_decoder_reset(&conn->decoder);
+
+	conn->public.connected = FALSE;
+	conn->connection = sipe_backend_transport_connect(SIPE_CORE_PUBLIC,
+							  &setup);
+}
+
+/*
+ * Select connection for the next request:
+ *
+ *  - idle connection (connected ones first)
+ *  - NULL, i.e. open a new connection, if the pool isn't full yet
+ *  - least-loaded connection
+ */
+static struct sipe_http_connection *sipe_http_pool_select(struct sipe_http *http,
+							  struct sipe_http_pool *pool)
+{
+	struct sipe_http_connection *selected = NULL;
+	guint selected_load = 0;
+	GSList *entry;
+
+	for (entry = pool->connections; entry; entry = entry->next) {
+		struct sipe_http_connection *conn = entry->data;
+		guint load = sipe_http_request_pending_count(SIPE_HTTP_CONNECTION_PUBLIC);
+
+		if (!selected ||
+		    (load < selected_load) ||
+		    ((load == selected_load) &&
+		     conn->public.connected &&
+		     !selected->public.connected)) {
+			selected      = conn;
+			selected_load = load;
+		}
+	}
+
+	if (selected &&
+	    ((selected_load == 0) ||
+	     (g_slist_length(pool->connections) >= http->max_connections)))
+		return(selected);
+
+	return(NULL);
+}
+
 struct sipe_http_connection_public *sipe_http_transport_new(struct sipe_core_private *sipe_private,
 							    const gchar *host_in,
 							    const guint32 port,
@@ -459,51 +725,47 @@ struct sipe_http_connection_public *sipe_http_transport_new(struct sipe_core_pri
 		SIPE_DEBUG_ERROR("sipe_http_transport_new: new connection requested during shutdown: THIS SHOULD NOT HAPPEN! Debugging information:\n"
 				 "Host/Port: %s", host_port);
 	} else {
-		conn = g_hash_table_lookup(http->connections, host_port);
+		struct sipe_http_pool *pool = g_hash_table_lookup(http->connections,
+								  host_port);
+
+		if (!pool) {
+			pool = g_new0(struct sipe_http_pool, 1);
+			pool->host_port = host_port;
+			g_hash_table_insert(http->connections,
+					    host_port,
+					    pool);
+			host_port = NULL; /* pool takes ownership of the key */
+		}
+
+		conn = sipe_http_pool_select(http, pool);
 
 		if (conn) {
 			/* re-establishing connection */
-			if (!conn->connection) {
-				SIPE_DEBUG_INFO("sipe_http_transport_new: re-establishing %s", host_port);
-
-				/* will be re-inserted after connect */
-				sipe_http_transport_update_timeout_queue(conn, TRUE);
-			}
+			if (!conn->connection)
+				SIPE_DEBUG_INFO("sipe_http_transport_new: re-establishing %s", conn->host_port);
 
 		} else {
 			/* new connection */
-			SIPE_DEBUG_INFO("sipe_http_transport_new: new %s", host_port);
-
 			conn = g_new0(struct sipe_http_connection, 1);
 
 			conn->public.sipe_private = sipe_private;
 			conn->public.host         = g_strdup(host);
 			conn->public.port         = port;
 
-			conn->host_port           = host_port;
+			conn->pool                = pool;
+			conn->host_port           = g_strdup_printf("%s#%u",
+								    pool->host_port,
+								    ++pool->counter);
 			conn->use_tls             = use_tls;
 
-			g_hash_table_insert(http->connections,
-					    host_port,
-					    conn);
-			host_port = NULL; /* conn_private takes ownership of the key */
-		}
+			SIPE_DEBUG_INFO("sipe_http_transport_new: new %s", conn->host_port);
 
-		if (!conn->connection) {
-			sipe_connect_setup setup = {
-				use_tls ? SIPE_TRANSPORT_TLS : SIPE_TRANSPORT_TCP,
-				host,
-				port,
-				conn,
-				sipe_http_transport_connected,
-				sipe_http_transport_input,
-				sipe_http_transport_error
-			};
-
-			conn->public.connected = FALSE;
-			conn->connection = sipe_backend_transport_connect(SIPE_CORE_PUBLIC,
-									  &setup);
+			pool->connections = g_slist_append(pool->connections,
+							   conn);
 		}
+
+		if (!conn->connection)
+			sipe_http_transport_connect(conn);
 	}
 
 	g_free(host_port);
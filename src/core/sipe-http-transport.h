@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -39,9 +39,11 @@ struct sip_sec_context;
 struct sipe_http_connection_public {
 	struct sipe_core_private *sipe_private;
 
-	GSList *pending_requests;        /* handled by sipe-http-request.c */
+	GQueue pending_requests;         /* handled by sipe-http-request.c */
+	/* authentication is connection-based, i.e. not shared in the pool */
 	struct sip_sec_context *context; /* handled by sipe-http-request.c */
 	gchar *cached_authorization;     /* handled by sipe-http-request.c */
+	gboolean pipelining;             /* handled by sipe-http-request.c */
 
 	gchar *host;
 	guint32 port;
@@ -60,7 +62,10 @@ gboolean sipe_http_shutting_down(struct sipe_core_private *sipe_private);
 /**
  * Initiate HTTP connection
  *
- * If a connection to this host/port already exists it will be reused.
+ * Connections to the same host/port are pooled. An idle connection will
+ * be reused. Otherwise a new connection is opened until the pool has
+ * reached its maximum size (SIPE_SETTING_HTTP_CONNECTIONS). After that
+ * the connection with the least pending requests is returned.
  *
  * @param sipe_private SIPE core private data
  * @param host         name of the host to connect to
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2013-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2013-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -50,6 +50,21 @@ typedef void (sipe_http_response_callback)(struct sipe_core_private *sipe_privat
 					   const gchar *body,
 					   gpointer callback_data);
 
+/**
+ * HTTP response body callback
+ *
+ * Called for each fragment of the decoded response body as it arrives.
+ *
+ * @param sipe_private  SIPE core private data
+ * @param data          body fragment (not NUL terminated)
+ * @param length        length of body fragment
+ * @param callback_data callback data (same as for response callback)
+ */
+typedef void (sipe_http_body_callback)(struct sipe_core_private *sipe_private,
+				       const gchar *data,
+				       gsize length,
+				       gpointer callback_data);
+
 /* HTTP response status codes */
 #define SIPE_HTTP_STATUS_FAILED                0 /* internal use */
 #define SIPE_HTTP_STATUS_OK                  200
@@ -151,6 +166,34 @@ void sipe_http_request_session(struct sipe_http_request *request,
  */
 void sipe_http_request_allow_redirect(struct sipe_http_request *request);
 
+/**
+ * Allow HTTP/1.1 pipelining of HTTP request
+ *
+ * Only has an effect for GET requests outside of HTTP sessions. The
+ * request may be sent before the responses of earlier requests on the
+ * same connection have been received. Use this only for requests that
+ * can safely be repeated.
+ *
+ * @param request pointer to opaque HTTP request data structure
+ */
+void sipe_http_request_allow_pipelining(struct sipe_http_request *request);
+
+/**
+ * Stream body of successful HTTP response
+ *
+ * The body of a 2xx response is not collected in memory. Instead it is
+ * passed to @c callback fragment by fragment as it arrives. Afterwards the
+ * response callback is called with an empty body. If the response callback
+ * reports a failure then the data received so far must be discarded.
+ *
+ * Bodies of all other responses are passed to the response callback as usual.
+ *
+ * @param request  pointer to opaque HTTP request data structure
+ * @param callback body callback function
+ */
+void sipe_http_request_stream_body(struct sipe_http_request *request,
+				   sipe_http_body_callback *callback);
+
 /**
  * Provide authentication information for HTTP request
  *
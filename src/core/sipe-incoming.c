@@ -291,9 +291,7 @@ static void sipe_invite_mime_cb(gpointer user_data, const GSList *fields,
 
 		/* Replace message body with chosen alternative, so we can continue to
 		 * process it as a normal single part message. */
-		g_free(msg->body);
-		msg->body = g_strndup(body, length);
-		msg->bodylen = length;
+		sipmsg_set_body(msg, g_strndup(body, length), length);
 	}
 }
 #endif
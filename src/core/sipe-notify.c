@@ -43,6 +43,7 @@
 #include "sipe-conf.h"
 #include "sipe-core.h"
 #include "sipe-core-private.h"
+#include "sipe-free-busy.h"
 #include "sipe-group.h"
 #include "sipe-groupchat.h"
 #include "sipe-media.h"
@@ -518,14 +519,14 @@ static void process_incoming_notify_msrtc(struct sipe_core_private *sipe_private
 	sbuddy = sipe_buddy_find_by_uri(sipe_private, uri);
 	if (sbuddy)
 	{
-		g_free(sbuddy->activity);
-		sbuddy->activity = activity;
-		activity = NULL;
+		struct sipe_buddy_calendar *cal = sipe_buddy_calendar(sbuddy);
 
-		sbuddy->activity_since = activity_since;
+		sipe_buddy_set_string(sipe_private, &sbuddy->activity, activity);
 
-		sbuddy->user_avail = user_avail;
-		sbuddy->user_avail_since = user_avail_since;
+		cal->activity_since = activity_since;
+
+		cal->user_avail = user_avail;
+		cal->user_avail_since = user_avail_since;
 
 		g_free(sbuddy->note);
 		sbuddy->note = NULL;
@@ -533,27 +534,24 @@ static void process_incoming_notify_msrtc(struct sipe_core_private *sipe_private
 
 		sbuddy->is_oof_note = (xn_oof != NULL);
 
-		g_free(sbuddy->device_name);
-		sbuddy->device_name = NULL;
-		if (!is_empty(device_name)) { sbuddy->device_name = g_strdup(device_name); }
+		sipe_buddy_set_string(sipe_private,
+				      &sbuddy->device_name,
+				      is_empty(device_name) ? NULL : device_name);
 
 		if (!is_empty(cal_free_busy_base64)) {
-			g_free(sbuddy->cal_start_time);
-			sbuddy->cal_start_time = g_strdup(cal_start_time);
-
-			sbuddy->cal_granularity = sipe_strcase_equal(cal_granularity, "PT15M") ? 15 : 0;
+			cal->start_time = sipe_utils_str_to_time(cal_start_time);
 
-			g_free(sbuddy->cal_free_busy_base64);
-			sbuddy->cal_free_busy_base64 = cal_free_busy_base64;
-			cal_free_busy_base64 = NULL;
+			cal->granularity = sipe_strcase_equal(cal_granularity, "PT15M") ? 15 : 0;
 
-			g_free(sbuddy->cal_free_busy);
-			sbuddy->cal_free_busy = NULL;
+			g_free(cal->free_busy);
+			cal->free_busy = sipe_free_busy_from_base64(cal_free_busy_base64,
+								    &cal->free_busy_slots);
 		}
 
-		sbuddy->last_non_cal_status_id = status_id;
-		g_free(sbuddy->last_non_cal_activity);
-		sbuddy->last_non_cal_activity = g_strdup(sbuddy->activity);
+		cal->last_non_cal_status_id = status_id;
+		sipe_buddy_set_string(sipe_private,
+				      &cal->last_non_cal_activity,
+				      sbuddy->activity);
 
 		if (sipe_strcase_equal(sbuddy->name, self_uri)) {
 			if (!sipe_strequal(sbuddy->note, sipe_private->note)) /* not same */
@@ -570,7 +568,7 @@ static void process_incoming_notify_msrtc(struct sipe_core_private *sipe_private
 			}
 
 			sipe_status_set_token(sipe_private,
-					      sbuddy->last_non_cal_status_id);
+					      cal->last_non_cal_status_id);
 		}
 	}
 	g_free(cal_free_busy_base64);
@@ -590,346 +588,381 @@ static void process_incoming_notify_msrtc(struct sipe_core_private *sipe_private
 	g_free(self_uri);
 }
 
-static void process_incoming_notify_rlmi(struct sipe_core_private *sipe_private,
-					 const gchar *data,
-					 unsigned len)
+struct rlmi_data {
+	struct sipe_core_private *sipe_private;
+	struct sipe_buddy *sbuddy;
+	gchar *uri;
+	const char *status;
+	gboolean do_update_status;
+	gboolean has_note_cleaned;
+	gboolean has_free_busy_cleaned;
+};
+
+static gboolean process_incoming_notify_rlmi_categories(const sipe_xml *xn_categories,
+							gpointer user_data)
 {
-	const char *uri;
-	struct sipe_buddy *sbuddy = NULL;
-	sipe_xml *xn_categories;
-	const sipe_xml *xn_category;
-	const char *status = NULL;
-	gboolean do_update_status = FALSE;
-	gboolean has_note_cleaned = FALSE;
-	gboolean has_free_busy_cleaned = FALSE;
-
-	xn_categories = sipe_xml_parse(data, len);
-	uri = sipe_xml_attribute(xn_categories, "uri"); /* with 'sip:' prefix */
+	struct rlmi_data *rlmi = user_data;
+	const gchar *uri = sipe_xml_attribute(xn_categories, "uri"); /* with 'sip:' prefix */
+
 	if (uri) {
-		sbuddy = sipe_buddy_find_by_uri(sipe_private, uri);
+		rlmi->sbuddy = sipe_buddy_find_by_uri(rlmi->sipe_private, uri);
+		rlmi->uri    = g_strdup(uri);
 	}
 
-	if (!sbuddy) {
-		/* Got presence of a buddy not in our contact list, ignore. */
-		sipe_xml_free(xn_categories);
-		return;
-	}
+	/* Got presence of a buddy not in our contact list, ignore. */
+	return(rlmi->sbuddy != NULL);
+}
 
-	for (xn_category = sipe_xml_child(xn_categories, "category");
-		 xn_category ;
-		 xn_category = sipe_xml_twin(xn_category) )
+static gboolean process_incoming_notify_rlmi_category(const sipe_xml *xn_category,
+						      gpointer user_data)
+{
+	struct rlmi_data *rlmi = user_data;
+	struct sipe_core_private *sipe_private = rlmi->sipe_private;
+	struct sipe_buddy *sbuddy = rlmi->sbuddy;
+	const gchar *uri = rlmi->uri;
+	const sipe_xml *xn_node;
+	const char *tmp;
+	const char *attrVar = sipe_xml_attribute(xn_category, "name");
+	time_t publish_time = (tmp = sipe_xml_attribute(xn_category, "publishTime")) ?
+		sipe_utils_str_to_time(tmp) : 0;
+
+	/* contactCard */
+	if (sipe_strequal(attrVar, "contactCard"))
 	{
-		const sipe_xml *xn_node;
-		const char *tmp;
-		const char *attrVar = sipe_xml_attribute(xn_category, "name");
-		time_t publish_time = (tmp = sipe_xml_attribute(xn_category, "publishTime")) ?
-			sipe_utils_str_to_time(tmp) : 0;
-
-		/* contactCard */
-		if (sipe_strequal(attrVar, "contactCard"))
-		{
-			const sipe_xml *card = sipe_xml_child(xn_category, "contactCard");
-
-			if (card) {
-				const sipe_xml *node;
-				/* identity - Display Name and email */
-				node = sipe_xml_child(card, "identity");
-				if (node) {
-					char* display_name = sipe_xml_data(
-						sipe_xml_child(node, "name/displayName"));
-					char* email = sipe_xml_data(
-						sipe_xml_child(node, "email"));
-
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DISPLAY_NAME, display_name);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_EMAIL, email);
-
-					g_free(display_name);
-					g_free(email);
-				}
-				/* company */
-				node = sipe_xml_child(card, "company");
-				if (node) {
-					char* company = sipe_xml_data(node);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_COMPANY, company);
-					g_free(company);
-				}
-				/* department */
-				node = sipe_xml_child(card, "department");
-				if (node) {
-					char* department = sipe_xml_data(node);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DEPARTMENT, department);
-					g_free(department);
-				}
-				/* title */
-				node = sipe_xml_child(card, "title");
-				if (node) {
-					char* title = sipe_xml_data(node);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_JOB_TITLE, title);
-					g_free(title);
-				}
-				/* office */
-				node = sipe_xml_child(card, "office");
-				if (node) {
-					char* office = sipe_xml_data(node);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_OFFICE, office);
-					g_free(office);
-				}
-				/* site (url) */
-				node = sipe_xml_child(card, "url");
-				if (node) {
-					char* site = sipe_xml_data(node);
-					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_SITE, site);
-					g_free(site);
-				}
-				/* phone */
-				for (node = sipe_xml_child(card, "phone");
-				     node;
-				     node = sipe_xml_twin(node))
-				{
-					const char *phone_type = sipe_xml_attribute(node, "type");
-					char* phone = sipe_xml_data(sipe_xml_child(node, "uri"));
-					char* phone_display_string = sipe_xml_data(sipe_xml_child(node, "displayString"));
-
-					sipe_update_user_phone(sipe_private, uri, phone_type, phone, phone_display_string);
-
-					g_free(phone);
-					g_free(phone_display_string);
+		const sipe_xml *card = sipe_xml_child(xn_category, "contactCard");
+
+		if (card) {
+			const sipe_xml *node;
+			/* identity - Display Name and email */
+			node = sipe_xml_child(card, "identity");
+			if (node) {
+				char* display_name = sipe_xml_data(
+					sipe_xml_child(node, "name/displayName"));
+				char* email = sipe_xml_data(
+					sipe_xml_child(node, "email"));
+
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DISPLAY_NAME, display_name);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_EMAIL, email);
+
+				g_free(display_name);
+				g_free(email);
+			}
+			/* company */
+			node = sipe_xml_child(card, "company");
+			if (node) {
+				char* company = sipe_xml_data(node);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_COMPANY, company);
+				g_free(company);
+			}
+			/* department */
+			node = sipe_xml_child(card, "department");
+			if (node) {
+				char* department = sipe_xml_data(node);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DEPARTMENT, department);
+				g_free(department);
+			}
+			/* title */
+			node = sipe_xml_child(card, "title");
+			if (node) {
+				char* title = sipe_xml_data(node);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_JOB_TITLE, title);
+				g_free(title);
+			}
+			/* office */
+			node = sipe_xml_child(card, "office");
+			if (node) {
+				char* office = sipe_xml_data(node);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_OFFICE, office);
+				g_free(office);
+			}
+			/* site (url) */
+			node = sipe_xml_child(card, "url");
+			if (node) {
+				char* site = sipe_xml_data(node);
+				sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_SITE, site);
+				g_free(site);
+			}
+			/* phone */
+			for (node = sipe_xml_child(card, "phone");
+			     node;
+			     node = sipe_xml_twin(node))
+			{
+				const char *phone_type = sipe_xml_attribute(node, "type");
+				char* phone = sipe_xml_data(sipe_xml_child(node, "uri"));
+				char* phone_display_string = sipe_xml_data(sipe_xml_child(node, "displayString"));
+
+				sipe_update_user_phone(sipe_private, uri, phone_type, phone, phone_display_string);
+
+				g_free(phone);
+				g_free(phone_display_string);
+			}
+			/* address */
+			for (node = sipe_xml_child(card, "address");
+			     node;
+			     node = sipe_xml_twin(node))
+			{
+				if (sipe_strequal(sipe_xml_attribute(node, "type"), "work")) {
+					char* street = sipe_xml_data(sipe_xml_child(node, "street"));
+					char* city = sipe_xml_data(sipe_xml_child(node, "city"));
+					char* state = sipe_xml_data(sipe_xml_child(node, "state"));
+					char* zipcode = sipe_xml_data(sipe_xml_child(node, "zipcode"));
+					char* country_code = sipe_xml_data(sipe_xml_child(node, "countryCode"));
+
+					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_STREET, street);
+					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_CITY, city);
+					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_STATE, state);
+					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_ZIPCODE, zipcode);
+					sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_COUNTRY, country_code);
+
+					g_free(street);
+					g_free(city);
+					g_free(state);
+					g_free(zipcode);
+					g_free(country_code);
+
+					break;
 				}
-				/* address */
-				for (node = sipe_xml_child(card, "address");
-				     node;
-				     node = sipe_xml_twin(node))
-				{
-					if (sipe_strequal(sipe_xml_attribute(node, "type"), "work")) {
-						char* street = sipe_xml_data(sipe_xml_child(node, "street"));
-						char* city = sipe_xml_data(sipe_xml_child(node, "city"));
-						char* state = sipe_xml_data(sipe_xml_child(node, "state"));
-						char* zipcode = sipe_xml_data(sipe_xml_child(node, "zipcode"));
-						char* country_code = sipe_xml_data(sipe_xml_child(node, "countryCode"));
-
-						sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_STREET, street);
-						sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_CITY, city);
-						sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_STATE, state);
-						sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_ZIPCODE, zipcode);
-						sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_COUNTRY, country_code);
-
-						g_free(street);
-						g_free(city);
-						g_free(state);
-						g_free(zipcode);
-						g_free(country_code);
-
-						break;
-					}
+			}
+			/* photo */
+			for (node = sipe_xml_child(card, "photo");
+			     node;
+			     node = sipe_xml_twin(node)) {
+				gchar *photo_url = sipe_xml_data(sipe_xml_child(node, "uri"));
+				gchar *hash = sipe_xml_data(sipe_xml_child(node, "hash"));
+				gboolean found = FALSE;
+
+				if (!is_empty(uri) && !is_empty(hash)) {
+					sipe_buddy_update_photo(sipe_private,
+								uri,
+								hash,
+								photo_url,
+								NULL);
+					found = TRUE;
 				}
-				/* photo */
-				for (node = sipe_xml_child(card, "photo");
-				     node;
-				     node = sipe_xml_twin(node)) {
-					gchar *photo_url = sipe_xml_data(sipe_xml_child(node, "uri"));
-					gchar *hash = sipe_xml_data(sipe_xml_child(node, "hash"));
-					gboolean found = FALSE;
-
-					if (!is_empty(uri) && !is_empty(hash)) {
-						sipe_buddy_update_photo(sipe_private,
-									uri,
-									hash,
-									photo_url,
-									NULL);
-						found = TRUE;
-					}
 
-					g_free(hash);
-					g_free(photo_url);
+				g_free(hash);
+				g_free(photo_url);
 
-					if (found)
-						break;
-				}
+				if (found)
+					break;
 			}
 		}
-		/* note */
-		else if (sipe_strequal(attrVar, "note"))
-		{
-			if (!has_note_cleaned) {
-				has_note_cleaned = TRUE;
+	}
+	/* note */
+	else if (sipe_strequal(attrVar, "note"))
+	{
+		if (!rlmi->has_note_cleaned) {
+			rlmi->has_note_cleaned = TRUE;
 
-				g_free(sbuddy->note);
-				sbuddy->note = NULL;
-				sbuddy->is_oof_note = FALSE;
-				sbuddy->note_since = publish_time;
+			g_free(sbuddy->note);
+			sbuddy->note = NULL;
+			sbuddy->is_oof_note = FALSE;
+			sbuddy->note_since = publish_time;
 
-				do_update_status = TRUE;
-			}
-			if (publish_time >= sbuddy->note_since) {
-				/* clean up in case no 'note' element is supplied
-				 * which indicate note removal in client
-				 */
-				g_free(sbuddy->note);
-				sbuddy->note = NULL;
-				sbuddy->is_oof_note = FALSE;
+			rlmi->do_update_status = TRUE;
+		}
+		if (publish_time >= sbuddy->note_since) {
+			/* clean up in case no 'note' element is supplied
+			 * which indicate note removal in client
+			 */
+			g_free(sbuddy->note);
+			sbuddy->note = NULL;
+			sbuddy->is_oof_note = FALSE;
+			sbuddy->note_since = publish_time;
+
+			xn_node = sipe_xml_child(xn_category, "note/body");
+			if (xn_node) {
+				char *tmp;
+				sbuddy->note = g_markup_escape_text((tmp = sipe_xml_data(xn_node)), -1);
+				g_free(tmp);
+				sbuddy->is_oof_note = sipe_strequal(sipe_xml_attribute(xn_node, "type"), "OOF");
 				sbuddy->note_since = publish_time;
 
-				xn_node = sipe_xml_child(xn_category, "note/body");
-				if (xn_node) {
-					char *tmp;
-					sbuddy->note = g_markup_escape_text((tmp = sipe_xml_data(xn_node)), -1);
-					g_free(tmp);
-					sbuddy->is_oof_note = sipe_strequal(sipe_xml_attribute(xn_node, "type"), "OOF");
-					sbuddy->note_since = publish_time;
-
-					SIPE_DEBUG_INFO("process_incoming_notify_rlmi: uri(%s), note(%s)",
-							uri, sbuddy->note ? sbuddy->note : "");
-				}
-				/* to trigger UI refresh in case no status info is supplied in this update */
-				do_update_status = TRUE;
+				SIPE_DEBUG_INFO("process_incoming_notify_rlmi: uri(%s), note(%s)",
+						uri, sbuddy->note ? sbuddy->note : "");
 			}
+			/* to trigger UI refresh in case no status info is supplied in this update */
+			rlmi->do_update_status = TRUE;
 		}
-		/* state */
-		else if(sipe_strequal(attrVar, "state"))
-		{
-			char *tmp;
-			int availability;
-			const sipe_xml *xn_availability;
-			const sipe_xml *xn_activity;
-			const sipe_xml *xn_device;
-			const sipe_xml *xn_meeting_subject;
-			const sipe_xml *xn_meeting_location;
-			const gchar *legacy_activity;
-
-			xn_node = sipe_xml_child(xn_category, "state");
-			if (!xn_node) continue;
-			xn_availability = sipe_xml_child(xn_node, "availability");
-			if (!xn_availability) continue;
-			xn_activity = sipe_xml_child(xn_node, "activity");
-			xn_meeting_subject = sipe_xml_child(xn_node, "meetingSubject");
-			xn_meeting_location = sipe_xml_child(xn_node, "meetingLocation");
-
-			tmp = sipe_xml_data(xn_availability);
-			availability = atoi(tmp);
-			g_free(tmp);
+	}
+	/* state */
+	else if(sipe_strequal(attrVar, "state"))
+	{
+		char *tmp;
+		int availability;
+		gchar *activity = NULL;
+		const sipe_xml *xn_availability;
+		const sipe_xml *xn_activity;
+		const sipe_xml *xn_device;
+		const sipe_xml *xn_meeting_subject;
+		const sipe_xml *xn_meeting_location;
+		const gchar *legacy_activity;
+
+		xn_node = sipe_xml_child(xn_category, "state");
+		if (!xn_node) return(TRUE);
+		xn_availability = sipe_xml_child(xn_node, "availability");
+		if (!xn_availability) return(TRUE);
+		xn_activity = sipe_xml_child(xn_node, "activity");
+		xn_meeting_subject = sipe_xml_child(xn_node, "meetingSubject");
+		xn_meeting_location = sipe_xml_child(xn_node, "meetingLocation");
+
+		tmp = sipe_xml_data(xn_availability);
+		availability = atoi(tmp);
+		g_free(tmp);
 
-			sbuddy->is_mobile = FALSE;
-			xn_device = sipe_xml_child(xn_node, "device");
-			if (xn_device) {
-				tmp = sipe_xml_data(xn_device);
-				sbuddy->is_mobile = !g_ascii_strcasecmp(tmp, "Mobile");
-				g_free(tmp);
-			}
+		sbuddy->is_mobile = FALSE;
+		xn_device = sipe_xml_child(xn_node, "device");
+		if (xn_device) {
+			tmp = sipe_xml_data(xn_device);
+			sbuddy->is_mobile = !g_ascii_strcasecmp(tmp, "Mobile");
+			g_free(tmp);
+		}
 
-			/* activity */
-			g_free(sbuddy->activity);
-			sbuddy->activity = NULL;
-			if (xn_activity) {
-				const char *token = sipe_xml_attribute(xn_activity, "token");
-				const sipe_xml *xn_custom = sipe_xml_child(xn_activity, "custom");
+		/* activity */
+		if (xn_activity) {
+			const char *token = sipe_xml_attribute(xn_activity, "token");
+			const sipe_xml *xn_custom = sipe_xml_child(xn_activity, "custom");
 
-				/* from token */
-				if (!is_empty(token)) {
-					sbuddy->activity = g_strdup(sipe_core_activity_description(sipe_status_token_to_activity(token)));
-				}
-				/* from custom element */
-				if (xn_custom) {
-					char *custom = sipe_xml_data(xn_custom);
-
-					if (!is_empty(custom)) {
-						g_free(sbuddy->activity);
-						sbuddy->activity = custom;
-						custom = NULL;
-					}
-					g_free(custom);
-				}
+			/* from token */
+			if (!is_empty(token)) {
+				activity = g_strdup(sipe_core_activity_description(sipe_status_token_to_activity(token)));
 			}
-			/* meeting_subject */
-			g_free(sbuddy->meeting_subject);
-			sbuddy->meeting_subject = NULL;
-			if (xn_meeting_subject) {
-				char *meeting_subject = sipe_xml_data(xn_meeting_subject);
-
-				if (!is_empty(meeting_subject)) {
-					sbuddy->meeting_subject = meeting_subject;
-					meeting_subject = NULL;
-				}
-				g_free(meeting_subject);
-			}
-			/* meeting_location */
-			g_free(sbuddy->meeting_location);
-			sbuddy->meeting_location = NULL;
-			if (xn_meeting_location) {
-				char *meeting_location = sipe_xml_data(xn_meeting_location);
-
-				if (!is_empty(meeting_location)) {
-					sbuddy->meeting_location = meeting_location;
-					meeting_location = NULL;
+			/* from custom element */
+			if (xn_custom) {
+				char *custom = sipe_xml_data(xn_custom);
+
+				if (!is_empty(custom)) {
+					g_free(activity);
+					activity = custom;
+					custom = NULL;
 				}
-				g_free(meeting_location);
+				g_free(custom);
 			}
+		}
+		/* meeting_subject */
+		if (sbuddy->cal) {
+			g_free(sbuddy->cal->meeting_subject);
+			sbuddy->cal->meeting_subject = NULL;
+		}
+		if (xn_meeting_subject) {
+			char *meeting_subject = sipe_xml_data(xn_meeting_subject);
 
-			status = sipe_ocs2007_status_from_legacy_availability(availability, NULL);
-			legacy_activity = sipe_ocs2007_legacy_activity_description(availability);
-			if (sbuddy->activity && legacy_activity) {
-				gchar *tmp2 = sbuddy->activity;
+			if (!is_empty(meeting_subject)) {
+				sipe_buddy_calendar(sbuddy)->meeting_subject = meeting_subject;
+				meeting_subject = NULL;
+			}
+			g_free(meeting_subject);
+		}
+		/* meeting_location */
+		if (sbuddy->cal) {
+			g_free(sbuddy->cal->meeting_location);
+			sbuddy->cal->meeting_location = NULL;
+		}
+		if (xn_meeting_location) {
+			char *meeting_location = sipe_xml_data(xn_meeting_location);
 
-				sbuddy->activity = g_strdup_printf("%s, %s", sbuddy->activity, legacy_activity);
-				g_free(tmp2);
-			} else if (legacy_activity) {
-				sbuddy->activity = g_strdup(legacy_activity);
+			if (!is_empty(meeting_location)) {
+				sipe_buddy_calendar(sbuddy)->meeting_location = meeting_location;
+				meeting_location = NULL;
 			}
+			g_free(meeting_location);
+		}
+
+		rlmi->status = sipe_ocs2007_status_from_legacy_availability(availability, NULL);
+		legacy_activity = sipe_ocs2007_legacy_activity_description(availability);
+		if (activity && legacy_activity) {
+			gchar *tmp2 = activity;
 
-			do_update_status = TRUE;
+			activity = g_strdup_printf("%s, %s", activity, legacy_activity);
+			g_free(tmp2);
+		} else if (legacy_activity) {
+			activity = g_strdup(legacy_activity);
 		}
-		/* calendarData */
-		else if(sipe_strequal(attrVar, "calendarData"))
-		{
-			const sipe_xml *xn_free_busy = sipe_xml_child(xn_category, "calendarData/freeBusy");
-			const sipe_xml *xn_working_hours = sipe_xml_child(xn_category, "calendarData/WorkingHours");
+		sipe_buddy_set_string(rlmi->sipe_private,
+				      &sbuddy->activity,
+				      activity);
+		g_free(activity);
 
-			if (xn_free_busy) {
-				if (!has_free_busy_cleaned) {
-					has_free_busy_cleaned = TRUE;
+		rlmi->do_update_status = TRUE;
+	}
+	/* calendarData */
+	else if(sipe_strequal(attrVar, "calendarData"))
+	{
+		const sipe_xml *xn_free_busy = sipe_xml_child(xn_category, "calendarData/freeBusy");
+		const sipe_xml *xn_working_hours = sipe_xml_child(xn_category, "calendarData/WorkingHours");
 
-					g_free(sbuddy->cal_start_time);
-					sbuddy->cal_start_time = NULL;
+		if (xn_free_busy) {
+			struct sipe_buddy_calendar *cal = sipe_buddy_calendar(sbuddy);
 
-					g_free(sbuddy->cal_free_busy_base64);
-					sbuddy->cal_free_busy_base64 = NULL;
+			if (!rlmi->has_free_busy_cleaned) {
+				rlmi->has_free_busy_cleaned = TRUE;
 
-					g_free(sbuddy->cal_free_busy);
-					sbuddy->cal_free_busy = NULL;
+				cal->start_time = 0;
 
-					sbuddy->cal_free_busy_published = publish_time;
-				}
+				g_free(cal->free_busy);
+				cal->free_busy = NULL;
+				cal->free_busy_slots = 0;
 
-				if (publish_time >= sbuddy->cal_free_busy_published) {
-					g_free(sbuddy->cal_start_time);
-					sbuddy->cal_start_time = g_strdup(sipe_xml_attribute(xn_free_busy, "startTime"));
+				cal->free_busy_published = publish_time;
+			}
 
-					sbuddy->cal_granularity = sipe_strcase_equal(sipe_xml_attribute(xn_free_busy, "granularity"), "PT15M") ?
-						15 : 0;
+			if (publish_time >= cal->free_busy_published) {
+				const gchar *start_time = sipe_xml_attribute(xn_free_busy, "startTime");
+				gchar *free_busy_base64 = sipe_xml_data(xn_free_busy);
 
-					g_free(sbuddy->cal_free_busy_base64);
-					sbuddy->cal_free_busy_base64 = sipe_xml_data(xn_free_busy);
+				cal->start_time = sipe_utils_str_to_time(start_time);
 
-					g_free(sbuddy->cal_free_busy);
-					sbuddy->cal_free_busy = NULL;
+				cal->granularity = sipe_strcase_equal(sipe_xml_attribute(xn_free_busy, "granularity"), "PT15M") ?
+					15 : 0;
 
-					sbuddy->cal_free_busy_published = publish_time;
+				g_free(cal->free_busy);
+				cal->free_busy = sipe_free_busy_from_base64(free_busy_base64,
+									    &cal->free_busy_slots);
 
-					SIPE_DEBUG_INFO("process_incoming_notify_rlmi: startTime=%s granularity=%d cal_free_busy_base64=\n%s", sbuddy->cal_start_time, sbuddy->cal_granularity, sbuddy->cal_free_busy_base64);
-				}
-			}
+				cal->free_busy_published = publish_time;
 
-			if (xn_working_hours) {
-				sipe_cal_parse_working_hours(xn_working_hours, sbuddy);
+				SIPE_DEBUG_INFO("process_incoming_notify_rlmi: startTime=%s granularity=%d cal_free_busy_base64=\n%s", start_time, cal->granularity, free_busy_base64);
+				g_free(free_busy_base64);
 			}
 		}
+
+		if (xn_working_hours) {
+			sipe_cal_parse_working_hours(xn_working_hours, sbuddy);
+		}
+	}
+
+	return(TRUE);
+}
+
+static const struct sipe_xml_stream_path rlmi_paths[] = {
+	{ "",         process_incoming_notify_rlmi_categories, NULL },
+	{ "category", NULL, process_incoming_notify_rlmi_category },
+	{ NULL,       NULL, NULL }
+};
+
+static void process_incoming_notify_rlmi(struct sipe_core_private *sipe_private,
+					 const gchar *data,
+					 unsigned len)
+{
+	struct rlmi_data rlmi;
+	const gchar *uri;
+
+	memset(&rlmi, 0, sizeof(rlmi));
+	rlmi.sipe_private = sipe_private;
+
+	sipe_xml_stream_parse(data, len, rlmi_paths, &rlmi);
+	if (!rlmi.sbuddy) {
+		g_free(rlmi.uri);
+		return;
 	}
+	uri = rlmi.uri;
 
-	if (do_update_status) {
+	if (rlmi.do_update_status) {
 		guint activity;
 
-		if (status) {
-			SIPE_DEBUG_INFO("process_incoming_notify_rlmi: %s", status);
-			activity = sipe_status_token_to_activity(status);
+		if (rlmi.status) {
+			SIPE_DEBUG_INFO("process_incoming_notify_rlmi: %s", rlmi.status);
+			activity = sipe_status_token_to_activity(rlmi.status);
 		} else {
 			/* no status category in this update,
 			   using contact's current status */
@@ -942,7 +975,7 @@ static void process_incoming_notify_rlmi(struct sipe_core_private *sipe_private,
 
 	sipe_backend_buddy_refresh_properties(SIPE_CORE_PUBLIC, uri);
 
-	sipe_xml_free(xn_categories);
+	g_free(rlmi.uri);
 }
 
 static void sipe_buddy_status_from_activity(struct sipe_core_private *sipe_private,
@@ -1233,29 +1266,39 @@ static void add_new_buddy(struct sipe_core_private *sipe_private,
 	g_strfreev(item_groups);
 }
 
-static gboolean sipe_process_roaming_contacts(struct sipe_core_private *sipe_private,
-					      struct sipmsg *msg)
-{
-	int len = msg->bodylen;
-
-	const gchar *tmp = sipmsg_find_header(msg, "Event");
-	const sipe_xml *item;
-	sipe_xml *isc;
-	guint delta;
-	const sipe_xml *group_node;
-
-	if (!g_str_has_prefix(tmp, "vnd-microsoft-roaming-contacts")) {
-		return FALSE;
-	}
+struct roaming_contacts_data {
+	struct sipe_core_private *sipe_private;
+	gboolean root;
+	gboolean delta;
+	gboolean processing;
+	gboolean have_group;
+};
 
-	/* Convert the contact from XML to backend Buddies */
-	isc = sipe_xml_parse(msg->body, len);
-	if (!isc) {
-		return FALSE;
+/* Make sure we have at least one group */
+static void roaming_contacts_check_group(struct roaming_contacts_data *data)
+{
+	struct sipe_core_private *sipe_private = data->sipe_private;
+
+	if (!data->have_group) {
+		if (sipe_group_count(sipe_private) == 0) {
+			sipe_group_create(sipe_private,
+					  NULL,
+					  _("Other Contacts"),
+					  NULL);
+		}
+		data->have_group = TRUE;
 	}
+}
 
+static gboolean roaming_contacts_root(const sipe_xml *isc,
+				      gpointer user_data)
+{
+	struct roaming_contacts_data *data = user_data;
+	struct sipe_core_private *sipe_private = data->sipe_private;
 	/* [MS-SIP]: deltaNum MUST be non-zero */
-	delta = sipe_xml_int_attribute(isc, "deltaNum", 0);
+	guint delta = sipe_xml_int_attribute(isc, "deltaNum", 0);
+
+	data->root = TRUE;
 	if (delta) {
 		sipe_private->deltanum_contacts = delta;
 	}
@@ -1289,179 +1332,246 @@ static gboolean sipe_process_roaming_contacts(struct sipe_core_private *sipe_pri
 		if (!sipe_ucs_is_migrated(sipe_private)) {
 			/* Start processing contact list */
 			sipe_backend_buddy_list_processing_start(SIPE_CORE_PUBLIC);
+			data->processing = TRUE;
+		}
 
-			/* Parse groups */
-			for (group_node = sipe_xml_child(isc, "group"); group_node; group_node = sipe_xml_twin(group_node))
-				add_new_group(sipe_private, group_node);
+	/* Buddy list updates are small: use tree based processing */
+	} else if (sipe_strequal(sipe_xml_name(isc), "contactDelta")) {
+		data->delta = TRUE;
+		return(FALSE);
+	}
 
-			/* Make sure we have at least one group */
-			if (sipe_group_count(sipe_private) == 0) {
-				sipe_group_create(sipe_private,
-						  NULL,
-						  _("Other Contacts"),
-						  NULL);
-			}
+	return(TRUE);
+}
 
-			/* Parse contacts */
-			for (item = sipe_xml_child(isc, "contact"); item; item = sipe_xml_twin(item)) {
-				const gchar *name = sipe_xml_attribute(item, "uri");
-				gchar *uri        = sip_uri_from_name(name);
-				add_new_buddy(sipe_private, item, uri);
-				g_free(uri);
-			}
+static gboolean roaming_contacts_group(const sipe_xml *group_node,
+				       gpointer user_data)
+{
+	struct roaming_contacts_data *data = user_data;
 
-			sipe_buddy_cleanup_local_list(sipe_private);
+	if (data->processing)
+		add_new_group(data->sipe_private, group_node);
 
-			/* Add self-contact if not there yet. 2005 systems. */
-			/* This will resemble subscription to roaming_self in 2007 systems */
-			if (!SIPE_CORE_PRIVATE_FLAG_IS(OCS2007)) {
-				gchar *self_uri = sip_uri_self(sipe_private);
-				sipe_buddy_add(sipe_private,
-					       self_uri,
-					       NULL,
-					       NULL);
-				g_free(self_uri);
-			}
+	return(TRUE);
+}
 
-			/* Finished processing contact list */
-			sipe_backend_buddy_list_processing_finish(SIPE_CORE_PUBLIC);
-		}
+static gboolean roaming_contacts_contact(const sipe_xml *item,
+					 gpointer user_data)
+{
+	struct roaming_contacts_data *data = user_data;
 
-	/* Process buddy list updates */
-	} else if (sipe_strequal(sipe_xml_name(isc), "contactDelta")) {
+	if (data->processing) {
+		const gchar *name = sipe_xml_attribute(item, "uri");
+		gchar *uri        = sip_uri_from_name(name);
 
-		/* Process new groups */
-		for (group_node = sipe_xml_child(isc, "addedGroup"); group_node; group_node = sipe_xml_twin(group_node))
-			add_new_group(sipe_private, group_node);
-
-		/* Process modified groups */
-		for (group_node = sipe_xml_child(isc, "modifiedGroup"); group_node; group_node = sipe_xml_twin(group_node)) {
-			struct sipe_group *group = sipe_group_find_by_id(sipe_private,
-									 (int)g_ascii_strtod(sipe_xml_attribute(group_node, "id"),
-											     NULL));
-			if (group) {
-				const gchar *name = get_group_name(group_node);
-
-				if (!(is_empty(name) ||
-				      sipe_strequal(group->name, name)) &&
-				    sipe_group_rename(sipe_private,
-						      group,
-						      name))
-					SIPE_DEBUG_INFO("Replaced group %d name with %s", group->id, name);
-			}
-		}
+		/* all groups are sent before the contacts */
+		roaming_contacts_check_group(data);
+
+		add_new_buddy(data->sipe_private, item, uri);
+		g_free(uri);
+	}
+
+	return(TRUE);
+}
 
-		/* Process new buddies */
-		for (item = sipe_xml_child(isc, "addedContact"); item; item = sipe_xml_twin(item)) {
-			add_new_buddy(sipe_private,
-				      item,
-				      sipe_xml_attribute(item, "uri"));
+static const struct sipe_xml_stream_path roaming_contacts_paths[] = {
+	{ "",        roaming_contacts_root, NULL },
+	{ "group",   NULL, roaming_contacts_group },
+	{ "contact", NULL, roaming_contacts_contact },
+	{ NULL,      NULL, NULL }
+};
+
+static void process_roaming_contacts_delta(struct sipe_core_private *sipe_private,
+					   const sipe_xml *isc)
+{
+	const sipe_xml *item;
+	const sipe_xml *group_node;
+
+	/* Process new groups */
+	for (group_node = sipe_xml_child(isc, "addedGroup"); group_node; group_node = sipe_xml_twin(group_node))
+		add_new_group(sipe_private, group_node);
+
+	/* Process modified groups */
+	for (group_node = sipe_xml_child(isc, "modifiedGroup"); group_node; group_node = sipe_xml_twin(group_node)) {
+		struct sipe_group *group = sipe_group_find_by_id(sipe_private,
+								 (int)g_ascii_strtod(sipe_xml_attribute(group_node, "id"),
+										     NULL));
+		if (group) {
+			const gchar *name = get_group_name(group_node);
+
+			if (!(is_empty(name) ||
+			      sipe_strequal(group->name, name)) &&
+			    sipe_group_rename(sipe_private,
+					      group,
+					      name))
+				SIPE_DEBUG_INFO("Replaced group %d name with %s", group->id, name);
 		}
+	}
+
+	/* Process new buddies */
+	for (item = sipe_xml_child(isc, "addedContact"); item; item = sipe_xml_twin(item)) {
+		add_new_buddy(sipe_private,
+			      item,
+			      sipe_xml_attribute(item, "uri"));
+	}
 
-		/* Process modified buddies */
-		for (item = sipe_xml_child(isc, "modifiedContact"); item; item = sipe_xml_twin(item)) {
-			const gchar *uri = sipe_xml_attribute(item, "uri");
-			struct sipe_buddy *buddy = sipe_buddy_find_by_uri(sipe_private,
-									  uri);
-
-			if (buddy) {
-				gchar **item_groups = g_strsplit(sipe_xml_attribute(item,
-										    "groups"),
-								 " ", 0);
-
-				/* this should be defined. Otherwise we would get "deletedContact" */
-				if (item_groups) {
-					const gchar *name = sipe_xml_attribute(item, "name");
-					gboolean empty_name = is_empty(name);
-					GSList *found = NULL;
-					int i = 0;
-
-					while (item_groups[i]) {
-						struct sipe_group *group = sipe_group_find_by_id(sipe_private,
-												 g_ascii_strtod(item_groups[i],
-														NULL));
-						/* ignore unkown groups */
-						if (group) {
-							sipe_backend_buddy b = sipe_backend_buddy_find(SIPE_CORE_PUBLIC,
-												       uri,
-												       group->name);
-
-							/* add group to found list */
-							found = g_slist_prepend(found, group);
-
-							if (b) {
-								/* new alias? */
-								gchar *b_alias = sipe_backend_buddy_get_alias(SIPE_CORE_PUBLIC,
-													      b);
-
-								if (!(empty_name ||
-								      sipe_strequal(b_alias, name))) {
-									sipe_backend_buddy_set_alias(SIPE_CORE_PUBLIC,
-												     b,
-												     name);
-									SIPE_DEBUG_INFO("Replaced for buddy %s in group '%s' old alias '%s' with '%s'",
-											uri, group->name, b_alias, name);
-								}
-								g_free(b_alias);
-
-							} else {
-								const gchar *alias = empty_name ? uri : name;
-								/* buddy was not in this group */
-								sipe_backend_buddy_add(SIPE_CORE_PUBLIC,
-										       uri,
-										       alias,
-										       group->name);
-								sipe_buddy_insert_group(buddy, group);
-								SIPE_DEBUG_INFO("Added buddy %s (alias '%s' to group '%s'",
-										uri, alias, group->name);
+	/* Process modified buddies */
+	for (item = sipe_xml_child(isc, "modifiedContact"); item; item = sipe_xml_twin(item)) {
+		const gchar *uri = sipe_xml_attribute(item, "uri");
+		struct sipe_buddy *buddy = sipe_buddy_find_by_uri(sipe_private,
+								  uri);
+
+		if (buddy) {
+			gchar **item_groups = g_strsplit(sipe_xml_attribute(item,
+									    "groups"),
+							 " ", 0);
+
+			/* this should be defined. Otherwise we would get "deletedContact" */
+			if (item_groups) {
+				const gchar *name = sipe_xml_attribute(item, "name");
+				gboolean empty_name = is_empty(name);
+				GSList *found = NULL;
+				int i = 0;
+
+				while (item_groups[i]) {
+					struct sipe_group *group = sipe_group_find_by_id(sipe_private,
+											 g_ascii_strtod(item_groups[i],
+													NULL));
+					/* ignore unkown groups */
+					if (group) {
+						sipe_backend_buddy b = sipe_backend_buddy_find(SIPE_CORE_PUBLIC,
+											       uri,
+											       group->name);
+
+						/* add group to found list */
+						found = g_slist_prepend(found, group);
+
+						if (b) {
+							/* new alias? */
+							gchar *b_alias = sipe_backend_buddy_get_alias(SIPE_CORE_PUBLIC,
+												      b);
+
+							if (!(empty_name ||
+							      sipe_strequal(b_alias, name))) {
+								sipe_backend_buddy_set_alias(SIPE_CORE_PUBLIC,
+											     b,
+											     name);
+								SIPE_DEBUG_INFO("Replaced for buddy %s in group '%s' old alias '%s' with '%s'",
+										uri, group->name, b_alias, name);
 							}
+							g_free(b_alias);
+
+						} else {
+							const gchar *alias = empty_name ? uri : name;
+							/* buddy was not in this group */
+							sipe_backend_buddy_add(SIPE_CORE_PUBLIC,
+									       uri,
+									       alias,
+									       group->name);
+							sipe_buddy_insert_group(buddy, group);
+							SIPE_DEBUG_INFO("Added buddy %s (alias '%s' to group '%s'",
+									uri, alias, group->name);
 						}
-
-						/* next group */
-						i++;
 					}
-					g_strfreev(item_groups);
 
- 					/* removed from groups? */
-					sipe_buddy_update_groups(sipe_private,
-								 buddy,
-								 found);
-					g_slist_free(found);
+					/* next group */
+					i++;
 				}
+				g_strfreev(item_groups);
+
+ 					/* removed from groups? */
+				sipe_buddy_update_groups(sipe_private,
+							 buddy,
+							 found);
+				g_slist_free(found);
 			}
 		}
+	}
 
-		/* Process deleted buddies */
-		for (item = sipe_xml_child(isc, "deletedContact"); item; item = sipe_xml_twin(item)) {
-			const gchar *uri = sipe_xml_attribute(item, "uri");
-			struct sipe_buddy *buddy = sipe_buddy_find_by_uri(sipe_private,
-									  uri);
+	/* Process deleted buddies */
+	for (item = sipe_xml_child(isc, "deletedContact"); item; item = sipe_xml_twin(item)) {
+		const gchar *uri = sipe_xml_attribute(item, "uri");
+		struct sipe_buddy *buddy = sipe_buddy_find_by_uri(sipe_private,
+								  uri);
 
-			if (buddy) {
-				SIPE_DEBUG_INFO("Removing buddy %s", uri);
-				sipe_buddy_remove(sipe_private, buddy);
-			}
+		if (buddy) {
+			SIPE_DEBUG_INFO("Removing buddy %s", uri);
+			sipe_buddy_remove(sipe_private, buddy);
+		}
+	}
+
+	/* Process deleted groups
+	 *
+	 * NOTE: all buddies will already have been removed from the
+	 *       group prior to this. The log shows that OCS actually
+	 *       sends two separate updates when you delete a group:
+	 *
+	 *         - first one with "modifiedContact" removing buddies
+	 *           from the group, leaving it empty, and
+	 *
+	 *         - then one with "deletedGroup" removing the group
+	 */
+	for (group_node = sipe_xml_child(isc, "deletedGroup"); group_node; group_node = sipe_xml_twin(group_node))
+		sipe_group_remove(sipe_private,
+				  sipe_group_find_by_id(sipe_private,
+							(int)g_ascii_strtod(sipe_xml_attribute(group_node, "id"),
+									    NULL)));
+
+}
+
+static gboolean sipe_process_roaming_contacts(struct sipe_core_private *sipe_private,
+					      struct sipmsg *msg)
+{
+	const gchar *tmp = sipmsg_find_header(msg, "Event");
+	struct roaming_contacts_data data;
+	gboolean complete;
+
+	if (!g_str_has_prefix(tmp, "vnd-microsoft-roaming-contacts")) {
+		return FALSE;
+	}
+
+	/* Convert the contact from XML to backend Buddies */
+	memset(&data, 0, sizeof(data));
+	data.sipe_private = sipe_private;
+	complete = sipe_xml_stream_parse(msg->body,
+					 msg->bodylen,
+					 roaming_contacts_paths,
+					 &data);
+
+	if (data.processing) {
+		roaming_contacts_check_group(&data);
+
+		/* don't drop buddies that were in the unparsed part */
+		if (complete)
+			sipe_buddy_cleanup_local_list(sipe_private);
+
+		/* Add self-contact if not there yet. 2005 systems. */
+		/* This will resemble subscription to roaming_self in 2007 systems */
+		if (!SIPE_CORE_PRIVATE_FLAG_IS(OCS2007)) {
+			gchar *self_uri = sip_uri_self(sipe_private);
+			sipe_buddy_add(sipe_private,
+				       self_uri,
+				       NULL,
+				       NULL);
+			g_free(self_uri);
 		}
 
-		/* Process deleted groups
-		 *
-		 * NOTE: all buddies will already have been removed from the
-		 *       group prior to this. The log shows that OCS actually
-		 *       sends two separate updates when you delete a group:
-		 *
-		 *         - first one with "modifiedContact" removing buddies
-		 *           from the group, leaving it empty, and
-		 *
-		 *         - then one with "deletedGroup" removing the group
-		 */
-		for (group_node = sipe_xml_child(isc, "deletedGroup"); group_node; group_node = sipe_xml_twin(group_node))
-			sipe_group_remove(sipe_private,
-					  sipe_group_find_by_id(sipe_private,
-								(int)g_ascii_strtod(sipe_xml_attribute(group_node, "id"),
-										    NULL)));
+		/* Finished processing contact list */
+		sipe_backend_buddy_list_processing_finish(SIPE_CORE_PUBLIC);
 
+	/* Process buddy list updates */
+	} else if (data.delta) {
+		sipe_xml *isc = sipe_xml_parse(msg->body, msg->bodylen);
+		if (!isc) {
+			return FALSE;
+		}
+		process_roaming_contacts_delta(sipe_private, isc);
+		sipe_xml_free(isc);
+
+	/* document could not be parsed at all */
+	} else if (!data.root) {
+		return FALSE;
 	}
-	sipe_xml_free(isc);
 
 	/* Subscribe to buddies, if contact list not migrated to UCS */
 	if (!sipe_ucs_is_migrated(sipe_private))
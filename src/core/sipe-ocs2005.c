@@ -37,6 +37,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-ews.h"
+#include "sipe-free-busy.h"
 #include "sipe-ocs2005.h"
 #include "sipe-ocs2007.h"
 #include "sipe-schedule.h"
@@ -361,10 +362,11 @@ static void send_presence_soap(struct sipe_core_private *sipe_private,
 	SIPE_CORE_PRIVATE_FLAG_SET(INITIAL_PUBLISH);
 
 	/* CalendarInfo */
-	if (cal && (!is_empty(cal->legacy_dn) || !is_empty(cal->email)) && cal->fb_start && !is_empty(cal->free_busy))
+	if (cal && (!is_empty(cal->legacy_dn) || !is_empty(cal->email)) && cal->fb_start && cal->free_busy)
 	{
 		char *fb_start_str = sipe_utils_time_to_str(cal->fb_start);
-		char *free_busy_base64 = sipe_cal_get_freebusy_base64(cal->free_busy);
+		char *free_busy_base64 = sipe_free_busy_to_base64(cal->free_busy,
+								  cal->free_busy_slots);
 		calendar_data = g_strdup_printf(SIPE_SOAP_SET_PRESENCE_CALENDAR,
 						!is_empty(cal->legacy_dn) ? cal->legacy_dn : cal->email,
 						fb_start_str,
@@ -421,10 +423,12 @@ void sipe_ocs2005_apply_calendar_status(struct sipe_core_private *sipe_private,
 {
 	time_t cal_avail_since;
 	int cal_status = sipe_cal_get_status(sbuddy, time(NULL), &cal_avail_since);
+	struct sipe_buddy_calendar *cal;
 	int avail;
 	gchar *self_uri;
 
 	if (!sbuddy) return;
+	cal = sipe_buddy_calendar(sbuddy);
 
 	if (cal_status < SIPE_CAL_NO_DATA) {
 		SIPE_DEBUG_INFO("sipe_apply_calendar_status: cal_status      : %d for %s", cal_status, sbuddy->name);
@@ -433,9 +437,10 @@ void sipe_ocs2005_apply_calendar_status(struct sipe_core_private *sipe_private,
 
 	/* scheduled Cal update call */
 	if (!status_id) {
-		status_id = sbuddy->last_non_cal_status_id;
-		g_free(sbuddy->activity);
-		sbuddy->activity = g_strdup(sbuddy->last_non_cal_activity);
+		status_id = cal->last_non_cal_status_id;
+		sipe_buddy_set_string(sipe_private,
+				      &sbuddy->activity,
+				      cal->last_non_cal_activity);
 	}
 
 	if (!status_id) {
@@ -446,23 +451,25 @@ void sipe_ocs2005_apply_calendar_status(struct sipe_core_private *sipe_private,
 
 	/* adjust to calendar status */
 	if (cal_status != SIPE_CAL_NO_DATA) {
-		SIPE_DEBUG_INFO("sipe_apply_calendar_status: user_avail_since: %s", sipe_utils_time_to_debug_str(localtime(&sbuddy->user_avail_since)));
+		SIPE_DEBUG_INFO("sipe_apply_calendar_status: user_avail_since: %s", sipe_utils_time_to_debug_str(localtime(&cal->user_avail_since)));
 
 		if ((cal_status == SIPE_CAL_BUSY) &&
-		    (cal_avail_since > sbuddy->user_avail_since) &&
+		    (cal_avail_since > cal->user_avail_since) &&
 		    sipe_ocs2007_status_is_busy(status_id)) {
 			status_id = sipe_status_activity_to_token(SIPE_ACTIVITY_BUSY);
-			g_free(sbuddy->activity);
-			sbuddy->activity = g_strdup(sipe_core_activity_description(SIPE_ACTIVITY_IN_MEETING));
+			sipe_buddy_set_string(sipe_private,
+					      &sbuddy->activity,
+					      sipe_core_activity_description(SIPE_ACTIVITY_IN_MEETING));
 		}
 		avail = sipe_ocs2007_availability_from_status(status_id, NULL);
 
-		SIPE_DEBUG_INFO("sipe_apply_calendar_status: activity_since  : %s", sipe_utils_time_to_debug_str(localtime(&sbuddy->activity_since)));
-		if (cal_avail_since > sbuddy->activity_since) {
+		SIPE_DEBUG_INFO("sipe_apply_calendar_status: activity_since  : %s", sipe_utils_time_to_debug_str(localtime(&cal->activity_since)));
+		if (cal_avail_since > cal->activity_since) {
 			if ((cal_status == SIPE_CAL_OOF) &&
 			    sipe_ocs2007_availability_is_away(avail)) {
-				g_free(sbuddy->activity);
-				sbuddy->activity = g_strdup(sipe_core_activity_description(SIPE_ACTIVITY_OOF));
+				sipe_buddy_set_string(sipe_private,
+						      &sbuddy->activity,
+						      sipe_core_activity_description(SIPE_ACTIVITY_OOF));
 			}
 		}
 	}
@@ -47,6 +47,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-ews.h"
+#include "sipe-free-busy.h"
 #include "sipe-media.h"
 #include "sipe-nls.h"
 #include "sipe-ocs2007.h"
@@ -1297,13 +1298,14 @@ static gchar *sipe_publish_get_category_cal_free_busy(struct sipe_core_private *
 	g_free(key_cal_400);
 	g_free(key_cal_32000);
 
-	if (!cal || is_empty(cal->email) || !cal->fb_start || is_empty(cal->free_busy)) {
+	if (!cal || is_empty(cal->email) || !cal->fb_start || !cal->free_busy) {
 		SIPE_DEBUG_INFO_NOFORMAT("sipe_publish_get_category_cal_free_busy: no data to publish, exiting");
 		return NULL;
 	}
 
 	fb_start_str = sipe_utils_time_to_str(cal->fb_start);
-	free_busy_base64 = sipe_cal_get_freebusy_base64(cal->free_busy);
+	free_busy_base64 = sipe_free_busy_to_base64(cal->free_busy,
+						    cal->free_busy_slots);
 
 	/* we will rebuplish the same data to refresh publication time,
 	 * so if data from multiple sources, most recent will be choosen
@@ -2062,337 +2064,456 @@ static void sipe_refresh_blocked_status(struct sipe_core_private *sipe_private)
 			   sipe_private);
 }
 
-/**
-  *   When we receive some self (BE) NOTIFY with a new subscriber
-  *   we sends a setSubscribers request to him [SIP-PRES] 4.8
-  *
-  */
-void sipe_ocs2007_process_roaming_self(struct sipe_core_private *sipe_private,
-				       struct sipmsg *msg)
-{
+struct roaming_self_subscriber {
+	gchar *user;  /* without 'sip:' prefix */
+	gchar *display_name;
+	gboolean acknowledged;
+};
+
+struct roaming_self_data {
+	struct sipe_core_private *sipe_private;
 	gchar *contact;
 	gchar *to;
-	sipe_xml *xml;
-	const sipe_xml *node;
-	const sipe_xml *node2;
-        char *display_name = NULL;
-        char *uri;
-	GSList *category_names = NULL;
-	int aggreg_avail = 0;
-	gchar *activity_token = NULL;
-	gboolean do_update_status = FALSE;
-	gboolean has_note_cleaned = FALSE;
+	GHashTable *category_names;
 	GHashTable *devices;
+	GSList *subscribers;  /* processed after containers & blocked status */
+	int aggreg_avail;
+	gchar *activity_token;
+	gboolean root;
+	gboolean has_containers;
+	gboolean do_update_status;
+	gboolean has_note_cleaned;
+};
 
-	SIPE_DEBUG_INFO_NOFORMAT("sipe_ocs2007_process_roaming_self");
-
-	xml = sipe_xml_parse(msg->body, msg->bodylen);
-	if (!xml) return;
+static gboolean roaming_self_root(SIPE_UNUSED_PARAMETER const sipe_xml *node,
+				  gpointer user_data)
+{
+	struct roaming_self_data *data = user_data;
+	data->root = TRUE;
+	return(TRUE);
+}
 
-	contact = get_contact(sipe_private);
-	to = sip_uri_self(sipe_private);
+static gboolean roaming_self_category(const sipe_xml *node,
+				      gpointer user_data)
+{
+	struct roaming_self_data *data = user_data;
+	struct sipe_core_private *sipe_private = data->sipe_private;
+	const char *tmp;
+	const gchar *name = sipe_xml_attribute(node, "name");
+	guint container = sipe_xml_int_attribute(node, "container", -1);
+	guint instance  = sipe_xml_int_attribute(node, "instance", -1);
+	guint version   = sipe_xml_int_attribute(node, "version", 0);
+	time_t publish_time = (tmp = sipe_xml_attribute(node, "publishTime")) ?
+		sipe_utils_str_to_time(tmp) : 0;
+	gchar *key;
+	GHashTable *cat_publications;
 
-	/* categories */
-	/* set list of categories participating in this XML */
-	for (node = sipe_xml_child(xml, "categories/category"); node; node = sipe_xml_twin(node)) {
-		const gchar *name = sipe_xml_attribute(node, "name");
-		category_names = sipe_utils_slist_insert_unique_sorted(category_names,
-								       (gchar *)name,
-								       (GCompareFunc)strcmp,
-								       NULL);
-	}
-	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: category_names length=%d",
-			category_names ? (int) g_slist_length(category_names) : -1);
-	/* drop category information */
-	if (category_names) {
-		GSList *entry = category_names;
-		while (entry) {
-			GHashTable *cat_publications;
-			const gchar *category = entry->data;
-			entry = entry->next;
-			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: dropping category: %s", category);
-			cat_publications = g_hash_table_lookup(sipe_private->our_publications, category);
-			if (cat_publications) {
-				g_hash_table_remove(sipe_private->our_publications, category);
-				SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: dropped category: %s", category);
-			}
+	/*
+	 * drop category information when a category name participates in
+	 * this XML for the first time, i.e. before we fill it again below.
+	 */
+	if (name && !g_hash_table_lookup(data->category_names, name)) {
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: dropping category: %s", name);
+		if (g_hash_table_lookup(sipe_private->our_publications, name)) {
+			g_hash_table_remove(sipe_private->our_publications, name);
+			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: dropped category: %s", name);
 		}
+		g_hash_table_insert(data->category_names, g_strdup(name), GINT_TO_POINTER(1));
 	}
-	g_slist_free(category_names);
 
 	/* filling our categories reflected in roaming data */
-	devices = g_hash_table_new_full(g_str_hash, g_str_equal,
-					g_free, NULL);
-	for (node = sipe_xml_child(xml, "categories/category"); node; node = sipe_xml_twin(node)) {
-		const char *tmp;
-		const gchar *name = sipe_xml_attribute(node, "name");
-		guint container = sipe_xml_int_attribute(node, "container", -1);
-		guint instance  = sipe_xml_int_attribute(node, "instance", -1);
-		guint version   = sipe_xml_int_attribute(node, "version", 0);
-		time_t publish_time = (tmp = sipe_xml_attribute(node, "publishTime")) ?
-			sipe_utils_str_to_time(tmp) : 0;
-		gchar *key;
-		GHashTable *cat_publications = g_hash_table_lookup(sipe_private->our_publications, name);
-
-		/* Ex. clear note: <category name="note"/> */
-		if (container == (guint)-1) {
+	cat_publications = g_hash_table_lookup(sipe_private->our_publications, name);
+
+	/* Ex. clear note: <category name="note"/> */
+	if (container == (guint)-1) {
+		g_free(sipe_private->note);
+		sipe_private->note = NULL;
+		data->do_update_status = TRUE;
+		return(TRUE);
+	}
+
+	/* Ex. clear note: <category name="note" container="200"/> */
+	if (instance == (guint)-1) {
+		if (container == 200) {
 			g_free(sipe_private->note);
 			sipe_private->note = NULL;
-			do_update_status = TRUE;
-			continue;
-		}
-
-		/* Ex. clear note: <category name="note" container="200"/> */
-		if (instance == (guint)-1) {
-			if (container == 200) {
-				g_free(sipe_private->note);
-				sipe_private->note = NULL;
-				do_update_status = TRUE;
-			}
-			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: removing publications for: %s/%u", name, container);
-			sipe_remove_category_container_publications(
-				sipe_private->our_publications, name, container);
-			continue;
+			data->do_update_status = TRUE;
 		}
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: removing publications for: %s/%u", name, container);
+		sipe_remove_category_container_publications(
+			sipe_private->our_publications, name, container);
+		return(TRUE);
+	}
 
-		/* key is <category><instance><container> */
-		key = g_strdup_printf("<%s><%u><%u>", name, instance, container);
-		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: key=%s version=%d", key, version);
+	/* key is <category><instance><container> */
+	key = g_strdup_printf("<%s><%u><%u>", name, instance, container);
+	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: key=%s version=%d", key, version);
 
-		/* capture all userState publication for later clean up if required */
-		if (sipe_strequal(name, "state") && (container == 2 || container == 3)) {
-			const sipe_xml *xn_state = sipe_xml_child(node, "state");
+	/* capture all userState publication for later clean up if required */
+	if (sipe_strequal(name, "state") && (container == 2 || container == 3)) {
+		const sipe_xml *xn_state = sipe_xml_child(node, "state");
 
-			if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "userState")) {
-				struct sipe_publication *publication = g_new0(struct sipe_publication, 1);
-				publication->category  = g_strdup(name);
-				publication->instance  = instance;
-				publication->container = container;
-				publication->version   = version;
+		if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "userState")) {
+			struct sipe_publication *publication = g_new0(struct sipe_publication, 1);
+			publication->category  = g_strdup(name);
+			publication->instance  = instance;
+			publication->container = container;
+			publication->version   = version;
 
-				if (!sipe_private->user_state_publications) {
-					sipe_private->user_state_publications = g_hash_table_new_full(
-						g_str_hash, g_str_equal,
-						g_free,	(GDestroyNotify)free_publication);
-				}
-				g_hash_table_insert(sipe_private->user_state_publications, g_strdup(key), publication);
-				SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added to user_state_publications key=%s version=%d",
-						key, version);
+			if (!sipe_private->user_state_publications) {
+				sipe_private->user_state_publications = g_hash_table_new_full(
+					g_str_hash, g_str_equal,
+					g_free,	(GDestroyNotify)free_publication);
 			}
+			g_hash_table_insert(sipe_private->user_state_publications, g_strdup(key), publication);
+			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added to user_state_publications key=%s version=%d",
+					key, version);
 		}
+	}
 
-		/* count each client instance only once */
-		if (sipe_strequal(name, "device"))
-			g_hash_table_replace(devices, g_strdup_printf("%u", instance), NULL);
+	/* count each client instance only once */
+	if (sipe_strequal(name, "device"))
+		g_hash_table_replace(data->devices, g_strdup_printf("%u", instance), NULL);
 
-		if (sipe_is_our_publication(sipe_private, key)) {
-			struct sipe_publication *publication = g_new0(struct sipe_publication, 1);
+	if (sipe_is_our_publication(sipe_private, key)) {
+		struct sipe_publication *publication = g_new0(struct sipe_publication, 1);
 
-			publication->category = g_strdup(name);
-			publication->instance  = instance;
-			publication->container = container;
-			publication->version   = version;
+		publication->category = g_strdup(name);
+		publication->instance  = instance;
+		publication->container = container;
+		publication->version   = version;
 
-			/* filling publication->availability */
-			if (sipe_strequal(name, "state")) {
-				const sipe_xml *xn_state = sipe_xml_child(node, "state");
-				const sipe_xml *xn_avail = sipe_xml_child(xn_state, "availability");
+		/* filling publication->availability */
+		if (sipe_strequal(name, "state")) {
+			const sipe_xml *xn_state = sipe_xml_child(node, "state");
+			const sipe_xml *xn_avail = sipe_xml_child(xn_state, "availability");
 
-				if (xn_avail) {
-					gchar *avail_str = sipe_xml_data(xn_avail);
-					if (avail_str) {
-						publication->availability = atoi(avail_str);
-					}
-					g_free(avail_str);
+			if (xn_avail) {
+				gchar *avail_str = sipe_xml_data(xn_avail);
+				if (avail_str) {
+					publication->availability = atoi(avail_str);
 				}
-				/* for calendarState */
-				if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "calendarState")) {
-					const sipe_xml *xn_activity = sipe_xml_child(xn_state, "activity");
-					struct sipe_cal_event *event = g_new0(struct sipe_cal_event, 1);
-
-					event->start_time = sipe_utils_str_to_time(sipe_xml_attribute(xn_state, "startTime"));
-					if (xn_activity) {
-						if (sipe_strequal(sipe_xml_attribute(xn_activity, "token"),
-								  sipe_status_activity_to_token(SIPE_ACTIVITY_IN_MEETING)))
-						{
-							event->is_meeting = TRUE;
-						}
+				g_free(avail_str);
+			}
+			/* for calendarState */
+			if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "calendarState")) {
+				const sipe_xml *xn_activity = sipe_xml_child(xn_state, "activity");
+				struct sipe_cal_event *event = g_new0(struct sipe_cal_event, 1);
+
+				event->start_time = sipe_utils_str_to_time(sipe_xml_attribute(xn_state, "startTime"));
+				if (xn_activity) {
+					if (sipe_strequal(sipe_xml_attribute(xn_activity, "token"),
+							  sipe_status_activity_to_token(SIPE_ACTIVITY_IN_MEETING)))
+					{
+						event->is_meeting = TRUE;
 					}
-					event->subject = sipe_xml_data(sipe_xml_child(xn_state, "meetingSubject"));
-					event->location = sipe_xml_data(sipe_xml_child(xn_state, "meetingLocation"));
-
-					publication->cal_event_hash = sipe_cal_event_hash(event);
-					SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: hash=%s",
-							publication->cal_event_hash);
-					sipe_cal_event_free(event);
 				}
+				event->subject = sipe_xml_data(sipe_xml_child(xn_state, "meetingSubject"));
+				event->location = sipe_xml_data(sipe_xml_child(xn_state, "meetingLocation"));
+
+				publication->cal_event_hash = sipe_cal_event_hash(event);
+				SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: hash=%s",
+						publication->cal_event_hash);
+				sipe_cal_event_free(event);
+			}
+		}
+		/* filling publication->note */
+		if (sipe_strequal(name, "note")) {
+			const sipe_xml *xn_body = sipe_xml_child(node, "note/body");
+
+			if (!data->has_note_cleaned) {
+				data->has_note_cleaned = TRUE;
+
+				g_free(sipe_private->note);
+				sipe_private->note = NULL;
+				sipe_private->note_since = publish_time;
+
+				data->do_update_status = TRUE;
 			}
-			/* filling publication->note */
-			if (sipe_strequal(name, "note")) {
-				const sipe_xml *xn_body = sipe_xml_child(node, "note/body");
 
-				if (!has_note_cleaned) {
-					has_note_cleaned = TRUE;
+			g_free(publication->note);
+			publication->note = NULL;
+			if (xn_body) {
+				char *tmp;
 
+				publication->note = g_markup_escape_text((tmp = sipe_xml_data(xn_body)), -1);
+				g_free(tmp);
+				if (publish_time >= sipe_private->note_since) {
 					g_free(sipe_private->note);
-					sipe_private->note = NULL;
+					sipe_private->note = g_strdup(publication->note);
 					sipe_private->note_since = publish_time;
+					if (sipe_strequal(sipe_xml_attribute(xn_body, "type"), "OOF"))
+						SIPE_CORE_PRIVATE_FLAG_SET(OOF_NOTE);
+					else
+						SIPE_CORE_PRIVATE_FLAG_UNSET(OOF_NOTE);
 
-					do_update_status = TRUE;
-				}
-
-				g_free(publication->note);
-				publication->note = NULL;
-				if (xn_body) {
-					char *tmp;
-
-					publication->note = g_markup_escape_text((tmp = sipe_xml_data(xn_body)), -1);
-					g_free(tmp);
-					if (publish_time >= sipe_private->note_since) {
-						g_free(sipe_private->note);
-						sipe_private->note = g_strdup(publication->note);
-						sipe_private->note_since = publish_time;
-						if (sipe_strequal(sipe_xml_attribute(xn_body, "type"), "OOF"))
-							SIPE_CORE_PRIVATE_FLAG_SET(OOF_NOTE);
-						else
-							SIPE_CORE_PRIVATE_FLAG_UNSET(OOF_NOTE);
-
-						do_update_status = TRUE;
-					}
+					data->do_update_status = TRUE;
 				}
 			}
+		}
 
-			/* filling publication->fb_start_str, free_busy_base64, working_hours_xml_str */
-			if (sipe_strequal(name, "calendarData") && (publication->container == 300)) {
-				const sipe_xml *xn_free_busy = sipe_xml_child(node, "calendarData/freeBusy");
-				const sipe_xml *xn_working_hours = sipe_xml_child(node, "calendarData/WorkingHours");
-				if (xn_free_busy) {
-					publication->fb_start_str = g_strdup(sipe_xml_attribute(xn_free_busy, "startTime"));
-					publication->free_busy_base64 = sipe_xml_data(xn_free_busy);
-				}
-				if (xn_working_hours) {
-					publication->working_hours_xml_str = sipe_xml_stringify(xn_working_hours);
-				}
+		/* filling publication->fb_start_str, free_busy_base64, working_hours_xml_str */
+		if (sipe_strequal(name, "calendarData") && (publication->container == 300)) {
+			const sipe_xml *xn_free_busy = sipe_xml_child(node, "calendarData/freeBusy");
+			const sipe_xml *xn_working_hours = sipe_xml_child(node, "calendarData/WorkingHours");
+			if (xn_free_busy) {
+				publication->fb_start_str = g_strdup(sipe_xml_attribute(xn_free_busy, "startTime"));
+				publication->free_busy_base64 = sipe_xml_data(xn_free_busy);
 			}
-
-			if (!cat_publications) {
-				cat_publications = g_hash_table_new_full(
-							g_str_hash, g_str_equal,
-							g_free,	(GDestroyNotify)free_publication);
-				g_hash_table_insert(sipe_private->our_publications, g_strdup(name), cat_publications);
-				SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added GHashTable cat=%s", name);
+			if (xn_working_hours) {
+				publication->working_hours_xml_str = sipe_xml_stringify(xn_working_hours);
 			}
-			g_hash_table_insert(cat_publications, g_strdup(key), publication);
-			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added key=%s version=%d", key, version);
 		}
-		g_free(key);
 
-		/* aggregateState (not an our publication) from 2-nd container */
-		if (sipe_strequal(name, "state") && container == 2) {
-			const sipe_xml *xn_state = sipe_xml_child(node, "state");
-			const sipe_xml *xn_activity = sipe_xml_child(xn_state, "activity");
+		if (!cat_publications) {
+			cat_publications = g_hash_table_new_full(
+						g_str_hash, g_str_equal,
+						g_free,	(GDestroyNotify)free_publication);
+			g_hash_table_insert(sipe_private->our_publications, g_strdup(name), cat_publications);
+			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added GHashTable cat=%s", name);
+		}
+		g_hash_table_insert(cat_publications, g_strdup(key), publication);
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added key=%s version=%d", key, version);
+	}
+	g_free(key);
 
-			if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "aggregateState")) {
-				const sipe_xml *xn_avail = sipe_xml_child(xn_state, "availability");
+	/* aggregateState (not an our publication) from 2-nd container */
+	if (sipe_strequal(name, "state") && container == 2) {
+		const sipe_xml *xn_state = sipe_xml_child(node, "state");
+		const sipe_xml *xn_activity = sipe_xml_child(xn_state, "activity");
 
-				if (xn_avail) {
-					gchar *avail_str = sipe_xml_data(xn_avail);
-					if (avail_str) {
-						aggreg_avail = atoi(avail_str);
-					}
-					g_free(avail_str);
-				}
+		if (xn_state && sipe_strequal(sipe_xml_attribute(xn_state, "type"), "aggregateState")) {
+			const sipe_xml *xn_avail = sipe_xml_child(xn_state, "availability");
 
-				do_update_status = TRUE;
+			if (xn_avail) {
+				gchar *avail_str = sipe_xml_data(xn_avail);
+				if (avail_str) {
+					data->aggreg_avail = atoi(avail_str);
+				}
+				g_free(avail_str);
 			}
 
-			if (xn_activity) {
-				activity_token = g_strdup(sipe_xml_attribute(xn_activity, "token"));
-			}
+			data->do_update_status = TRUE;
 		}
 
-		/* userProperties published by server from AD */
-		if (!sipe_private->csta &&
-		    sipe_strequal(name, "userProperties")) {
-			const sipe_xml *line;
-			/* line, for Remote Call Control (RCC) or external Lync/Communicator call */
-			for (line = sipe_xml_child(node, "userProperties/lines/line"); line; line = sipe_xml_twin(line)) {
-				const gchar *line_type = sipe_xml_attribute(line, "lineType");
-				gchar *line_uri = sipe_xml_data(line);
-				if (!line_uri) {
-					continue;
-				}
+		if (xn_activity) {
+			data->activity_token = g_strdup(sipe_xml_attribute(xn_activity, "token"));
+		}
+	}
 
-				if (sipe_strequal(line_type, "Rcc") || sipe_strequal(line_type, "Dual")) {
-					const gchar *line_server = sipe_xml_attribute(line, "lineServer");
-					if (line_server) {
-						gchar *tmp = g_strstrip(line_uri);
-						SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: line_uri=%s server=%s",
-								tmp, line_server);
-						sip_csta_open(sipe_private, tmp, line_server);
-					}
+	/* userProperties published by server from AD */
+	if (!sipe_private->csta &&
+	    sipe_strequal(name, "userProperties")) {
+		const sipe_xml *line;
+		/* line, for Remote Call Control (RCC) or external Lync/Communicator call */
+		for (line = sipe_xml_child(node, "userProperties/lines/line"); line; line = sipe_xml_twin(line)) {
+			const gchar *line_type = sipe_xml_attribute(line, "lineType");
+			gchar *line_uri = sipe_xml_data(line);
+			if (!line_uri) {
+				continue;
+			}
+
+			if (sipe_strequal(line_type, "Rcc") || sipe_strequal(line_type, "Dual")) {
+				const gchar *line_server = sipe_xml_attribute(line, "lineServer");
+				if (line_server) {
+					gchar *tmp = g_strstrip(line_uri);
+					SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: line_uri=%s server=%s",
+							tmp, line_server);
+					sip_csta_open(sipe_private, tmp, line_server);
 				}
+			}
 #ifdef HAVE_VV
-				else if (sipe_strequal(line_type, "Uc")) {
+			else if (sipe_strequal(line_type, "Uc")) {
 
-					if (!sipe_private->uc_line_uri) {
-						sipe_private->uc_line_uri = g_strdup(g_strstrip(line_uri));
-					} else {
-						SIPE_DEBUG_INFO_NOFORMAT("sipe_ocs2007_process_roaming_self: "
-								"sipe_private->uc_line_uri is already set.");
-					}
+				if (!sipe_private->uc_line_uri) {
+					sipe_private->uc_line_uri = g_strdup(g_strstrip(line_uri));
+				} else {
+					SIPE_DEBUG_INFO_NOFORMAT("sipe_ocs2007_process_roaming_self: "
+							"sipe_private->uc_line_uri is already set.");
 				}
+			}
 #endif
 
-				g_free(line_uri);
+			g_free(line_uri);
 
-				break;
-			}
+			break;
+		}
+	}
+
+	return(TRUE);
+}
+
+static gboolean roaming_self_containers(SIPE_UNUSED_PARAMETER const sipe_xml *node,
+					gpointer user_data)
+{
+	struct roaming_self_data *data = user_data;
+	data->has_containers = TRUE;
+	return(TRUE);
+}
+
+static gboolean roaming_self_container(const sipe_xml *node,
+				       gpointer user_data)
+{
+	struct roaming_self_data *data = user_data;
+	struct sipe_core_private *sipe_private = data->sipe_private;
+	const sipe_xml *node2;
+	guint id = sipe_xml_int_attribute(node, "id", 0);
+	struct sipe_container *container = sipe_find_container(sipe_private, id);
+
+	if (container) {
+		sipe_private->containers = g_slist_remove(sipe_private->containers, container);
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: removed existing container id=%d v%d", container->id, container->version);
+		sipe_ocs2007_free_container(container);
+	}
+	container = g_new0(struct sipe_container, 1);
+	container->id = id;
+	container->version = sipe_xml_int_attribute(node, "version", 0);
+	sipe_private->containers = g_slist_append(sipe_private->containers, container);
+	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added container id=%d v%d", container->id, container->version);
+
+	for (node2 = sipe_xml_child(node, "member"); node2; node2 = sipe_xml_twin(node2)) {
+		struct sipe_container_member *member = g_new0(struct sipe_container_member, 1);
+		member->type = g_strdup(sipe_xml_attribute(node2, "type"));
+		member->value = g_strdup(sipe_xml_attribute(node2, "value"));
+		container->members = g_slist_append(container->members, member);
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added container member type=%s value=%s",
+				member->type, member->value ? member->value : "");
+	}
+
+	return(TRUE);
+}
+
+static gboolean roaming_self_subscriber(const sipe_xml *node,
+					gpointer user_data)
+{
+	struct roaming_self_data *data = user_data;
+	const gchar *user = sipe_xml_attribute(node, "user");
+	struct roaming_self_subscriber *subscriber;
+
+	if (!user) return(TRUE);
+
+	subscriber = g_new0(struct roaming_self_subscriber, 1);
+	subscriber->user         = g_strdup(user);
+	subscriber->display_name = g_strdup(sipe_xml_attribute(node, "displayName"));
+	subscriber->acknowledged = !sipe_strcase_equal(sipe_xml_attribute(node, "acknowledged"),
+						       "false");
+	data->subscribers = g_slist_prepend(data->subscribers, subscriber);
+
+	return(TRUE);
+}
+
+static void roaming_self_subscriber_free(gpointer data)
+{
+	struct roaming_self_subscriber *subscriber = data;
+	g_free(subscriber->user);
+	g_free(subscriber->display_name);
+	g_free(subscriber);
+}
+
+static void roaming_self_process_subscriber(struct roaming_self_data *data,
+					    struct roaming_self_subscriber *subscriber)
+{
+	struct sipe_core_private *sipe_private = data->sipe_private;
+	const gchar *user = subscriber->user;
+	gchar *uri;
+	gchar *hdr;
+	gchar *body;
+
+	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: user %s", user);
+	uri = sip_uri_from_name(user);
+
+	sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DISPLAY_NAME, subscriber->display_name);
+	sipe_backend_buddy_refresh_properties(SIPE_CORE_PUBLIC, uri);
+
+	if (!subscriber->acknowledged) {
+		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: user added you %s", user);
+		if (!sipe_backend_buddy_find(SIPE_CORE_PUBLIC, uri, NULL)) {
+			sipe_backend_buddy_request_add(SIPE_CORE_PUBLIC, uri, subscriber->display_name);
 		}
+
+		hdr = g_strdup_printf(
+			"Contact: %s\r\n"
+			"Content-Type: application/msrtc-presence-setsubscriber+xml\r\n", data->contact);
+
+		body = g_strdup_printf(
+			"<setSubscribers xmlns=\"http://schemas.microsoft.com/2006/09/sip/presence-subscribers\">"
+			"<subscriber user=\"%s\" acknowledged=\"true\"/>"
+			"</setSubscribers>", user);
+
+		sip_transport_service(sipe_private,
+				      data->to,
+				      hdr,
+				      body,
+				      NULL);
+		g_free(body);
+		g_free(hdr);
 	}
+	g_free(uri);
+}
+
+static const struct sipe_xml_stream_path roaming_self_paths[] = {
+	{ "",                      roaming_self_root,       NULL },
+	{ "categories/category",   NULL,                    roaming_self_category },
+	{ "containers",            roaming_self_containers, NULL },
+	{ "containers/container",  NULL,                    roaming_self_container },
+	{ "subscribers/subscriber", NULL,                   roaming_self_subscriber },
+	{ NULL,                    NULL,                    NULL }
+};
+
+/**
+  *   When we receive some self (BE) NOTIFY with a new subscriber
+  *   we sends a setSubscribers request to him [SIP-PRES] 4.8
+  *
+  */
+void sipe_ocs2007_process_roaming_self(struct sipe_core_private *sipe_private,
+				       struct sipmsg *msg)
+{
+	struct roaming_self_data data;
+	GSList *entry;
+
+	SIPE_DEBUG_INFO_NOFORMAT("sipe_ocs2007_process_roaming_self");
+
+	memset(&data, 0, sizeof(data));
+	data.sipe_private   = sipe_private;
+	data.contact        = get_contact(sipe_private);
+	data.to             = sip_uri_self(sipe_private);
+	data.category_names = g_hash_table_new_full(g_str_hash, g_str_equal,
+						    g_free, NULL);
+	data.devices        = g_hash_table_new_full(g_str_hash, g_str_equal,
+						    g_free, NULL);
+
+	sipe_xml_stream_parse(msg->body, msg->bodylen, roaming_self_paths, &data);
+	data.subscribers = g_slist_reverse(data.subscribers);
+
+	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: category_names length=%d",
+			(int) g_hash_table_size(data.category_names));
+	g_hash_table_destroy(data.category_names);
+
+	if (!data.root) {
+		g_hash_table_destroy(data.devices);
+		sipe_utils_slist_free_full(data.subscribers, roaming_self_subscriber_free);
+		g_free(data.contact);
+		g_free(data.to);
+		return;
+	}
+
 	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: sipe_private->our_publications size=%d",
 			sipe_private->our_publications ? (int) g_hash_table_size(sipe_private->our_publications) : -1);
 
 	/* active clients for user account */
-	if (g_hash_table_size(devices) > 1) {
+	if (g_hash_table_size(data.devices) > 1) {
 		SIPE_CORE_PRIVATE_FLAG_SET(MPOP);
 		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: multiple clients detected (%d)",
-				g_hash_table_size(devices));
+				g_hash_table_size(data.devices));
 	} else {
 		SIPE_CORE_PRIVATE_FLAG_UNSET(MPOP);
 		SIPE_DEBUG_INFO_NOFORMAT("sipe_ocs2007_process_roaming_self: single client detected");
 	}
-	g_hash_table_destroy(devices);
-
-	/* containers */
-	for (node = sipe_xml_child(xml, "containers/container"); node; node = sipe_xml_twin(node)) {
-		guint id = sipe_xml_int_attribute(node, "id", 0);
-		struct sipe_container *container = sipe_find_container(sipe_private, id);
-
-		if (container) {
-			sipe_private->containers = g_slist_remove(sipe_private->containers, container);
-			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: removed existing container id=%d v%d", container->id, container->version);
-			sipe_ocs2007_free_container(container);
-		}
-		container = g_new0(struct sipe_container, 1);
-		container->id = id;
-		container->version = sipe_xml_int_attribute(node, "version", 0);
-		sipe_private->containers = g_slist_append(sipe_private->containers, container);
-		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added container id=%d v%d", container->id, container->version);
-
-		for (node2 = sipe_xml_child(node, "member"); node2; node2 = sipe_xml_twin(node2)) {
-			struct sipe_container_member *member = g_new0(struct sipe_container_member, 1);
-			member->type = g_strdup(sipe_xml_attribute(node2, "type"));
-			member->value = g_strdup(sipe_xml_attribute(node2, "value"));
-			container->members = g_slist_append(container->members, member);
-			SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: added container member type=%s value=%s",
-					member->type, member->value ? member->value : "");
-		}
-	}
+	g_hash_table_destroy(data.devices);
 
 	SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: access_level_set=%s",
 			SIPE_CORE_PRIVATE_FLAG_IS(ACCESS_LEVEL_SET) ? "TRUE" : "FALSE");
-	if (!SIPE_CORE_PRIVATE_FLAG_IS(ACCESS_LEVEL_SET) && sipe_xml_child(xml, "containers")) {
+	if (!SIPE_CORE_PRIVATE_FLAG_IS(ACCESS_LEVEL_SET) && data.has_containers) {
 		char *container_xmls = NULL;
 		int sameEnterpriseAL = sipe_ocs2007_find_access_level(sipe_private, "sameEnterprise", NULL, NULL);
 		int federatedAL      = sipe_ocs2007_find_access_level(sipe_private, "federated", NULL, NULL);
@@ -2422,51 +2543,11 @@ void sipe_ocs2007_process_roaming_self(struct sipe_core_private *sipe_private,
 	sipe_refresh_blocked_status(sipe_private);
 
 	/* subscribers */
-	for (node = sipe_xml_child(xml, "subscribers/subscriber"); node; node = sipe_xml_twin(node)) {
-		const char *user;
-		const char *acknowledged;
-		gchar *hdr;
-		gchar *body;
-
-		user = sipe_xml_attribute(node, "user"); /* without 'sip:' prefix */
-		if (!user) continue;
-		SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: user %s", user);
-		display_name = g_strdup(sipe_xml_attribute(node, "displayName"));
-		uri = sip_uri_from_name(user);
-
-		sipe_buddy_update_property(sipe_private, uri, SIPE_BUDDY_INFO_DISPLAY_NAME, display_name);
-		sipe_backend_buddy_refresh_properties(SIPE_CORE_PUBLIC, uri);
-
-	        acknowledged= sipe_xml_attribute(node, "acknowledged");
-		if(sipe_strcase_equal(acknowledged,"false")){
-                        SIPE_DEBUG_INFO("sipe_ocs2007_process_roaming_self: user added you %s", user);
-			if (!sipe_backend_buddy_find(SIPE_CORE_PUBLIC, uri, NULL)) {
-				sipe_backend_buddy_request_add(SIPE_CORE_PUBLIC, uri, display_name);
-			}
-
-		        hdr = g_strdup_printf(
-				      "Contact: %s\r\n"
-				      "Content-Type: application/msrtc-presence-setsubscriber+xml\r\n", contact);
-
-		        body = g_strdup_printf(
-				       "<setSubscribers xmlns=\"http://schemas.microsoft.com/2006/09/sip/presence-subscribers\">"
-				       "<subscriber user=\"%s\" acknowledged=\"true\"/>"
-				       "</setSubscribers>", user);
-
-		        sip_transport_service(sipe_private,
-					      to,
-					      hdr,
-					      body,
-					      NULL);
-		        g_free(body);
-		        g_free(hdr);
-                }
-		g_free(display_name);
-		g_free(uri);
-	}
-
-	g_free(contact);
-	sipe_xml_free(xml);
+	for (entry = data.subscribers; entry; entry = entry->next)
+		roaming_self_process_subscriber(&data, entry->data);
+	sipe_utils_slist_free_full(data.subscribers, roaming_self_subscriber_free);
+	g_free(data.contact);
+	g_free(data.to);
 
 	/* Publish initial state if not yet.
 	 * Assuming this happens on initial responce to subscription to roaming-self
@@ -2478,14 +2559,14 @@ void sipe_ocs2007_process_roaming_self(struct sipe_core_private *sipe_private,
 		SIPE_CORE_PRIVATE_FLAG_SET(INITIAL_PUBLISH);
 		/* dalayed run */
 		sipe_cal_delayed_calendar_update(sipe_private);
-		do_update_status = FALSE;
-	} else if (aggreg_avail) {
+		data.do_update_status = FALSE;
+	} else if (data.aggreg_avail) {
 
-		if (aggreg_avail &&
-		    (aggreg_avail < SIPE_OCS2007_LEGACY_AVAILIBILITY_OFFLINE)) {
+		if (data.aggreg_avail &&
+		    (data.aggreg_avail < SIPE_OCS2007_LEGACY_AVAILIBILITY_OFFLINE)) {
 			/* not offline */
 			sipe_status_set_token(sipe_private,
-					      sipe_ocs2007_status_from_legacy_availability(aggreg_avail, activity_token));
+					      sipe_ocs2007_status_from_legacy_availability(data.aggreg_avail, data.activity_token));
 		} else {
 			/* do not let offline status switch us off */
 			sipe_status_set_activity(sipe_private,
@@ -2493,12 +2574,11 @@ void sipe_ocs2007_process_roaming_self(struct sipe_core_private *sipe_private,
 		}
 	}
 
-	if (do_update_status) {
+	if (data.do_update_status) {
 		sipe_status_and_note(sipe_private, NULL);
 	}
 
-	g_free(to);
-	g_free(activity_token);
+	g_free(data.activity_token);
 }
 
 /**
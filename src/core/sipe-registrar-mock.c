@@ -0,0 +1,1101 @@
+/**
+ * @file sipe-registrar-mock.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Mock Lync/OCS registrar for load testing
+ *
+ * Accepts SIP over TCP, or TLS when a certificate is given, and implements
+ * just enough of the server side to log SIPE in:
+ *
+ *   - REGISTER with connection-less NTLM [MS-SIPAE] or without any
+ *     authentication ("none"). After the NTLM handshake all messages from
+ *     the server are signed. Client signatures are *NOT* verified.
+ *   - SUBSCRIBE to vnd-microsoft-roaming-contacts is answered with a
+ *     contact list of <contacts> buddies
+ *   - presence SUBSCRIBEs, batched or single, are answered with 200 OK
+ *     followed by RLMI BENOTIFY storms for the subscribed buddies
+ *   - every other request gets a 200 OK
+ *
+ * NOTE: the core doesn't use Basic authentication for SIP, i.e. "none" is
+ *       the only alternative to NTLM.
+ *
+ * Example: 10 accounts with 1,000 contacts each
+ *
+ *   $ sipe_registrar_mock --certificate mock.pem --password secret \
+ *                         --contacts 1000 --rate 20
+ *   $ sipe-null --server localhost --port 5061 --transport tls \
+ *               --user user%u@mock.test --password secret \
+ *               --accounts 10 --linger 60
+ *
+ * Repeat with 100 and 10,000 contacts to get the scaling behaviour. The
+ * null backend reports login time, presence updates/second and memory.
+ *
+ * mock.pem must contain the certificate and the private key, e.g.
+ *
+ *   $ openssl req -x509 -newkey rsa:2048 -nodes -days 365 \
+ *                 -subj /CN=localhost -keyout mock.pem -out mock.pem
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include "sipe-common.h"
+#include "sip-sec-ntlm.c"
+
+#include "sipmsg.h"
+#include "sipe-mime.h"
+#include "sipe-sign.h"
+
+#define MOCK_REALM            "SIP Communications Service"
+#define MOCK_NETBIOS_DOMAIN   "MOCK"
+#define MOCK_NETBIOS_COMPUTER "REGISTRAR"
+#define MOCK_TAG              "5564f46b2c"
+#define MOCK_BOUNDARY         "MockBoundary"
+#define MOCK_READ_SIZE        16384
+#define MOCK_NTLM_FLAGS       (NEGOTIATE_FLAGS_CONNLESS | NTLMSSP_TARGET_TYPE_DOMAIN)
+/* replaced with the real signature after the message has been assembled */
+#define MOCK_RSPAUTH_DUMMY    "00000000000000000000000000000000"
+
+/* command line options */
+static gint     option_port           = 5061;
+static gchar   *option_certificate    = NULL;
+static gchar   *option_authentication = NULL;
+static gchar   *option_password       = NULL;
+static gchar   *option_target         = NULL;
+static gint     option_contacts       = 100;
+static gint     option_rate           = 0;
+static gint     option_burst          = 100;
+static gint     option_storms         = 1;
+static gboolean option_verbose        = FALSE;
+
+static const GOptionEntry options[] = {
+	{ "port",           'p', 0, G_OPTION_ARG_INT,    &option_port,
+	  "listen port [default: 5061]", "PORT" },
+	{ "certificate",    'c', 0, G_OPTION_ARG_STRING, &option_certificate,
+	  "PEM file with certificate & key, enables TLS", "FILE" },
+	{ "authentication", 'a', 0, G_OPTION_ARG_STRING, &option_authentication,
+	  "ntlm or none [default: ntlm]", "TYPE" },
+	{ "password",       'w', 0, G_OPTION_ARG_STRING, &option_password,
+	  "NTLM password for all users", "PASSWORD" },
+	{ "target",         't', 0, G_OPTION_ARG_STRING, &option_target,
+	  "NTLM target name [default: sip/registrar.mock]", "NAME" },
+	{ "contacts",       'n', 0, G_OPTION_ARG_INT,    &option_contacts,
+	  "contacts per user [default: 100]", "N" },
+	{ "rate",           'r', 0, G_OPTION_ARG_INT,    &option_rate,
+	  "BENOTIFYs per second and connection, 0 = unlimited [default: 0]", "N" },
+	{ "burst",          'b', 0, G_OPTION_ARG_INT,    &option_burst,
+	  "contacts per BENOTIFY [default: 100]", "N" },
+	{ "storms",         's', 0, G_OPTION_ARG_INT,    &option_storms,
+	  "presence updates per subscribed contact [default: 1]", "N" },
+	{ "verbose",        'v', 0, G_OPTION_ARG_NONE,   &option_verbose,
+	  "print debug messages", NULL },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+static GTlsCertificate *certificate = NULL;
+static gboolean use_ntlm            = TRUE;
+
+struct mock_statistics {
+	guint connections;
+	guint registrations;
+	guint requests;
+	guint notifications;
+	guint presence_updates;
+};
+static struct mock_statistics totals;
+
+/* presence updates for one subscription */
+struct mock_storm {
+	gchar **uris;
+	guint count;
+	guint next;
+	guint rounds;
+};
+
+struct mock_connection {
+	guint id;
+	GIOStream *stream;
+	GInputStream *input;
+	GOutputStream *output;
+	gchar buffer[MOCK_READ_SIZE];
+	GString *received;
+	gboolean failed;
+
+	/* registration */
+	gchar *self;
+	gchar *domain;
+	gchar *callid;
+	guint cseq;
+
+	/* NTLM */
+	guint8 nonce[8];
+	gchar *opaque;
+	guint32 flags;
+	guchar server_sign_key[16];
+	guchar server_seal_key[16];
+	gboolean signing;
+	guint snum;
+	GString *sign_buffer;
+
+	/* presence */
+	GQueue storms;
+	guint storm_timer;
+	guint rlmi_version;
+
+	struct mock_statistics stats;
+};
+
+/*
+ * Stubs
+ */
+gboolean sipe_backend_debug_enabled(void)
+{
+	return(option_verbose);
+}
+
+void sipe_backend_debug_literal(sipe_debug_level level,
+				const gchar *msg)
+{
+	if (option_verbose || (level != SIPE_DEBUG_LEVEL_INFO))
+		fprintf(stderr, "DEBUG(%d): %s\n", level, msg);
+}
+
+void sipe_backend_debug(sipe_debug_level level,
+			const gchar *format,
+			...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	if (option_verbose || (level != SIPE_DEBUG_LEVEL_INFO)) {
+		gchar *msg = g_strdup_vprintf(format, ap);
+		sipe_backend_debug_literal(level, msg);
+		g_free(msg);
+	}
+	va_end(ap);
+}
+
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public)
+{
+	return(NULL);
+}
+
+gchar *sipe_backend_markup_css_property(SIPE_UNUSED_PARAMETER const gchar *style,
+					SIPE_UNUSED_PARAMETER const gchar *option)
+{
+	return(NULL);
+}
+
+void sipe_mime_parts_foreach(SIPE_UNUSED_PARAMETER const gchar *type,
+			     SIPE_UNUSED_PARAMETER const gchar *body,
+			     SIPE_UNUSED_PARAMETER sipe_mime_parts_cb callback,
+			     SIPE_UNUSED_PARAMETER gpointer user_data)
+{
+}
+
+char *generateUUIDfromEPID(SIPE_UNUSED_PARAMETER const gchar *epid)
+{
+	return(NULL);
+}
+
+char *sipe_get_epid(SIPE_UNUSED_PARAMETER const char *self_sip_uri,
+		    SIPE_UNUSED_PARAMETER const char *hostname,
+		    SIPE_UNUSED_PARAMETER const char *ip_address)
+{
+	return(NULL);
+}
+
+/*
+ * Server side of connection-less NTLM
+ */
+static void av_pair_append(GByteArray *data,
+			   guint16 id,
+			   gconstpointer value,
+			   gsize length)
+{
+	struct av_pair av;
+
+	av.av_id  = GUINT16_TO_LE(id);
+	av.av_len = GUINT16_TO_LE(length);
+	g_byte_array_append(data, (const guint8 *) &av, sizeof(av));
+	if (length)
+		g_byte_array_append(data, value, length);
+}
+
+static void av_pair_append_string(GByteArray *data,
+				  guint16 id,
+				  const gchar *value)
+{
+	gsize length  = 0;
+	gchar *utf16 = g_convert(value, -1, "UTF-16LE", "UTF-8",
+				 NULL, &length, NULL);
+	av_pair_append(data, id, utf16, length);
+	g_free(utf16);
+}
+
+static gchar *ntlm_challenge(struct mock_connection *conn)
+{
+	struct challenge_message cmsg;
+	GByteArray *message = g_byte_array_new();
+	GByteArray *info    = g_byte_array_new();
+	gsize target_length = 0;
+	gchar *target       = g_convert(MOCK_NETBIOS_DOMAIN, -1,
+					"UTF-16LE", "UTF-8",
+					NULL, &target_length, NULL);
+	guint64 timestamp   = GUINT64_TO_LE(TIME_T_TO_VAL(time(NULL)));
+	gchar *gssapi_data;
+
+	NONCE(conn->nonce, 8);
+
+	av_pair_append_string(info, MsvAvNbDomainName,   MOCK_NETBIOS_DOMAIN);
+	av_pair_append_string(info, MsvAvNbComputerName, MOCK_NETBIOS_COMPUTER);
+	av_pair_append_string(info, MsvAvDnsDomainName,  conn->domain);
+	av_pair_append(info, MsvAvTimestamp, &timestamp, sizeof(timestamp));
+	av_pair_append(info, MsvAvEOL, NULL, 0);
+
+	memset(&cmsg, 0, sizeof(cmsg));
+	memcpy(cmsg.protocol, "NTLMSSP\0", 8);
+	cmsg.type                  = GUINT32_TO_LE(2);
+	cmsg.target_name.len       = GUINT16_TO_LE(target_length);
+	cmsg.target_name.maxlen    = cmsg.target_name.len;
+	cmsg.target_name.offset    = GUINT32_TO_LE(sizeof(cmsg));
+	cmsg.flags                 = GUINT32_TO_LE(MOCK_NTLM_FLAGS);
+	memcpy(cmsg.nonce, conn->nonce, 8);
+	cmsg.target_info.len       = GUINT16_TO_LE(info->len);
+	cmsg.target_info.maxlen    = cmsg.target_info.len;
+	cmsg.target_info.offset    = GUINT32_TO_LE(sizeof(cmsg) + target_length);
+	cmsg.ver.product_major_version = 6;		/* 6.1.7601 (Windows 2008 R2 SP1) */
+	cmsg.ver.product_minor_version = 1;
+	cmsg.ver.product_build         = GUINT16_TO_LE(7601);
+	cmsg.ver.ntlm_revision_current = 0x0F;		/* NTLMSSP_REVISION_W2K3 */
+
+	g_byte_array_append(message, (const guint8 *) &cmsg, sizeof(cmsg));
+	g_byte_array_append(message, (const guint8 *) target, target_length);
+	g_byte_array_append(message, info->data, info->len);
+	gssapi_data = g_base64_encode(message->data, message->len);
+
+	g_byte_array_free(info, TRUE);
+	g_byte_array_free(message, TRUE);
+	g_free(target);
+
+	return(gssapi_data);
+}
+
+static const guint8 *ntlm_field(const guint8 *data,
+				gsize length,
+				const struct smb_header *header,
+				gsize *field_length)
+{
+	guint32 offset = GUINT32_FROM_LE(header->offset);
+	guint16 len    = GUINT16_FROM_LE(header->len);
+
+	if ((offset > length) || (len > length - offset))
+		return(NULL);
+
+	*field_length = len;
+	return(data + offset);
+}
+
+static gchar *ntlm_string(const guint8 *data,
+			  gsize length,
+			  const struct smb_header *header)
+{
+	gsize len;
+	const guint8 *field = ntlm_field(data, length, header, &len);
+
+	if (!field)
+		return(NULL);
+	if (len == 0)
+		return(g_strdup(""));
+	return(unicode_strconvcopy_back((const gchar *) field, len));
+}
+
+/* verifies NTProofStr and derives the server-to-client keys */
+static gboolean ntlm_authenticate(struct mock_connection *conn,
+				  const gchar *gssapi_data)
+{
+	gsize length    = 0;
+	guint8 *data    = g_base64_decode(gssapi_data, &length);
+	gboolean result = FALSE;
+
+	if (data && (length >= sizeof(struct authenticate_message))) {
+		struct authenticate_message amsg;
+		const guint8 *nt_resp;
+		gsize nt_len = 0;
+		gchar *user;
+		gchar *domain;
+
+		/* to meet sparc's alignment requirement */
+		memcpy(&amsg, data, sizeof(amsg));
+		nt_resp = ntlm_field(data, length, &amsg.nt_resp, &nt_len);
+		user    = ntlm_string(data, length, &amsg.user);
+		domain  = ntlm_string(data, length, &amsg.domain);
+
+		/* NTLMv2: NTProofStr (16) + temp (28 + target info) */
+		if (nt_resp && (nt_len >= 16 + 28) && user && domain) {
+			guchar response_key_nt[16];
+			guchar nt_proof_str[16];
+			gsize temp_len = nt_len - 16;
+			guint8 *temp   = g_malloc(8 + temp_len);
+
+			NTOWFv2(option_password, user, domain, response_key_nt);
+			memcpy(temp,     conn->nonce, 8);
+			memcpy(temp + 8, nt_resp + 16, temp_len);
+			HMAC_MD5(response_key_nt, 16, temp, 8 + temp_len, nt_proof_str);
+			g_free(temp);
+
+			if (memcmp(nt_proof_str, nt_resp, 16) == 0) {
+				guchar session_base_key[16];
+				guchar exported_session_key[16];
+				const guint8 *session_key;
+				gsize session_key_len = 0;
+
+				conn->flags = GUINT32_FROM_LE(amsg.flags);
+				session_key = ntlm_field(data, length,
+							 &amsg.session_key,
+							 &session_key_len);
+
+				/* NTLMv2: KeyExchangeKey == SessionBaseKey */
+				HMAC_MD5(response_key_nt, 16, nt_resp, 16, session_base_key);
+
+				if (!IS_FLAG(conn->flags, NTLMSSP_NEGOTIATE_KEY_EXCH)) {
+					memcpy(exported_session_key, session_base_key, 16);
+					result = TRUE;
+				} else if (session_key && (session_key_len == 16)) {
+					RC4K(session_base_key, 16, session_key, 16, exported_session_key);
+					result = TRUE;
+				}
+
+				if (result) {
+					SIGNKEY(exported_session_key, FALSE, conn->server_sign_key);
+					SEALKEY(conn->flags, exported_session_key, FALSE, conn->server_seal_key);
+				}
+			} else {
+				printf("connection %u: NTLM authentication for %s\\%s failed\n",
+				       conn->id, domain, user);
+			}
+		}
+
+		g_free(domain);
+		g_free(user);
+	}
+	g_free(data);
+
+	return(result);
+}
+
+/*
+ * Connection handling
+ */
+static void connection_send(struct mock_connection *conn,
+			    GString *message,
+			    const gchar *body)
+{
+	gsize length  = body ? strlen(body) : 0;
+	gsize rspauth = 0;
+	GError *error = NULL;
+
+	if (conn->signing) {
+		g_string_append(message, "Authentication-Info: NTLM rspauth=\"");
+		rspauth = message->len;
+		g_string_append_printf(message,
+				       MOCK_RSPAUTH_DUMMY "\", srand=\"%08X\", snum=\"%u\", opaque=\"%s\", qop=\"auth\", targetname=\"%s\", realm=\"" MOCK_REALM "\"\r\n",
+				       g_random_int(),
+				       ++conn->snum,
+				       conn->opaque,
+				       option_target);
+	}
+	g_string_append_printf(message,
+			       "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+			       "\r\n",
+			       length);
+	if (body)
+		g_string_append_len(message, body, length);
+
+	if (rspauth) {
+		struct sipmsg *msg = sipmsg_parse_msg(message->str);
+
+		/* realm & targetname are taken from Authentication-Info */
+		if (sipe_sign_input(conn->sign_buffer, 4, msg,
+				    NULL, NULL, NULL, NULL, NULL)) {
+			guint32 mac[4];
+			gchar *signature;
+
+			sip_sec_ntlm_sipe_signature_make(conn->flags,
+							 conn->sign_buffer->str,
+							 0,
+							 conn->server_sign_key,
+							 conn->server_seal_key,
+							 mac);
+			signature = buff_to_hex_str((guint8 *) mac, sizeof(mac));
+			memcpy(message->str + rspauth, signature,
+			       sizeof(MOCK_RSPAUTH_DUMMY) - 1);
+			g_free(signature);
+		}
+		sipmsg_free(msg);
+	}
+
+	if (!conn->failed &&
+	    !g_output_stream_write_all(conn->output,
+				       message->str,
+				       message->len,
+				       NULL,
+				       NULL,
+				       &error)) {
+		printf("connection %u: write failed: %s\n",
+		       conn->id, error->message);
+		g_error_free(error);
+		conn->failed = TRUE;
+	}
+
+	g_string_free(message, TRUE);
+}
+
+static const gchar *header_or_empty(const struct sipmsg *msg,
+				    const gchar *name)
+{
+	const gchar *value = sipmsg_find_header(msg, name);
+	return(value ? value : "");
+}
+
+static GString *response_new(const struct sipmsg *msg,
+			     guint code,
+			     const gchar *reason)
+{
+	GString *response = g_string_new(NULL);
+	const gchar *to   = header_or_empty(msg, "To");
+	const gchar *via;
+	guint i;
+
+	g_string_append_printf(response, "SIP/2.0 %u %s\r\n", code, reason);
+	for (i = 0; (via = sipmsg_find_header_instance(msg, "Via", i)); i++)
+		g_string_append_printf(response, "Via: %s\r\n", via);
+	g_string_append_printf(response,
+			       "From: %s\r\n"
+			       "To: %s%s\r\n"
+			       "Call-ID: %s\r\n"
+			       "CSeq: %s\r\n"
+			       "Server: RTC/6.0\r\n",
+			       header_or_empty(msg, "From"),
+			       to, strstr(to, ";tag=") ? "" : ";tag=" MOCK_TAG,
+			       header_or_empty(msg, "Call-ID"),
+			       header_or_empty(msg, "CSeq"));
+
+	return(response);
+}
+
+static GString *request_new(struct mock_connection *conn,
+			    const gchar *method,
+			    const gchar *headers)
+{
+	GString *request = g_string_new(NULL);
+
+	g_string_append_printf(request,
+			       "%s %s SIP/2.0\r\n"
+			       "Via: SIP/2.0/%s 127.0.0.1:%d;branch=z9hG4bK%08X\r\n"
+			       "From: <%s>;tag=" MOCK_TAG "\r\n"
+			       "To: <%s>\r\n"
+			       "Call-ID: %s\r\n"
+			       "CSeq: %u %s\r\n"
+			       "%s",
+			       method, conn->self,
+			       certificate ? "TLS" : "TCP", option_port, g_random_int(),
+			       conn->self,
+			       conn->self,
+			       conn->callid,
+			       ++conn->cseq, method,
+			       headers);
+
+	return(request);
+}
+
+/*
+ * Presence storms
+ */
+static void storm_free(gpointer data)
+{
+	struct mock_storm *storm = data;
+	g_strfreev(storm->uris);
+	g_free(storm);
+}
+
+static void storm_send(struct mock_connection *conn,
+		       struct mock_storm *storm)
+{
+	GString *body = g_string_new(NULL);
+	guint last    = MIN(storm->next + option_burst, storm->count);
+	guint i;
+
+	g_string_append_printf(body,
+			       "--" MOCK_BOUNDARY "\r\n"
+			       "Content-Transfer-Encoding: binary\r\n"
+			       "Content-ID: <resourceList>\r\n"
+			       "Content-Type: application/rlmi+xml\r\n"
+			       "\r\n"
+			       "<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" uri=\"%s\" version=\"%u\" fullState=\"false\">",
+			       conn->self,
+			       ++conn->rlmi_version);
+	for (i = storm->next; i < last; i++)
+		g_string_append_printf(body,
+				       "<resource uri=\"%s\"><instance id=\"%u\" state=\"active\" cid=\"c%u\"/></resource>",
+				       storm->uris[i], i, i);
+	g_string_append(body, "</list>\r\n");
+
+	/* alternate availability between rounds, i.e. every round is a change */
+	for (i = storm->next; i < last; i++) {
+		gboolean busy = ((i + storm->rounds) & 1) != 0;
+
+		g_string_append_printf(body,
+				       "--" MOCK_BOUNDARY "\r\n"
+				       "Content-Transfer-Encoding: binary\r\n"
+				       "Content-ID: <c%u>\r\n"
+				       "Content-Type: application/msrtc-event-categories+xml\r\n"
+				       "\r\n"
+				       "<categories xmlns=\"http://schemas.microsoft.com/2006/09/sip/categories\" uri=\"%s\">"
+				       "<category name=\"state\" instance=\"1\" publishTime=\"2016-03-01T10:00:00.000Z\" container=\"2\" version=\"%u\" expireType=\"endpoint\">"
+				       "<state xmlns=\"http://schemas.microsoft.com/2006/09/sip/state\" manual=\"false\" type=\"aggregateState\">"
+				       "<availability>%u</availability><activity token=\"%s\"/><device>Computer</device>"
+				       "</state></category>"
+				       "</categories>\r\n",
+				       i, storm->uris[i],
+				       conn->rlmi_version,
+				       busy ? 6500 : 3500,
+				       busy ? "Busy" : "Available");
+	}
+	g_string_append(body, "--" MOCK_BOUNDARY "--\r\n");
+
+	connection_send(conn,
+			request_new(conn,
+				    "BENOTIFY",
+				    "Event: presence\r\n"
+				    "subscription-state: active;expires=27862\r\n"
+				    "Require: eventlist\r\n"
+				    "Content-Type: multipart/related; type=\"application/rlmi+xml\"; start=\"<resourceList>\"; boundary=\"" MOCK_BOUNDARY "\"\r\n"),
+			body->str);
+	g_string_free(body, TRUE);
+
+	conn->stats.notifications++;
+	conn->stats.presence_updates += last - storm->next;
+	totals.notifications++;
+	totals.presence_updates += last - storm->next;
+
+	storm->next = last;
+}
+
+static gboolean storm_tick(gpointer data)
+{
+	struct mock_connection *conn = data;
+	struct mock_storm *storm     = g_queue_peek_head(&conn->storms);
+
+	if (storm && !conn->failed) {
+		storm_send(conn, storm);
+
+		if (storm->next >= storm->count) {
+			storm->next = 0;
+			if (--storm->rounds == 0)
+				storm_free(g_queue_pop_head(&conn->storms));
+		}
+	}
+
+	if (conn->failed || g_queue_is_empty(&conn->storms)) {
+		conn->storm_timer = 0;
+		return(FALSE);
+	}
+	return(TRUE);
+}
+
+static void storm_add(struct mock_connection *conn,
+		      const struct sipmsg *msg)
+{
+	GPtrArray *uris = g_ptr_array_new();
+
+	/* batched: <resource uri="..."/> for every buddy */
+	if (msg->body && strstr(msg->body, "<resource uri=\"")) {
+		const gchar *resource = msg->body;
+
+		while ((resource = strstr(resource, "<resource uri=\"")) != NULL) {
+			const gchar *end;
+
+			resource += sizeof("<resource uri=\"") - 1;
+			end = strchr(resource, '"');
+			if (!end)
+				break;
+			g_ptr_array_add(uris, g_strndup(resource, end - resource));
+			resource = end;
+		}
+
+	/* single: buddy is in To: */
+	} else {
+		gchar *to = sipmsg_find_part_of_header(sipmsg_find_header(msg, "To"),
+						       "<", ">", NULL);
+		if (to && !sipe_strequal(to, conn->self))
+			g_ptr_array_add(uris, to);
+		else
+			g_free(to);
+	}
+
+	if (uris->len && (option_storms > 0)) {
+		struct mock_storm *storm = g_new0(struct mock_storm, 1);
+
+		storm->count  = uris->len;
+		storm->rounds = option_storms;
+		g_ptr_array_add(uris, NULL);
+		storm->uris   = (gchar **) g_ptr_array_free(uris, FALSE);
+		g_queue_push_tail(&conn->storms, storm);
+
+		if (!conn->storm_timer)
+			conn->storm_timer = (option_rate > 0) ?
+				g_timeout_add(MAX(1000 / option_rate, 1), storm_tick, conn) :
+				g_idle_add(storm_tick, conn);
+	} else {
+		g_ptr_array_free(uris, TRUE);
+	}
+}
+
+/*
+ * Request processing
+ */
+static void send_roaming_contacts(struct mock_connection *conn)
+{
+	GString *body = g_string_new("<contactList deltaNum=\"1\" xmlns=\"http://schemas.microsoft.com/2006/09/sip/contactlist\">"
+				     "<group id=\"1\" name=\"~\" externalURI=\"\"/>"
+				     "<group id=\"2\" name=\"Team\" externalURI=\"\"/>");
+	gint i;
+
+	for (i = 0; i < option_contacts; i++)
+		g_string_append_printf(body,
+				       "<contact uri=\"contact%05d@%s\" name=\"\" groups=\"%u \" subscribed=\"true\" externalURI=\"\"/>",
+				       i, conn->domain,
+				       (i % 10) ? 1 : 2);
+	g_string_append(body, "</contactList>");
+
+	connection_send(conn,
+			request_new(conn,
+				    "NOTIFY",
+				    "Event: vnd-microsoft-roaming-contacts\r\n"
+				    "subscription-state: active;expires=35000\r\n"
+				    "Content-Type: application/vnd-microsoft-roaming-contacts+xml\r\n"),
+			body->str);
+	g_string_free(body, TRUE);
+}
+
+static void process_register(struct mock_connection *conn,
+			     const struct sipmsg *msg)
+{
+	const gchar *expires = sipmsg_find_header(msg, "Expires");
+	GString *response;
+
+	if (!conn->self) {
+		conn->self = sipmsg_find_part_of_header(sipmsg_find_header(msg, "From"),
+							"<", ">", NULL);
+		if (conn->self) {
+			const gchar *at = strchr(conn->self, '@');
+			conn->domain = g_strdup(at ? at + 1 : "mock.test");
+		} else {
+			conn->self   = g_strdup("sip:unknown@mock.test");
+			conn->domain = g_strdup("mock.test");
+		}
+	}
+
+	/* de-registration */
+	if (expires && (strtoul(expires, NULL, 10) == 0)) {
+		connection_send(conn, response_new(msg, 200, "OK"), NULL);
+		return;
+	}
+
+	if (use_ntlm) {
+		const gchar *authorization = sipmsg_find_header(msg, "Authorization");
+		gchar *gssapi_data         = sipmsg_find_part_of_header(authorization,
+									"gssapi-data=\"",
+									"\"",
+									NULL);
+
+		/* handshake messages drop the old security association */
+		if (!authorization || gssapi_data)
+			conn->signing = FALSE;
+
+		if (!conn->signing) {
+			if (!gssapi_data) {
+				/* offer NTLM */
+				response = response_new(msg, 401, "Unauthorized");
+				g_string_append_printf(response,
+						       "WWW-Authenticate: NTLM realm=\"" MOCK_REALM "\", targetname=\"%s\", version=4\r\n",
+						       option_target);
+				connection_send(conn, response, NULL);
+				return;
+
+			} else if (*gssapi_data == '\0') {
+				/* NEGOTIATE is empty: send CHALLENGE */
+				gchar *challenge = ntlm_challenge(conn);
+
+				g_free(conn->opaque);
+				conn->opaque = g_strdup_printf("%08X", g_random_int());
+
+				response = response_new(msg, 401, "Unauthorized");
+				g_string_append_printf(response,
+						       "WWW-Authenticate: NTLM opaque=\"%s\", gssapi-data=\"%s\", targetname=\"%s\", realm=\"" MOCK_REALM "\", version=4\r\n",
+						       conn->opaque,
+						       challenge,
+						       option_target);
+				connection_send(conn, response, NULL);
+				g_free(challenge);
+				g_free(gssapi_data);
+				return;
+
+			} else if (!ntlm_authenticate(conn, gssapi_data)) {
+				/* client gives up on a failed NTLM handshake */
+				response = response_new(msg, 401, "Unauthorized");
+				g_string_append_printf(response,
+						       "WWW-Authenticate: NTLM realm=\"" MOCK_REALM "\", targetname=\"%s\", version=4\r\n",
+						       option_target);
+				connection_send(conn, response, NULL);
+				g_free(gssapi_data);
+				return;
+			}
+
+			/* AUTHENTICATE succeeded */
+			conn->signing = TRUE;
+		}
+		g_free(gssapi_data);
+	}
+
+	response = response_new(msg, 200, "OK");
+	g_string_append(response,
+			"Expires: 7200\r\n"
+			"Supported: msrtc-event-categories\r\n"
+			"Supported: adhoclist\r\n"
+			"Allow-Events: vnd-microsoft-provisioning,vnd-microsoft-roaming-contacts,vnd-microsoft-roaming-ACL,presence,presence.wpending,vnd-microsoft-roaming-self,vnd-microsoft-provisioning-v2\r\n"
+			"ms-keep-alive: UAS; tcp=no; hop-hop=yes; end-host=no; timeout=300\r\n");
+	connection_send(conn, response, NULL);
+
+	conn->stats.registrations++;
+	totals.registrations++;
+}
+
+static void process_subscribe(struct mock_connection *conn,
+			      const struct sipmsg *msg)
+{
+	const gchar *event   = sipmsg_find_header(msg, "Event");
+	const gchar *expires = sipmsg_find_header(msg, "Expires");
+	GString *response    = response_new(msg, 200, "OK");
+
+	g_string_append(response, "Expires: 36000\r\n");
+	connection_send(conn, response, NULL);
+
+	/* unsubscribe */
+	if (expires && (strtoul(expires, NULL, 10) == 0))
+		return;
+
+	if (sipe_strcase_equal(event, "vnd-microsoft-roaming-contacts"))
+		send_roaming_contacts(conn);
+	else if (sipe_strcase_equal(event, "presence"))
+		storm_add(conn, msg);
+}
+
+static void process_message(struct mock_connection *conn,
+			    const struct sipmsg *msg)
+{
+	/* responses to our NOTIFYs */
+	if (msg->response)
+		return;
+
+	conn->stats.requests++;
+	totals.requests++;
+
+	if (sipe_strequal(msg->method, "REGISTER"))
+		process_register(conn, msg);
+	else if (sipe_strequal(msg->method, "SUBSCRIBE"))
+		process_subscribe(conn, msg);
+	else if (!sipe_strequal(msg->method, "ACK"))
+		connection_send(conn, response_new(msg, 200, "OK"), NULL);
+}
+
+/* returns FALSE on fatal errors */
+static gboolean process_input(struct mock_connection *conn)
+{
+	GString *received = conn->received;
+	gsize consumed    = 0;
+	gboolean result   = TRUE;
+
+	while (!conn->failed) {
+		const gchar *start = received->str + consumed;
+		const gchar *end;
+		struct sipmsg *msg;
+		gchar *header;
+		gsize length;
+
+		/* skip keep-alive CRLFs */
+		while ((*start == '\r') || (*start == '\n'))
+			start++;
+		consumed = start - received->str;
+
+		end = strstr(start, "\r\n\r\n");
+		if (!end)
+			break;
+
+		header = g_strndup(start, end - start);
+		msg    = sipmsg_parse_header(header);
+		g_free(header);
+		if (!msg ||
+		    (msg->response == SIPMSG_RESPONSE_FATAL_ERROR) ||
+		    (msg->bodylen < 0)) {
+			printf("connection %u: corrupted message received\n",
+			       conn->id);
+			sipmsg_free(msg);
+			result = FALSE;
+			break;
+		}
+
+		length = end + 4 - start + msg->bodylen;
+		if (consumed + length > received->len) {
+			/* message is incomplete */
+			sipmsg_free(msg);
+			break;
+		}
+
+		msg->body = g_strndup(end + 4, msg->bodylen);
+		consumed += length;
+
+		process_message(conn, msg);
+		sipmsg_free(msg);
+	}
+
+	g_string_erase(received, 0, consumed);
+	return(result && !conn->failed);
+}
+
+static void connection_free(struct mock_connection *conn)
+{
+	struct mock_storm *storm;
+
+	printf("connection %u: %s closed - requests: %u BENOTIFYs: %u presence updates: %u\n",
+	       conn->id,
+	       conn->self ? conn->self : "<unknown>",
+	       conn->stats.requests,
+	       conn->stats.notifications,
+	       conn->stats.presence_updates);
+
+	if (conn->storm_timer)
+		g_source_remove(conn->storm_timer);
+	while ((storm = g_queue_pop_head(&conn->storms)) != NULL)
+		storm_free(storm);
+
+	g_io_stream_close(conn->stream, NULL, NULL);
+	g_object_unref(conn->stream);
+	g_string_free(conn->sign_buffer, TRUE);
+	g_string_free(conn->received, TRUE);
+	g_free(conn->opaque);
+	g_free(conn->callid);
+	g_free(conn->domain);
+	g_free(conn->self);
+	g_free(conn);
+}
+
+static void connection_read(struct mock_connection *conn);
+
+static void read_completed(GObject *stream,
+			   GAsyncResult *result,
+			   gpointer data)
+{
+	struct mock_connection *conn = data;
+	GError *error                = NULL;
+	gssize len                   = g_input_stream_read_finish(G_INPUT_STREAM(stream),
+								  result,
+								  &error);
+
+	if (len > 0) {
+		g_string_append_len(conn->received, conn->buffer, len);
+		if (process_input(conn)) {
+			connection_read(conn);
+			return;
+		}
+	} else if (len < 0) {
+		printf("connection %u: read failed: %s\n",
+		       conn->id, error->message);
+		g_error_free(error);
+	}
+
+	connection_free(conn);
+}
+
+static void connection_read(struct mock_connection *conn)
+{
+	g_input_stream_read_async(conn->input,
+				  conn->buffer,
+				  sizeof(conn->buffer),
+				  G_PRIORITY_DEFAULT,
+				  NULL,
+				  read_completed,
+				  conn);
+}
+
+static gboolean incoming(SIPE_UNUSED_PARAMETER GSocketService *service,
+			 GSocketConnection *connection,
+			 SIPE_UNUSED_PARAMETER GObject *source,
+			 SIPE_UNUSED_PARAMETER gpointer data)
+{
+	GIOStream *stream = G_IO_STREAM(connection);
+	struct mock_connection *conn;
+
+	if (certificate) {
+		GError *error = NULL;
+
+		/* takes a reference to the socket connection */
+		stream = g_tls_server_connection_new(stream, certificate, &error);
+		if (!stream) {
+			printf("TLS setup failed: %s\n", error->message);
+			g_error_free(error);
+			return(TRUE);
+		}
+	} else {
+		g_object_ref(stream);
+	}
+
+	conn              = g_new0(struct mock_connection, 1);
+	conn->id          = ++totals.connections;
+	conn->stream      = stream;
+	conn->input       = g_io_stream_get_input_stream(stream);
+	conn->output      = g_io_stream_get_output_stream(stream);
+	conn->received    = g_string_sized_new(MOCK_READ_SIZE);
+	conn->sign_buffer = g_string_sized_new(256);
+	conn->callid      = g_strdup_printf("mock%04X%08X", conn->id, g_random_int());
+	g_queue_init(&conn->storms);
+
+	connection_read(conn);
+
+	return(TRUE);
+}
+
+static gboolean print_totals(gpointer data)
+{
+	printf("connections: %u registrations: %u requests: %u BENOTIFYs: %u presence updates: %u\n",
+	       totals.connections,
+	       totals.registrations,
+	       totals.requests,
+	       totals.notifications,
+	       totals.presence_updates);
+	g_main_loop_quit(data);
+	return(FALSE);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context = g_option_context_new("- mock Lync/OCS registrar");
+	GSocketService *service;
+	GMainLoop *loop;
+	GError *error           = NULL;
+
+#if !GLIB_CHECK_VERSION(2,36,0)
+	g_type_init();
+#endif
+
+	g_option_context_add_main_entries(context, options, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		printf("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return(1);
+	}
+	g_option_context_free(context);
+
+	if (option_authentication &&
+	    !sipe_strcase_equal(option_authentication, "ntlm")) {
+		if (sipe_strcase_equal(option_authentication, "none")) {
+			use_ntlm = FALSE;
+		} else {
+			printf("unsupported authentication type '%s'\n",
+			       option_authentication);
+			return(1);
+		}
+	}
+	if ((use_ntlm && is_empty(option_password)) ||
+	    (option_contacts < 0) || (option_burst < 1)) {
+		printf("invalid options, see --help\n");
+		return(1);
+	}
+	if (!option_target)
+		option_target = g_strdup("sip/registrar.mock");
+
+	if (option_certificate) {
+		certificate = g_tls_certificate_new_from_file(option_certificate,
+							      &error);
+		if (!certificate) {
+			printf("can't load certificate from '%s': %s\n",
+			       option_certificate, error->message);
+			g_error_free(error);
+			return(1);
+		}
+	}
+
+	sip_sec_init__ntlm();
+
+	service = g_socket_service_new();
+	if (!g_socket_listener_add_inet_port(G_SOCKET_LISTENER(service),
+					     option_port,
+					     NULL,
+					     &error)) {
+		printf("can't listen on port %d: %s\n",
+		       option_port, error->message);
+		g_error_free(error);
+		g_object_unref(service);
+		return(1);
+	}
+	g_signal_connect(service, "incoming", G_CALLBACK(incoming), NULL);
+	g_socket_service_start(service);
+
+	printf("listening on port %d (%s, %s authentication, %d contacts)\n",
+	       option_port,
+	       certificate ? "TLS" : "TCP",
+	       use_ntlm ? "NTLM" : "no",
+	       option_contacts);
+
+	loop = g_main_loop_new(NULL, FALSE);
+	g_unix_signal_add(SIGINT,  print_totals, loop);
+	g_unix_signal_add(SIGTERM, print_totals, loop);
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+
+	g_socket_service_stop(service);
+	g_object_unref(service);
+	if (certificate)
+		g_object_unref(certificate);
+	sip_sec_destroy__ntlm();
+
+	return(0);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
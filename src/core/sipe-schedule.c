@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -22,11 +22,36 @@
 
 #include <glib.h>
 
+#include "sip-transport.h"
 #include "sipe-backend.h"
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-schedule.h"
 
+/*
+ * Hierarchical timer wheel
+ *
+ * Level 0 has one slot per tick. Each higher level has one slot per full
+ * revolution of the level below. Entries further away than level 0 are
+ * moved ("cascaded") down one level when the wheel reaches their slot.
+ *
+ * Entries further away than the wheel can hold are linked at its far end
+ * and are linked again from there until they are due.
+ *
+ * Only one backend timer is active at any time. It is armed for the next
+ * tick that has work to do. All actions expiring in the same tick are
+ * executed from one backend callback. sipe_schedule_coalesce() moves the
+ * deadline of an action onto a coarser grid, so that more actions share
+ * the same tick.
+ */
+#define SIPE_SCHEDULE_TICK_MS      50
+#define SIPE_SCHEDULE_LEVEL_BITS    6
+#define SIPE_SCHEDULE_LEVEL_SLOTS  (1 << SIPE_SCHEDULE_LEVEL_BITS)
+#define SIPE_SCHEDULE_LEVEL_MASK   (SIPE_SCHEDULE_LEVEL_SLOTS - 1)
+#define SIPE_SCHEDULE_LEVELS        4
+/* 2^24 ticks * 50ms = ~9.7 days */
+#define SIPE_SCHEDULE_MAX_TICKS    ((1 << (SIPE_SCHEDULE_LEVELS * SIPE_SCHEDULE_LEVEL_BITS)) - 1)
+
 struct sipe_schedule {
 	/**
 	 * Name of action.
@@ -34,11 +59,30 @@ struct sipe_schedule {
 	 * Example:  <presence><sip:user@domain.com> or <registration>
 	 */
 	gchar *name;
-	struct sipe_core_private *sipe_private;
-	gpointer backend_private;
 	gpointer payload;
 	sipe_schedule_action action;
 	GDestroyNotify destroy;
+	guint64 expires;                 /* in ticks, can be beyond the wheel */
+	struct sipe_schedule_slot *slot;
+	struct sipe_schedule *prev;
+	struct sipe_schedule *next;
+};
+
+struct sipe_schedule_slot {
+	struct sipe_schedule *first;
+	struct sipe_schedule *last;
+};
+
+struct sipe_schedule_wheel {
+	struct sipe_core_private *sipe_private;
+	GHashTable *names;               /* name -> sipe_schedule */
+	GTimer *clock;
+	guint64 now;                     /* all ticks <= now have been executed */
+	gpointer backend_private;        /* single backend timer */
+	guint64 backend_expires;         /* tick the backend timer is armed for */
+	gboolean executing;
+	gboolean cancelled;              /* cancel_all() called while executing */
+	struct sipe_schedule_slot slots[SIPE_SCHEDULE_LEVELS][SIPE_SCHEDULE_LEVEL_SLOTS];
 };
 
 static void sipe_schedule_deallocate(struct sipe_schedule *schedule)
@@ -48,41 +92,258 @@ static void sipe_schedule_deallocate(struct sipe_schedule *schedule)
 	g_free(schedule);
 }
 
+static guint64 sipe_schedule_clock(struct sipe_schedule_wheel *wheel)
+{
+	return((guint64) (g_timer_elapsed(wheel->clock, NULL) * 1000) /
+	       SIPE_SCHEDULE_TICK_MS);
+}
+
+static void sipe_schedule_link(struct sipe_schedule_wheel *wheel,
+			       struct sipe_schedule *schedule)
+{
+	guint64 delta = MIN(schedule->expires - wheel->now, SIPE_SCHEDULE_MAX_TICKS);
+	guint64 tick  = wheel->now + delta;
+	struct sipe_schedule_slot *slot;
+	guint level = 0;
+
+	while ((level < SIPE_SCHEDULE_LEVELS - 1) &&
+	       (delta >> ((level + 1) * SIPE_SCHEDULE_LEVEL_BITS)))
+		level++;
+	slot = &wheel->slots[level][(tick >> (level * SIPE_SCHEDULE_LEVEL_BITS)) &
+				    SIPE_SCHEDULE_LEVEL_MASK];
+
+	schedule->slot = slot;
+	schedule->prev = slot->last;
+	schedule->next = NULL;
+	if (slot->last)
+		slot->last->next = schedule;
+	else
+		slot->first = schedule;
+	slot->last = schedule;
+}
+
+static void sipe_schedule_unlink(struct sipe_schedule *schedule)
+{
+	struct sipe_schedule_slot *slot = schedule->slot;
+
+	if (schedule->prev)
+		schedule->prev->next = schedule->next;
+	else
+		slot->first = schedule->next;
+	if (schedule->next)
+		schedule->next->prev = schedule->prev;
+	else
+		slot->last = schedule->prev;
+	schedule->slot = NULL;
+}
+
+/* first tick > wheel->now that needs processing, 0 if wheel is empty */
+static guint64 sipe_schedule_next_tick(struct sipe_schedule_wheel *wheel)
+{
+	guint64 next = 0;
+	guint level;
+
+	for (level = 0; level < SIPE_SCHEDULE_LEVELS; level++) {
+		guint shift = level * SIPE_SCHEDULE_LEVEL_BITS;
+		guint64 base = wheel->now >> shift;
+		guint i;
+
+		for (i = 1; i <= SIPE_SCHEDULE_LEVEL_SLOTS; i++) {
+			if (wheel->slots[level][(base + i) & SIPE_SCHEDULE_LEVEL_MASK].first) {
+				guint64 tick = (base + i) << shift;
+				if (!next || (tick < next))
+					next = tick;
+				break;
+			}
+		}
+	}
+
+	return(next);
+}
+
+static void sipe_schedule_arm(struct sipe_schedule_wheel *wheel)
+{
+	struct sipe_core_private *sipe_private = wheel->sipe_private;
+	guint64 next = sipe_schedule_next_tick(wheel);
+	guint64 current;
+	guint64 delay;
+
+	/* backend timer already fires early enough */
+	if (wheel->backend_private && next && (wheel->backend_expires <= next))
+		return;
+
+	if (wheel->backend_private) {
+		sipe_backend_schedule_cancel(SIPE_CORE_PUBLIC,
+					     wheel->backend_private);
+		wheel->backend_private = NULL;
+	}
+	if (!next)
+		return;
+
+	current = sipe_schedule_clock(wheel);
+	delay   = next > current ? (next - current) * SIPE_SCHEDULE_TICK_MS : 0;
+	wheel->backend_expires = next;
+	/* waking up a bit early is harmless: the timer is simply re-armed */
+	if (delay >= 2000)
+		wheel->backend_private = sipe_backend_schedule_seconds(SIPE_CORE_PUBLIC,
+								       delay / 1000,
+								       wheel);
+	else
+		wheel->backend_private = sipe_backend_schedule_mseconds(SIPE_CORE_PUBLIC,
+									delay,
+									wheel);
+}
+
+static void sipe_schedule_wheel_free(struct sipe_schedule_wheel *wheel)
+{
+	g_hash_table_destroy(wheel->names);
+	g_timer_destroy(wheel->clock);
+	g_free(wheel);
+}
+
+static void sipe_schedule_cascade(struct sipe_schedule_wheel *wheel)
+{
+	guint level;
+
+	for (level = 1; level < SIPE_SCHEDULE_LEVELS; level++) {
+		guint shift = level * SIPE_SCHEDULE_LEVEL_BITS;
+		struct sipe_schedule_slot *slot = &wheel->slots[level][(wheel->now >> shift) &
+								       SIPE_SCHEDULE_LEVEL_MASK];
+		struct sipe_schedule *schedule = slot->first;
+
+		slot->first = slot->last = NULL;
+		while (schedule) {
+			struct sipe_schedule *next = schedule->next;
+			sipe_schedule_link(wheel, schedule);
+			schedule = next;
+		}
+
+		/* only continue if this level wrapped around too */
+		if ((wheel->now >> shift) & SIPE_SCHEDULE_LEVEL_MASK)
+			break;
+	}
+}
+
 void sipe_core_schedule_execute(gpointer data)
 {
-	struct sipe_schedule *expired = data;
-	struct sipe_core_private *sipe_private = expired->sipe_private;
+	struct sipe_schedule_wheel *wheel = data;
+	struct sipe_core_private *sipe_private = wheel->sipe_private;
+	guint64 current = sipe_schedule_clock(wheel);
+
+	/* backend has already released its timer */
+	wheel->backend_private = NULL;
+	wheel->executing = TRUE;
+
+	/* send messages from all expired actions at once */
+	sip_transport_cork(sipe_private);
+
+	while (TRUE) {
+		guint64 next = sipe_schedule_next_tick(wheel);
+		struct sipe_schedule_slot *slot;
+
+		/* skip over ticks without work */
+		if (!next || (next > current)) {
+			wheel->now = MAX(wheel->now, current);
+			break;
+		}
+
+		wheel->now = next;
+		if (!(wheel->now & SIPE_SCHEDULE_LEVEL_MASK))
+			sipe_schedule_cascade(wheel);
+
+		/* actions added for this tick during execution are picked up too */
+		slot = &wheel->slots[0][wheel->now & SIPE_SCHEDULE_LEVEL_MASK];
+		while (slot->first) {
+			struct sipe_schedule *expired = slot->first;
+
+			sipe_schedule_unlink(expired);
+
+			/* reached the far end of the wheel, but not yet due */
+			if (expired->expires > wheel->now) {
+				sipe_schedule_link(wheel, expired);
+				continue;
+			}
+
+			g_hash_table_remove(wheel->names, expired->name);
+
+			SIPE_DEBUG_INFO("sipe_core_schedule_execute: executing %s", expired->name);
+			SIPE_DEBUG_INFO("sipe_core_schedule_execute timeouts count %d after removal",
+					g_hash_table_size(wheel->names));
+
+			(*expired->action)(sipe_private, expired->payload);
+			sipe_schedule_deallocate(expired);
+
+			/* action has called sipe_schedule_cancel_all() */
+			if (wheel->cancelled) {
+				sipe_schedule_wheel_free(wheel);
+				sip_transport_uncork(sipe_private);
+				return;
+			}
+		}
+	}
+
+	wheel->executing = FALSE;
+	sip_transport_uncork(sipe_private);
+	sipe_schedule_arm(wheel);
+}
+
+static struct sipe_schedule_wheel *sipe_schedule_wheel(struct sipe_core_private *sipe_private)
+{
+	struct sipe_schedule_wheel *wheel = sipe_private->timeouts;
 
-	SIPE_DEBUG_INFO("sipe_core_schedule_execute: executing %s", expired->name);
-	sipe_private->timeouts = g_slist_remove(sipe_private->timeouts, expired);
-	SIPE_DEBUG_INFO("sipe_core_schedule_execute timeouts count %d after removal",
-			g_slist_length(sipe_private->timeouts));
+	if (!wheel) {
+		wheel = g_new0(struct sipe_schedule_wheel, 1);
+		wheel->sipe_private = sipe_private;
+		wheel->names = g_hash_table_new(g_str_hash, g_str_equal);
+		wheel->clock = g_timer_new();
+		sipe_private->timeouts = wheel;
+	}
 
-	(*expired->action)(sipe_private, expired->payload);
-	sipe_schedule_deallocate(expired);
+	return(wheel);
 }
 
-static struct sipe_schedule *sipe_schedule_allocate(struct sipe_core_private *sipe_private,
-						    const gchar *name,
-						    gpointer payload,
-						    sipe_schedule_action action,
-						    GDestroyNotify destroy)
+static void sipe_schedule_allocate(struct sipe_core_private *sipe_private,
+				   const gchar *name,
+				   gpointer payload,
+				   guint milliseconds,
+				   guint slack_ticks,
+				   sipe_schedule_action action,
+				   GDestroyNotify destroy)
 {
+	struct sipe_schedule_wheel *wheel;
 	struct sipe_schedule *new;
+	guint64 ticks = (milliseconds + SIPE_SCHEDULE_TICK_MS - 1) / SIPE_SCHEDULE_TICK_MS;
 
 	/* Make sure each action only exists once */
 	sipe_schedule_cancel(sipe_private, name);
 
+	wheel = sipe_schedule_wheel(sipe_private);
+	/* an empty wheel can simply jump to the current time */
+	if (!wheel->executing && !g_hash_table_size(wheel->names))
+		wheel->now = sipe_schedule_clock(wheel);
+
 	new = g_new0(struct sipe_schedule, 1);
 	new->name = g_strdup(name);
-	new->sipe_private = sipe_private;
 	new->payload = payload;
 	new->action = action;
 	new->destroy = destroy;
-	sipe_private->timeouts = g_slist_append(sipe_private->timeouts, new);
+
+	/* never expire in the past or the tick currently executing */
+	new->expires = sipe_schedule_clock(wheel) + (ticks ? ticks : 1);
+	if (new->expires <= wheel->now)
+		new->expires = wheel->now + 1;
+
+	/* round up to a multiple of the slack: shares the tick with others */
+	if (slack_ticks > 1)
+		new->expires = ((new->expires + slack_ticks - 1) / slack_ticks) * slack_ticks;
+
+	sipe_schedule_link(wheel, new);
+	g_hash_table_insert(wheel->names, new->name, new);
 	SIPE_DEBUG_INFO("sipe_schedule_allocate timeouts count %d after addition",
-			g_slist_length(sipe_private->timeouts));
-	return(new);
+			g_hash_table_size(wheel->names));
+
+	if (!wheel->executing)
+		sipe_schedule_arm(wheel);
 }
 
 void sipe_schedule_seconds(struct sipe_core_private *sipe_private,
@@ -92,16 +353,15 @@ void sipe_schedule_seconds(struct sipe_core_private *sipe_private,
 			   sipe_schedule_action action,
 			   GDestroyNotify destroy)
 {
-	struct sipe_schedule *new = sipe_schedule_allocate(sipe_private,
-							   name,
-							   payload,
-							   action,
-							   destroy);
 	SIPE_DEBUG_INFO("scheduling action %s timeout %d seconds",
 			name, seconds);
-	new->backend_private = sipe_backend_schedule_seconds(SIPE_CORE_PUBLIC,
-							     seconds,
-							     new);
+	sipe_schedule_allocate(sipe_private,
+			       name,
+			       payload,
+			       MIN(seconds, G_MAXUINT / 1000) * 1000,
+			       0,
+			       action,
+			       destroy);
 }
 
 void sipe_schedule_mseconds(struct sipe_core_private *sipe_private,
@@ -111,60 +371,82 @@ void sipe_schedule_mseconds(struct sipe_core_private *sipe_private,
 			    sipe_schedule_action action,
 			    GDestroyNotify destroy)
 {
-	struct sipe_schedule *new = sipe_schedule_allocate(sipe_private,
-							   name,
-							   payload,
-							   action,
-							   destroy);
 	SIPE_DEBUG_INFO("scheduling action %s timeout %d milliseconds",
 			name, milliseconds);
-	new->backend_private = sipe_backend_schedule_mseconds(SIPE_CORE_PUBLIC,
-							      milliseconds,
-							      new);
+	sipe_schedule_allocate(sipe_private,
+			       name,
+			       payload,
+			       milliseconds,
+			       0,
+			       action,
+			       destroy);
+}
+
+void sipe_schedule_coalesce(struct sipe_core_private *sipe_private,
+			    const gchar *name,
+			    gpointer payload,
+			    guint seconds,
+			    guint slack,
+			    sipe_schedule_action action,
+			    GDestroyNotify destroy)
+{
+	SIPE_DEBUG_INFO("scheduling action %s timeout %d seconds slack %d seconds",
+			name, seconds, slack);
+	sipe_schedule_allocate(sipe_private,
+			       name,
+			       payload,
+			       MIN(seconds, G_MAXUINT / 1000) * 1000,
+			       MIN(slack, G_MAXUINT / 1000) * 1000 / SIPE_SCHEDULE_TICK_MS,
+			       action,
+			       destroy);
 }
 
-static void sipe_schedule_remove(struct sipe_core_private *sipe_private,
-				 struct sipe_schedule *schedule)
+static void sipe_schedule_remove(struct sipe_schedule *schedule)
 {
 	SIPE_DEBUG_INFO("sipe_schedule_remove: action name=%s",
 			schedule->name);
-	sipe_backend_schedule_cancel(SIPE_CORE_PUBLIC,
-				     schedule->backend_private);
+	sipe_schedule_unlink(schedule);
 	sipe_schedule_deallocate(schedule);
 }
 
 void sipe_schedule_cancel(struct sipe_core_private *sipe_private,
 			  const gchar *name)
 {
-	GSList *entry;
-
-	if (!sipe_private->timeouts || !name) return;
-
-	entry = sipe_private->timeouts;
-	while (entry) {
-		struct sipe_schedule *schedule = entry->data;
-		if (sipe_strequal(schedule->name, name)) {
-			GSList *to_delete = entry;
-			entry = entry->next;
-			sipe_private->timeouts = g_slist_delete_link(sipe_private->timeouts,
-								     to_delete);
-			sipe_schedule_remove(sipe_private, schedule);
-		} else {
-			entry = entry->next;
-		}
+	struct sipe_schedule_wheel *wheel = sipe_private->timeouts;
+	struct sipe_schedule *schedule;
+
+	if (!wheel || !name) return;
+
+	schedule = g_hash_table_lookup(wheel->names, name);
+	if (schedule) {
+		g_hash_table_remove(wheel->names, name);
+		sipe_schedule_remove(schedule);
+		/* backend timer is re-armed lazily when it fires */
 	}
 }
 
 void sipe_schedule_cancel_all(struct sipe_core_private *sipe_private)
 {
-	GSList *entry = sipe_private->timeouts;
+	struct sipe_schedule_wheel *wheel = sipe_private->timeouts;
+	GList *schedules, *entry;
 
-	while (entry) {
-		sipe_schedule_remove(sipe_private, entry->data);
-		entry = entry->next;
-	}
+	if (!wheel) return;
+
+	schedules = g_hash_table_get_values(wheel->names);
+	g_hash_table_remove_all(wheel->names);
+	for (entry = schedules; entry; entry = entry->next)
+		sipe_schedule_remove(entry->data);
+	g_list_free(schedules);
+
+	if (wheel->backend_private)
+		sipe_backend_schedule_cancel(SIPE_CORE_PUBLIC,
+					     wheel->backend_private);
 
-	g_slist_free(sipe_private->timeouts);
+	/* wheel is freed by sipe_core_schedule_execute() */
+	if (wheel->executing)
+		wheel->cancelled = TRUE;
+	else
+		sipe_schedule_wheel_free(wheel);
 	sipe_private->timeouts = NULL;
 }
 
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -49,6 +49,32 @@ void sipe_schedule_mseconds(struct sipe_core_private *sipe_private,
 			    guint milliseconds,
 			    sipe_schedule_action action,
 			    GDestroyNotify destroy);
+
+/**
+  * Schedule action like sipe_schedule_seconds(), but allow the scheduler
+  * to execute it up to @c slack seconds later.
+  *
+  * The deadline is rounded up to a multiple of the slack. Actions that
+  * expire close together, e.g. the resubscriptions for many buddies,
+  * therefore end up in the same tick and are executed from one backend
+  * timer callback.
+  *
+  * @param sipe_core_private
+  * @param name of action (will be copied)
+  * @param seconds timeout in seconds
+  * @param slack   maximum delay in seconds (0 = none)
+  * @param action  callback function
+  * @param destroy payload destroy function
+  * @param payload callback data (can be NULL, otherwise caller must allocate memory)
+  */
+void sipe_schedule_coalesce(struct sipe_core_private *sipe_private,
+			    const gchar *name,
+			    gpointer payload,
+			    guint seconds,
+			    guint slack,
+			    sipe_schedule_action action,
+			    GDestroyNotify destroy);
+
 void sipe_schedule_cancel(struct sipe_core_private *sipe_private,
 			  const gchar *name);
 void sipe_schedule_cancel_all(struct sipe_core_private *sipe_private);
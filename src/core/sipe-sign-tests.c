@@ -0,0 +1,569 @@
+/**
+ * @file sipe-sign-tests.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * Tests for sipe-sign.c signature input string
+ *
+ * The benchmark replays the verification of a TLS-DSK signed message as
+ * done by sip_transport_input(): build signature input, calculate
+ * HMAC-SHA1 and compare it with the rspauth value from the message.
+ *
+ * Usage: sipe_sign_tests [<benchmark iterations>]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <glib.h>
+
+#include "sipe-common.h"
+#include "sipe-crypt.h"
+#include "sipe-digest.h"
+#include "sipe-mime.h"
+
+#include "sipe-sign.c"
+
+#include "sipe-utils.h"
+#include "sipe-test-allocations.h"
+
+/*
+ * Stubs
+ */
+gboolean sipe_backend_debug_enabled(void)
+{
+	return(FALSE);
+}
+
+void sipe_backend_debug_literal(sipe_debug_level level,
+				const gchar *msg)
+{
+	printf("DEBUG(%d): %s\n", level, msg);
+}
+
+void sipe_backend_debug(sipe_debug_level level,
+			const gchar *format,
+			...)
+{
+	va_list ap;
+	gchar *newformat = g_strdup_printf("DEBUG(%d): %s\n", level, format);
+
+	va_start(ap, format);
+	vprintf(newformat, ap);
+	va_end(ap);
+
+	g_free(newformat);
+}
+
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public)
+{
+	return(NULL);
+}
+
+gchar *sipe_backend_markup_css_property(SIPE_UNUSED_PARAMETER const gchar *style,
+					SIPE_UNUSED_PARAMETER const gchar *option)
+{
+	return(NULL);
+}
+
+void sipe_mime_parts_foreach(SIPE_UNUSED_PARAMETER const gchar *type,
+			     SIPE_UNUSED_PARAMETER const gchar *body,
+			     SIPE_UNUSED_PARAMETER sipe_mime_parts_cb callback,
+			     SIPE_UNUSED_PARAMETER gpointer user_data)
+{
+}
+
+char *generateUUIDfromEPID(SIPE_UNUSED_PARAMETER const gchar *epid)
+{
+	return(NULL);
+}
+
+char *sipe_get_epid(SIPE_UNUSED_PARAMETER const char *self_sip_uri,
+		    SIPE_UNUSED_PARAMETER const char *hostname,
+		    SIPE_UNUSED_PARAMETER const char *ip_address)
+{
+	return(NULL);
+}
+
+/*
+ * Signature input implementation before sipe_sign_input() was introduced
+ */
+static gchar * const empty_string = "";
+
+struct legacy_breakdown {
+	struct sipmsg *msg;
+	gchar *protocol;
+	gchar *rand;
+	gchar *num;
+	gchar *realm;
+	gchar *target_name;
+	const gchar *call_id;
+	gchar *cseq;
+	gchar *from_url;
+	gchar *from_tag;
+	gchar *to_url;
+	gchar *to_tag;
+	gchar *p_assertet_identity_sip_uri;
+	gchar *p_assertet_identity_tel_uri;
+	const gchar *expires;
+};
+
+static void legacy_breakdown_parse(struct legacy_breakdown *msg,
+				   const gchar *realm,
+				   const gchar *target,
+				   const gchar *protocol)
+{
+	const gchar *hdr;
+
+	msg->rand = msg->num = msg->realm = msg->target_name =
+		msg->cseq = msg->from_url = msg->from_tag = msg->to_url = msg->to_tag =
+		msg->p_assertet_identity_sip_uri = msg->p_assertet_identity_tel_uri = empty_string;
+	msg->call_id = msg->expires = empty_string;
+
+	if ((hdr = sipmsg_find_header(msg->msg, "Proxy-Authorization")) ||
+	    (hdr = sipmsg_find_header(msg->msg, "Proxy-Authentication-Info")) ||
+	    (hdr = sipmsg_find_header(msg->msg, "Authentication-Info")) ) {
+		msg->protocol = sipmsg_find_part_of_header(hdr, NULL, " ", empty_string);
+		msg->rand   = sipmsg_find_part_of_header(hdr, "rand=\"", "\"", empty_string);
+		msg->num    = sipmsg_find_part_of_header(hdr, "num=\"", "\"", empty_string);
+		msg->realm  = sipmsg_find_part_of_header(hdr, "realm=\"", "\"", empty_string);
+		msg->target_name = sipmsg_find_part_of_header(hdr, "targetname=\"", "\"", empty_string);
+	} else {
+		msg->protocol = g_strdup(protocol);
+		msg->realm = g_strdup(realm);
+		msg->target_name = g_strdup(target);
+	}
+
+	msg->call_id = sipmsg_find_header(msg->msg, "Call-ID");
+
+	hdr = sipmsg_find_header(msg->msg, "CSeq");
+	if (NULL != hdr) {
+		msg->cseq = sipmsg_find_part_of_header(hdr, NULL, " ", empty_string);
+	}
+
+	hdr = sipmsg_find_header(msg->msg, "From");
+	if (NULL != hdr) {
+		msg->from_url = sipmsg_find_part_of_header(hdr, "<", ">", empty_string);
+		msg->from_tag = sipmsg_find_part_of_header(hdr, ";tag=", ";", empty_string);
+	}
+
+	hdr = sipmsg_find_header(msg->msg, "To");
+	if (NULL != hdr) {
+		msg->to_url = sipmsg_find_part_of_header(hdr, "<", ">", empty_string);
+		msg->to_tag = sipmsg_find_part_of_header(hdr, ";tag=", ";", empty_string);
+	}
+
+	hdr = sipmsg_find_header(msg->msg, "P-Asserted-Identity");
+	if (NULL == hdr) {
+		hdr = sipmsg_find_header(msg->msg, "P-Preferred-Identity");
+	}
+	if (NULL != hdr) {
+		gchar *sip_uri = NULL;
+		gchar *tel_uri = NULL;
+
+		sipmsg_parse_p_asserted_identity(hdr, &sip_uri, &tel_uri);
+		if (sip_uri)
+			msg->p_assertet_identity_sip_uri = sip_uri;
+		if (tel_uri)
+			msg->p_assertet_identity_tel_uri = tel_uri;
+	}
+
+	msg->expires = sipmsg_find_header(msg->msg, "Expires");
+}
+
+static void legacy_breakdown_free(struct legacy_breakdown *msg)
+{
+	if (msg->protocol != empty_string)
+		g_free(msg->protocol);
+	if (msg->rand != empty_string)
+		g_free(msg->rand);
+	if (msg->num != empty_string)
+		g_free(msg->num);
+	if (msg->realm != empty_string)
+		g_free(msg->realm);
+	if (msg->target_name != empty_string)
+		g_free(msg->target_name);
+	if (msg->cseq != empty_string)
+		g_free(msg->cseq);
+	if (msg->from_url != empty_string)
+		g_free(msg->from_url);
+	if (msg->from_tag != empty_string)
+		g_free(msg->from_tag);
+	if (msg->to_url != empty_string)
+		g_free(msg->to_url);
+	if (msg->to_tag != empty_string)
+		g_free(msg->to_tag);
+	if (msg->p_assertet_identity_sip_uri != empty_string)
+		g_free(msg->p_assertet_identity_sip_uri);
+	if (msg->p_assertet_identity_tel_uri != empty_string)
+		g_free(msg->p_assertet_identity_tel_uri);
+}
+
+static gchar *legacy_breakdown_get_string(int version,
+					  struct legacy_breakdown *msgbd)
+{
+	gchar *response_str;
+	gchar *msg;
+
+	if (msgbd->realm == empty_string || msgbd->realm == NULL)
+		return NULL;
+
+	response_str = msgbd->msg->response != 0 ? g_strdup_printf("<%d>", msgbd->msg->response) : empty_string;
+	if (version < 3) {
+		msg = g_strdup_printf(
+			"<%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s>" // 1 - 11
+			"<%s>%s", // 12 - 13
+			msgbd->protocol, msgbd->rand, msgbd->num, msgbd->realm, msgbd->target_name, msgbd->call_id, msgbd->cseq,
+			msgbd->msg->method, msgbd->from_url, msgbd->from_tag, msgbd->to_tag,
+			msgbd->expires ? msgbd->expires : empty_string, response_str
+		);
+	} else {
+		msg = g_strdup_printf(
+			"<%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s>" // 1 - 14
+			"<%s>%s", // 15 - 16
+			msgbd->protocol, msgbd->rand, msgbd->num, msgbd->realm, msgbd->target_name, msgbd->call_id, msgbd->cseq,
+			msgbd->msg->method, msgbd->from_url, msgbd->from_tag, msgbd->to_url, msgbd->to_tag,
+			msgbd->p_assertet_identity_sip_uri, msgbd->p_assertet_identity_tel_uri,
+			msgbd->expires ? msgbd->expires : empty_string, response_str
+		);
+	}
+
+	if (response_str != empty_string)
+		g_free(response_str);
+
+	return msg;
+}
+
+static gchar *legacy_sign_input(int version,
+				struct sipmsg *msg,
+				const gchar *protocol,
+				const gchar *realm,
+				const gchar *target,
+				const gchar *rand,
+				const gchar *num)
+{
+	struct legacy_breakdown msgbd;
+	gchar *result;
+
+	msgbd.msg = msg;
+	legacy_breakdown_parse(&msgbd, realm, target, protocol);
+	if (rand) {
+		if (msgbd.rand != empty_string)
+			g_free(msgbd.rand);
+		msgbd.rand = g_strdup(rand);
+	}
+	if (num) {
+		if (msgbd.num != empty_string)
+			g_free(msgbd.num);
+		msgbd.num = g_strdup(num);
+	}
+	result = legacy_breakdown_get_string(version, &msgbd);
+	legacy_breakdown_free(&msgbd);
+
+	return(result);
+}
+
+/*
+ * Tester code
+ */
+static guint succeeded = 0;
+static guint failed    = 0;
+
+static void assert_string(const gchar *what,
+			  const gchar *value,
+			  const gchar *expected)
+{
+	if (sipe_strequal(value, expected)) {
+		succeeded++;
+	} else {
+		printf("%s FAILED: '%s' expected: '%s'\n",
+		       what,
+		       value ? value : "(nil)",
+		       expected ? expected : "(nil)");
+		failed++;
+	}
+}
+
+#define TEST_PROTOCOL "NTLM"
+#define TEST_REALM    "SIP Communications Service"
+#define TEST_TARGET   "server.example.com"
+
+static void compare_legacy(const gchar *label,
+			   const gchar *message,
+			   const gchar *rand,
+			   const gchar *num)
+{
+	struct sipmsg *msg = sipmsg_parse_msg(message);
+	GString *buffer    = g_string_new("");
+	int version;
+
+	for (version = 2; version <= 4; version += 2) {
+		gchar *what      = g_strdup_printf("%s (version %d)", label, version);
+		gchar *reference = legacy_sign_input(version,
+						     msg,
+						     TEST_PROTOCOL,
+						     TEST_REALM,
+						     TEST_TARGET,
+						     rand,
+						     num);
+		gboolean ok      = sipe_sign_input(buffer,
+						   version,
+						   msg,
+						   TEST_PROTOCOL,
+						   TEST_REALM,
+						   TEST_TARGET,
+						   rand,
+						   num);
+
+		assert_string(what, ok ? buffer->str : NULL, reference);
+		g_free(reference);
+		g_free(what);
+	}
+
+	g_string_free(buffer, TRUE);
+	sipmsg_free(msg);
+}
+
+/* TLS-DSK signed BENOTIFY as received during a presence storm */
+static const gchar benotify[] =
+	"BENOTIFY sip:user@example.com;transport=tls;ms-opaque=d3470f2e1d;ms-received-cid=1F00;grid SIP/2.0\r\n"
+	"ms-user-logon-data: RemoteUser\r\n"
+	"Via: SIP/2.0/TLS 192.168.1.1:5061;branch=z9hG4bKF2D1CB8B.0CBB1A4B0B8D7C4E;branched=FALSE;ms-internal-info=\"ck9lUWkq7aZyEdxa7uI4Nl2sFCLdm7ljQUKkL9bwAA\"\r\n"
+	"Authentication-Info: TLS-DSK qop=\"auth\", opaque=\"ADDF7D10\", srand=\"CA45D5F1\", snum=\"2021\", rspauth=\"03f9d1f0b6c3e0e3d2fbd0b6a2a8be1fa6a5d9a7\", targetname=\"server.example.com\", realm=\"SIP Communications Service\", version=4\r\n"
+	"Max-Forwards: 68\r\n"
+	"Content-Length: 0\r\n"
+	"From: <sip:user@example.com>;tag=FE2EF63C5E2B9CBB\r\n"
+	"To: <sip:user@example.com>;tag=9c2d7cfe1b;epid=4f7ebb3d17\r\n"
+	"Call-ID: 7c4e3e5d6ff94e00a1c3bd1e3e1e8c41\r\n"
+	"CSeq: 14 BENOTIFY\r\n"
+	"Require: eventlist\r\n"
+	"Content-Type: application/msrtc-event-categories+xml\r\n"
+	"Event: presence\r\n"
+	"subscription-state: active;expires=27862\r\n"
+	"\r\n";
+
+static const guchar benchmark_key[] = "0123456789abcdef0123456789abcdef";
+
+typedef gboolean (*verify_function)(struct sipmsg *msg, GString *buffer);
+
+/* sip_transport_input() & sip_sec_verify_signature() before */
+static gboolean legacy_verify(struct sipmsg *msg,
+			      SIPE_UNUSED_PARAMETER GString *buffer)
+{
+	gchar *input   = legacy_sign_input(4, msg, NULL, NULL, NULL, NULL, NULL);
+	gchar *rspauth = sipmsg_find_part_of_header(sipmsg_find_header(msg, "Authentication-Info"),
+						    "rspauth=\"", "\"", NULL);
+	guchar *signature;
+	gsize length   = hex_str_to_buff(rspauth, &signature);
+	guchar *mac    = g_malloc0(SIPE_DIGEST_HMAC_SHA1_LENGTH);
+	gboolean valid;
+
+	sipe_digest_hmac_sha1(benchmark_key, sizeof(benchmark_key) - 1,
+			      (guchar *) input, strlen(input),
+			      mac);
+	valid = (length == SIPE_DIGEST_HMAC_SHA1_LENGTH) &&
+		(memcmp(signature, mac, length) == 0);
+
+	g_free(mac);
+	g_free(signature);
+	g_free(rspauth);
+	g_free(input);
+	return(valid);
+}
+
+/* sip_transport_input() & sip_sec_verify_signature() now */
+static gboolean signing_verify(struct sipmsg *msg,
+			       GString *buffer)
+{
+	struct sipe_sign_span rspauth;
+	guchar signature[SIPE_DIGEST_HMAC_SHA1_LENGTH];
+	guchar mac[SIPE_DIGEST_HMAC_SHA1_LENGTH];
+	gsize i;
+
+	sipe_sign_input(buffer, 4, msg, NULL, NULL, NULL, NULL, NULL);
+	sipe_sign_span_find(&rspauth,
+			    sipmsg_find_header(msg, "Authentication-Info"),
+			    "rspauth=\"", "\"");
+	if (rspauth.length != 2 * sizeof(signature))
+		return(FALSE);
+	for (i = 0; i < sizeof(signature); i++)
+		signature[i] = (g_ascii_xdigit_value(rspauth.start[2 * i]) << 4) |
+			g_ascii_xdigit_value(rspauth.start[2 * i + 1]);
+
+	sipe_digest_hmac_sha1(benchmark_key, sizeof(benchmark_key) - 1,
+			      (guchar *) buffer->str, buffer->len,
+			      mac);
+	return(memcmp(signature, mac, sizeof(mac)) == 0);
+}
+
+static void benchmark(const gchar *label,
+		      struct sipmsg *msg,
+		      guint iterations,
+		      verify_function verify)
+{
+	GString *buffer = g_string_sized_new(512);
+	gsize start_allocations = sipe_test_allocations;
+	GTimer *timer = g_timer_new();
+	gdouble elapsed;
+	guint i;
+
+	for (i = 0; i < iterations; i++)
+		(void) (*verify)(msg, buffer);
+
+	elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+	g_string_free(buffer, TRUE);
+
+	printf("%-8s %8.0f ns/message %10.0f messages/second %6s allocations/message\n",
+	       label,
+	       elapsed * 1e9 / iterations,
+	       iterations / elapsed,
+	       sipe_test_allocations_per(start_allocations, iterations));
+}
+
+int main(int argc, char *argv[])
+{
+	guint iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000;
+
+	/* must be called before any other GLib function */
+	sipe_test_allocations_init();
+
+	/* Initialization for crypto backend (test mode) */
+	sipe_crypto_init(FALSE);
+
+	/* [MS-SIPAE] example, authentication protocol version 2 */
+	{
+		struct sipmsg *msg = sipmsg_parse_msg("SIP/2.0 200 OK\r\n"
+						      "Authentication-Info: NTLM rspauth=\"0100000000000000BF2E52667DDF6DED\", srand=\"0878F41B\", snum=\"1\", opaque=\"4452DFB0\", qop=\"auth\", targetname=\"ocs1.ocs.provo.novell.com\", realm=\"SIP Communications Service\"\r\n"
+						      "From: \"Gabriel Burt\"<sip:gabriel@ocs.provo.novell.com>;tag=2947328781;epid=1234567890\r\n"
+						      "To: <sip:gabriel@ocs.provo.novell.com>;tag=B816D65C2300A32CFA6D371F2AF537FD\r\n"
+						      "Call-ID: 8592g5DCBa1694i5887m0D0Bt2247b3F38xAE9Fx\r\n"
+						      "CSeq: 3 REGISTER\r\n"
+						      "Expires: 900\r\n"
+						      "Content-Length: 0\r\n"
+						      "\r\n");
+		GString *buffer = g_string_new("");
+
+		sipe_sign_input(buffer, 2, msg, NULL, NULL, NULL, NULL, NULL);
+		assert_string("MS-SIPAE example",
+			      buffer->str,
+			      "<NTLM><0878F41B><1><SIP Communications Service><ocs1.ocs.provo.novell.com><8592g5DCBa1694i5887m0D0Bt2247b3F38xAE9Fx><3><REGISTER><sip:gabriel@ocs.provo.novell.com><2947328781><B816D65C2300A32CFA6D371F2AF537FD><900><200>");
+
+		/* buffer is reused */
+		sipe_sign_input(buffer, 2, msg, NULL, NULL, NULL, "00000001", "2");
+		assert_string("MS-SIPAE example (outgoing)",
+			      buffer->str,
+			      "<NTLM><00000001><2><SIP Communications Service><ocs1.ocs.provo.novell.com><8592g5DCBa1694i5887m0D0Bt2247b3F38xAE9Fx><3><REGISTER><sip:gabriel@ocs.provo.novell.com><2947328781><B816D65C2300A32CFA6D371F2AF537FD><900><200>");
+
+		g_string_free(buffer, TRUE);
+		sipmsg_free(msg);
+	}
+
+	/* compare against legacy implementation */
+	compare_legacy("BENOTIFY", benotify, NULL, NULL);
+	compare_legacy("outgoing request",
+		       "MESSAGE sip:bob@example.com SIP/2.0\r\n"
+		       "From: <sip:alice@example.com>;tag=1234;epid=abcd\r\n"
+		       "To: <sip:bob@example.com>\r\n"
+		       "Call-ID: 0123456789\r\n"
+		       "CSeq: 5 MESSAGE\r\n"
+		       "Content-Length: 0\r\n"
+		       "\r\n",
+		       "DEADBEEF", "42");
+	compare_legacy("outgoing with Proxy-Authorization",
+		       "REGISTER sip:example.com SIP/2.0\r\n"
+		       "Proxy-Authorization: Kerberos qop=\"auth\", realm=\"SIP Communications Service\", opaque=\"1234\", targetname=\"sip/server.example.com\", crand=\"11111111\", cnum=\"1\"\r\n"
+		       "From: <sip:alice@example.com>;tag=1234;epid=abcd\r\n"
+		       "To: <sip:alice@example.com>\r\n"
+		       "Call-ID: 0123456789\r\n"
+		       "CSeq: 2 REGISTER\r\n"
+		       "Content-Length: 0\r\n"
+		       "\r\n",
+		       "DEADBEEF", "42");
+	compare_legacy("P-Asserted-Identity sip & tel",
+		       "SIP/2.0 183 Session Progress\r\n"
+		       "Authentication-Info: NTLM rspauth=\"0100\", srand=\"1B6D47A1\", snum=\"11\", targetname=\"server.example.com\", realm=\"SIP Communications Service\"\r\n"
+		       "From: \"Alice\"<sip:alice@example.com>;tag=1\r\n"
+		       "To: <sip:bob@example.com>;tag=2;epid=3\r\n"
+		       "Call-ID: 0123456789\r\n"
+		       "CSeq: 1 INVITE\r\n"
+		       "P-Asserted-Identity: \"Bob\" <tel:+4912345>, <SIP:bob@example.com>, <sip:other@example.com>\r\n"
+		       "Content-Length: 0\r\n"
+		       "\r\n",
+		       NULL, NULL);
+	compare_legacy("P-Preferred-Identity tel only",
+		       "INVITE sip:bob@example.com SIP/2.0\r\n"
+		       "From: sip:alice@example.com;tag=1\r\n"
+		       "To: sip:bob@example.com\r\n"
+		       "Call-ID: 0123456789\r\n"
+		       "CSeq: 1 INVITE\r\n"
+		       "P-Preferred-Identity: tel:+4912345\r\n"
+		       "Expires: 60\r\n"
+		       "Content-Length: 0\r\n"
+		       "\r\n",
+		       "DEADBEEF", "42");
+	compare_legacy("unterminated values",
+		       "SIP/2.0 200 OK\r\n"
+		       "Authentication-Info: TLS-DSK srand=\"1B6D47A1\", realm=\"SIP Communications Service\", targetname=\"server\r\n"
+		       "From: <sip:alice@example.com;tag=1\r\n"
+		       "To: <sip:bob@example.com>;tag=2\r\n"
+		       "Call-ID: 0123456789\r\n"
+		       "CSeq: 1 REGISTER\r\n"
+		       "Content-Length: 0\r\n"
+		       "\r\n",
+		       NULL, NULL);
+
+	/* no realm -> message can't be signed */
+	{
+		struct sipmsg *msg = sipmsg_parse_msg("OPTIONS sip:bob@example.com SIP/2.0\r\n"
+						      "Call-ID: 0123456789\r\n"
+						      "Content-Length: 0\r\n"
+						      "\r\n");
+		GString *buffer = g_string_new("");
+		gboolean ok = sipe_sign_input(buffer, 4, msg, "NTLM", NULL, NULL, NULL, NULL);
+
+		assert_string("no realm", ok ? buffer->str : NULL, NULL);
+		g_string_free(buffer, TRUE);
+		sipmsg_free(msg);
+	}
+
+	if (iterations) {
+		struct sipmsg *msg = sipmsg_parse_msg(benotify);
+
+		printf("Verifying %u x TLS-DSK signed BENOTIFY:\n", iterations);
+		benchmark("legacy",  msg, iterations, legacy_verify);
+		benchmark("signing", msg, iterations, signing_verify);
+		sipmsg_free(msg);
+	}
+
+	printf("Result: %d PASSED %d FAILED\n", succeeded, failed);
+	return(failed);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
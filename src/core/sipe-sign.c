@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2008 Novell, Inc.
  *
  * This program is free software; you can redistribute it and/or modify
@@ -29,146 +29,199 @@
 #include "sipe-backend.h"
 #include "sipe-sign.h"
 
-static gchar * const empty_string = "";
-
-void sipmsg_breakdown_parse(struct sipmsg_breakdown * msg, gchar * realm, gchar * target,
-			    const gchar *protocol)
+/* span of a header value: not NUL terminated */
+struct sipe_sign_span {
+	const gchar *start;
+	gsize length;
+};
+
+/* empty span if not found, see also sipmsg_find_part_of_header() */
+static void sipe_sign_span_find(struct sipe_sign_span *span,
+				const gchar *hdr,
+				const gchar *before,
+				const gchar *after)
 {
-	const gchar * hdr;
-	if (msg == NULL || msg->msg == NULL) {
-		SIPE_DEBUG_INFO_NOFORMAT("sipmsg_breakdown_parse msg or msg->msg is NULL");
+	const gchar *end;
+
+	span->start  = NULL;
+	span->length = 0;
+
+	if (!hdr)
 		return;
-	}
 
-	msg->rand = msg->num = msg->realm = msg->target_name =
-		msg->cseq = msg->from_url = msg->from_tag = msg->to_url = msg->to_tag =
-		msg->p_assertet_identity_sip_uri = msg->p_assertet_identity_tel_uri = empty_string;
-	msg->call_id = msg->expires = empty_string;
-
-	if ((hdr = sipmsg_find_header(msg->msg, "Proxy-Authorization")) ||
-	    (hdr = sipmsg_find_header(msg->msg, "Proxy-Authentication-Info")) ||
-	    (hdr = sipmsg_find_header(msg->msg, "Authentication-Info")) ) {
-		msg->protocol = sipmsg_find_part_of_header(hdr, NULL, " ", empty_string);
-		msg->rand   = sipmsg_find_part_of_header(hdr, "rand=\"", "\"", empty_string);
-		msg->num    = sipmsg_find_part_of_header(hdr, "num=\"", "\"", empty_string);
-		msg->realm  = sipmsg_find_part_of_header(hdr, "realm=\"", "\"", empty_string);
-		msg->target_name = sipmsg_find_part_of_header(hdr, "targetname=\"", "\"", empty_string);
-	} else {
-		msg->protocol = g_strdup(protocol);
-		msg->realm = g_strdup(realm);
-		msg->target_name = g_strdup(target);
+	if (before) {
+		hdr = strstr(hdr, before);
+		if (!hdr)
+			return;
+		hdr += strlen(before);
 	}
 
-	msg->call_id = sipmsg_find_header(msg->msg, "Call-ID");
+	end = after ? strstr(hdr, after) : NULL;
+	span->start  = hdr;
+	span->length = end ? (gsize) (end - hdr) : strlen(hdr);
+}
 
-	hdr = sipmsg_find_header(msg->msg, "CSeq");
-	if (NULL != hdr) {
-		msg->cseq = sipmsg_find_part_of_header(hdr, NULL, " ", empty_string);
-	}
+/* sip: and tel: URIs, see also sipmsg_parse_p_asserted_identity() */
+static void sipe_sign_span_identity(struct sipe_sign_span *sip_uri,
+				    struct sipe_sign_span *tel_uri,
+				    const gchar *hdr)
+{
+	sip_uri->start  = tel_uri->start  = NULL;
+	sip_uri->length = tel_uri->length = 0;
 
-	hdr = sipmsg_find_header(msg->msg, "From");
-	if (NULL != hdr) {
-		msg->from_url = sipmsg_find_part_of_header(hdr, "<", ">", empty_string);
-		msg->from_tag = sipmsg_find_part_of_header(hdr, ";tag=", ";", empty_string);
-	}
+	if (!hdr)
+		return;
 
-	hdr = sipmsg_find_header(msg->msg, "To");
-	if (NULL != hdr) {
-		msg->to_url = sipmsg_find_part_of_header(hdr, "<", ">", empty_string);
-		msg->to_tag = sipmsg_find_part_of_header(hdr, ";tag=", ";", empty_string);
+	if (g_ascii_strncasecmp(hdr, "tel:", 4) == 0) {
+		tel_uri->start  = hdr;
+		tel_uri->length = strlen(hdr);
+		return;
 	}
 
-	hdr = sipmsg_find_header(msg->msg, "P-Asserted-Identity");
-	if (NULL == hdr) {
-		hdr = sipmsg_find_header(msg->msg, "P-Preferred-Identity");
-	}
-	if (NULL != hdr) {
-		gchar *sip_uri = NULL;
-		gchar *tel_uri = NULL;
-
-		sipmsg_parse_p_asserted_identity(hdr, &sip_uri, &tel_uri);
-		if (sip_uri)
-			msg->p_assertet_identity_sip_uri = sip_uri;
-		if (tel_uri)
-			msg->p_assertet_identity_tel_uri = tel_uri;
+	while (*hdr) {
+		const gchar *comma = strchr(hdr, ',');
+		const gchar *end   = comma ? comma : hdr + strlen(hdr);
+		const gchar *uri   = memchr(hdr, '<', end - hdr);
+
+		if (uri) {
+			const gchar *uri_end;
+			struct sipe_sign_span *span = NULL;
+
+			uri++;
+			uri_end = memchr(uri, '>', end - uri);
+			if (!uri_end)
+				uri_end = end;
+
+			if (uri_end - uri >= 4) {
+				if (g_ascii_strncasecmp(uri, "sip:", 4) == 0)
+					span = sip_uri;
+				else if (g_ascii_strncasecmp(uri, "tel:", 4) == 0)
+					span = tel_uri;
+			}
+
+			/* first URI of each type wins */
+			if (span && !span->start) {
+				span->start  = uri;
+				span->length = uri_end - uri;
+			}
+		}
+
+		if (!comma)
+			break;
+		hdr = comma + 1;
 	}
+}
 
-	msg->expires = sipmsg_find_header(msg->msg, "Expires");
+static void sipe_sign_append(GString *buffer,
+			     const gchar *value)
+{
+	g_string_append_c(buffer, '<');
+	if (value)
+		g_string_append(buffer, value);
+	g_string_append_c(buffer, '>');
 }
 
-void
-sipmsg_breakdown_free(struct sipmsg_breakdown * msg)
+static void sipe_sign_append_span(GString *buffer,
+				  const struct sipe_sign_span *span)
 {
-	if (msg->protocol != empty_string)
-		g_free(msg->protocol);
-	if (msg->rand != empty_string)
-		g_free(msg->rand);
-	if (msg->num != empty_string)
-		g_free(msg->num);
-	if (msg->realm != empty_string)
-		g_free(msg->realm);
-	if (msg->target_name != empty_string)
-		g_free(msg->target_name);
-
-	// straight from header
-	//g_free(msg->call_id);
-
-	if (msg->cseq != empty_string)
-		g_free(msg->cseq);
-	if (msg->from_url != empty_string)
-		g_free(msg->from_url);
-	if (msg->from_tag != empty_string)
-		g_free(msg->from_tag);
-	if (msg->to_url != empty_string)
-		g_free(msg->to_url);
-	if (msg->to_tag != empty_string)
-		g_free(msg->to_tag);
-
-	if (msg->p_assertet_identity_sip_uri != empty_string)
-		g_free(msg->p_assertet_identity_sip_uri);
-	if (msg->p_assertet_identity_tel_uri != empty_string)
-		g_free(msg->p_assertet_identity_tel_uri);
-
-	// straight from header
-	//g_free (msg->expires);
+	g_string_append_c(buffer, '<');
+	g_string_append_len(buffer, span->start, span->length);
+	g_string_append_c(buffer, '>');
 }
 
-gchar *
-sipmsg_breakdown_get_string(int version,
-			    struct sipmsg_breakdown * msgbd)
+gboolean sipe_sign_input(GString *buffer,
+			 int version,
+			 const struct sipmsg *msg,
+			 const gchar *protocol,
+			 const gchar *realm,
+			 const gchar *target,
+			 const gchar *rand,
+			 const gchar *num)
 {
-	gchar *response_str;
-	gchar *msg;
-	if (msgbd->realm == empty_string || msgbd->realm == NULL) {
-		SIPE_DEBUG_INFO_NOFORMAT("realm NULL, so returning NULL signature string");
-		return NULL;
+	struct sipe_sign_span span_protocol, span_rand, span_num;
+	struct sipe_sign_span span_realm, span_target;
+	struct sipe_sign_span from_url, from_tag, to_url, to_tag;
+	const gchar *hdr;
+
+	g_string_truncate(buffer, 0);
+
+	if ((hdr = sipmsg_find_header(msg, "Proxy-Authorization")) ||
+	    (hdr = sipmsg_find_header(msg, "Proxy-Authentication-Info")) ||
+	    (hdr = sipmsg_find_header(msg, "Authentication-Info")) ) {
+		sipe_sign_span_find(&span_protocol, hdr, NULL,            " ");
+		sipe_sign_span_find(&span_rand,     hdr, "rand=\"",       "\"");
+		sipe_sign_span_find(&span_num,      hdr, "num=\"",        "\"");
+		sipe_sign_span_find(&span_realm,    hdr, "realm=\"",      "\"");
+		sipe_sign_span_find(&span_target,   hdr, "targetname=\"", "\"");
+	} else {
+		sipe_sign_span_find(&span_protocol, protocol, NULL, NULL);
+		sipe_sign_span_find(&span_rand,     NULL,     NULL, NULL);
+		sipe_sign_span_find(&span_num,      NULL,     NULL, NULL);
+		sipe_sign_span_find(&span_realm,    realm,    NULL, NULL);
+		sipe_sign_span_find(&span_target,   target,   NULL, NULL);
 	}
 
-	response_str = msgbd->msg->response != 0 ? g_strdup_printf("<%d>", msgbd->msg->response) : empty_string;
-	if (version < 3) {
-		msg = g_strdup_printf(
-			"<%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s>" // 1 - 11
-			"<%s>%s", // 12 - 13
-			msgbd->protocol, msgbd->rand, msgbd->num, msgbd->realm, msgbd->target_name, msgbd->call_id, msgbd->cseq,
-			msgbd->msg->method, msgbd->from_url, msgbd->from_tag, msgbd->to_tag,
-			msgbd->expires ? msgbd->expires : empty_string, response_str
-		);
-	} else {
-		msg = g_strdup_printf(
-			"<%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s><%s>" // 1 - 14
-			"<%s>%s", // 15 - 16
-			msgbd->protocol, msgbd->rand, msgbd->num, msgbd->realm, msgbd->target_name, msgbd->call_id, msgbd->cseq,
-			msgbd->msg->method, msgbd->from_url, msgbd->from_tag, msgbd->to_url, msgbd->to_tag,
-			msgbd->p_assertet_identity_sip_uri, msgbd->p_assertet_identity_tel_uri,
-			msgbd->expires ? msgbd->expires : empty_string, response_str
-		);
+	if (!span_realm.start) {
+		SIPE_DEBUG_INFO_NOFORMAT("sipe_sign_input: realm NULL, so returning NULL signature string");
+		return(FALSE);
 	}
 
-	if (response_str != empty_string) {
-		g_free(response_str);
+	/* values for outgoing message override header */
+	if (rand)
+		sipe_sign_span_find(&span_rand, rand, NULL, NULL);
+	if (num)
+		sipe_sign_span_find(&span_num,  num,  NULL, NULL);
+
+	sipe_sign_append_span(buffer, &span_protocol);
+	sipe_sign_append_span(buffer, &span_rand);
+	sipe_sign_append_span(buffer, &span_num);
+	sipe_sign_append_span(buffer, &span_realm);
+	sipe_sign_append_span(buffer, &span_target);
+	sipe_sign_append(buffer, sipmsg_find_header(msg, "Call-ID"));
+
+	hdr = sipmsg_find_header(msg, "CSeq");
+	{
+		struct sipe_sign_span cseq;
+		sipe_sign_span_find(&cseq, hdr, NULL, " ");
+		sipe_sign_append_span(buffer, &cseq);
+	}
+
+	sipe_sign_append(buffer, msg->method);
+
+	hdr = sipmsg_find_header(msg, "From");
+	sipe_sign_span_find(&from_url, hdr, "<",     ">");
+	sipe_sign_span_find(&from_tag, hdr, ";tag=", ";");
+	hdr = sipmsg_find_header(msg, "To");
+	sipe_sign_span_find(&to_url,   hdr, "<",     ">");
+	sipe_sign_span_find(&to_tag,   hdr, ";tag=", ";");
+
+	sipe_sign_append_span(buffer, &from_url);
+	sipe_sign_append_span(buffer, &from_tag);
+	if (version >= 3)
+		sipe_sign_append_span(buffer, &to_url);
+	sipe_sign_append_span(buffer, &to_tag);
+
+	if (version >= 3) {
+		struct sipe_sign_span sip_uri, tel_uri;
+
+		hdr = sipmsg_find_header(msg, "P-Asserted-Identity");
+		if (!hdr)
+			hdr = sipmsg_find_header(msg, "P-Preferred-Identity");
+		sipe_sign_span_identity(&sip_uri, &tel_uri, hdr);
+
+		sipe_sign_append_span(buffer, &sip_uri);
+		sipe_sign_append_span(buffer, &tel_uri);
+	}
+
+	sipe_sign_append(buffer, sipmsg_find_header(msg, "Expires"));
+
+	if (msg->response != 0) {
+		gchar response[16];
+		g_snprintf(response, sizeof(response), "%d", msg->response);
+		sipe_sign_append(buffer, response);
 	}
 
-	return msg;
+	return(TRUE);
 }
 
 /*
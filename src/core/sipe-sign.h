@@ -3,6 +3,7 @@
  *
  * pidgin-sipe
  *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2008 Novell, Inc.
  *
  * This program is free software; you can redistribute it and/or modify
@@ -20,32 +21,38 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
  */
 
-struct sipmsg_breakdown {
-	struct sipmsg * msg;
-	gchar * protocol;
-	gchar * rand;
-	gchar * num;
-	gchar * realm;
-	gchar * target_name;
-	const gchar * call_id;
-	gchar * cseq;
-	//method
-	gchar * from_url;
-	gchar * from_tag;
-	/** @since 3 */
-	gchar * to_url;
-	gchar * to_tag;
-	/** @since 3 */
-	gchar * p_assertet_identity_sip_uri;
-	/** @since 3 */
-	gchar * p_assertet_identity_tel_uri;
-	const gchar * expires;
-	//response code
-};
+/*
+ * Interface dependencies:
+ *
+ * <glib.h>
+ */
+
+/* Forward declarations */
+struct sipmsg;
 
-void sipmsg_breakdown_parse(struct sipmsg_breakdown * msg, gchar * realm, gchar * target,
-			    const gchar *protocol);
-gchar*
-sipmsg_breakdown_get_string(int version,
-			    struct sipmsg_breakdown * msgbd);
-void sipmsg_breakdown_free(struct sipmsg_breakdown * msg);
+/**
+ * Create signature input string for SIP message ([MS-SIPAE] 3.2.5.5.3)
+ *
+ * The fields are copied directly from the message headers into @c buffer,
+ * i.e. no memory is allocated if the buffer is already large enough.
+ *
+ * @param buffer   signature input is written to this buffer (it is
+ *                 truncated first). Should be reused for all messages.
+ * @param version  authentication protocol version
+ * @param msg      parsed SIP message
+ * @param protocol protocol if message has no authentication header
+ * @param realm    realm if message has no authentication header
+ * @param target   target name if message has no authentication header
+ * @param rand     random value (may be @c NULL: take from header)
+ * @param num      sequence number (may be @c NULL: take from header)
+ *
+ * @return @c FALSE if the message can't be signed, i.e. realm is unknown
+ */
+gboolean sipe_sign_input(GString *buffer,
+			 int version,
+			 const struct sipmsg *msg,
+			 const gchar *protocol,
+			 const gchar *realm,
+			 const gchar *target,
+			 const gchar *rand,
+			 const gchar *num);
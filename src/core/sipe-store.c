@@ -0,0 +1,195 @@
+/**
+ * @file sipe-store.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "sipe-common.h"
+#include "sipe-backend.h"
+#include "sipe-core.h"
+#include "sipe-core-private.h"
+#include "sipe-crypt.h"
+#include "sipe-digest.h"
+#include "sipe-store.h"
+#include "sipe-tls.h"
+#include "sipe-utils.h"
+
+#define STORE_HEADER_LENGTH (SIPE_STORE_MAGIC_LENGTH + SIPE_CRYPT_AEAD_IV_LENGTH)
+
+guchar *sipe_store_key(struct sipe_core_private *sipe_private,
+		       const gchar *name)
+{
+	gchar *secret = sipe_backend_secret_get(SIPE_CORE_PUBLIC, name);
+	guchar *key   = NULL;
+
+	if (secret) {
+		if (hex_str_to_buff(secret, &key) != SIPE_CRYPT_AEAD_KEY_LENGTH) {
+			SIPE_DEBUG_ERROR("sipe_store_key: invalid key '%s', creating a new one",
+					 name);
+			g_free(key);
+			key = NULL;
+		}
+		memset(secret, 0, strlen(secret));
+		g_free(secret);
+	}
+
+	if (!key) {
+		struct sipe_tls_random random;
+
+		sipe_tls_fill_random(&random, SIPE_CRYPT_AEAD_KEY_LENGTH * 8);
+		secret = buff_to_hex_str(random.buffer, SIPE_CRYPT_AEAD_KEY_LENGTH);
+		if (sipe_backend_secret_set(SIPE_CORE_PUBLIC, name, secret)) {
+			key = g_memdup(random.buffer, SIPE_CRYPT_AEAD_KEY_LENGTH);
+		} else {
+			SIPE_DEBUG_INFO("sipe_store_key: backend can't keep secrets, store for '%s' disabled",
+					name);
+		}
+		memset(secret, 0, strlen(secret));
+		g_free(secret);
+		memset(random.buffer, 0, random.length);
+		sipe_tls_free_random(&random);
+	}
+
+	return(key);
+}
+
+void sipe_store_key_free(guchar *key)
+{
+	if (key) {
+		memset(key, 0, SIPE_CRYPT_AEAD_KEY_LENGTH);
+		g_free(key);
+	}
+}
+
+gchar *sipe_store_filename(struct sipe_core_private *sipe_private,
+			   const gchar *prefix)
+{
+	guchar digest[SIPE_DIGEST_SHA1_LENGTH];
+	gchar *runtime_dir = sipe_utils_get_user_runtime_dir();
+	gchar *account;
+	gchar *filename;
+
+	/* don't expose the account name in the file system */
+	sipe_digest_sha1((guchar *) sipe_private->username,
+			 strlen(sipe_private->username),
+			 digest);
+	account  = buff_to_hex_str(digest, sizeof(digest));
+	filename = g_strdup_printf("%s/%s-%s.cache",
+				   runtime_dir,
+				   prefix,
+				   account);
+	g_free(account);
+	g_free(runtime_dir);
+
+	return(filename);
+}
+
+void sipe_store_save(const gchar *filename,
+		     const gchar *magic,
+		     const guchar *key,
+		     const gchar *data,
+		     gsize length)
+{
+	gsize size = STORE_HEADER_LENGTH + length + SIPE_CRYPT_AEAD_TAG_LENGTH;
+	guchar *buffer = g_malloc(size);
+	struct sipe_tls_random iv;
+	GError *error = NULL;
+
+	/* GCM: IV must never be reused with the same key */
+	sipe_tls_fill_random(&iv, SIPE_CRYPT_AEAD_IV_LENGTH * 8);
+	memcpy(buffer, magic, SIPE_STORE_MAGIC_LENGTH);
+	memcpy(buffer + SIPE_STORE_MAGIC_LENGTH, iv.buffer, SIPE_CRYPT_AEAD_IV_LENGTH);
+	sipe_tls_free_random(&iv);
+
+	if (!sipe_crypt_aead_encrypt(key,
+				     buffer + SIPE_STORE_MAGIC_LENGTH,
+				     buffer, SIPE_STORE_MAGIC_LENGTH,
+				     (const guchar *) data, length,
+				     buffer + STORE_HEADER_LENGTH)) {
+		SIPE_DEBUG_ERROR("sipe_store_save: encryption for '%s' failed",
+				 filename);
+	} else if (!g_file_set_contents(filename,
+					/* runtime dir is private to the user */
+					(gchar *) buffer,
+					size,
+					&error)) {
+		SIPE_DEBUG_ERROR("sipe_store_save: can't write '%s': %s",
+				 filename, error->message);
+		g_error_free(error);
+	}
+
+	g_free(buffer);
+}
+
+gchar *sipe_store_load(const gchar *filename,
+		       const gchar *magic,
+		       const guchar *key)
+{
+	gchar *buffer;
+	gsize size;
+	gchar *data = NULL;
+
+	if (!g_file_get_contents(filename, &buffer, &size, NULL))
+		return(NULL);
+
+	if ((size < STORE_HEADER_LENGTH + SIPE_CRYPT_AEAD_TAG_LENGTH) ||
+	    memcmp(buffer, magic, SIPE_STORE_MAGIC_LENGTH)) {
+		SIPE_DEBUG_ERROR("sipe_store_load: '%s' has an unknown format",
+				 filename);
+	} else {
+		gsize length = size - STORE_HEADER_LENGTH - SIPE_CRYPT_AEAD_TAG_LENGTH;
+
+		data = g_malloc(length + 1);
+		if (sipe_crypt_aead_decrypt(key,
+					    (guchar *) buffer + SIPE_STORE_MAGIC_LENGTH,
+					    (guchar *) buffer, SIPE_STORE_MAGIC_LENGTH,
+					    (guchar *) buffer + STORE_HEADER_LENGTH,
+					    length + SIPE_CRYPT_AEAD_TAG_LENGTH,
+					    (guchar *) data)) {
+			data[length] = '\0';
+		} else {
+			SIPE_DEBUG_INFO("sipe_store_load: '%s' is corrupted or was written with another key",
+					filename);
+			g_free(data);
+			data = NULL;
+		}
+	}
+	g_free(buffer);
+
+	/* unusable store: remove it */
+	if (!data)
+		(void) g_remove(filename);
+
+	return(data);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
@@ -0,0 +1,114 @@
+/**
+ * @file sipe-store.h
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Encrypted per-account store files in the user runtime directory
+ *
+ * File layout:
+ *
+ *   magic (8) | IV (12) | AES-256-GCM(data) | tag (16)
+ *
+ * The key is random and kept by the backend with the other secrets of the
+ * account, never in the store file itself. Nothing in the file is derived
+ * from the account password.
+ */
+
+/*
+ * Interface dependencies:
+ *
+ * <glib.h>
+ */
+
+/* Forward declarations */
+struct sipe_core_private;
+
+#define SIPE_STORE_MAGIC_LENGTH 8
+
+/**
+ * Get store key from backend, create a new one if necessary
+ *
+ * @param sipe_private SIPE core private data
+ * @param name         name of the backend secret
+ *
+ * @return key or @c NULL if the backend can't keep secrets, i.e. the
+ *         store should be disabled. Must be @c sipe_store_key_free()'d.
+ */
+guchar *sipe_store_key(struct sipe_core_private *sipe_private,
+		       const gchar *name);
+
+/**
+ * Wipe & free store key
+ *
+ * @param key from @c sipe_store_key(). May be @c NULL
+ */
+void sipe_store_key_free(guchar *key);
+
+/**
+ * Store file name for the account
+ *
+ * @param sipe_private SIPE core private data
+ * @param prefix       prefix of the file name, e.g. "webticket"
+ *
+ * @return file name. Must be @c g_free()'d.
+ */
+gchar *sipe_store_filename(struct sipe_core_private *sipe_private,
+			   const gchar *prefix);
+
+/**
+ * Encrypt data and write it to the store file
+ *
+ * @param filename from @c sipe_store_filename()
+ * @param magic    @c SIPE_STORE_MAGIC_LENGTH bytes file magic
+ * @param key      from @c sipe_store_key()
+ * @param data     data to store
+ * @param length   length of data
+ */
+void sipe_store_save(const gchar *filename,
+		     const gchar *magic,
+		     const guchar *key,
+		     const gchar *data,
+		     gsize length);
+
+/**
+ * Read store file and decrypt data
+ *
+ * An unusable store file, e.g. one written with another key, is removed.
+ *
+ * @param filename from @c sipe_store_filename()
+ * @param magic    @c SIPE_STORE_MAGIC_LENGTH bytes file magic
+ * @param key      from @c sipe_store_key()
+ *
+ * @return NUL terminated data or @c NULL. Must be @c g_free()'d.
+ */
+gchar *sipe_store_load(const gchar *filename,
+		       const gchar *magic,
+		       const guchar *key);
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
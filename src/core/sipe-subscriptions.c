@@ -49,6 +49,48 @@ struct sip_subscription {
 	GSList *buddies; /* batched subscriptions */
 };
 
+/*
+ * Initial presence subscription scheduler
+ *
+ * The buddy list is split into batches, i.e. batched SUBSCRIBEs with up to
+ * batch_size resources or single SUBSCRIBEs if the server doesn't support
+ * adhoclist. At most "window" SUBSCRIBEs are in flight at any time.
+ *
+ * Fast responses grow the batch size & window, slow responses shrink them.
+ * On server pushback (408, 480, 5xx, transaction timeout) the batch is
+ * queued again and sending is suspended for Retry-After seconds.
+ */
+#define PRESENCE_BATCH_SIZE_MIN        10
+#define PRESENCE_BATCH_SIZE_INITIAL   100
+#define PRESENCE_BATCH_SIZE_MAX      1000
+#define PRESENCE_WINDOW_INITIAL         2
+#define PRESENCE_WINDOW_MAX             8
+#define PRESENCE_RESPONSE_FAST        500 /* [ms] */
+#define PRESENCE_RESPONSE_SLOW       3000 /* [ms] */
+#define PRESENCE_RETRY_AFTER           10 /* [s] default   */
+#define PRESENCE_RETRY_AFTER_MAX      300 /* [s] upper limit */
+#define PRESENCE_RETRIES_MAX            5 /* consecutive pushbacks */
+#define PRESENCE_TIMEOUT               60 /* [s] */
+#define PRESENCE_SCHEDULER_ACTION "<+presence-scheduler>"
+
+struct sipe_presence_scheduler {
+	GQueue pending;      /* gchar *: URIs waiting to be subscribed */
+	guint inflight;      /* URIs in SUBSCRIBEs without response */
+	guint failed;        /* URIs which couldn't be subscribed */
+	guint requests;      /* SUBSCRIBEs without response */
+	guint batch_size;
+	guint window;
+	guint retries;       /* consecutive pushbacks */
+	gboolean suspended;  /* waiting for Retry-After */
+};
+
+/* transaction payload */
+struct presence_batch {
+	GSList *uris;        /* gchar * */
+	guint count;
+	gint64 sent;         /* monotonic time [us] */
+};
+
 static void sipe_subscription_free(struct sip_subscription *subscription)
 {
 
@@ -61,12 +103,30 @@ static void sipe_subscription_free(struct sip_subscription *subscription)
 	sipe_dialog_free((struct sip_dialog *) subscription);
 }
 
+static void sipe_presence_scheduler_reset(struct sipe_presence_scheduler *scheduler)
+{
+	gchar *uri;
+
+	while ((uri = g_queue_pop_head(&scheduler->pending)) != NULL)
+		g_free(uri);
+	scheduler->inflight   = 0;
+	scheduler->failed     = 0;
+	scheduler->requests   = 0;
+	scheduler->batch_size = PRESENCE_BATCH_SIZE_INITIAL;
+	scheduler->window     = PRESENCE_WINDOW_INITIAL;
+	scheduler->retries    = 0;
+	scheduler->suspended  = FALSE;
+}
+
 void sipe_subscriptions_init(struct sipe_core_private *sipe_private)
 {
 	sipe_private->subscriptions = g_hash_table_new_full(g_str_hash,
 							    g_str_equal,
 							    g_free,
 							    (GDestroyNotify)sipe_subscription_free);
+	sipe_private->presence_scheduler = g_new0(struct sipe_presence_scheduler, 1);
+	g_queue_init(&sipe_private->presence_scheduler->pending);
+	sipe_presence_scheduler_reset(sipe_private->presence_scheduler);
 }
 
 static void sipe_unsubscribe_cb(SIPE_UNUSED_PARAMETER gpointer key,
@@ -107,6 +167,8 @@ void sipe_subscriptions_unsubscribe(struct sipe_core_private *sipe_private)
 void sipe_subscriptions_destroy(struct sipe_core_private *sipe_private)
 {
 	g_hash_table_destroy(sipe_private->subscriptions);
+	sipe_presence_scheduler_reset(sipe_private->presence_scheduler);
+	g_free(sipe_private->presence_scheduler);
 }
 
 static void sipe_subscription_remove(struct sipe_core_private *sipe_private,
@@ -137,6 +199,23 @@ static gchar *sipe_subscription_key(const gchar *event,
 		return(g_strdup_printf("<%s>", event));
 }
 
+/**
+ * Generate subscription key for a scheduled presence batch
+ *
+ * All batches are sent to our own URI, but each of them creates a new
+ * dialog. They are therefore identified by <presence><uri><Call-ID>.
+ *
+ * @param uri    presence URI (must not by @c NULL)
+ * @param callid Call-ID of the batch dialog (must not by @c NULL)
+ *
+ * @return key string. Must be g_free()'d after use.
+ */
+static gchar *sipe_subscription_batch_key(const gchar *uri,
+					  const gchar *callid)
+{
+	return(g_strdup_printf("<presence><%s><%s>", uri, callid));
+}
+
 static struct sip_dialog *sipe_subscribe_dialog(struct sipe_core_private *sipe_private,
 						const gchar *key)
 {
@@ -148,10 +227,17 @@ static struct sip_dialog *sipe_subscribe_dialog(struct sipe_core_private *sipe_p
 
 static void sipe_subscription_expiration(struct sipe_core_private *sipe_private,
 					 struct sipmsg *msg,
-					 const gchar *event);
-static gboolean process_subscribe_response(struct sipe_core_private *sipe_private,
-					   struct sipmsg *msg,
-					   struct transaction *trans)
+					 const gchar *event,
+					 const gchar *key);
+
+/**
+ * @param scheduled TRUE for responses to batched SUBSCRIBEs from the
+ *                  presence scheduler. They are stored with a batch key.
+ */
+static void sipe_subscription_response(struct sipe_core_private *sipe_private,
+				       struct sipmsg *msg,
+				       struct transaction *trans,
+				       gboolean scheduled)
 {
 	const gchar *event = sipmsg_find_header(msg, "Event");
 
@@ -165,8 +251,22 @@ static gboolean process_subscribe_response(struct sipe_core_private *sipe_privat
 		gchar *with = parse_from(sipmsg_find_header(msg, "To"));
 		const gchar *subscription_state = sipmsg_find_header(msg, "subscription-state");
 		gboolean terminated = subscription_state && strstr(subscription_state, "terminated");
+		const gchar *callid = sipmsg_find_header(msg, "Call-ID");
 		gchar *key = sipe_subscription_key(event, with);
 
+		/* dialog of a scheduled presence batch? */
+		if (callid && sipe_strcase_equal(event, "presence")) {
+			gchar *batch_key = sipe_subscription_batch_key(with, callid);
+
+			if (scheduled ||
+			    g_hash_table_lookup(sipe_private->subscriptions, batch_key)) {
+				g_free(key);
+				key = batch_key;
+			} else {
+				g_free(batch_key);
+			}
+		}
+
 		/*
 		 * @TODO: does the server send this only for one-off
 		 *        subscriptions, i.e. the ones which anyway
@@ -220,11 +320,10 @@ static gboolean process_subscribe_response(struct sipe_core_private *sipe_privat
 						key);
 
 				g_hash_table_insert(sipe_private->subscriptions,
-						    key,
+						    g_strdup(key),
 						    subscription);
-				key = NULL; /* table takes ownership of key */
 
-				subscription->dialog.callid = g_strdup(sipmsg_find_header(msg, "Call-ID"));
+				subscription->dialog.callid = g_strdup(callid);
 				subscription->dialog.cseq   = sipmsg_parse_cseq(msg);
 				subscription->dialog.with   = g_strdup(with);
 				subscription->event         = g_strdup(event);
@@ -234,7 +333,7 @@ static gboolean process_subscribe_response(struct sipe_core_private *sipe_privat
 
 			sipe_dialog_parse(dialog, msg, TRUE);
 
-			sipe_subscription_expiration(sipe_private, msg, event);
+			sipe_subscription_expiration(sipe_private, msg, event, key);
 		}
 		g_free(key);
 		g_free(with);
@@ -242,7 +341,13 @@ static gboolean process_subscribe_response(struct sipe_core_private *sipe_privat
 
 	if (sipmsg_find_header(msg, "ms-piggyback-cseq"))
 		process_incoming_notify(sipe_private, msg);
+}
 
+static gboolean process_subscribe_response(struct sipe_core_private *sipe_private,
+					   struct sipmsg *msg,
+					   struct transaction *trans)
+{
+	sipe_subscription_response(sipe_private, msg, trans, FALSE);
 	return(TRUE);
 }
 
@@ -442,7 +547,7 @@ static void sipe_presence_timeout_mime_cb(gpointer user_data,
 		}
 
 		if (uri) {
-			*buddies = g_slist_append(*buddies, sip_uri(uri));
+			*buddies = g_slist_prepend(*buddies, sip_uri(uri));
 		}
 	}
 
@@ -453,14 +558,16 @@ static void sipe_subscribe_presence_batched_schedule(struct sipe_core_private *s
 						     const gchar *action_name,
 						     const gchar *who,
 						     GSList *buddies,
-						     int timeout);
+						     int timeout,
+						     guint slack);
 static void sipe_process_presence_timeout(struct sipe_core_private *sipe_private,
 					  struct sipmsg *msg,
 					  const gchar *who,
-					  int timeout)
+					  const gchar *action_name,
+					  int timeout,
+					  guint slack)
 {
 	const char *ctype = sipmsg_find_header(msg, "Content-Type");
-	gchar *action_name = sipe_utils_presence_key(who);
 
 	SIPE_DEBUG_INFO("sipe_process_presence_timeout: Content-Type: %s", ctype ? ctype : "");
 
@@ -471,24 +578,26 @@ static void sipe_process_presence_timeout(struct sipe_core_private *sipe_private
 		GSList *buddies = NULL;
 
 		sipe_mime_parts_foreach(ctype, msg->body, sipe_presence_timeout_mime_cb, &buddies);
+		buddies = g_slist_reverse(buddies);
 
 		if (buddies)
 			sipe_subscribe_presence_batched_schedule(sipe_private,
 								 action_name,
 								 who,
 								 buddies,
-								 timeout);
+								 timeout,
+								 slack);
 
 	} else {
-		sipe_schedule_seconds(sipe_private,
-				      action_name,
-				      g_strdup(who),
-				      timeout,
-				      sipe_subscribe_presence_single_cb,
-				      g_free);
+		sipe_schedule_coalesce(sipe_private,
+				       action_name,
+				       g_strdup(who),
+				       timeout,
+				       slack,
+				       sipe_subscribe_presence_single_cb,
+				       g_free);
 		SIPE_DEBUG_INFO("Resubscription single contact with batched support(%s) in %d seconds", who, timeout);
 	}
-	g_free(action_name);
 }
 
 /**
@@ -507,24 +616,120 @@ void sipe_subscribe_conference(struct sipe_core_private *sipe_private,
 		       NULL);
 }
 
+/**
+ * Presence subscription body builder
+ *
+ * OCS2007: batchSub with adhocList & categoryList [MS-PRES]
+ * OCS2005: adhoclist [MS-SIP]
+ *
+ * The body is built in place with one buffer that is sized up front from
+ * the number of resources, i.e. the cost is linear in the number of buddies.
+ */
+#define PRESENCE_BODY_SIZE     512 /* header & trailer */
+#define PRESENCE_RESOURCE_SIZE  64 /* one <resource> with an average URI */
+
+static GString *sipe_subscribe_presence_body_new(struct sipe_core_private *sipe_private,
+						 guint resources)
+{
+	GString *body = g_string_sized_new(PRESENCE_BODY_SIZE +
+					   resources * PRESENCE_RESOURCE_SIZE);
+
+	if (SIPE_CORE_PRIVATE_FLAG_IS(OCS2007))
+		g_string_append_printf(body,
+				       "<batchSub xmlns=\"http://schemas.microsoft.com/2006/01/sip/batch-subscribe\" uri=\"sip:%s\" name=\"\">\n"
+				       "<action name=\"subscribe\" id=\"63792024\">\n"
+				       "<adhocList>\n",
+				       sipe_private->username);
+	else
+		g_string_append_printf(body,
+				       "<adhoclist xmlns=\"urn:ietf:params:xml:ns:adrl\" uri=\"sip:%s\" name=\"sip:%s\">\n"
+				       "<create xmlns=\"\">\n",
+				       sipe_private->username,
+				       sipe_private->username);
+
+	return(body);
+}
+
+static void sipe_subscribe_presence_body_add(GString *body,
+					     const gchar *uri,
+					     gboolean context)
+{
+	g_string_append(body, "<resource uri=\"");
+	g_string_append(body, uri);
+	g_string_append(body, context ? "\"><context/></resource>\n" : "\"/>\n");
+}
+
+static gchar *sipe_subscribe_presence_body_finish(struct sipe_core_private *sipe_private,
+						  GString *body)
+{
+	if (SIPE_CORE_PRIVATE_FLAG_IS(OCS2007))
+		g_string_append(body,
+				"</adhocList>\n"
+				"<categoryList xmlns=\"http://schemas.microsoft.com/2006/09/sip/categorylist\">\n"
+				"<category name=\"calendarData\"/>\n"
+				"<category name=\"contactCard\"/>\n"
+				"<category name=\"note\"/>\n"
+				"<category name=\"state\"/>\n"
+				"</categoryList>\n"
+				"</action>\n"
+				"</batchSub>");
+	else
+		g_string_append(body,
+				"</create>\n"
+				"</adhoclist>\n");
+
+	return(g_string_free(body, FALSE));
+}
+
+static gboolean process_presence_scheduler_response(struct sipe_core_private *sipe_private,
+						    struct sipmsg *msg,
+						    struct transaction *trans);
+static gboolean process_presence_scheduler_timeout(struct sipe_core_private *sipe_private,
+						   struct sipmsg *msg,
+						   struct transaction *trans);
+
 /**
  * code for presence subscription
+ *
+ * @param key       subscription key of the dialog. @c NULL for <presence><uri>
+ * @param scheduled TRUE for SUBSCRIBEs from the presence scheduler. They
+ *                  always create a new dialog.
  */
-static void sipe_subscribe_presence_buddy(struct sipe_core_private *sipe_private,
-					  const gchar *uri,
-					  const gchar *request,
-					  const gchar *body)
+static struct transaction *sipe_subscribe_presence_buddy(struct sipe_core_private *sipe_private,
+							 const gchar *uri,
+							 const gchar *key,
+							 const gchar *request,
+							 const gchar *body,
+							 gboolean scheduled)
 {
-	gchar *key = sipe_utils_presence_key(uri);
+	struct transaction *trans = NULL;
+
+	if (scheduled) {
+		trans = sip_transport_request_timeout(sipe_private,
+						      "SUBSCRIBE",
+						      uri,
+						      uri,
+						      request,
+						      body,
+						      NULL,
+						      process_presence_scheduler_response,
+						      PRESENCE_TIMEOUT,
+						      process_presence_scheduler_timeout);
+	} else {
+		gchar *presence_key = key ? NULL : sipe_utils_presence_key(uri);
 
-	sip_transport_subscribe(sipe_private,
-				uri,
-				request,
-				body,
-				sipe_subscribe_dialog(sipe_private, key),
-				process_subscribe_response);
+		sip_transport_subscribe(sipe_private,
+					uri,
+					request,
+					body,
+					sipe_subscribe_dialog(sipe_private,
+							      key ? key : presence_key),
+					process_subscribe_response);
 
-	g_free(key);
+		g_free(presence_key);
+	}
+
+	return(trans);
 }
 
 /**
@@ -538,10 +743,12 @@ static void sipe_subscribe_presence_buddy(struct sipe_core_private *sipe_private
  * The To-URI and the URI listed in the resource list MUST be the same for a single category SUBSCRIBE request.
  *
  */
-void sipe_subscribe_presence_single(struct sipe_core_private *sipe_private,
-				    const gchar *uri,
-				    const gchar *to)
+static struct transaction *sipe_subscribe_presence_single_to(struct sipe_core_private *sipe_private,
+							     const gchar *uri,
+							     const gchar *to,
+							     gboolean scheduled)
 {
+	struct transaction *trans;
 	gchar *self = NULL;
 	gchar *contact = get_contact(sipe_private);
 	gchar *request;
@@ -552,22 +759,13 @@ void sipe_subscribe_presence_single(struct sipe_core_private *sipe_private,
 							   uri);
 
 	if (SIPE_CORE_PRIVATE_FLAG_IS(OCS2007)) {
+		GString *body = sipe_subscribe_presence_body_new(sipe_private, 1);
+
+		sipe_subscribe_presence_body_add(body,
+						 uri,
+						 sbuddy && sbuddy->just_added);
 		content_type = "Content-Type: application/msrtc-adrl-categorylist+xml\r\n";
-		content = g_strdup_printf("<batchSub xmlns=\"http://schemas.microsoft.com/2006/01/sip/batch-subscribe\" uri=\"sip:%s\" name=\"\">\n"
-					  "<action name=\"subscribe\" id=\"63792024\"><adhocList>\n"
-					  "<resource uri=\"%s\"%s\n"
-					  "</adhocList>\n"
-					  "<categoryList xmlns=\"http://schemas.microsoft.com/2006/09/sip/categorylist\">\n"
-					  "<category name=\"calendarData\"/>\n"
-					  "<category name=\"contactCard\"/>\n"
-					  "<category name=\"note\"/>\n"
-					  "<category name=\"state\"/>\n"
-					  "</categoryList>\n"
-					  "</action>\n"
-					  "</batchSub>",
-					  sipe_private->username,
-					  uri,
-					  sbuddy && sbuddy->just_added ? "><context/></resource>" : "/>");
+		content = sipe_subscribe_presence_body_finish(sipe_private, body);
 		if (!to) {
 			additional = "Require: adhoclist, categoryList\r\n" \
 				     "Supported: eventlist\r\n";
@@ -594,11 +792,21 @@ void sipe_subscribe_presence_single(struct sipe_core_private *sipe_private,
 				  contact);
 	g_free(contact);
 
-	sipe_subscribe_presence_buddy(sipe_private, to, request, content);
+	trans = sipe_subscribe_presence_buddy(sipe_private, to, NULL, request, content,
+					      scheduled);
 
 	g_free(content);
 	g_free(self);
 	g_free(request);
+
+	return(trans);
+}
+
+void sipe_subscribe_presence_single(struct sipe_core_private *sipe_private,
+				    const gchar *uri,
+				    const gchar *to)
+{
+	sipe_subscribe_presence_single_to(sipe_private, uri, to, FALSE);
 }
 
 void sipe_subscribe_presence_single_cb(struct sipe_core_private *sipe_private,
@@ -615,13 +823,16 @@ void sipe_subscribe_presence_single_cb(struct sipe_core_private *sipe_private,
  *   A batch category SUBSCRIBE request MUST have the same To-URI and From-URI.
  *   This header will be send only if adhoclist there is a "Supported: adhoclist" in REGISTER answer else will be send a Single Category SUBSCRIBE
  */
-static void sipe_subscribe_presence_batched_to(struct sipe_core_private *sipe_private,
-					       gchar *resources_uri,
-					       const gchar *to)
+static struct transaction *sipe_subscribe_presence_batched_to(struct sipe_core_private *sipe_private,
+							      GString *body,
+							      const gchar *to,
+							      const gchar *key,
+							      gboolean scheduled)
 {
+	struct transaction *trans;
 	gchar *contact = get_contact(sipe_private);
 	gchar *request;
-	gchar *content;
+	gchar *content = sipe_subscribe_presence_body_finish(sipe_private, body);
 	const gchar *require = "";
 	const gchar *accept = "";
 	const gchar *autoextend = "";
@@ -631,30 +842,10 @@ static void sipe_subscribe_presence_batched_to(struct sipe_core_private *sipe_pr
 		require = ", categoryList";
 		accept = ", application/msrtc-event-categories+xml, application/xpidf+xml, application/pidf+xml";
                 content_type = "application/msrtc-adrl-categorylist+xml";
-                content = g_strdup_printf("<batchSub xmlns=\"http://schemas.microsoft.com/2006/01/sip/batch-subscribe\" uri=\"sip:%s\" name=\"\">\n"
-					  "<action name=\"subscribe\" id=\"63792024\">\n"
-					  "<adhocList>\n%s</adhocList>\n"
-					  "<categoryList xmlns=\"http://schemas.microsoft.com/2006/09/sip/categorylist\">\n"
-					  "<category name=\"calendarData\"/>\n"
-					  "<category name=\"contactCard\"/>\n"
-					  "<category name=\"note\"/>\n"
-					  "<category name=\"state\"/>\n"
-					  "</categoryList>\n"
-					  "</action>\n"
-					  "</batchSub>",
-					  sipe_private->username,
-					  resources_uri);
 	} else {
                 autoextend =  "Supported: com.microsoft.autoextend\r\n";
 		content_type = "application/adrl+xml";
-        	content = g_strdup_printf("<adhoclist xmlns=\"urn:ietf:params:xml:ns:adrl\" uri=\"sip:%s\" name=\"sip:%s\">\n"
-					  "<create xmlns=\"\">\n%s</create>\n"
-					  "</adhoclist>\n",
-					  sipe_private->username,
-					  sipe_private->username,
-					  resources_uri);
 	}
-	g_free(resources_uri);
 
 	request = g_strdup_printf("Require: adhoclist%s\r\n"
 				  "Supported: eventlist\r\n"
@@ -672,14 +863,18 @@ static void sipe_subscribe_presence_batched_to(struct sipe_core_private *sipe_pr
 				  contact);
 	g_free(contact);
 
-	sipe_subscribe_presence_buddy(sipe_private, to, request, content);
+	trans = sipe_subscribe_presence_buddy(sipe_private, to, key, request, content,
+					      scheduled);
 
 	g_free(content);
 	g_free(request);
+
+	return(trans);
 }
 
 struct presence_batched_routed {
 	gchar  *host;
+	gchar  *key;                 /* subscription key, NULL for <presence><host> */
 	const GSList *buddies; /* points to subscription->buddies */
 };
 
@@ -687,6 +882,7 @@ static void sipe_subscribe_presence_batched_routed_free(gpointer payload)
 {
 	struct presence_batched_routed *data = payload;
 	g_free(data->host);
+	g_free(data->key);
 	g_free(payload);
 }
 
@@ -695,23 +891,25 @@ static void sipe_subscribe_presence_batched_routed(struct sipe_core_private *sip
 {
 	struct presence_batched_routed *data = payload;
 	const GSList *buddies = data->buddies;
-	gchar *resources_uri = g_strdup("");
+	GString *body = sipe_subscribe_presence_body_new(sipe_private,
+							 g_slist_length((GSList *) buddies));
 	while (buddies) {
-		gchar *tmp = resources_uri;
-		resources_uri = g_strdup_printf("%s<resource uri=\"%s\"/>\n", tmp, (char *) buddies->data);
-		g_free(tmp);
+		sipe_subscribe_presence_body_add(body, buddies->data, FALSE);
 		buddies = buddies->next;
 	}
 	sipe_subscribe_presence_batched_to(sipe_private,
-					   resources_uri,
-					   data->host);
+					   body,
+					   data->host,
+					   data->key,
+					   FALSE);
 }
 
 static void sipe_subscribe_presence_batched_schedule(struct sipe_core_private *sipe_private,
 						     const gchar *action_name,
 						     const gchar *who,
 						     GSList *buddies,
-						     int timeout)
+						     int timeout,
+						     guint slack)
 {
 	struct sip_subscription *subscription = g_hash_table_lookup(sipe_private->subscriptions,
 								    action_name);
@@ -734,68 +932,241 @@ static void sipe_subscribe_presence_batched_schedule(struct sipe_core_private *s
 	}
 
 	payload->host    = g_strdup(who);
+	payload->key     = g_strdup(action_name);
 	payload->buddies = subscription->buddies;
-	sipe_schedule_seconds(sipe_private,
-			      action_name,
-			      payload,
-			      timeout,
-			      sipe_subscribe_presence_batched_routed,
-			      sipe_subscribe_presence_batched_routed_free);
+	sipe_schedule_coalesce(sipe_private,
+			       action_name,
+			       payload,
+			       timeout,
+			       slack,
+			       sipe_subscribe_presence_batched_routed,
+			       sipe_subscribe_presence_batched_routed_free);
 	SIPE_DEBUG_INFO("Resubscription multiple contacts with batched support & route(%s) in %d", who, timeout);
 }
 
-static void sipe_subscribe_resource_uri_with_context(const gchar *name,
-						     gpointer value,
-						     gchar **resources_uri)
+static void presence_batch_free(gpointer data)
 {
-	struct sipe_buddy *sbuddy = (struct sipe_buddy *)value;
-	gchar *context = sbuddy && sbuddy->just_added ? "><context/></resource>" : "/>";
-	gchar *tmp = *resources_uri;
+	struct presence_batch *batch = data;
+	sipe_utils_slist_free_full(batch->uris, g_free);
+	g_free(batch);
+}
 
-	/* should be enough to include context one time */
-	if (sbuddy)
-		sbuddy->just_added = FALSE;
+static void sipe_presence_scheduler_debug(struct sipe_presence_scheduler *scheduler,
+					  const gchar *event)
+{
+	SIPE_DEBUG_INFO("sipe_presence_scheduler: %s - pending %u in-flight %u failed %u (batch size %u window %u)",
+			event,
+			g_queue_get_length(&scheduler->pending),
+			scheduler->inflight,
+			scheduler->failed,
+			scheduler->batch_size,
+			scheduler->window);
+}
 
-	*resources_uri = g_strdup_printf("%s<resource uri=\"%s\"%s\n", tmp, name, context);
-	g_free(tmp);
+static void sipe_presence_scheduler_send(struct sipe_core_private *sipe_private)
+{
+	struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
+	gboolean batched = SIPE_CORE_PRIVATE_FLAG_IS(BATCHED_SUPPORT);
+	gchar *self = sip_uri_self(sipe_private);
+
+	while (!scheduler->suspended &&
+	       (scheduler->requests < scheduler->window) &&
+	       !g_queue_is_empty(&scheduler->pending)) {
+		struct presence_batch *batch = g_new0(struct presence_batch, 1);
+		guint size = batched ? scheduler->batch_size : 1;
+		struct transaction *trans;
+		gchar *uri;
+
+		while ((batch->count < size) &&
+		       ((uri = g_queue_pop_head(&scheduler->pending)) != NULL)) {
+			batch->uris = g_slist_prepend(batch->uris, uri);
+			batch->count++;
+		}
+		batch->uris = g_slist_reverse(batch->uris);
+		batch->sent = g_get_monotonic_time();
+
+		if (batched) {
+			GString *body = sipe_subscribe_presence_body_new(sipe_private,
+									 batch->count);
+			GSList *entry;
+
+			for (entry = batch->uris; entry; entry = entry->next) {
+				struct sipe_buddy *sbuddy = sipe_buddy_find_by_uri(sipe_private,
+										   entry->data);
+
+				/* should be enough to include context one time */
+				sipe_subscribe_presence_body_add(body,
+								 entry->data,
+								 SIPE_CORE_PRIVATE_FLAG_IS(OCS2007) &&
+								 sbuddy && sbuddy->just_added);
+				if (sbuddy)
+					sbuddy->just_added = FALSE;
+			}
+			trans = sipe_subscribe_presence_batched_to(sipe_private,
+								   body,
+								   self,
+								   NULL,
+								   TRUE);
+		} else {
+			trans = sipe_subscribe_presence_single_to(sipe_private,
+								  batch->uris->data,
+								  NULL,
+								  TRUE);
+		}
+
+		if (trans) {
+			struct transaction_payload *payload = g_new0(struct transaction_payload, 1);
+
+			payload->destroy = presence_batch_free;
+			payload->data    = batch;
+			trans->payload   = payload;
+
+			scheduler->requests++;
+			scheduler->inflight += batch->count;
+		} else {
+			scheduler->failed += batch->count;
+			presence_batch_free(batch);
+		}
+	}
+	g_free(self);
+
+	sipe_presence_scheduler_debug(scheduler, "send");
 }
 
-static void sipe_subscribe_resource_uri(const char *name,
-					SIPE_UNUSED_PARAMETER gpointer value,
-					gchar **resources_uri)
+static void sipe_presence_scheduler_resume(struct sipe_core_private *sipe_private,
+					   SIPE_UNUSED_PARAMETER gpointer unused)
 {
-	gchar *tmp = *resources_uri;
-        *resources_uri = g_strdup_printf("%s<resource uri=\"%s\"/>\n", tmp, name);
-	g_free(tmp);
+	sipe_private->presence_scheduler->suspended = FALSE;
+	sipe_presence_scheduler_send(sipe_private);
 }
 
-/**
-  * A callback for g_hash_table_foreach
-  */
-static void schedule_buddy_resubscription_cb(char *buddy_name,
-					     SIPE_UNUSED_PARAMETER struct sipe_buddy *buddy,
-					     struct sipe_core_private *sipe_private)
+/* server pushback: queue batch again and suspend sending */
+static void sipe_presence_scheduler_pushback(struct sipe_core_private *sipe_private,
+					     struct presence_batch *batch,
+					     guint retry_after)
 {
-	guint time_range = (sipe_buddy_count(sipe_private) * 1000) / 25; /* time interval for 25 requests per sec. In msec. */
+	struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
 
-	/*
-	 * g_hash_table_size() can never return 0, otherwise this function
-	 * wouldn't be called :-) But to keep Coverity happy...
-	 */
-	if (time_range) {
-		gchar *action_name = sipe_utils_presence_key(buddy_name);
-		guint timeout = ((guint) rand()) / (RAND_MAX / time_range) + 1; /* random period within the range but never 0! */
+	if (++scheduler->retries > PRESENCE_RETRIES_MAX) {
+		SIPE_DEBUG_ERROR("sipe_presence_scheduler_pushback: giving up on %u URIs",
+				 batch->count);
+		scheduler->failed += batch->count;
+		return;
+	}
 
-		sipe_schedule_mseconds(sipe_private,
-				       action_name,
-				       g_strdup(buddy_name),
-				       timeout,
-				       sipe_subscribe_presence_single_cb,
-				       g_free);
-		g_free(action_name);
+	/* batch->uris is in order, i.e. push back in reverse order */
+	batch->uris = g_slist_reverse(batch->uris);
+	while (batch->uris) {
+		g_queue_push_head(&scheduler->pending, batch->uris->data);
+		batch->uris = g_slist_delete_link(batch->uris, batch->uris);
+	}
+
+	scheduler->batch_size = MAX(scheduler->batch_size / 2,
+				    PRESENCE_BATCH_SIZE_MIN);
+	scheduler->window     = 1;
+
+	if (!scheduler->suspended) {
+		scheduler->suspended = TRUE;
+		sipe_schedule_seconds(sipe_private,
+				      PRESENCE_SCHEDULER_ACTION,
+				      NULL,
+				      MIN(retry_after, PRESENCE_RETRY_AFTER_MAX),
+				      sipe_presence_scheduler_resume,
+				      NULL);
+		SIPE_DEBUG_INFO("sipe_presence_scheduler_pushback: suspended for %u seconds",
+				retry_after);
 	}
 }
 
+static void sipe_presence_scheduler_completed(struct sipe_core_private *sipe_private,
+					      struct presence_batch *batch)
+{
+	struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
+
+	scheduler->requests--;
+	scheduler->inflight -= batch->count;
+}
+
+static gboolean process_presence_scheduler_timeout(struct sipe_core_private *sipe_private,
+						   SIPE_UNUSED_PARAMETER struct sipmsg *msg,
+						   struct transaction *trans)
+{
+	struct presence_batch *batch = trans->payload->data;
+
+	SIPE_DEBUG_INFO("process_presence_scheduler_timeout: no response for %u URIs",
+			batch->count);
+
+	sipe_presence_scheduler_completed(sipe_private, batch);
+	sipe_presence_scheduler_pushback(sipe_private, batch, PRESENCE_RETRY_AFTER);
+	sipe_presence_scheduler_send(sipe_private);
+
+	return(TRUE);
+}
+
+static gboolean process_presence_scheduler_response(struct sipe_core_private *sipe_private,
+						    struct sipmsg *msg,
+						    struct transaction *trans)
+{
+	struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
+	struct presence_batch *batch = trans->payload->data;
+	guint latency = (g_get_monotonic_time() - batch->sent) / 1000;
+
+	sipe_presence_scheduler_completed(sipe_private, batch);
+
+	/* server pushback */
+	if ((msg->response == 408) ||
+	    (msg->response == 480) ||
+	    (msg->response >= 500)) {
+		const gchar *retry_after = sipmsg_find_header(msg, "Retry-After");
+		const gchar *diagnostics = sipmsg_find_header(msg, "ms-diagnostics");
+
+		SIPE_DEBUG_INFO("process_presence_scheduler_response: %d (%s) for %u URIs",
+				msg->response,
+				diagnostics ? diagnostics : "",
+				batch->count);
+
+		sipe_presence_scheduler_pushback(sipe_private,
+						 batch,
+						 retry_after ?
+						 strtoul(retry_after, NULL, 10) :
+						 PRESENCE_RETRY_AFTER);
+
+	} else {
+		scheduler->retries = 0;
+
+		if (msg->response == 200) {
+			/* adapt to server response time */
+			if (latency < PRESENCE_RESPONSE_FAST) {
+				scheduler->batch_size = MIN(scheduler->batch_size * 2,
+							    PRESENCE_BATCH_SIZE_MAX);
+				scheduler->window     = MIN(scheduler->window + 1,
+							    PRESENCE_WINDOW_MAX);
+			} else if (latency > PRESENCE_RESPONSE_SLOW) {
+				scheduler->batch_size = MAX(scheduler->batch_size / 2,
+							    PRESENCE_BATCH_SIZE_MIN);
+				scheduler->window     = MAX(scheduler->window - 1, 1);
+			}
+		} else {
+			scheduler->failed += batch->count;
+		}
+
+		/* every batched SUBSCRIBE creates a new dialog */
+		sipe_subscription_response(sipe_private, msg, trans,
+					   SIPE_CORE_PRIVATE_FLAG_IS(BATCHED_SUPPORT));
+	}
+
+	sipe_presence_scheduler_send(sipe_private);
+
+	return(TRUE);
+}
+
+static void sipe_presence_scheduler_add(const gchar *uri,
+					SIPE_UNUSED_PARAMETER gpointer value,
+					struct sipe_presence_scheduler *scheduler)
+{
+	g_queue_push_tail(&scheduler->pending, g_strdup(uri));
+}
+
 void sipe_subscribe_presence_initial(struct sipe_core_private *sipe_private)
 {
 	/*
@@ -803,32 +1174,31 @@ void sipe_subscribe_presence_initial(struct sipe_core_private *sipe_private)
 	 * We'll resubsribe to them based on the Expire field values.
 	 */
 	if (!SIPE_CORE_PRIVATE_FLAG_IS(SUBSCRIBED_BUDDIES)) {
+		struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
 
-		if (SIPE_CORE_PRIVATE_FLAG_IS(BATCHED_SUPPORT)) {
-			gchar *to = sip_uri_self(sipe_private);
-			gchar *resources_uri = g_strdup("");
-			if (SIPE_CORE_PRIVATE_FLAG_IS(OCS2007)) {
-				sipe_buddy_foreach(sipe_private,
-						   (GHFunc) sipe_subscribe_resource_uri_with_context,
-						   &resources_uri);
-			} else {
-				sipe_buddy_foreach(sipe_private,
-						   (GHFunc) sipe_subscribe_resource_uri,
-						   &resources_uri);
-			}
-			sipe_subscribe_presence_batched_to(sipe_private, resources_uri, to);
-			g_free(to);
-
-		} else {
-			sipe_buddy_foreach(sipe_private,
-					   (GHFunc) schedule_buddy_resubscription_cb,
-					   sipe_private);
-		}
+		sipe_schedule_cancel(sipe_private, PRESENCE_SCHEDULER_ACTION);
+		sipe_presence_scheduler_reset(scheduler);
+		sipe_buddy_foreach(sipe_private,
+				   (GHFunc) sipe_presence_scheduler_add,
+				   scheduler);
+		sipe_presence_scheduler_send(sipe_private);
 
 		SIPE_CORE_PRIVATE_FLAG_SET(SUBSCRIBED_BUDDIES);
 	}
 }
 
+void sipe_core_presence_subscriptions(struct sipe_core_public *sipe_public,
+				      guint *pending,
+				      guint *inflight,
+				      guint *failed)
+{
+	struct sipe_presence_scheduler *scheduler = SIPE_CORE_PRIVATE->presence_scheduler;
+
+	*pending  = g_queue_get_length(&scheduler->pending);
+	*inflight = scheduler->inflight;
+	*failed   = scheduler->failed;
+}
+
 void sipe_subscribe_poolfqdn_resource_uri(const char *host,
 					  GSList *server,
 					  struct sipe_core_private *sipe_private)
@@ -836,6 +1206,7 @@ void sipe_subscribe_poolfqdn_resource_uri(const char *host,
 	struct presence_batched_routed *payload = g_malloc(sizeof(struct presence_batched_routed));
 	SIPE_DEBUG_INFO("process_incoming_notify_rlmi_resub: pool(%s)", host);
 	payload->host    = g_strdup(host);
+	payload->key     = NULL;
 	payload->buddies = server;
 	sipe_subscribe_presence_batched_routed(sipe_private,
 					       payload);
@@ -894,29 +1265,36 @@ static const struct event_subscription_data events_table[] =
 
 static void sipe_subscription_expiration(struct sipe_core_private *sipe_private,
 					 struct sipmsg *msg,
-					 const gchar *event)
+					 const gchar *event,
+					 const gchar *key)
 {
 	const gchar *expires_header = sipmsg_find_header(msg, "Expires");
 	guint timeout = expires_header ? strtol(expires_header, NULL, 10) : 0;
 
 	if (timeout) {
+		/* buddy resubscriptions can be delayed by up to 1 min */
+		guint slack = 0;
+
 		/* 2 min ahead of expiration */
-		if (timeout > 240) timeout -= 120;
+		if (timeout > 240) {
+			timeout -= 120;
+			slack    = 60;
+		}
 
 		if (sipe_strcase_equal(event, "presence")) {
 			gchar *who = parse_from(sipmsg_find_header(msg, "To"));
 
+			/* subscription key is also the action name */
 			if (SIPE_CORE_PRIVATE_FLAG_IS(BATCHED_SUPPORT)) {
-				sipe_process_presence_timeout(sipe_private, msg, who, timeout);
+				sipe_process_presence_timeout(sipe_private, msg, who, key, timeout, slack);
 			} else {
-				gchar *action_name = sipe_utils_presence_key(who);
-				sipe_schedule_seconds(sipe_private,
-						      action_name,
-						      g_strdup(who),
-						      timeout,
-						      sipe_subscribe_presence_single_cb,
-						      g_free);
-				g_free(action_name);
+				sipe_schedule_coalesce(sipe_private,
+						       key,
+						       g_strdup(who),
+						       timeout,
+						       slack,
+						       sipe_subscribe_presence_single_cb,
+						       g_free);
 				SIPE_DEBUG_INFO("Resubscription single contact '%s' in %d seconds", who, timeout);
 			}
 			g_free(who);
@@ -960,6 +1338,121 @@ void sipe_subscription_self_events(struct sipe_core_private *sipe_private)
 			(*esd->callback)(sipe_private, NULL);
 }
 
+/*
+ * Subscription check after warm reconnect
+ *
+ * Send an in-dialog SUBSCRIBE for every subscription. If the server no
+ * longer knows the dialog (481) it is dropped and we subscribe again.
+ */
+static void sipe_subscription_resubscribe(struct sipe_core_private *sipe_private,
+					  const gchar *key,
+					  struct sip_subscription *subscription)
+{
+	/* pending refresh would use the dropped dialog */
+	sipe_schedule_cancel(sipe_private, key);
+
+	if (sipe_strcase_equal(subscription->event, "presence")) {
+		struct sipe_presence_scheduler *scheduler = sipe_private->presence_scheduler;
+		gchar *self = sip_uri_self(sipe_private);
+		GSList *entry;
+
+		for (entry = subscription->buddies; entry; entry = entry->next)
+			g_queue_push_tail(&scheduler->pending, g_strdup(entry->data));
+		if (!subscription->buddies &&
+		    !sipe_strcase_equal(subscription->dialog.with, self))
+			g_queue_push_tail(&scheduler->pending,
+					  g_strdup(subscription->dialog.with));
+		g_free(self);
+
+		g_hash_table_remove(sipe_private->subscriptions, key);
+		sipe_presence_scheduler_send(sipe_private);
+
+	} else {
+		const struct event_subscription_data *esd;
+
+		for (esd = events_table; esd->event; esd++)
+			if (sipe_strcase_equal(subscription->event, esd->event))
+				break;
+
+		g_hash_table_remove(sipe_private->subscriptions, key);
+		if (esd->event)
+			(*esd->callback)(sipe_private, NULL);
+	}
+}
+
+static gboolean process_subscription_check_response(struct sipe_core_private *sipe_private,
+						    struct sipmsg *msg,
+						    struct transaction *trans)
+{
+	const gchar *key = trans->payload->data;
+	struct sip_subscription *subscription = g_hash_table_lookup(sipe_private->subscriptions,
+								    key);
+
+	if (!subscription)
+		return(TRUE);
+
+	if (msg->response == 200) {
+		/* existing refresh timer is still valid */
+		sipe_dialog_parse(&subscription->dialog, msg, TRUE);
+		if (sipmsg_find_header(msg, "ms-piggyback-cseq"))
+			process_incoming_notify(sipe_private, msg);
+
+	} else if ((msg->response == 481) ||
+		   (msg->response == 400)) {
+		SIPE_DEBUG_INFO("process_subscription_check_response: dialog for '%s' was lost",
+				key);
+		sipe_subscription_resubscribe(sipe_private, key, subscription);
+	}
+
+	return(TRUE);
+}
+
+static void sipe_subscription_check_cb(gpointer key,
+				       gpointer value,
+				       gpointer user_data)
+{
+	struct sip_subscription *subscription = value;
+	struct sipe_core_private *sipe_private = user_data;
+	gchar *contact = get_contact(sipe_private);
+	gchar *hdr = g_strdup_printf(
+		"Event: %s\r\n"
+		"Supported: com.microsoft.autoextend\r\n"
+		"Supported: ms-benotify\r\n"
+		"Proxy-Require: ms-benotify\r\n"
+		"Contact: %s\r\n",
+		subscription->event,
+		contact);
+	struct transaction *trans;
+	g_free(contact);
+
+	trans = sip_transport_request(sipe_private,
+				      "SUBSCRIBE",
+				      subscription->dialog.with,
+				      subscription->dialog.with,
+				      hdr,
+				      NULL,
+				      &subscription->dialog,
+				      process_subscription_check_response);
+	g_free(hdr);
+
+	if (trans) {
+		struct transaction_payload *payload = g_new0(struct transaction_payload, 1);
+
+		payload->destroy = g_free;
+		payload->data    = g_strdup(key);
+		trans->payload   = payload;
+	}
+}
+
+void sipe_subscriptions_check(struct sipe_core_private *sipe_private)
+{
+	SIPE_DEBUG_INFO("sipe_subscriptions_check: %u subscriptions",
+			g_hash_table_size(sipe_private->subscriptions));
+	g_hash_table_foreach(sipe_private->subscriptions,
+			     sipe_subscription_check_cb,
+			     sipe_private);
+}
+
 /*
   Local Variables:
   mode: c
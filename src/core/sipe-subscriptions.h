@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2013 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -54,3 +54,11 @@ void sipe_subscribe_poolfqdn_resource_uri(const gchar *host,
  * @param sipe_private SIPE core private data
  */
 void sipe_subscription_self_events(struct sipe_core_private *sipe_private);
+
+/**
+ * Check all subscription dialogs after a warm reconnect. Subscriptions
+ * which the server no longer knows are subscribed again.
+ *
+ * @param sipe_private SIPE core private data
+ */
+void sipe_subscriptions_check(struct sipe_core_private *sipe_private);
@@ -0,0 +1,114 @@
+/**
+ * @file sipe-test-allocations.h
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Allocation counter for test & benchmark programs
+ *
+ * g_mem_set_vtable() is a no-op since GLib 2.46. Whether allocations can
+ * be counted is therefore checked at startup. If they can't, the results
+ * are reported as "n/a".
+ *
+ * Only include this header from the source file that contains main().
+ */
+
+/*
+ * Interface dependencies:
+ *
+ * <stdlib.h>
+ * <glib.h>
+ */
+
+static gsize sipe_test_allocations         = 0;
+static gboolean sipe_test_allocations_work = FALSE;
+
+static gpointer sipe_test_count_malloc(gsize n_bytes)
+{
+	sipe_test_allocations++;
+	return(malloc(n_bytes));
+}
+
+static gpointer sipe_test_count_realloc(gpointer mem, gsize n_bytes)
+{
+	sipe_test_allocations++;
+	return(realloc(mem, n_bytes));
+}
+
+static GMemVTable sipe_test_allocation_counter = {
+	&sipe_test_count_malloc,
+	&sipe_test_count_realloc,
+	&free,
+	NULL,
+	NULL,
+	NULL,
+};
+
+/**
+ * Install the allocation counter
+ *
+ * Must be called before any other GLib function.
+ */
+static void sipe_test_allocations_init(void)
+{
+	gpointer probe;
+
+	g_mem_set_vtable(&sipe_test_allocation_counter);
+
+	/* check if the vtable has taken effect */
+	probe = g_malloc(1);
+	sipe_test_allocations_work = (sipe_test_allocations != 0);
+	g_free(probe);
+
+	if (!sipe_test_allocations_work)
+		printf("NOTE: GLib ignores g_mem_set_vtable(), allocations are not counted\n");
+}
+
+/**
+ * Allocations since @c start per operation
+ *
+ * @param start      value of @c sipe_test_allocations before the operations
+ * @param operations number of operations
+ *
+ * @return formatted number or "n/a". Only valid until the next call.
+ */
+static const gchar *sipe_test_allocations_per(gsize start, guint operations)
+{
+	static gchar buffer[32];
+
+	if (!sipe_test_allocations_work)
+		return("n/a");
+
+	g_snprintf(buffer, sizeof(buffer), "%.1f",
+		   operations ?
+		   (gdouble) (sipe_test_allocations - start) / operations :
+		   0.0);
+	return(buffer);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
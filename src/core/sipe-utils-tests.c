@@ -0,0 +1,313 @@
+/**
+ * @file sipe-utils-tests.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Tests for the URI hash & equality functions and the string pool
+ * in sipe-utils.c
+ *
+ * Usage: sipe_utils_tests [<benchmark iterations> [<buddies>]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <glib.h>
+
+#include "sipe-common.h"
+#include "sipe-backend.h"
+#include "sipe-utils.h"
+#include "sipe-test-allocations.h"
+
+/*
+ * Stubs
+ */
+gboolean sipe_backend_debug_enabled(void)
+{
+	return(FALSE);
+}
+
+void sipe_backend_debug_literal(sipe_debug_level level,
+				const gchar *msg)
+{
+	printf("DEBUG(%d): %s\n", level, msg);
+}
+
+void sipe_backend_debug(sipe_debug_level level,
+			const gchar *format,
+			...)
+{
+	va_list ap;
+	gchar *newformat = g_strdup_printf("DEBUG(%d): %s\n", level, format);
+
+	va_start(ap, format);
+	vprintf(newformat, ap);
+	va_end(ap);
+
+	g_free(newformat);
+}
+
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public)
+{
+	return(NULL);
+}
+
+char *generateUUIDfromEPID(SIPE_UNUSED_PARAMETER const gchar *epid)
+{
+	return(NULL);
+}
+
+char *sipe_get_epid(SIPE_UNUSED_PARAMETER const char *self_sip_uri,
+		    SIPE_UNUSED_PARAMETER const char *hostname,
+		    SIPE_UNUSED_PARAMETER const char *ip_address)
+{
+	return(NULL);
+}
+
+/*
+ * Tester code
+ */
+static guint succeeded = 0;
+static guint failed    = 0;
+
+static void assert_uri(const gchar *uri1,
+		       const gchar *uri2,
+		       gboolean expected)
+{
+	gboolean equal = sipe_utils_uri_equal(uri1, uri2);
+
+	if (equal == expected) {
+		succeeded++;
+	} else {
+		printf("'%s' == '%s' FAILED: %d expected: %d\n",
+		       uri1 ? uri1 : "(nil)",
+		       uri2 ? uri2 : "(nil)",
+		       equal, expected);
+		failed++;
+	}
+
+	/* equal URIs must have the same hash */
+	if (equal && uri1 && uri2) {
+		if (sipe_utils_uri_hash(uri1) == sipe_utils_uri_hash(uri2)) {
+			succeeded++;
+		} else {
+			printf("hash('%s') == hash('%s') FAILED\n", uri1, uri2);
+			failed++;
+		}
+	}
+}
+
+static void assert_pool(struct sipe_string_pool *pool,
+			guint expected_strings,
+			gsize expected_bytes,
+			guint expected_references)
+{
+	guint strings, references;
+	gsize bytes;
+
+	sipe_string_pool_stats(pool, &strings, &bytes, &references);
+	if ((strings    == expected_strings) &&
+	    (bytes      == expected_bytes)   &&
+	    (references == expected_references)) {
+		succeeded++;
+	} else {
+		printf("string pool FAILED: %u/%" G_GSIZE_FORMAT "/%u expected: %u/%" G_GSIZE_FORMAT "/%u\n",
+		       strings, bytes, references,
+		       expected_strings, expected_bytes, expected_references);
+		failed++;
+	}
+}
+
+static void test_pool(void)
+{
+	struct sipe_string_pool *pool = sipe_string_pool_new();
+	gchar *copy = g_strdup("Available");
+	const gchar *s1, *s2, *s3;
+
+	assert_pool(pool, 0, 0, 0);
+
+	if (sipe_string_pool_ref(pool, NULL) == NULL) {
+		succeeded++;
+	} else {
+		printf("sipe_string_pool_ref(NULL) FAILED\n");
+		failed++;
+	}
+	sipe_string_pool_unref(pool, NULL);
+	assert_pool(pool, 0, 0, 0);
+
+	s1 = sipe_string_pool_ref(pool, "Available");
+	s2 = sipe_string_pool_ref(pool, copy);
+	s3 = sipe_string_pool_ref(pool, "In a meeting");
+	g_free(copy);
+	assert_pool(pool, 2, 10 + 13, 3);
+
+	if ((s1 == s2) && (s1 != s3) && g_str_equal(s1, "Available")) {
+		succeeded++;
+	} else {
+		printf("string pool sharing FAILED\n");
+		failed++;
+	}
+
+	sipe_string_pool_unref(pool, s1);
+	assert_pool(pool, 2, 10 + 13, 2);
+	sipe_string_pool_unref(pool, s2);
+	assert_pool(pool, 1, 13, 1);
+	sipe_string_pool_unref(pool, s3);
+	assert_pool(pool, 0, 0, 0);
+
+	/* left-over references are reported & freed */
+	sipe_string_pool_ref(pool, "Busy");
+	sipe_string_pool_free(pool);
+}
+
+/* buddy URI hash functions before the ASCII fast path was introduced */
+static guint legacy_hash(gconstpointer nick)
+{
+	char *lc = g_utf8_strdown(nick, -1);
+	guint bucket = g_str_hash(lc);
+	g_free(lc);
+
+	return bucket;
+}
+
+static gboolean legacy_equal(gconstpointer nick1, gconstpointer nick2)
+{
+	char *nick1_norm = NULL;
+	char *nick2_norm = NULL;
+	gboolean equal;
+
+	if (nick1 == NULL && nick2 == NULL) return TRUE;
+	if (nick1 == NULL || nick2 == NULL    ||
+	    !g_utf8_validate(nick1, -1, NULL) ||
+	    !g_utf8_validate(nick2, -1, NULL)) return FALSE;
+
+	nick1_norm = g_utf8_casefold(nick1, -1);
+	nick2_norm = g_utf8_casefold(nick2, -1);
+	equal = g_utf8_collate(nick1_norm, nick2_norm) == 0;
+	g_free(nick2_norm);
+	g_free(nick1_norm);
+
+	return equal;
+}
+
+static void benchmark(const gchar *label,
+		      guint buddies,
+		      guint iterations,
+		      GHashFunc hash,
+		      GEqualFunc equal)
+{
+	GHashTable *table = g_hash_table_new_full(hash, equal, g_free, NULL);
+	gchar **lookups   = g_new(gchar *, buddies);
+	gsize start_allocations;
+	GTimer *timer;
+	gdouble elapsed;
+	guint found = 0;
+	guint total = buddies * iterations;
+	guint i, j;
+
+	/* sipe_buddy_add() stores lower-case URIs */
+	for (i = 0; i < buddies; i++) {
+		gchar *uri = g_strdup_printf("sip:user%05u@contoso.com", i);
+		g_hash_table_insert(table, uri, uri);
+		/* URIs from the server are mostly lower-case, but not all */
+		lookups[i] = (i % 10) ?
+			g_strdup(uri) :
+			g_strdup_printf("sip:User%05u@Contoso.COM", i);
+	}
+
+	start_allocations = sipe_test_allocations;
+	timer = g_timer_new();
+	for (j = 0; j < iterations; j++)
+		for (i = 0; i < buddies; i++)
+			if (g_hash_table_lookup(table, lookups[i]))
+				found++;
+	elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	printf("%-8s %8.1f ns/lookup %6s allocations/lookup\n",
+	       label,
+	       elapsed * 1e9 / total,
+	       sipe_test_allocations_per(start_allocations, total));
+
+	if (found != total) {
+		printf("%s FAILED: found %u expected: %u\n", label, found, total);
+		failed++;
+	}
+
+	for (i = 0; i < buddies; i++)
+		g_free(lookups[i]);
+	g_free(lookups);
+	g_hash_table_destroy(table);
+}
+
+int main(int argc, char *argv[])
+{
+	guint iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10;
+	guint buddies    = (argc > 2) ? strtoul(argv[2], NULL, 10) : 10000;
+
+	/* must be called before any other GLib function */
+	sipe_test_allocations_init();
+
+	/* ASCII */
+	assert_uri("sip:alice@contoso.com", "sip:alice@contoso.com", TRUE);
+	assert_uri("sip:Alice@Contoso.COM", "sip:alice@contoso.com", TRUE);
+	assert_uri("sip:alice@contoso.com", "sip:bob@contoso.com",   FALSE);
+	assert_uri("sip:alice@contoso.com", "sip:alice@contoso.co",  FALSE);
+	assert_uri("sip:alice@contoso.co",  "sip:alice@contoso.com", FALSE);
+	assert_uri("",                      "",                      TRUE);
+	assert_uri(NULL,                    NULL,                    TRUE);
+	assert_uri("sip:alice@contoso.com", NULL,                    FALSE);
+	assert_uri(NULL,                    "sip:alice@contoso.com", FALSE);
+
+	/* UTF-8 */
+	assert_uri("sip:J\xc3\x96RG@contoso.com",  "sip:j\xc3\xb6rg@contoso.com", TRUE);
+	assert_uri("sip:j\xc3\xb6rg@contoso.com",  "sip:jorg@contoso.com",        FALSE);
+	/* KELVIN SIGN lower-cases to ASCII "k" */
+	assert_uri("sip:\xe2\x84\xaa@contoso.com", "sip:k@contoso.com",           TRUE);
+	/* invalid UTF-8 */
+	assert_uri("sip:\xff@contoso.com",         "sip:\xff@contoso.com",        FALSE);
+
+	/* string pool */
+	test_pool();
+
+	/* compare against legacy implementation */
+	if (iterations && buddies) {
+		printf("Looking up %u x %u buddies:\n", iterations, buddies);
+		benchmark("legacy", buddies, iterations,
+			  legacy_hash, legacy_equal);
+		benchmark("ascii", buddies, iterations,
+			  sipe_utils_uri_hash, sipe_utils_uri_equal);
+	}
+
+	printf("Result: %d PASSED %d FAILED\n", succeeded, failed);
+	return(failed);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
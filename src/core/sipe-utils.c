@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2009-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2009-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -28,6 +28,7 @@
 
 #include <glib.h>
 
+#include "sipe-common.h"
 #include "sipe-backend.h"
 #include "sipe-core.h"    /* to ensure same API for backends */
 #include "sipe-core-private.h"
@@ -357,6 +358,174 @@ gint sipe_strcompare(gconstpointer a, gconstpointer b)
 #endif
 }
 
+/*
+ * Case-insensitive URI hash & equality
+ *
+ * URIs are nearly always ASCII. In that case the functions work in place
+ * without allocating memory. Only URIs with non-ASCII characters fall back
+ * to the UTF-8 case folding functions from GLib.
+ *
+ * The ASCII hash is the same as g_str_hash() on the lower-cased string,
+ * i.e. the same as the UTF-8 fallback for strings that lower-case to ASCII.
+ */
+guint sipe_utils_uri_hash(gconstpointer uri)
+{
+	const signed char *p;
+	guint32 h = 5381;
+
+	for (p = uri; *p; p++) {
+		/* non-ASCII character */
+		if (*p < 0) {
+			gchar *lc = g_utf8_strdown(uri, -1);
+			h = g_str_hash(lc);
+			g_free(lc);
+			break;
+		}
+		h = (h << 5) + h + g_ascii_tolower(*p);
+	}
+
+	return(h);
+}
+
+static gboolean sipe_utils_uri_equal_utf8(const gchar *uri1,
+					  const gchar *uri2)
+{
+	gchar *uri1_norm;
+	gchar *uri2_norm;
+	gboolean equal;
+
+	if (!g_utf8_validate(uri1, -1, NULL) ||
+	    !g_utf8_validate(uri2, -1, NULL))
+		return(FALSE);
+
+	uri1_norm = g_utf8_casefold(uri1, -1);
+	uri2_norm = g_utf8_casefold(uri2, -1);
+	equal = g_utf8_collate(uri1_norm, uri2_norm) == 0;
+	g_free(uri2_norm);
+	g_free(uri1_norm);
+
+	return(equal);
+}
+
+gboolean sipe_utils_uri_equal(gconstpointer uri1, gconstpointer uri2)
+{
+	const guchar *p1 = uri1;
+	const guchar *p2 = uri2;
+
+	if (!p1 || !p2)
+		return(p1 == p2);
+
+	for (;; p1++, p2++) {
+		/* non-ASCII characters need case folding */
+		if ((*p1 | *p2) & 0x80)
+			return(sipe_utils_uri_equal_utf8(uri1, uri2));
+		if (g_ascii_tolower(*p1) != g_ascii_tolower(*p2))
+			return(FALSE);
+		if (!*p1)
+			return(TRUE);
+	}
+}
+
+/*
+ * Reference counted string pool
+ *
+ * Key is the string, value is the reference count. The key destroy
+ * function isn't used, because g_hash_table_insert() would free the key
+ * when the reference count of an existing string is updated.
+ */
+struct sipe_string_pool {
+	GHashTable *strings;
+	gsize bytes;
+	guint references;
+};
+
+struct sipe_string_pool *sipe_string_pool_new(void)
+{
+	struct sipe_string_pool *pool = g_new0(struct sipe_string_pool, 1);
+	pool->strings = g_hash_table_new(g_str_hash, g_str_equal);
+	return(pool);
+}
+
+static void sipe_string_pool_free_string(gpointer key,
+					 SIPE_UNUSED_PARAMETER gpointer value,
+					 SIPE_UNUSED_PARAMETER gpointer user_data)
+{
+	g_free(key);
+}
+
+void sipe_string_pool_free(struct sipe_string_pool *pool)
+{
+	if (pool) {
+		if (pool->references)
+			SIPE_DEBUG_ERROR("sipe_string_pool_free: %u references to %u strings left",
+					 pool->references,
+					 g_hash_table_size(pool->strings));
+		g_hash_table_foreach(pool->strings,
+				     sipe_string_pool_free_string,
+				     NULL);
+		g_hash_table_destroy(pool->strings);
+		g_free(pool);
+	}
+}
+
+const gchar *sipe_string_pool_ref(struct sipe_string_pool *pool,
+				  const gchar *string)
+{
+	gpointer key, count;
+
+	if (!string)
+		return(NULL);
+
+	if (g_hash_table_lookup_extended(pool->strings, string, &key, &count)) {
+		count = GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1);
+	} else {
+		key   = g_strdup(string);
+		count = GUINT_TO_POINTER(1);
+		pool->bytes += strlen(key) + 1;
+	}
+	g_hash_table_insert(pool->strings, key, count);
+	pool->references++;
+
+	return(key);
+}
+
+void sipe_string_pool_unref(struct sipe_string_pool *pool,
+			    const gchar *string)
+{
+	gpointer key, count;
+
+	if (!string)
+		return;
+
+	if (!g_hash_table_lookup_extended(pool->strings, string, &key, &count) ||
+	    (key != string)) {
+		SIPE_DEBUG_ERROR("sipe_string_pool_unref: '%s' is not in pool",
+				 string);
+		return;
+	}
+
+	pool->references--;
+	if (GPOINTER_TO_UINT(count) > 1) {
+		g_hash_table_insert(pool->strings,
+				    key,
+				    GUINT_TO_POINTER(GPOINTER_TO_UINT(count) - 1));
+	} else {
+		pool->bytes -= strlen(key) + 1;
+		g_hash_table_remove(pool->strings, key);
+		g_free(key);
+	}
+}
+
+void sipe_string_pool_stats(struct sipe_string_pool *pool,
+			    guint *strings,
+			    gsize *bytes,
+			    guint *references)
+{
+	*strings    = g_hash_table_size(pool->strings);
+	*bytes      = pool->bytes;
+	*references = pool->references;
+}
+
 time_t
 sipe_utils_str_to_time(const gchar *timestamp)
 {
@@ -565,6 +734,22 @@ void sipe_utils_shrink_buffer(struct sipe_transport_connection *conn,
 	memmove(conn->buffer, unread, conn->buffer_used + 1);
 }
 
+void sipe_utils_buffer_high_water(struct sipe_core_private *sipe_private,
+				  struct sipe_transport_connection *conn)
+{
+	const gchar *setting = sipe_backend_setting(SIPE_CORE_PUBLIC,
+						    SIPE_SETTING_BUFFER_HIGH_WATER);
+
+	conn->buffer_high_water = 0;
+	if (!is_empty(setting)) {
+		/* KB, at least the initial buffer size */
+		guint64 value = g_ascii_strtoull(setting, NULL, 10);
+		conn->buffer_high_water = CLAMP(value,
+						SIPE_TRANSPORT_BUFFER_INITIAL / 1024,
+						1024 * 1024) * 1024;
+	}
+}
+
 gboolean sipe_utils_ip_is_private(const char *ip)
 {
 	return g_str_has_prefix(ip, "10.")      ||
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2009-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2009-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -307,6 +307,89 @@ gboolean sipe_strcase_equal(const gchar *left, const gchar *right);
  */
 gint sipe_strcompare(gconstpointer a, gconstpointer b);
 
+/**
+ * Case-insensitive hash for URIs
+ *
+ * Doesn't allocate memory for ASCII URIs. The declaration is compatible
+ * to @c GHashFunc.
+ *
+ * @param uri A URI (must not be @c NULL)
+ *
+ * @return hash value
+ */
+guint sipe_utils_uri_hash(gconstpointer uri);
+
+/**
+ * Case-insensitive equality for URIs
+ *
+ * Doesn't allocate memory for ASCII URIs. The declaration is compatible
+ * to @c GEqualFunc.
+ *
+ * @param uri1 A URI
+ * @param uri2 A URI to compare with uri1
+ *
+ * @return @c TRUE if the URIs are the same, else @c FALSE.
+ */
+gboolean sipe_utils_uri_equal(gconstpointer uri1, gconstpointer uri2);
+
+/**
+ * Reference counted pool of shared strings
+ *
+ * Stores every string value only once, however often it is used.
+ */
+struct sipe_string_pool;
+
+/**
+ * Create an empty string pool
+ *
+ * @return string pool. Must be freed with @c sipe_string_pool_free()
+ */
+struct sipe_string_pool *sipe_string_pool_new(void);
+
+/**
+ * Free a string pool and all strings in it
+ *
+ * @param pool string pool (may be @c NULL)
+ */
+void sipe_string_pool_free(struct sipe_string_pool *pool);
+
+/**
+ * Get a shared copy of a string and add a reference to it
+ *
+ * @param pool   string pool
+ * @param string a string (may be @c NULL)
+ *
+ * @return shared string (or @c NULL). Must NOT be g_free()'d. Release
+ *         with @c sipe_string_pool_unref() instead.
+ */
+const gchar *sipe_string_pool_ref(struct sipe_string_pool *pool,
+				  const gchar *string);
+
+/**
+ * Release a reference to a shared string
+ *
+ * The string is freed when the last reference has been released.
+ *
+ * @param pool   string pool
+ * @param string shared string returned by @c sipe_string_pool_ref()
+ *               (may be @c NULL)
+ */
+void sipe_string_pool_unref(struct sipe_string_pool *pool,
+			    const gchar *string);
+
+/**
+ * String pool statistics
+ *
+ * @param pool       string pool
+ * @param strings    (out) number of distinct strings
+ * @param bytes      (out) memory used for the strings
+ * @param references (out) number of references to the strings
+ */
+void sipe_string_pool_stats(struct sipe_string_pool *pool,
+			    guint *strings,
+			    gsize *bytes,
+			    guint *references);
+
 /**
  * Parses a timestamp in ISO8601 format and returns a time_t.
  * Assumes UTC if no timezone specified
@@ -448,6 +531,15 @@ gchar *sipe_utils_str_replace(const gchar *string,
  */
 void sipe_utils_shrink_buffer(struct sipe_transport_connection *conn,
 			      const gchar *unread);
+
+/**
+ * Set high-water mark of transport buffer from account setting
+ *
+ * @param sipe_private SIPE core private data
+ * @param conn         the transport connection
+ */
+void sipe_utils_buffer_high_water(struct sipe_core_private *sipe_private,
+				  struct sipe_transport_connection *conn);
 /**
  * Checks whether given IP address belongs to private block as defined in RFC1918
  *
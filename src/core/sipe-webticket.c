@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -26,6 +26,20 @@
  *   - [MS-OCAUTHWS]: http://msdn.microsoft.com/en-us/library/ff595592.aspx
  *   - MS Tech-Ed Europe 2010 "UNC310: Microsoft Lync 2010 Technology Explained"
  *     http://ecn.channel9.msdn.com/o9/te/Europe/2010/pptx/unc310.pptx
+ *
+ *
+ * Persistent token store
+ *
+ * Valid Web Tickets and the ADFS token are stored per account in the user
+ * runtime directory, so that they survive a restart or reconnect. Store
+ * file layout:
+ *
+ *   magic (8) | IV (12) | AES-256-GCM(GKeyFile data) | tag (16)
+ *
+ * The key is random and kept by the backend with the other secrets of the
+ * account, never in the store file itself. Nothing in the file is derived
+ * from the account password. If the backend can't keep secrets then the
+ * store is disabled.
  */
 
 #include <string.h>
@@ -38,6 +52,7 @@
 #include "sipe-core.h"
 #include "sipe-core-private.h"
 #include "sipe-digest.h"
+#include "sipe-store.h"
 #include "sipe-svc.h"
 #include "sipe-tls.h"
 #include "sipe-webticket.h"
@@ -90,6 +105,9 @@ struct sipe_webticket {
 	gchar *adfs_token;
 	time_t adfs_token_expires;
 
+	/* persistent store key, NULL if store is disabled */
+	guchar *store_key;
+
 	gboolean retrieved_realminfo;
 	gboolean shutting_down;
 };
@@ -105,6 +123,7 @@ void sipe_webticket_free(struct sipe_core_private *sipe_private)
 
 	g_free(webticket->webticket_adfs_uri);
 	g_free(webticket->adfs_token);
+	sipe_store_key_free(webticket->store_key);
 	if (webticket->pending)
 		g_hash_table_destroy(webticket->pending);
 	if (webticket->cache)
@@ -171,6 +190,174 @@ static const struct webticket_token *cache_hit(struct sipe_core_private *sipe_pr
 	return(wt);
 }
 
+#define STORE_MAGIC        "SIPEWT02"
+#define STORE_GROUP_ADFS   "ADFS"
+#define STORE_SECRET       "webticket_store_key"
+
+struct store_data {
+	GKeyFile *keyfile;
+	time_t valid;
+};
+
+static void store_token(gpointer key,
+			gpointer value,
+			gpointer user_data)
+{
+	const struct webticket_token *wt = value;
+	struct store_data *sd = user_data;
+
+	if (wt->auth_uri && (wt->expires >= sd->valid)) {
+		gchar *expires = sipe_utils_time_to_str(wt->expires);
+		g_key_file_set_string(sd->keyfile, key, "auth_uri", wt->auth_uri);
+		g_key_file_set_string(sd->keyfile, key, "token",    wt->token);
+		g_key_file_set_string(sd->keyfile, key, "expires",  expires);
+		g_free(expires);
+	}
+}
+
+static void store_save(struct sipe_core_private *sipe_private)
+{
+	struct sipe_webticket *webticket = sipe_private->webticket;
+	struct store_data sd;
+	GKeyFile *keyfile;
+	gchar *data;
+	gsize length;
+
+	if (!webticket->store_key)
+		return;
+
+	sd.keyfile = keyfile = g_key_file_new();
+	sd.valid   = time(NULL) + 60;
+	g_hash_table_foreach(webticket->cache, store_token, &sd);
+
+	if (webticket->adfs_token &&
+	    (webticket->adfs_token_expires >= sd.valid)) {
+		gchar *expires = sipe_utils_time_to_str(webticket->adfs_token_expires);
+		if (webticket->webticket_adfs_uri)
+			g_key_file_set_string(keyfile, STORE_GROUP_ADFS, "uri",
+					      webticket->webticket_adfs_uri);
+		g_key_file_set_string(keyfile, STORE_GROUP_ADFS, "token",   webticket->adfs_token);
+		g_key_file_set_string(keyfile, STORE_GROUP_ADFS, "expires", expires);
+		g_free(expires);
+	}
+
+	data = g_key_file_to_data(keyfile, &length, NULL);
+	g_key_file_free(keyfile);
+
+	if (data) {
+		gchar *filename = sipe_store_filename(sipe_private, "webticket");
+
+		sipe_store_save(filename, STORE_MAGIC, webticket->store_key,
+				data, length);
+
+		g_free(filename);
+		memset(data, 0, length);
+		g_free(data);
+	}
+}
+
+static gchar *store_group_time(GKeyFile *keyfile,
+			       const gchar *group,
+			       time_t valid,
+			       time_t *expires)
+{
+	gchar *value = g_key_file_get_string(keyfile, group, "expires", NULL);
+
+	*expires = sipe_utils_str_to_time(value);
+	g_free(value);
+
+	/* still valid for 60 seconds? */
+	if (*expires < valid)
+		return(NULL);
+
+	return(g_key_file_get_string(keyfile, group, "token", NULL));
+}
+
+void sipe_webticket_preload(struct sipe_core_private *sipe_private)
+{
+	struct sipe_webticket *webticket;
+	gchar *filename;
+	gchar *data;
+
+	sipe_webticket_init(sipe_private);
+	webticket = sipe_private->webticket;
+
+	webticket->store_key = sipe_store_key(sipe_private, STORE_SECRET);
+	if (!webticket->store_key)
+		return;
+
+	filename = sipe_store_filename(sipe_private, "webticket");
+	data     = sipe_store_load(filename, STORE_MAGIC, webticket->store_key);
+	if (data) {
+		GKeyFile *keyfile = g_key_file_new();
+
+		if (g_key_file_load_from_data(keyfile,
+					      data,
+					      strlen(data),
+					      G_KEY_FILE_NONE,
+					      NULL)) {
+			gchar **groups = g_key_file_get_groups(keyfile, NULL);
+			time_t valid = time(NULL) + 60;
+			guint i;
+
+			for (i = 0; groups[i]; i++) {
+				const gchar *group = groups[i];
+				time_t expires;
+				gchar *token = store_group_time(keyfile,
+								group,
+								valid,
+								&expires);
+
+				if (!token)
+					continue;
+
+				if (sipe_strequal(group, STORE_GROUP_ADFS)) {
+					SIPE_DEBUG_INFO_NOFORMAT("sipe_webticket_preload: ADFS token");
+					g_free(webticket->adfs_token);
+					g_free(webticket->webticket_adfs_uri);
+					webticket->adfs_token         = token;
+					webticket->adfs_token_expires = expires;
+					webticket->webticket_adfs_uri = g_key_file_get_string(keyfile,
+											      group,
+											      "uri",
+											      NULL);
+					/* ADFS setup has already been detected */
+					webticket->retrieved_realminfo = webticket->webticket_adfs_uri != NULL;
+				} else {
+					gchar *auth_uri = g_key_file_get_string(keyfile,
+										group,
+										"auth_uri",
+										NULL);
+
+					if (auth_uri) {
+						SIPE_DEBUG_INFO("sipe_webticket_preload: token for URI %s",
+								group);
+						/* cache takes ownership of token */
+						cache_token(sipe_private,
+							    group,
+							    auth_uri,
+							    token,
+							    expires);
+						g_free(auth_uri);
+					} else {
+						g_free(token);
+					}
+				}
+			}
+
+			g_strfreev(groups);
+		} else {
+			SIPE_DEBUG_ERROR("sipe_webticket_preload: invalid data in '%s'",
+					 filename);
+		}
+
+		g_key_file_free(keyfile);
+		memset(data, 0, strlen(data));
+		g_free(data);
+	}
+	g_free(filename);
+}
+
 /* frees just the main request data, when this is called "queued" is cleared */
 static void callback_data_free(struct webticket_callback_data *wcd)
 {
@@ -487,6 +674,7 @@ static void webticket_token(struct sipe_core_private *sipe_private,
 					    wcd->service_auth_uri,
 					    wsse_security,
 					    expires);
+				store_save(sipe_private);
 				callback_execute(sipe_private,
 						 wcd,
 						 wcd->service_auth_uri,
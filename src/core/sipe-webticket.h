@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2011-12 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2011-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -68,6 +68,16 @@ gboolean sipe_webticket_request(struct sipe_core_private *sipe_private,
 				sipe_webticket_callback *callback,
 				gpointer callback_data);
 
+/**
+ * Preload still valid tokens from persistent store
+ *
+ * Must be called after backend initialization, as the store key is kept
+ * by the backend.
+ *
+ * @param sipe_private SIPE core private data
+ */
+void sipe_webticket_preload(struct sipe_core_private *sipe_private);
+
 /**
  * Free webticket data
  *
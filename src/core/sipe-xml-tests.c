@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -128,6 +128,19 @@ static void assert_data(const sipe_xml *xml, const gchar *s)
 	g_free(data);
 }
 
+static void assert_size(const sipe_xml *xml, gsize maximum)
+{
+	gsize size = sipe_xml_size(xml);
+
+	if (size && (size <= maximum)) {
+		succeeded++;
+	} else {
+		printf("[%s]\nXML size FAILED: %" G_GSIZE_FORMAT " maximum: %" G_GSIZE_FORMAT "\n",
+		       teststring, size, maximum);
+		failed++;
+	}
+}
+
 static void assert_attribute(const sipe_xml *xml,
 			     const gchar *key, const gchar *value)
 {
@@ -220,6 +233,115 @@ static void assert_raw(const gchar *raw,
 }
 
 
+/* streaming parser */
+struct stream_test {
+	GString *log;
+	guint calls;
+	guint stop_after; /* 0: never stop */
+};
+
+static gboolean stream_log(const gchar *type,
+			   const sipe_xml *node,
+			   struct stream_test *st)
+{
+	gchar *string = sipe_xml_stringify(node);
+	g_string_append_printf(st->log, "%s%s", type, string);
+	g_free(string);
+	return(!st->stop_after || (++st->calls < st->stop_after));
+}
+
+static gboolean stream_start(const sipe_xml *node, gpointer user_data)
+{
+	return(stream_log("S", node, user_data));
+}
+
+static gboolean stream_end(const sipe_xml *node, gpointer user_data)
+{
+	return(stream_log("E", node, user_data));
+}
+
+static void assert_stream(const gchar *s,
+			  const struct sipe_xml_stream_path *paths,
+			  guint stop_after,
+			  gboolean ok,
+			  const gchar *expected)
+{
+	struct stream_test st;
+	gboolean result;
+
+	st.log        = g_string_new("");
+	st.calls      = 0;
+	st.stop_after = stop_after;
+	result = sipe_xml_stream_parse(s, s ? strlen(s) : 0, paths, &st);
+
+	teststring = s ? s : "(nil)";
+
+	if (((ok && result) || (!ok && !result)) &&
+	    sipe_strequal(st.log->str, expected)) {
+		succeeded++;
+	} else {
+		printf("[%s]\nXML stream FAILED: %d '%s' expected: %d '%s'\n",
+		       teststring, result, st.log->str, ok, expected);
+		failed++;
+	}
+
+	g_string_free(st.log, TRUE);
+}
+
+static gboolean stream_collect(const sipe_xml *node, gpointer user_data)
+{
+	GSList **list = user_data;
+	*list = g_slist_append(*list, sipe_xml_stringify(node));
+	return(TRUE);
+}
+
+/* stream and tree parser must return the same nodes */
+static void assert_stream_tree(const gchar *s, const gchar *path)
+{
+	struct sipe_xml_stream_path paths[] = {
+		{ NULL, NULL, stream_collect },
+		{ NULL, NULL, NULL }
+	};
+	sipe_xml *xml = sipe_xml_parse(s, strlen(s));
+	GSList *streamed = NULL;
+	GSList *entry;
+	const sipe_xml *node;
+	gboolean ok;
+
+	teststring = s;
+	paths[0].path = path;
+	ok = sipe_xml_stream_parse(s, strlen(s), paths, &streamed) && xml;
+
+	for (node = sipe_xml_child(xml, path), entry = streamed;
+	     ok && node;
+	     node = sipe_xml_twin(node), entry = entry->next) {
+		gchar *string = sipe_xml_stringify(node);
+
+		if (!entry || !sipe_strequal(string, entry->data)) {
+			printf("[%s]\nXML stream/tree FAILED: '%s' expected: '%s'\n",
+			       teststring,
+			       entry ? (gchar *) entry->data : "(nil)",
+			       string);
+			ok = FALSE;
+		}
+		g_free(string);
+		if (!entry)
+			break;
+	}
+
+	if (ok && !entry) {
+		succeeded++;
+	} else {
+		printf("[%s]\nXML stream/tree FAILED: '%s'\n",
+		       teststring, path);
+		failed++;
+	}
+
+	sipe_utils_slist_free_full(streamed, g_free);
+	sipe_xml_free(xml);
+}
+
+
 /* memory leak check */
 static gsize allocated = 0;
 
@@ -422,6 +544,49 @@ int main(SIPE_UNUSED_PARAMETER int argc, SIPE_UNUSED_PARAMETER char **argv)
 	assert_data(child1, "15500");
 	sipe_xml_free(xml);
 
+	/* mixed content */
+	xml = assert_parse("<test>a<child>b</child>c<child/>d</test>", TRUE);
+	assert_data(xml, "acd");
+	child1 = assert_child(xml, "child", TRUE);
+	assert_data(child1, "b");
+	sipe_xml_free(xml);
+
+	/*
+	 * text node larger than an arena block, e.g. base64 picture data.
+	 * libxml2 delivers it in pieces split at the entities.
+	 */
+	{
+		GString *line_breaks = g_string_new("<test>");
+		GString *expected    = g_string_new(NULL);
+		gchar *text, *s, *data;
+		gsize length;
+
+		while (expected->len < 256 * 1024) {
+			g_string_append(line_breaks, "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA&#13;\n");
+			g_string_append(expected,    "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA\r\n");
+		}
+		g_string_append(line_breaks, "</test>");
+		length = expected->len;
+		text   = g_string_free(expected, FALSE);
+		s      = g_string_free(line_breaks, FALSE);
+		xml = assert_parse(s, TRUE);
+		teststring = "<test>(256KB text)</test>";
+		data = sipe_xml_data(xml);
+		if (sipe_strequal(data, text)) {
+			succeeded++;
+		} else {
+			printf("[%s]\nXML data FAILED: length %" G_GSIZE_FORMAT "\n",
+			       teststring, data ? strlen(data) : 0);
+			failed++;
+		}
+		/* text must be stored only once */
+		assert_size(xml, length + 8192);
+		g_free(data);
+		sipe_xml_free(xml);
+		g_free(s);
+		g_free(text);
+	}
+
 	/* broken XML */
 	xml = assert_parse("t", FALSE);
 	sipe_xml_free(xml);
@@ -473,6 +638,93 @@ int main(SIPE_UNUSED_PARAMETER int argc, SIPE_UNUSED_PARAMETER char **argv)
 	assert_raw("<ns:tag>data</tag1>",    "tag",     FALSE, NULL);
 	assert_raw("<ns:tag>data</ns:tag1>", "tag",     FALSE, NULL);
 
+	/* streaming parser */
+	{
+		static const struct sipe_xml_stream_path root_end[] = {
+			{ "",    NULL,         stream_end },
+			{ NULL,  NULL,         NULL       }
+		};
+		static const struct sipe_xml_stream_path root_start[] = {
+			{ "",    stream_start, NULL       },
+			{ NULL,  NULL,         NULL       }
+		};
+		static const struct sipe_xml_stream_path nested[] = {
+			{ "a",   stream_start, NULL       },
+			{ "a/b", NULL,         stream_end },
+			{ NULL,  NULL,         NULL       }
+		};
+		static const struct sipe_xml_stream_path start_end[] = {
+			{ "a",   stream_start, stream_end },
+			{ NULL,  NULL,         NULL       }
+		};
+		static const struct sipe_xml_stream_path subtree[] = {
+			{ "a",   NULL,         stream_end },
+			{ "a/b", stream_start, stream_end },
+			{ NULL,  NULL,         NULL       }
+		};
+		static const struct sipe_xml_stream_path none[] = {
+			{ NULL,  NULL,         NULL       }
+		};
+		static const gchar doc[] =
+			"<r x=\"0\">"
+			"<a n=\"1\"><b>one</b><c/></a>"
+			"<ns:a n=\"2\"><ns:b>two</ns:b></ns:a>"
+			"<d><a n=\"3\"/></d>"
+			"</r>";
+
+		assert_stream(NULL, root_end, 0, FALSE, "");
+		assert_stream("",   root_end, 0, FALSE, "");
+		assert_stream(doc,  none,     0, TRUE,  "");
+		assert_stream(doc,  root_end, 0, TRUE,
+			      "E<r x=\"0\"><a n=\"1\"><b>one</b><c/></a><a n=\"2\"><b>two</b></a><d><a n=\"3\"/></d></r>");
+		assert_stream(doc,  root_start, 0, TRUE,
+			      "S<r x=\"0\"/>");
+		assert_stream(doc,  nested, 0, TRUE,
+			      "S<a n=\"1\"/>E<b>one</b>S<a n=\"2\"/>E<b>two</b>");
+		assert_stream(doc,  start_end, 0, TRUE,
+			      "S<a n=\"1\"/>E<a n=\"1\"><b>one</b><c/></a>S<a n=\"2\"/>E<a n=\"2\"><b>two</b></a>");
+
+		/* callback returns FALSE */
+		assert_stream(doc,  start_end, 1, FALSE,
+			      "S<a n=\"1\"/>");
+		assert_stream(doc,  start_end, 3, FALSE,
+			      "S<a n=\"1\"/>E<a n=\"1\"><b>one</b><c/></a>S<a n=\"2\"/>");
+
+		/* a/b is inside of the captured subtree of a */
+		assert_stream(doc,  subtree, 0, TRUE,
+			      "E<a n=\"1\"><b>one</b><c/></a>E<a n=\"2\"><b>two</b></a>");
+
+		/* parser error after callbacks have been called */
+		assert_stream("<r><a n=\"1\"/><a n=\"2\"/><a n=\"3\"</r>", start_end, 0, FALSE,
+			      "S<a n=\"1\"/>E<a n=\"1\"/>S<a n=\"2\"/>E<a n=\"2\"/>");
+		assert_stream("<r><a>1</a></b>", root_end, 0, FALSE, "");
+
+		/* RLMI document */
+		assert_stream_tree("<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" uri=\"sip:alice@contoso.com\" version=\"1\" fullState=\"false\">"
+				   "<resource uri=\"sip:bob@contoso.com\" name=\"Bob\">"
+				   "<instance id=\"1\" state=\"active\" cid=\"1@contoso.com\"/>"
+				   "</resource>"
+				   "<resource uri=\"sip:carol@contoso.com\">"
+				   "<instance id=\"2\" state=\"terminated\" reason=\"rejected\"/>"
+				   "</resource>"
+				   "<resource uri=\"sip:dave@contoso.com\">"
+				   "<instance id=\"3\" state=\"active\" cid=\"3@contoso.com\">"
+				   "<categories xmlns=\"http://schemas.microsoft.com/2006/09/sip/categories\" uri=\"sip:dave@contoso.com\">"
+				   "<category name=\"state\" instance=\"0\" publishTime=\"2016-01-01T00:00:00Z\">"
+				   "<state xmlns=\"http://schemas.microsoft.com/2006/09/sip/state\" type=\"aggregateState\">"
+				   "<availability>3500</availability>"
+				   "</state>"
+				   "</category>"
+				   "<category name=\"note\"><note><body type=\"personal\">Hello &amp; bye</body></note></category>"
+				   "</categories>"
+				   "</instance>"
+				   "</resource>"
+				   "</list>",
+				   "resource");
+		assert_stream_tree("<list><resource uri=\"sip:bob@contoso.com\"><instance id=\"1\"/></resource></list>",
+				   "resource/instance");
+	}
+
 	if (allocated) {
 		printf("MEMORY LEAK: %" G_GSIZE_FORMAT " still allocated\n", allocated);
 		failed++;
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -38,30 +38,195 @@
 #include "sipe-utils.h"
 #include "sipe-xml.h"
 
+/*
+ * All memory for a parsed document is taken from one arena, i.e. a list
+ * of large blocks. Nodes are never freed individually: sipe_xml_free()
+ * on the root node releases the whole document at once.
+ */
+#define SIPE_XML_ARENA_BLOCK 4096
+#define SIPE_XML_ARENA_ALIGN (2 * sizeof(gpointer))
+
+struct sipe_xml_arena_block {
+	struct sipe_xml_arena_block *next;
+	gsize size;
+	gsize used;
+	/* data follows */
+};
+
+struct sipe_xml_attribute {
+	const gchar *name;  /* interned */
+	const gchar *value;
+};
+
 struct _sipe_xml {
-	gchar *name;
+	const gchar *name;  /* interned */
 	sipe_xml *parent;
 	sipe_xml *sibling;
 	sipe_xml *first;
 	sipe_xml *last;
-	GString *data;
-	GHashTable *attributes;
+	gchar *data;
+	gsize data_length;
+	struct sipe_xml_attribute *attributes;
+	guint attribute_count;
+};
+
+/* root node of a document */
+struct sipe_xml_document {
+	sipe_xml root;      /* must be first */
+	struct sipe_xml_arena_block *blocks;
 };
 
 struct _parser_data {
-	sipe_xml *root;
+	struct sipe_xml_document *document;
 	sipe_xml *current;
+	GHashTable *names;  /* name -> interned copy in arena */
+	GString *text;      /* text of current element not yet in arena */
 	gboolean error;
 };
 
-/* our string equal function is case insensitive -> hash must be too! */
-static guint sipe_ascii_strdown_hash(gconstpointer key)
+#define SIPE_XML_ARENA_ROUND(size) (((size) + SIPE_XML_ARENA_ALIGN - 1) & ~(SIPE_XML_ARENA_ALIGN - 1))
+#define BLOCK_HEADER      SIPE_XML_ARENA_ROUND(sizeof(struct sipe_xml_arena_block))
+#define BLOCK_DATA(block) ((gchar *) (block) + BLOCK_HEADER)
+
+static gpointer sipe_xml_arena_alloc(struct sipe_xml_document *document,
+				     gsize size)
+{
+	struct sipe_xml_arena_block *block = document->blocks;
+	gpointer mem;
+
+	size = SIPE_XML_ARENA_ROUND(size);
+
+	if (!block || (block->size - block->used < size)) {
+		gsize block_size = MAX(size, SIPE_XML_ARENA_BLOCK);
+
+		block = g_malloc(BLOCK_HEADER + block_size);
+		block->size = block_size;
+		block->used = 0;
+
+		/* keep the current block with free space at the head */
+		if (document->blocks && (block_size == size)) {
+			block->next = document->blocks->next;
+			document->blocks->next = block;
+		} else {
+			block->next = document->blocks;
+			document->blocks = block;
+		}
+	}
+
+	mem = BLOCK_DATA(block) + block->used;
+	block->used += size;
+	return(mem);
+}
+
+static gchar *sipe_xml_arena_strndup(struct sipe_xml_document *document,
+				     const gchar *string,
+				     gsize length)
 {
-	gchar *lc = g_ascii_strdown((const gchar *) key, -1);
-	guint bucket = g_str_hash(lc);
-	g_free(lc);
+	gchar *copy = sipe_xml_arena_alloc(document, length + 1);
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	return(copy);
+}
+
+static void sipe_xml_arena_free(struct sipe_xml_document *document)
+{
+	struct sipe_xml_arena_block *block = document->blocks;
+
+	while (block) {
+		struct sipe_xml_arena_block *next = block->next;
+		g_free(block);
+		block = next;
+	}
+	g_free(document);
+}
+
+/* release all nodes but keep one arena block for reuse */
+static void sipe_xml_document_reset(struct _parser_data *pd)
+{
+	struct sipe_xml_document *document = pd->document;
+
+	if (document) {
+		struct sipe_xml_arena_block *block = document->blocks;
+
+		if (block) {
+			struct sipe_xml_arena_block *next = block->next;
+			while (next) {
+				struct sipe_xml_arena_block *tmp = next->next;
+				g_free(next);
+				next = tmp;
+			}
+			block->next = NULL;
+			block->used = 0;
+		}
+		memset(&document->root, 0, sizeof(sipe_xml));
+	}
+
+	/* interned names were stored in the arena */
+	g_hash_table_remove_all(pd->names);
+	g_string_truncate(pd->text, 0);
+	pd->current = NULL;
+}
+
+static const gchar *sipe_xml_intern(struct _parser_data *pd,
+				    const gchar *name)
+{
+	gchar *interned = g_hash_table_lookup(pd->names, name);
+
+	if (!interned) {
+		interned = sipe_xml_arena_strndup(pd->document, name, strlen(name));
+		g_hash_table_insert(pd->names, interned, interned);
+	}
 
-	return(bucket);
+	return(interned);
+}
+
+/* libxml2 decodes all entities except &amp;.
+   &amp; is replaced by the equivalent &#38; */
+static const gchar *sipe_xml_attribute_value(struct sipe_xml_document *document,
+					     const gchar *value)
+{
+	gchar *copy = sipe_xml_arena_strndup(document, value, strlen(value));
+	gchar *read = strstr(copy, "&#38;");
+
+	if (read) {
+		gchar *write = read;
+
+		while (*read) {
+			if (g_str_has_prefix(read, "&#38;")) {
+				*write++ = '&';
+				read += 5;
+			} else {
+				*write++ = *read++;
+			}
+		}
+		*write = '\0';
+	}
+
+	return(copy);
+}
+
+/*
+ * libxml2 delivers text in small pieces. Collect them outside of the arena
+ * and copy the text into the arena once the element is closed or, for
+ * mixed content, a child element is opened.
+ */
+static void sipe_xml_text_flush(struct _parser_data *pd)
+{
+	sipe_xml *node = pd->current;
+	gchar *data;
+
+	if (!node || !pd->text->len) return;
+
+	data = sipe_xml_arena_alloc(pd->document,
+				    node->data_length + pd->text->len + 1);
+	if (node->data)
+		memcpy(data, node->data, node->data_length);
+	memcpy(data + node->data_length, pd->text->str, pd->text->len);
+	node->data_length += pd->text->len;
+	data[node->data_length] = '\0';
+	node->data = data;
+
+	g_string_truncate(pd->text, 0);
 }
 
 static void callback_start_element(void *user_data, const xmlChar *name, const xmlChar **attrs)
@@ -72,18 +237,21 @@ static void callback_start_element(void *user_data, const xmlChar *name, const x
 
 	if (!name || pd->error) return;
 
-	node = g_new0(sipe_xml, 1);
+	sipe_xml_text_flush(pd);
 
 	if ((tmp = strchr((char *)name, ':')) != NULL) {
 		name = (xmlChar *)tmp + 1;
 	}
-	node->name = g_strdup((gchar *)name);
 
-	if (!pd->root) {
-		pd->root = node;
+	if (!pd->current) {
+		if (!pd->document)
+			pd->document = g_new0(struct sipe_xml_document, 1);
+		node = &pd->document->root;
 	} else {
 		sipe_xml *current = pd->current;
 
+		node = sipe_xml_arena_alloc(pd->document, sizeof(sipe_xml));
+		memset(node, 0, sizeof(sipe_xml));
 		node->parent = current;
 		if (current->last) {
 			current->last->sibling = node;
@@ -92,22 +260,26 @@ static void callback_start_element(void *user_data, const xmlChar *name, const x
 		}
 		current->last = node;
 	}
+	node->name = sipe_xml_intern(pd, (const gchar *) name);
 
 	if (attrs) {
-		const xmlChar *key;
+		const xmlChar **count;
+		struct sipe_xml_attribute *attribute;
 
-		node->attributes = g_hash_table_new_full(sipe_ascii_strdown_hash,
-							 (GEqualFunc) sipe_strcase_equal,
-							 g_free, g_free);
-		while ((key = *attrs++) != NULL) {
+		for (count = attrs; *count; count += 2)
+			node->attribute_count++;
+		node->attributes = attribute = sipe_xml_arena_alloc(pd->document,
+								    node->attribute_count * sizeof(struct sipe_xml_attribute));
+
+		while (*attrs) {
+			const xmlChar *key = *attrs++;
 			if ((tmp = strchr((char *)key, ':')) != NULL) {
 				key = (xmlChar *)tmp + 1;
 			}
-			/* libxml2 decodes all entities except &amp;.
-			   &amp; is replaced by the equivalent &#38; */
-			g_hash_table_insert(node->attributes,
-					    g_strdup((gchar *) key),
-					    sipe_utils_str_replace((gchar *) *attrs++, "&#38;", "&"));
+			attribute->name  = sipe_xml_intern(pd, (const gchar *) key);
+			attribute->value = sipe_xml_attribute_value(pd->document,
+								    (const gchar *) *attrs++);
+			attribute++;
 		}
 	}
 
@@ -120,6 +292,8 @@ static void callback_end_element(void *user_data, const xmlChar *name)
 
 	if (!name || !pd->current || pd->error) return;
 
+	sipe_xml_text_flush(pd);
+
 	if (pd->current->parent)
 		pd->current = pd->current->parent;
 }
@@ -127,15 +301,10 @@ static void callback_end_element(void *user_data, const xmlChar *name)
 static void callback_characters(void *user_data, const xmlChar *text, int text_len)
 {
 	struct _parser_data *pd = user_data;
-	sipe_xml *node;
 
 	if (!pd->current || pd->error || !text || !text_len) return;
 
-	node = pd->current;
-	if (node->data)
-		node->data = g_string_append_len(node->data, (gchar *)text, text_len);
-	else
-		node->data = g_string_new_len((gchar *)text, text_len);
+	g_string_append_len(pd->text, (const gchar *) text, text_len);
 }
 
 static void callback_error(void *user_data, const char *msg, ...)
@@ -217,70 +386,259 @@ sipe_xml *sipe_xml_parse(const gchar *string, gsize length)
 	if (string && length) {
 		struct _parser_data *pd = g_new0(struct _parser_data, 1);
 
+		pd->names = g_hash_table_new(g_str_hash, g_str_equal);
+		pd->text  = g_string_new(NULL);
+
 		if (xmlSAXUserParseMemory(&parser, pd, string, length))
 			pd->error = TRUE;
 
-		if (pd->error) {
-			sipe_xml_free(pd->root);
-		} else {
-			result = pd->root;
+		if (pd->document) {
+			if (pd->error) {
+				sipe_xml_arena_free(pd->document);
+			} else {
+				result = &pd->document->root;
+			}
 		}
 
+		g_hash_table_destroy(pd->names);
+		g_string_free(pd->text, TRUE);
 		g_free(pd);
 	}
 
 	return result;
 }
 
-void sipe_xml_free(sipe_xml *node)
+/*
+ * Streaming parser
+ *
+ * Elements outside of a matched path are not stored. The subtree of an
+ * element with an end callback is captured with the normal tree callbacks
+ * into a document that is reset after the callback has been called.
+ */
+struct _stream_data {
+	struct _parser_data capture; /* must be first: error callbacks */
+	struct _parser_data scratch; /* start callbacks without capture */
+	const struct sipe_xml_stream_path *paths;
+	const struct sipe_xml_stream_path *capturing;
+	gpointer user_data;
+	GString *path;               /* path of current element */
+	GArray *path_lengths;        /* gsize: path->len before each open element */
+	guint capture_depth;
+	gboolean stopped;
+};
+
+static void stream_start_element(void *user_data, const xmlChar *name, const xmlChar **attrs)
 {
-	sipe_xml *child;
+	struct _stream_data *sd = user_data;
+	const struct sipe_xml_stream_path *path;
+	const char *tmp;
+	gsize length;
 
+	if (!name || sd->capture.error || sd->stopped) return;
+
+	if (sd->capture_depth) {
+		sd->capture_depth++;
+		callback_start_element(&sd->capture, name, attrs);
+		return;
+	}
+
+	if ((tmp = strchr((char *)name, ':')) != NULL) {
+		tmp++;
+	} else {
+		tmp = (const char *) name;
+	}
+	length = sd->path->len;
+	g_array_append_val(sd->path_lengths, length);
+	/* root element has the empty path */
+	if (sd->path_lengths->len > 1) {
+		if (sd->path->len)
+			g_string_append_c(sd->path, '/');
+		g_string_append(sd->path, tmp);
+	}
+
+	for (path = sd->paths; path->path; path++) {
+		if (strcmp(path->path, sd->path->str) == 0) {
+			const sipe_xml *node;
+
+			if (path->end) {
+				sd->capturing     = path;
+				sd->capture_depth = 1;
+				callback_start_element(&sd->capture, name, attrs);
+				node = &sd->capture.document->root;
+			} else {
+				callback_start_element(&sd->scratch, name, attrs);
+				node = &sd->scratch.document->root;
+			}
+
+			if (path->start && !(*path->start)(node, sd->user_data))
+				sd->stopped = TRUE;
+
+			if (!path->end)
+				sipe_xml_document_reset(&sd->scratch);
+			break;
+		}
+	}
+}
+
+static void stream_end_element(void *user_data, const xmlChar *name)
+{
+	struct _stream_data *sd = user_data;
+
+	if (!name || sd->capture.error || sd->stopped) return;
+
+	if (sd->capture_depth) {
+		if (--sd->capture_depth) {
+			callback_end_element(&sd->capture, name);
+			return;
+		}
+
+		/* root of the capture: callback_end_element() isn't called */
+		sipe_xml_text_flush(&sd->capture);
+		if (!(*sd->capturing->end)(&sd->capture.document->root,
+					   sd->user_data))
+			sd->stopped = TRUE;
+		sipe_xml_document_reset(&sd->capture);
+	}
+
+	if (sd->path_lengths->len) {
+		g_string_truncate(sd->path,
+				  g_array_index(sd->path_lengths,
+						gsize,
+						sd->path_lengths->len - 1));
+		g_array_set_size(sd->path_lengths, sd->path_lengths->len - 1);
+	}
+}
+
+static void stream_characters(void *user_data, const xmlChar *text, int text_len)
+{
+	struct _stream_data *sd = user_data;
+
+	/* text is only stored inside captured subtrees */
+	if (sd->capture_depth && !sd->stopped)
+		callback_characters(&sd->capture, text, text_len);
+}
+
+/* API doesn't accept const data structure */
+static xmlSAXHandler stream_parser = {
+	NULL,                   /* internalSubset */
+	NULL,                   /* isStandalone */
+	NULL,                   /* hasInternalSubset */
+	NULL,                   /* hasExternalSubset */
+	NULL,                   /* resolveEntity */
+	NULL,                   /* getEntity */
+	NULL,                   /* entityDecl */
+	NULL,                   /* notationDecl */
+	NULL,                   /* attributeDecl */
+	NULL,                   /* elementDecl */
+	NULL,                   /* unparsedEntityDecl */
+	NULL,                   /* setDocumentLocator */
+	NULL,                   /* startDocument */
+	NULL,                   /* endDocument */
+	stream_start_element,   /* startElement */
+	stream_end_element,     /* endElement   */
+	NULL,                   /* reference */
+	stream_characters,      /* characters */
+	NULL,                   /* ignorableWhitespace */
+	NULL,                   /* processingInstruction */
+	NULL,                   /* comment */
+	NULL,                   /* warning */
+	callback_error,         /* error */
+	NULL,                   /* fatalError */
+	NULL,                   /* getParameterEntity */
+	NULL,                   /* cdataBlock */
+	NULL,                   /* externalSubset */
+	XML_SAX2_MAGIC,         /* initialized */
+	NULL,                   /* _private */
+	NULL,                   /* startElementNs */
+	NULL,                   /* endElementNs   */
+	callback_serror,        /* serror */
+};
+
+gboolean sipe_xml_stream_parse(const gchar *string,
+			       gsize length,
+			       const struct sipe_xml_stream_path *paths,
+			       gpointer user_data)
+{
+	struct _stream_data *sd;
+	gboolean result;
+
+	if (!string || !length || !paths) return(FALSE);
+
+	sd = g_new0(struct _stream_data, 1);
+	sd->capture.names = g_hash_table_new(g_str_hash, g_str_equal);
+	sd->scratch.names = g_hash_table_new(g_str_hash, g_str_equal);
+	sd->capture.text  = g_string_new(NULL);
+	sd->scratch.text  = g_string_new(NULL);
+	sd->paths         = paths;
+	sd->user_data     = user_data;
+	sd->path          = g_string_new("");
+	sd->path_lengths  = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+	if (xmlSAXUserParseMemory(&stream_parser, sd, string, length))
+		sd->capture.error = TRUE;
+	result = !sd->capture.error && !sd->stopped;
+
+	if (sd->capture.document)
+		sipe_xml_arena_free(sd->capture.document);
+	if (sd->scratch.document)
+		sipe_xml_arena_free(sd->scratch.document);
+	g_hash_table_destroy(sd->capture.names);
+	g_hash_table_destroy(sd->scratch.names);
+	g_string_free(sd->capture.text, TRUE);
+	g_string_free(sd->scratch.text, TRUE);
+	g_string_free(sd->path, TRUE);
+	g_array_free(sd->path_lengths, TRUE);
+	g_free(sd);
+
+	return(result);
+}
+
+void sipe_xml_free(sipe_xml *node)
+{
 	if (!node) return;
 
 	/* we don't support partial tree deletion */
 	if (node->parent != NULL) {
-		SIPE_DEBUG_ERROR_NOFORMAT("sipe_xml_free: partial delete attempt! Expect crash or memory leaks...");
-	}
-
-	/* free children */
-	child = node->first;
-	while (child) {
-		sipe_xml *tmp = child->sibling;
-		child->parent = NULL; /* detach from tree, see above */
-		sipe_xml_free(child);
-		child = tmp;
+		SIPE_DEBUG_ERROR_NOFORMAT("sipe_xml_free: partial delete attempt! Ignored.");
+		return;
 	}
 
-	/* free node */
-	g_free(node->name);
-	if (node->data)       g_string_free(node->data, TRUE);
-	if (node->attributes) g_hash_table_destroy(node->attributes);
-	g_free(node);
+	/* root node is the start of the document */
+	sipe_xml_arena_free((struct sipe_xml_document *) node);
 }
 
-static void sipe_xml_stringify_attribute(gpointer key, gpointer value,
-					 gpointer user_data)
+gsize sipe_xml_size(const sipe_xml *xml)
 {
-	g_string_append_printf(user_data, " %s=\"%s\"",
-			       (const gchar *) key, (const gchar *) value);
+	const struct sipe_xml_arena_block *block;
+	gsize size = 0;
+
+	/* only the root node knows the document */
+	if (!xml || xml->parent) return(0);
+
+	for (block = ((const struct sipe_xml_document *) xml)->blocks;
+	     block;
+	     block = block->next)
+		size += BLOCK_HEADER + block->size;
+
+	return(size);
 }
 
 static void sipe_xml_stringify_node(GString *s, const sipe_xml *node)
 {
+	guint i;
+
 	g_string_append_printf(s, "<%s", node->name);
 
-	if (node->attributes) {
-		g_hash_table_foreach(node->attributes,
-				     (GHFunc) sipe_xml_stringify_attribute,
-				     s);
-	}
+	for (i = 0; i < node->attribute_count; i++)
+		g_string_append_printf(s, " %s=\"%s\"",
+				       node->attributes[i].name,
+				       node->attributes[i].value);
 
 	if (node->data || node->first) {
 		const sipe_xml *child;
 
 		g_string_append_printf(s, ">%s",
-				       node->data ? node->data->str : "");
+				       node->data ? node->data : "");
 
 		for (child = node->first; child; child = child->sibling)
 			sipe_xml_stringify_node(s, child);
@@ -304,25 +662,26 @@ gchar *sipe_xml_stringify(const sipe_xml *node)
 
 const sipe_xml *sipe_xml_child(const sipe_xml *parent, const gchar *name)
 {
-	gchar **names;
 	const sipe_xml *child = NULL;
+	const gchar *next;
+	gsize length;
 
 	if (!parent || !name) return NULL;
 
-	/* 0: child name */
-	/* 1: trailing path (optional) */
-	names = g_strsplit(name, "/", 2);
+	/* child name, followed by optional trailing path */
+	next = strchr(name, '/');
+	length = next ? (gsize) (next - name) : strlen(name);
 
 	for (child = parent->first; child; child = child->sibling) {
-		if (sipe_strequal(names[0], child->name))
+		if ((strncmp(name, child->name, length) == 0) &&
+		    (child->name[length] == '\0'))
 			break;
 	}
 
 	/* recurse into path */
-	if (child && names[1])
-		child = sipe_xml_child(child, names[1]);
+	if (child && next)
+		child = sipe_xml_child(child, next + 1);
 
-	g_strfreev(names);
 	return child;
 }
 
@@ -346,8 +705,15 @@ const gchar *sipe_xml_name(const sipe_xml *node)
 
 const gchar *sipe_xml_attribute(const sipe_xml *node, const gchar *attr)
 {
-	if (!node || !attr || !node->attributes) return NULL;
-	return(g_hash_table_lookup(node->attributes, attr));
+	guint i;
+
+	if (!node || !attr) return NULL;
+
+	for (i = 0; i < node->attribute_count; i++)
+		if (g_ascii_strcasecmp(node->attributes[i].name, attr) == 0)
+			return(node->attributes[i].value);
+
+	return(NULL);
 }
 
 guint sipe_xml_int_attribute(const sipe_xml *node, const gchar *attr,
@@ -359,8 +725,8 @@ guint sipe_xml_int_attribute(const sipe_xml *node, const gchar *attr,
 
 gchar *sipe_xml_data(const sipe_xml *node)
 {
-	if (!node || !node->data || !node->data->str) return NULL;
-	return g_strdup(node->data->str);
+	if (!node || !node->data) return NULL;
+	return g_strndup(node->data, node->data_length);
 }
 
 /**
@@ -375,17 +741,13 @@ void sipe_xml_dump(const sipe_xml *node, const gchar *path)
 	gchar *new_path;
 	if (!node) return;
 	new_path = g_strdup_printf("%s/%s", path ? path : "", node->name);
-	if (node->attributes) {
-		GList *attrs = g_hash_table_get_keys(node->attributes);
+	if (node->attribute_count) {
 		GString *buf = g_string_new("");
-		GList *entry = attrs;
-		while (entry) {
-			g_string_append_printf(buf, "%s ", (gchar *)entry->data);
-			entry = entry->next;
-		}
+		guint i;
+		for (i = 0; i < node->attribute_count; i++)
+			g_string_append_printf(buf, "%s ", node->attributes[i].name);
 		SIPE_DEBUG_INFO("%s [%s]", new_path, buf->str);
 		g_string_free(buf, TRUE);
-		g_list_free(attrs);
 	} else {
 		SIPE_DEBUG_INFO_NOFORMAT(new_path);
 	}
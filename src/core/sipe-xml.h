@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-11 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -39,6 +39,15 @@ sipe_xml *sipe_xml_parse(const gchar *string, gsize length);
  */
 void sipe_xml_free(sipe_xml *xml);
 
+/**
+ * Memory used by parsed XML information.
+ *
+ * @param xml Root node returned by @c sipe_xml_parse().
+ *
+ * @return Size in bytes or 0 for a non-root node.
+ */
+gsize sipe_xml_size(const sipe_xml *xml);
+
 /**
  * Convert XML information to string.
  *
@@ -108,6 +117,52 @@ guint sipe_xml_int_attribute(const sipe_xml *node, const gchar *attr,
  */
 gchar *sipe_xml_data(const sipe_xml *node);
 
+/**
+ * Streaming XML parser
+ *
+ * No tree is built for the whole document. Instead the caller registers
+ * interest in element paths and gets callbacks while the document is
+ * parsed. Memory usage therefore doesn't grow with document size.
+ *
+ * A path is relative to the root element, using the same syntax as
+ * @c sipe_xml_child() (a, a/b, a/b/c, etc.). The empty path "" matches
+ * the root element itself.
+ *
+ * - start: called when the element is opened. The node only has a name
+ *          and attributes, i.e. no children or data yet.
+ * - end:   called when the element is closed. The node contains the
+ *          complete subtree below the element. Paths inside such a
+ *          subtree are not matched.
+ *
+ * Nodes are only valid during the callback. Return @c FALSE from a
+ * callback to stop parsing.
+ */
+typedef gboolean (*sipe_xml_stream_callback)(const sipe_xml *node,
+					     gpointer user_data);
+
+struct sipe_xml_stream_path {
+	const gchar *path;
+	sipe_xml_stream_callback start; /* can be NULL */
+	sipe_xml_stream_callback end;   /* can be NULL */
+};
+
+/**
+ * Parse XML from a string with callbacks.
+ *
+ * NOTE: callbacks may have been called before a parser error is detected!
+ *
+ * @param string    String with the XML to be parsed.
+ * @param length    Length of the string.
+ * @param paths     Array of paths, terminated by an entry with path @c NULL.
+ * @param user_data Passed to callbacks.
+ *
+ * @return @c TRUE if the whole document has been parsed successfully
+ */
+gboolean sipe_xml_stream_parse(const gchar *string,
+			       gsize length,
+			       const struct sipe_xml_stream_path *paths,
+			       gpointer user_data);
+
 /**
  * For debugging while writing XML processing code.
  * NOTE: the code for this function is flagged out by default!
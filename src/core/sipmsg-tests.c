@@ -0,0 +1,378 @@
+/**
+ * @file sipmsg-tests.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Tests for sipmsg.c header parser
+ *
+ * Usage: sipmsg_tests [<benchmark iterations>]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <glib.h>
+
+#include "sipe-common.h"
+
+#include "sipmsg.c"
+#include "sipe-test-allocations.h"
+
+/*
+ * Stubs
+ */
+gboolean sipe_backend_debug_enabled(void)
+{
+	return(FALSE);
+}
+
+void sipe_backend_debug_literal(sipe_debug_level level,
+				const gchar *msg)
+{
+	printf("DEBUG(%d): %s\n", level, msg);
+}
+
+void sipe_backend_debug(sipe_debug_level level,
+			const gchar *format,
+			...)
+{
+	va_list ap;
+	gchar *newformat = g_strdup_printf("DEBUG(%d): %s\n", level, format);
+
+	va_start(ap, format);
+	vprintf(newformat, ap);
+	va_end(ap);
+
+	g_free(newformat);
+}
+
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public)
+{
+	return(NULL);
+}
+
+gchar *sipe_backend_markup_css_property(SIPE_UNUSED_PARAMETER const gchar *style,
+					SIPE_UNUSED_PARAMETER const gchar *option)
+{
+	return(NULL);
+}
+
+void sipe_mime_parts_foreach(SIPE_UNUSED_PARAMETER const gchar *type,
+			     SIPE_UNUSED_PARAMETER const gchar *body,
+			     SIPE_UNUSED_PARAMETER sipe_mime_parts_cb callback,
+			     SIPE_UNUSED_PARAMETER gpointer user_data)
+{
+}
+
+char *generateUUIDfromEPID(SIPE_UNUSED_PARAMETER const gchar *epid)
+{
+	return(NULL);
+}
+
+char *sipe_get_epid(SIPE_UNUSED_PARAMETER const char *self_sip_uri,
+		    SIPE_UNUSED_PARAMETER const char *hostname,
+		    SIPE_UNUSED_PARAMETER const char *ip_address)
+{
+	return(NULL);
+}
+
+/*
+ * Tester code
+ */
+static guint succeeded = 0;
+static guint failed    = 0;
+
+static void assert_header(const struct sipmsg *msg,
+			  const gchar *name,
+			  int which,
+			  const gchar *expected)
+{
+	const gchar *value = sipmsg_find_header_instance(msg, name, which);
+
+	if (sipe_strequal(value, expected)) {
+		succeeded++;
+	} else {
+		printf("header '%s'[%d] FAILED: '%s' expected: '%s'\n",
+		       name, which,
+		       value ? value : "(nil)",
+		       expected ? expected : "(nil)");
+		failed++;
+	}
+}
+
+static void assert_string(const gchar *what,
+			  const gchar *value,
+			  const gchar *expected)
+{
+	if (sipe_strequal(value, expected)) {
+		succeeded++;
+	} else {
+		printf("%s FAILED: '%s' expected: '%s'\n",
+		       what,
+		       value ? value : "(nil)",
+		       expected ? expected : "(nil)");
+		failed++;
+	}
+}
+
+static void assert_int(const gchar *what, int value, int expected)
+{
+	if (value == expected) {
+		succeeded++;
+	} else {
+		printf("%s FAILED: %d expected: %d\n", what, value, expected);
+		failed++;
+	}
+}
+
+/* header parser before the header index was introduced */
+static struct sipmsg *legacy_parse_header(const gchar *header)
+{
+	struct sipmsg *msg = g_new0(struct sipmsg, 1);
+	gchar **lines = g_strsplit(header, "\r\n", 0);
+	gchar **parts;
+
+	if (!lines[0]) {
+		g_strfreev(lines);
+		g_free(msg);
+		return(NULL);
+	}
+	parts = g_strsplit(lines[0], " ", 3);
+	if (!parts[0] || !parts[1] || !parts[2]) {
+		g_strfreev(parts);
+		g_strfreev(lines);
+		g_free(msg);
+		return(NULL);
+	}
+	if (strstr(parts[0], "SIP") || strstr(parts[0], "HTTP")) {
+		msg->responsestr = g_strdup(parts[2]);
+		msg->response = strtol(parts[1], NULL, 10);
+	} else {
+		msg->method = g_strdup(parts[0]);
+		msg->target = g_strdup(parts[1]);
+	}
+	g_strfreev(parts);
+	sipe_utils_parse_lines(&msg->headers, lines + 1, ":");
+	g_strfreev(lines);
+	msg->bodylen = strtol(sipe_utils_nameval_find(msg->headers,
+						      "Content-Length"),
+			      NULL, 10);
+	return(msg);
+}
+
+static const gchar *legacy_find_header(const struct sipmsg *msg,
+				       const gchar *name)
+{
+	return(sipe_utils_nameval_find(msg->headers, name));
+}
+
+typedef struct sipmsg *(*parse_function)(const gchar *header);
+typedef const gchar *(*find_function)(const struct sipmsg *msg,
+				      const gchar *name);
+
+static const gchar * const benchmark_lookups[] = {
+	"Call-ID", "CSeq", "From", "To", "Event", "Content-Type",
+	"Content-Length", "Authentication-Info", "Subscription-State",
+	"ms-diagnostics", /* not present */
+	NULL
+};
+
+static void benchmark(const gchar *label,
+		      const gchar *header,
+		      guint iterations,
+		      parse_function parse,
+		      find_function find)
+{
+	gsize start_allocations = sipe_test_allocations;
+	GTimer *timer = g_timer_new();
+	gdouble elapsed;
+	guint i;
+
+	for (i = 0; i < iterations; i++) {
+		struct sipmsg *msg = (*parse)(header);
+		const gchar * const *name;
+
+		for (name = benchmark_lookups; *name; name++)
+			(void) (*find)(msg, *name);
+		sipmsg_free(msg);
+	}
+
+	elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	printf("%-8s %8.0f ns/message %6s allocations/message\n",
+	       label,
+	       elapsed * 1e9 / iterations,
+	       sipe_test_allocations_per(start_allocations, iterations));
+}
+
+/* BENOTIFY as received during a presence storm */
+static const gchar benotify[] =
+	"BENOTIFY sip:user@example.com;transport=tls;ms-opaque=d3470f2e1d;ms-received-cid=1F00;grid SIP/2.0\r\n"
+	"ms-user-logon-data: RemoteUser\r\n"
+	"Via: SIP/2.0/TLS 192.168.1.1:5061;branch=z9hG4bKF2D1CB8B.0CBB1A4B0B8D7C4E;branched=FALSE;ms-internal-info=\"ck9lUWkq7aZyEdxa7uI4Nl2sFCLdm7ljQUKkL9bwAA\"\r\n"
+	"Authentication-Info: TLS-DSK qop=\"auth\", opaque=\"ADDF7D10\", srand=\"CA45D5F1\", snum=\"2021\", rspauth=\"03f9d1f0b6c3e0e3d2fbd0b6a2a8be1fa6a5d9a7\", targetname=\"server.example.com\", realm=\"SIP Communications Service\", version=4\r\n"
+	"Max-Forwards: 68\r\n"
+	"Content-Length: 0\r\n"
+	"From: <sip:user@example.com>;tag=FE2EF63C5E2B9CBB\r\n"
+	"To: <sip:user@example.com>;tag=9c2d7cfe1b;epid=4f7ebb3d17\r\n"
+	"Call-ID: 7c4e3e5d6ff94e00a1c3bd1e3e1e8c41\r\n"
+	"CSeq: 14 BENOTIFY\r\n"
+	"Require: eventlist\r\n"
+	"Content-Type: application/msrtc-event-categories+xml\r\n"
+	"Event: presence\r\n"
+	"subscription-state: active;expires=27862\r\n"
+	"\r\n";
+
+int main(int argc, char *argv[])
+{
+	guint iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000;
+	struct sipmsg *msg;
+
+	/* must be called before any other GLib function */
+	sipe_test_allocations_init();
+
+	/* corrupted first lines */
+	msg = sipmsg_parse_header("");
+	assert_int("empty header", msg == NULL, TRUE);
+	msg = sipmsg_parse_header("INVITE\r\n\r\n");
+	assert_int("1 part", msg == NULL, TRUE);
+	msg = sipmsg_parse_header("INVITE sip:a@b\r\nCall-ID: 1\r\n\r\n");
+	assert_int("2 parts", msg == NULL, TRUE);
+	msg = sipmsg_parse_header("INVITE sip:a@b SIP/2.0\r\nCall-ID 1\r\n\r\n");
+	assert_int("missing colon", msg == NULL, TRUE);
+
+	/* request */
+	msg = sipmsg_parse_header("MESSAGE sip:alice@example.com SIP/2.0\r\n"
+				  "Via: SIP/2.0/TLS 1.2.3.4\r\n"
+				  "Via:SIP/2.0/TLS 5.6.7.8\r\n"
+				  "Subject:\t \tfolded\r\n"
+				  " \tvalue\r\n"
+				  "\tcontinues\r\n"
+				  "CONTENT-LENGTH: 5\r\n"
+				  "\r\n");
+	assert_int("request parsed", msg != NULL, TRUE);
+	if (msg) {
+		assert_string("method", msg->method, "MESSAGE");
+		assert_string("target", msg->target, "sip:alice@example.com");
+		assert_int("response", msg->response, 0);
+		assert_int("bodylen", msg->bodylen, 5);
+		assert_header(msg, "via", 0, "SIP/2.0/TLS 1.2.3.4");
+		assert_header(msg, "VIA", 1, "SIP/2.0/TLS 5.6.7.8");
+		assert_header(msg, "Via", 2, NULL);
+		assert_header(msg, "Subject", 0, "folded value continues");
+		assert_header(msg, "Content-Length", 0, "5");
+		assert_header(msg, "Call-ID", 0, NULL);
+		assert_int("header count", g_slist_length(msg->headers), 4);
+
+		/* modifications disable the index */
+		sipmsg_remove_header_now(msg, "Via");
+		assert_header(msg, "Via", 0, "SIP/2.0/TLS 5.6.7.8");
+		sipmsg_add_header_now(msg, "Call-ID", "abc");
+		assert_header(msg, "call-id", 0, "abc");
+		sipmsg_free(msg);
+	}
+
+	/* response */
+	msg = sipmsg_parse_header("SIP/2.0 200 OK with spaces\r\n"
+				  "CSeq: 12 SUBSCRIBE\r\n"
+				  "Content-Length: 0\r\n"
+				  "\r\n");
+	assert_int("response parsed", msg != NULL, TRUE);
+	if (msg) {
+		assert_int("response", msg->response, 200);
+		assert_string("responsestr", msg->responsestr, "OK with spaces");
+		assert_string("response method", msg->method, "SUBSCRIBE");
+		assert_int("cseq", sipmsg_parse_cseq(msg), 12);
+		sipmsg_free(msg);
+	}
+
+	/* serialization appends to the send buffer */
+	msg = sipmsg_parse_msg("MESSAGE sip:bob@example.com SIP/2.0\r\n"
+			       "Call-ID: 1\r\n"
+			       "CSeq: 2 MESSAGE\r\n"
+			       "Content-Length: 5\r\n"
+			       "\r\n"
+			       "hello");
+	assert_int("message parsed", msg != NULL, TRUE);
+	if (msg) {
+		GString *buffer = g_string_new("\r\n\r\n");
+
+		sipmsg_add_header_now(msg, "Authorization", "NTLM x");
+		sipmsg_serialize(msg, buffer);
+		assert_string("serialized", buffer->str,
+			      "\r\n\r\n"
+			      "MESSAGE sip:bob@example.com SIP/2.0\r\n"
+			      "Call-ID: 1\r\n"
+			      "CSeq: 2 MESSAGE\r\n"
+			      "Content-Length: 5\r\n"
+			      "Authorization: NTLM x\r\n"
+			      "\r\n"
+			      "hello");
+		g_string_free(buffer, TRUE);
+		sipmsg_free(msg);
+	}
+
+	/* more distinct names than index slots */
+	{
+		GString *header = g_string_new("NOTIFY sip:a@b SIP/2.0\r\n");
+		guint i;
+
+		for (i = 0; i < 2 * SIPMSG_HEADER_INDEX_SLOTS; i++)
+			g_string_append_printf(header, "X-Header-%d: %d\r\n", i, i);
+		g_string_append(header, "Content-Length: 0\r\n\r\n");
+
+		msg = sipmsg_parse_header(header->str);
+		assert_int("many headers parsed", msg != NULL, TRUE);
+		if (msg) {
+			assert_header(msg, "x-header-0", 0, "0");
+			assert_header(msg, "X-HEADER-127", 0, "127");
+			assert_header(msg, "Content-Length", 0, "0");
+			sipmsg_free(msg);
+		}
+		g_string_free(header, TRUE);
+	}
+
+	/* compare against legacy implementation */
+	if (iterations) {
+		printf("Parsing %u x BENOTIFY header + %u lookups:\n",
+		       iterations,
+		       (guint) G_N_ELEMENTS(benchmark_lookups) - 1);
+		benchmark("legacy", benotify, iterations,
+			  legacy_parse_header, legacy_find_header);
+		benchmark("indexed", benotify, iterations,
+			  sipmsg_parse_header, sipmsg_find_header);
+	}
+
+	printf("Result: %d PASSED %d FAILED\n", succeeded, failed);
+	return(failed);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2014 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2008 Novell, Inc.
  * Copyright (C) 2005 Thomas Butter <butter@uni-mannheim.de>
  *
@@ -50,38 +50,293 @@ struct sipmsg *sipmsg_parse_msg(const gchar *msg) {
 	return smsg;
 }
 
+/*
+ * Parsed header storage
+ *
+ * The header text of a received message is copied once into a block owned
+ * by the message and split in place. The name/value pairs of all parsed
+ * headers live in a single array and point into that block, i.e. parsing
+ * does not allocate per header (except for the GSList nodes of the public
+ * msg->headers list).
+ *
+ * Lookups go through a fixed-size open addressing table keyed on a case
+ * folded hash of the header name. Each slot references the first header
+ * with that name, further instances are chained via "next".
+ *
+ * Any modification of msg->headers invalidates the index. Lookups then fall
+ * back to the linear list walk.
+ */
+#define SIPMSG_HEADER_INDEX_SLOTS   64 /* must be a power of 2 */
+#define SIPMSG_HEADER_INDEX_MAX     48 /* max. distinct names: 75% load */
+#define SIPMSG_HEADER_INITIAL_COUNT 32
+
+struct sipmsg_header_entry {
+	struct sipnameval nameval; /* points into block */
+	guint hash;
+	guint next;                /* 1-based index of next instance, 0 = end */
+};
+
+struct sipmsg_header_slot {
+	guint hash;
+	guint first;               /* 1-based index of first instance, 0 = empty */
+	guint last;                /* 1-based index of last instance */
+};
+
+struct sipmsg_header_index {
+	gchar *block;
+	struct sipmsg_header_entry *entries;
+	guint count;
+	guint capacity;
+	guint names;
+	gboolean valid;
+	struct sipmsg_header_slot slots[SIPMSG_HEADER_INDEX_SLOTS];
+};
+
+static guint header_name_hash(const gchar *name)
+{
+	guint hash = 5381;
+	while (*name)
+		hash = (hash << 5) + hash + (guchar) g_ascii_tolower(*name++);
+	return(hash);
+}
+
+static void header_index_free(struct sipmsg_header_index *index)
+{
+	if (index) {
+		g_free(index->entries);
+		g_free(index->block);
+		g_free(index);
+	}
+}
+
+static void header_index_invalidate(struct sipmsg *msg)
+{
+	if (msg->header_index)
+		msg->header_index->valid = FALSE;
+}
+
+static gboolean header_is_parsed(const struct sipmsg *msg,
+				 const struct sipnameval *elem)
+{
+	const struct sipmsg_header_index *index = msg->header_index;
+	const struct sipmsg_header_entry *entry = (const struct sipmsg_header_entry *) elem;
+	return(index &&
+	       (entry >= index->entries) &&
+	       (entry <  index->entries + index->count));
+}
+
+static void header_free(const struct sipmsg *msg,
+			struct sipnameval *elem)
+{
+	/* parsed headers are owned by the index */
+	if (!header_is_parsed(msg, elem)) {
+		g_free(elem->name);
+		g_free(elem->value);
+		g_free(elem);
+	}
+}
+
+static void headers_free(const struct sipmsg *msg, GSList *list)
+{
+	while (list) {
+		header_free(msg, list->data);
+		list = g_slist_delete_link(list, list);
+	}
+}
+
+static struct sipmsg_header_entry *header_index_add(struct sipmsg_header_index *index,
+						    gchar *name)
+{
+	struct sipmsg_header_entry *entry;
+
+	if (index->count == index->capacity) {
+		index->capacity *= 2;
+		index->entries   = g_renew(struct sipmsg_header_entry,
+					   index->entries,
+					   index->capacity);
+	}
+
+	entry = index->entries + index->count++;
+	entry->nameval.name = name;
+	entry->hash         = header_name_hash(name);
+	entry->next         = 0;
+
+	/* index is disabled after too many distinct names */
+	if (index->valid) {
+		guint i = entry->hash & (SIPMSG_HEADER_INDEX_SLOTS - 1);
+
+		while (TRUE) {
+			struct sipmsg_header_slot *slot = index->slots + i;
+
+			if (!slot->first) {
+				if (++index->names > SIPMSG_HEADER_INDEX_MAX) {
+					index->valid = FALSE;
+				} else {
+					slot->hash  = entry->hash;
+					slot->first = index->count;
+					slot->last  = index->count;
+				}
+				break;
+			}
+
+			if ((slot->hash == entry->hash) &&
+			    (g_ascii_strcasecmp(index->entries[slot->first - 1].nameval.name,
+						name) == 0)) {
+				index->entries[slot->last - 1].next = index->count;
+				slot->last = index->count;
+				break;
+			}
+
+			i = (i + 1) & (SIPMSG_HEADER_INDEX_SLOTS - 1);
+		}
+	}
+
+	return(entry);
+}
+
+static const gchar *header_index_find(const struct sipmsg_header_index *index,
+				      const gchar *name,
+				      int which)
+{
+	guint hash = header_name_hash(name);
+	guint i    = hash & (SIPMSG_HEADER_INDEX_SLOTS - 1);
+
+	while (TRUE) {
+		const struct sipmsg_header_slot *slot = index->slots + i;
+
+		if (!slot->first)
+			return(NULL);
+
+		if ((slot->hash == hash) &&
+		    (g_ascii_strcasecmp(index->entries[slot->first - 1].nameval.name,
+					name) == 0)) {
+			guint next = slot->first;
+			while (next && which--)
+				next = index->entries[next - 1].next;
+			return(next ? index->entries[next - 1].nameval.value : NULL);
+		}
+
+		i = (i + 1) & (SIPMSG_HEADER_INDEX_SLOTS - 1);
+	}
+}
+
+/* returns pointer to "\r\n" or to the string terminator */
+static gchar *header_line_end(gchar *line)
+{
+	while (*line && !((line[0] == '\r') && (line[1] == '\n')))
+		line++;
+	return(line);
+}
+
+static gchar *header_copy_span(gchar *write, const gchar *read, gsize length)
+{
+	if (write != read)
+		memmove(write, read, length);
+	return(write + length);
+}
+
+static const gchar *header_skip_whitespace(const gchar *read, const gchar *end)
+{
+	while ((read < end) && ((*read == ' ') || (*read == '\t')))
+		read++;
+	return(read);
+}
+
+/*
+ * Splits "name: value" lines starting at "read" in place. Folded lines are
+ * joined with a single space. Parsing stops at the first line with less
+ * than 3 characters, i.e. at the empty line terminating the header.
+ */
+static gboolean header_index_parse(struct sipmsg_header_index *index,
+				   gchar *read)
+{
+	gchar *write = read;
+
+	while (TRUE) {
+		gchar *end = header_line_end(read);
+		gchar *colon, *name;
+		struct sipmsg_header_entry *entry;
+
+		if (end - read <= 2)
+			break;
+
+		colon = memchr(read, ':', end - read);
+		if (!colon)
+			return(FALSE);
+
+		/* name: everything up to the colon */
+		*colon = '\0';
+		name   = write;
+		write  = header_copy_span(write, read, colon - read + 1);
+		entry  = header_index_add(index, name);
+
+		/* value: skip leading white space */
+		read = (gchar *) header_skip_whitespace(colon + 1, end);
+		entry->nameval.value = write;
+		write = header_copy_span(write, read, end - read);
+		read  = *end ? end + 2 : end;
+
+		/* folded lines */
+		while ((*read == ' ') || (*read == '\t')) {
+			end      = header_line_end(read);
+			read     = (gchar *) header_skip_whitespace(read, end);
+			*write++ = ' ';
+			write    = header_copy_span(write, read, end - read);
+			read     = *end ? end + 2 : end;
+		}
+		*write++ = '\0';
+	}
+
+	return(TRUE);
+}
+
 struct sipmsg *sipmsg_parse_header(const gchar *header) {
-	struct sipmsg *msg = g_new0(struct sipmsg,1);
-	gchar **lines = g_strsplit(header,"\r\n",0);
-	gchar **parts;
+	struct sipmsg *msg;
+	struct sipmsg_header_index *index;
+	gchar *block, *line_end, *space1, *space2;
 	const gchar *contentlength;
-	if(!lines[0]) {
-		g_strfreev(lines);
-		g_free(msg);
-		return NULL;
-	}
-	parts = g_strsplit(lines[0], " ", 3);
-	if(!parts[0] || !parts[1] || !parts[2]) {
-		g_strfreev(parts);
-		g_strfreev(lines);
-		g_free(msg);
-		return NULL;
+	guint i;
+
+	if (!header)
+		return(NULL);
+
+	/* request/status line: 3 parts separated by space */
+	block    = g_strdup(header);
+	line_end = header_line_end(block);
+	space1   = memchr(block, ' ', line_end - block);
+	space2   = space1 ? memchr(space1 + 1, ' ', line_end - space1 - 1) : NULL;
+	if (!space2) {
+		g_free(block);
+		return(NULL);
 	}
-	if(strstr(parts[0],"SIP") || strstr(parts[0],"HTTP")) { /* numeric response */
-		msg->responsestr = g_strdup(parts[2]);
-		msg->response = strtol(parts[1],NULL,10);
+	*space1 = '\0';
+	*space2 = '\0';
+
+	msg = g_new0(struct sipmsg, 1);
+	if (strstr(block, "SIP") || strstr(block, "HTTP")) { /* numeric response */
+		msg->responsestr = g_strndup(space2 + 1, line_end - space2 - 1);
+		msg->response = strtol(space1 + 1, NULL, 10);
 	} else { /* request */
-		msg->method = g_strdup(parts[0]);
-		msg->target = g_strdup(parts[1]);
+		msg->method = g_strdup(block);
+		msg->target = g_strdup(space1 + 1);
 		msg->response = 0;
 	}
-	g_strfreev(parts);
-	if (sipe_utils_parse_lines(&msg->headers, lines + 1, ":") == FALSE) {
-		g_strfreev(lines);
+
+	index = msg->header_index = g_new0(struct sipmsg_header_index, 1);
+	index->block    = block;
+	index->capacity = SIPMSG_HEADER_INITIAL_COUNT;
+	index->entries  = g_new(struct sipmsg_header_entry, index->capacity);
+	index->valid    = TRUE;
+	if (!header_index_parse(index, *line_end ? line_end + 2 : line_end)) {
 		sipmsg_free(msg);
 		return NULL;
 	}
-	g_strfreev(lines);
+
+	/* parsed header array is final: build list in original order */
+	for (i = index->count; i > 0; i--)
+		msg->headers = g_slist_prepend(msg->headers,
+					       &index->entries[i - 1].nameval);
+
 	contentlength = sipmsg_find_header(msg, "Content-Length");
 	if (contentlength) {
 		msg->bodylen = strtol(contentlength,NULL,10);
@@ -113,9 +368,8 @@ struct sipmsg *sipmsg_parse_header(const gchar *header) {
 			/* SHOULD NOT HAPPEN */
 			msg->method = 0;
 		} else {
-			parts = g_strsplit(tmp, " ", 2);
-			msg->method = g_strdup(parts[1]);
-			g_strfreev(parts);
+			const gchar *space = strchr(tmp, ' ');
+			msg->method = space ? g_strdup(space + 1) : NULL;
 		}
 	}
 	return msg;
@@ -153,34 +407,31 @@ struct sipmsg *sipmsg_copy(const struct sipmsg *other) {
 	return msg;
 }
 
-char *sipmsg_to_string(const struct sipmsg *msg) {
+void sipmsg_serialize(const struct sipmsg *msg, GString *buffer)
+{
 	GSList *cur;
-	GString *outstr = g_string_new("");
-	struct sipnameval *elem;
 
-	if(msg->response)
-		g_string_append_printf(outstr, "SIP/2.0 %d Unknown\r\n",
-			msg->response);
-	else
-		g_string_append_printf(outstr, "%s %s SIP/2.0\r\n",
-			msg->method, msg->target);
-
-	cur = msg->headers;
-	while(cur) {
-		elem = cur->data;
-                /*Todo: remove the LFCR in a good way*/
-                /*if(sipe_strequal(elem->name,"Proxy-Authorization"))
-                  g_string_append_printf(outstr, "%s: %s", elem->name,
-			elem->value);
-                else     */
-		   g_string_append_printf(outstr, "%s: %s\r\n", elem->name,
-			elem->value);
-		cur = g_slist_next(cur);
+	if (msg->response) {
+		g_string_append_printf(buffer, "SIP/2.0 %d Unknown\r\n",
+				       msg->response);
+	} else {
+		g_string_append(buffer, msg->method);
+		g_string_append_c(buffer, ' ');
+		g_string_append(buffer, msg->target);
+		g_string_append(buffer, " SIP/2.0\r\n");
 	}
 
-	g_string_append_printf(outstr, "\r\n%s", msg->bodylen ? msg->body : "");
+	for (cur = msg->headers; cur; cur = g_slist_next(cur)) {
+		const struct sipnameval *elem = cur->data;
+		g_string_append(buffer, elem->name);
+		g_string_append(buffer, ": ");
+		g_string_append(buffer, elem->value);
+		g_string_append(buffer, "\r\n");
+	}
 
-	return g_string_free(outstr, FALSE);
+	g_string_append(buffer, "\r\n");
+	if (msg->bodylen && msg->body)
+		g_string_append(buffer, msg->body);
 }
 
 /**
@@ -199,6 +450,7 @@ void sipmsg_add_header_now(struct sipmsg *msg, const gchar *name, const gchar *v
 	element->name = g_strdup(name);
 	element->value = g_strdup(value);
 	msg->headers = g_slist_append(msg->headers, element);
+	header_index_invalidate(msg);
 }
 
 /**
@@ -244,9 +496,8 @@ void sipmsg_strip_headers(struct sipmsg *msg, const gchar *keepers[]) {
 			SIPE_DEBUG_INFO("sipmsg_strip_headers: removing %s", elem->name);
 			entry = g_slist_next(entry);
 			msg->headers = g_slist_delete_link(msg->headers, to_delete);
-			g_free(elem->name);
-			g_free(elem->value);
-			g_free(elem);
+			header_index_invalidate(msg);
+			header_free(msg, elem);
 		} else {
 			entry = g_slist_next(entry);
 		}
@@ -257,6 +508,8 @@ void sipmsg_strip_headers(struct sipmsg *msg, const gchar *keepers[]) {
  * Merges newly added headers to message
  */
 void sipmsg_merge_new_headers(struct sipmsg *msg) {
+	if (msg->new_headers)
+		header_index_invalidate(msg);
 	while(msg->new_headers) {
 		msg->headers = g_slist_append(msg->headers, msg->new_headers->data);
 		msg->new_headers = g_slist_remove(msg->new_headers, msg->new_headers->data);
@@ -265,19 +518,30 @@ void sipmsg_merge_new_headers(struct sipmsg *msg) {
 
 void sipmsg_free(struct sipmsg *msg) {
 	if (msg) {
-		sipe_utils_nameval_free(msg->headers);
+		headers_free(msg, msg->headers);
 		sipe_utils_nameval_free(msg->new_headers);
+		header_index_free(msg->header_index);
 		g_free(msg->signature);
 		g_free(msg->rand);
 		g_free(msg->num);
 		g_free(msg->responsestr);
 		g_free(msg->method);
 		g_free(msg->target);
-		g_free(msg->body);
+		if (!msg->body_borrowed)
+			g_free(msg->body);
 		g_free(msg);
 	}
 }
 
+void sipmsg_set_body(struct sipmsg *msg, gchar *body, int length)
+{
+	if (!msg->body_borrowed)
+		g_free(msg->body);
+	msg->body          = body;
+	msg->bodylen       = length;
+	msg->body_borrowed = FALSE;
+}
+
 void sipmsg_remove_header_now(struct sipmsg *msg, const gchar *name) {
 	struct sipnameval *elem;
 	GSList *tmp = msg->headers;
@@ -286,9 +550,8 @@ void sipmsg_remove_header_now(struct sipmsg *msg, const gchar *name) {
 		// OCS2005 can send the same header in either all caps or mixed case
 		if (sipe_strcase_equal(elem->name, name)) {
 			msg->headers = g_slist_remove(msg->headers, elem);
-			g_free(elem->name);
-			g_free(elem->value);
-			g_free(elem);
+			header_index_invalidate(msg);
+			header_free(msg, elem);
 			return;
 		}
 		tmp = g_slist_next(tmp);
@@ -297,10 +560,14 @@ void sipmsg_remove_header_now(struct sipmsg *msg, const gchar *name) {
 }
 
 const gchar *sipmsg_find_header(const struct sipmsg *msg, const gchar *name) {
-	return sipe_utils_nameval_find_instance (msg->headers, name, 0);
+	return sipmsg_find_header_instance(msg, name, 0);
 }
 
 const gchar *sipmsg_find_header_instance(const struct sipmsg *msg, const gchar *name, int which) {
+	const struct sipmsg_header_index *index = msg->header_index;
+
+	if (index && index->valid && name)
+		return header_index_find(index, name, which);
 	return sipe_utils_nameval_find_instance(msg->headers, name, which);
 }
 
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2014 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  * Copyright (C) 2008 Novell, Inc.
  * Copyright (C) 2005, Thomas Butter <butter@uni-mannheim.de>
  *
@@ -31,6 +31,8 @@
 #define SIPMSG_RESPONSE_FATAL_ERROR -1
 #define SIPMSG_BODYLEN_CHUNKED      -1
 
+struct sipmsg_header_index;
+
 struct sipmsg {
 	int response; /* 0 means request, otherwise response code */
 	gchar *responsestr;
@@ -40,9 +42,12 @@ struct sipmsg {
 	GSList *new_headers;
 	int bodylen;
 	gchar *body;
+	gboolean body_borrowed; /* body is not owned by the message */
 	gchar *signature;
 	gchar *rand;
 	gchar *num;
+	/* private to sipmsg.c: storage & lookup index for parsed headers */
+	struct sipmsg_header_index *header_index;
 };
 
 struct sipendpoint {
@@ -60,6 +65,15 @@ void sipmsg_strip_headers(struct sipmsg *msg, const gchar *keepers[]);
 void sipmsg_merge_new_headers(struct sipmsg *msg);
 void sipmsg_free(struct sipmsg *msg);
 
+/**
+ * Replaces message body
+ *
+ * @param msg    SIP message
+ * @param body   new body. Ownership is transferred to the message.
+ * @param length length of new body
+ */
+void sipmsg_set_body(struct sipmsg *msg, gchar *body, int length);
+
 /**
  * Parses CSeq from SIP message
  *
@@ -90,7 +104,14 @@ const gchar *sipmsg_find_header_instance(const struct sipmsg *msg, const gchar *
 gchar *sipmsg_find_part_of_header(const char *hdr, const char * before, const char * after, const char * def);
 const gchar *sipmsg_find_auth_header(struct sipmsg *msg, const gchar *name);
 void sipmsg_remove_header_now(struct sipmsg *msg, const gchar *name);
-char *sipmsg_to_string(const struct sipmsg *msg);
+
+/**
+ * Serialize SIP message
+ *
+ * @param msg    SIP message
+ * @param buffer message is appended to this buffer
+ */
+void sipmsg_serialize(const struct sipmsg *msg, GString *buffer);
 
 /**
  * Formats message to html if not yet.
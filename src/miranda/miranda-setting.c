@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-11 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -20,6 +20,8 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>
+
 #include <windows.h>
 
 #include <glib.h>
@@ -44,11 +46,13 @@
  *     api/sipe-backend.h
  */
 static const gchar * const setting_name[SIPE_SETTING_LAST] = {
-	"email_url",      /* SIPE_SETTING_EMAIL_URL      */
-	"login",          /* SIPE_SETTING_EMAIL_LOGIN    */
-	"password",       /* SIPE_SETTING_EMAIL_PASSWORD */
-	"groupchat_user", /* SIPE_SETTING_GROUPCHAT_USER */
-	"useragent"       /* SIPE_SETTING_USER_AGENT     */
+	"email_url",         /* SIPE_SETTING_EMAIL_URL         */
+	"login",             /* SIPE_SETTING_EMAIL_LOGIN       */
+	"password",          /* SIPE_SETTING_EMAIL_PASSWORD    */
+	"groupchat_user",    /* SIPE_SETTING_GROUPCHAT_USER    */
+	"useragent",         /* SIPE_SETTING_USER_AGENT        */
+	"http_connections",  /* SIPE_SETTING_HTTP_CONNECTIONS  */
+	"buffer_high_water"  /* SIPE_SETTING_BUFFER_HIGH_WATER */
 };
 
 const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
@@ -74,6 +78,35 @@ const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
 
 }
 
+/* secrets are stored encrypted, like the account password */
+gchar *sipe_backend_secret_get(struct sipe_core_public *sipe_public,
+			       const gchar *name)
+{
+	SIPPROTO *pr = sipe_public->backend_private;
+	gchar *tmp = sipe_miranda_getString(pr, name);
+	gchar *ret = NULL;
+
+	if (tmp) {
+		CallService(MS_DB_CRYPT_DECODESTRING, strlen(tmp) + 1, (LPARAM)tmp);
+		ret = g_strdup(tmp);
+		mir_free(tmp);
+	}
+	return ret;
+}
+
+gboolean sipe_backend_secret_set(struct sipe_core_public *sipe_public,
+				 const gchar *name,
+				 const gchar *secret)
+{
+	SIPPROTO *pr = sipe_public->backend_private;
+	gchar *tmp = g_strdup(secret);
+
+	CallService(MS_DB_CRYPT_ENCODESTRING, strlen(tmp) + 1, (LPARAM)tmp);
+	sipe_miranda_setString(pr, name, tmp);
+	g_free(tmp);
+	return TRUE;
+}
+
 /*
   Local Variables:
   mode: c
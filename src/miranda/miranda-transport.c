@@ -99,18 +99,18 @@ miranda_sipe_input_cb(gpointer data,
 		return;
 	}
 
+	/*
+	 * Release memory after the previous burst. The transport might be
+	 * gone after input processing, so this can't be done afterwards.
+	 */
+	sipe_core_transport_buffer_release(conn);
+
 	do {
 		/* Increase input buffer size as needed */
-		if (conn->buffer_length < conn->buffer_used + BUFFER_SIZE_INCREMENT) {
-			conn->buffer_length += BUFFER_SIZE_INCREMENT;
-			conn->buffer = g_realloc(conn->buffer, conn->buffer_length);
-			SIPE_DEBUG_INFO("miranda_sipe_input_cb: new buffer length %" G_GSIZE_FORMAT,
-					conn->buffer_length);
-		}
+		readlen = sipe_core_transport_buffer_reserve(conn,
+							     BUFFER_SIZE_INCREMENT);
 
 		/* Try to read as much as there is space left in the buffer */
-		/* minus 1 for the string terminator */
-		readlen = conn->buffer_length - conn->buffer_used - 1;
 
 		len = Netlib_Recv(transport->fd, conn->buffer + conn->buffer_used, readlen, MSG_NODUMP);
 
@@ -0,0 +1,523 @@
+/**
+ * @file null-bench.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Benchmark for the SIP receive pipeline
+ *
+ * Logs the null backend into an in-memory transport and replays a corpus of
+ * server messages through the transport input callback, i.e.
+ * sip_transport_input() and process_input_message(), like a real backend
+ * would do after a read:
+ *
+ *   - 200 OK for the initial REGISTER (once)
+ *   - roaming contacts NOTIFY with <contacts> buddies
+ *   - RLMI BENOTIFY bursts with presence for every buddy
+ *   - instant MESSAGEs
+ *
+ * The corpus is fed in 16KB reads. Reported are messages/second,
+ * allocations/message, the number of sent messages and writes, and the
+ * peak RSS of the process.
+ *
+ * The first roaming contacts NOTIFY is timed separately, because it also
+ * triggers the initial batched presence SUBSCRIBEs for all contacts. They
+ * are answered with 200 OK until every contact has been subscribed, e.g.
+ *
+ *   $ sipe-null-bench 1 10000
+ *
+ * Usage: sipe-null-bench [<iterations> [<contacts>]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-core.h"
+#include "sipmsg.h"
+#include "sipe-test-allocations.h"
+
+#include "null-private.h"
+
+#define BENCH_DOMAIN          "contoso.com"
+#define BENCH_SELF            "alice@" BENCH_DOMAIN
+#define BENCH_READ_SIZE       (16 * 1024)
+#define BENCH_BURST_BUDDIES   10
+#define BENCH_MESSAGES        100
+
+/*
+ * In-memory transport
+ *
+ * Replaces null-transport.c: the connection is established immediately,
+ * reads are injected by replay() and sent messages are inspected.
+ */
+struct sipe_transport_null {
+	struct sipe_transport_connection public;
+	transport_input_cb *input;
+	struct sipe_backend_private *private;
+};
+
+static struct sipe_transport_null *bench_connection = NULL;
+static gchar *bench_register  = NULL;
+static guint bench_sent_count    = 0;
+static guint bench_batched_count = 0; /* <resource>s in batched SUBSCRIBE */
+static gsize bench_batched_bytes = 0;
+static GQueue bench_subscribes   = G_QUEUE_INIT; /* unanswered SUBSCRIBEs */
+
+gchar *sipe_backend_version(void)
+{
+	return(g_strdup("null-bench"));
+}
+
+const gchar *sipe_backend_network_ip_address(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public)
+{
+	return("127.0.0.1");
+}
+
+struct sipe_transport_connection *sipe_backend_transport_connect(struct sipe_core_public *sipe_public,
+								 const sipe_connect_setup *setup)
+{
+	struct sipe_transport_null *transport = g_new0(struct sipe_transport_null, 1);
+
+	transport->public.user_data   = setup->user_data;
+	transport->public.type        = setup->type;
+	transport->public.client_port = 50000;
+	transport->input              = setup->input;
+	transport->private            = sipe_public->backend_private;
+	transport->private->transport = transport;
+	bench_connection = transport;
+
+	/* connection is established immediately */
+	setup->connected(&transport->public);
+
+	return(&transport->public);
+}
+
+void sipe_backend_transport_disconnect(struct sipe_transport_connection *conn)
+{
+	struct sipe_transport_null *transport = (struct sipe_transport_null *) conn;
+
+	if (transport) {
+		if (transport->private->transport == transport)
+			transport->private->transport = NULL;
+		g_free(conn->buffer);
+		g_free(transport);
+		bench_connection = NULL;
+	}
+}
+
+static void bench_sent_message(const gchar *message)
+{
+	bench_sent_count++;
+
+	if (g_str_has_prefix(message, "REGISTER ")) {
+		g_free(bench_register);
+		bench_register = g_strdup(message);
+	} else if (g_str_has_prefix(message, "SUBSCRIBE ") &&
+		   strstr(message, "<adhocList>")) {
+		const gchar *resource = message;
+
+		while ((resource = strstr(resource, "<resource uri=")) != NULL) {
+			bench_batched_count++;
+			resource++;
+		}
+		bench_batched_bytes += strlen(message);
+		g_queue_push_tail(&bench_subscribes, g_strdup(message));
+	}
+}
+
+void sipe_backend_transport_message(struct sipe_transport_connection *conn,
+				    const gchar *buffer)
+{
+	struct sipe_null_statistics *stats = &((struct sipe_transport_null *) conn)->private->stats;
+
+	stats->writes++;
+	stats->bytes_written += strlen(buffer);
+
+	/* the core sends bursts of messages with one write */
+	while (*buffer) {
+		const gchar *end = strstr(buffer, "\r\n\r\n");
+		gsize length = strlen(buffer);
+		gchar *message;
+
+		if (end) {
+			const gchar *content_length = g_strstr_len(buffer,
+								   end - buffer,
+								   "Content-Length: ");
+			length = MIN(end + 4 - buffer +
+				     (content_length ?
+				      strtoul(content_length + 16, NULL, 10) :
+				      0),
+				     length);
+		}
+
+		message = g_strndup(buffer, length);
+		bench_sent_message(message);
+		g_free(message);
+		buffer += length;
+	}
+}
+
+void sipe_backend_transport_flush(SIPE_UNUSED_PARAMETER struct sipe_transport_connection *conn) {}
+
+/*
+ * Corpus generator
+ */
+static guint corpus_cseq = 0;
+
+static void corpus_request(GString *corpus,
+			   const gchar *method,
+			   const gchar *headers,
+			   const gchar *body,
+			   gsize length)
+{
+	corpus_cseq++;
+	g_string_append_printf(corpus,
+			       "%s sip:" BENCH_SELF ";transport=tls;ms-opaque=d3470f2e1d SIP/2.0\r\n"
+			       "Via: SIP/2.0/TLS 192.0.2.1:5061;branch=z9hG4bK%08X;ms-received-port=5061\r\n"
+			       "From: <sip:" BENCH_SELF ">;tag=%08X\r\n"
+			       "To: <sip:" BENCH_SELF ">;tag=5564f46b2c;epid=4f7ebb3d17\r\n"
+			       "Call-ID: 7c4e3e5d6ff94e00a1c3bd1e3e1e%04X\r\n"
+			       "CSeq: %u %s\r\n"
+			       "%s"
+			       "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+			       "\r\n",
+			       method,
+			       corpus_cseq,
+			       corpus_cseq,
+			       corpus_cseq & 0xFFFF,
+			       corpus_cseq,
+			       method,
+			       headers,
+			       length);
+	g_string_append_len(corpus, body, length);
+}
+
+static guint corpus_roaming_contacts(GString *corpus,
+				     guint contacts)
+{
+	GString *body = g_string_new("<contactList deltaNum=\"1\" xmlns=\"http://schemas.microsoft.com/2006/09/sip/contactlist\">"
+				     "<group id=\"1\" name=\"~\" externalURI=\"\"/>"
+				     "<group id=\"2\" name=\"Team\" externalURI=\"\"/>");
+	guint i;
+
+	for (i = 0; i < contacts; i++)
+		g_string_append_printf(body,
+				       "<contact uri=\"user%05u@" BENCH_DOMAIN "\" name=\"\" groups=\"%u \" subscribed=\"true\" externalURI=\"\"/>",
+				       i,
+				       (i % 10) ? 1 : 2);
+	g_string_append(body, "</contactList>");
+
+	corpus_request(corpus,
+		       "NOTIFY",
+		       "Event: vnd-microsoft-roaming-contacts\r\n"
+		       "subscription-state: active;expires=35000\r\n"
+		       "Content-Type: application/vnd-microsoft-roaming-contacts+xml\r\n",
+		       body->str,
+		       body->len);
+	g_string_free(body, TRUE);
+
+	return(1);
+}
+
+static guint corpus_rlmi_bursts(GString *corpus,
+				guint contacts)
+{
+	guint messages = 0;
+	guint first;
+
+	for (first = 0; first < contacts; first += BENCH_BURST_BUDDIES) {
+		GString *body = g_string_new("--BenchBoundary\r\n"
+					     "Content-Transfer-Encoding: binary\r\n"
+					     "Content-ID: <resourceList>\r\n"
+					     "Content-Type: application/rlmi+xml\r\n"
+					     "\r\n"
+					     "<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" uri=\"sip:" BENCH_SELF "\" version=\"1\" fullState=\"false\">");
+		guint last = MIN(first + BENCH_BURST_BUDDIES, contacts);
+		guint i;
+
+		for (i = first; i < last; i++)
+			g_string_append_printf(body,
+					       "<resource uri=\"sip:user%05u@" BENCH_DOMAIN "\"><instance id=\"%u\" state=\"active\" cid=\"c%u\"/></resource>",
+					       i, i, i);
+		g_string_append(body, "</list>\r\n");
+
+		for (i = first; i < last; i++)
+			g_string_append_printf(body,
+					       "--BenchBoundary\r\n"
+					       "Content-Transfer-Encoding: binary\r\n"
+					       "Content-ID: <c%u>\r\n"
+					       "Content-Type: application/msrtc-event-categories+xml\r\n"
+					       "\r\n"
+					       "<categories xmlns=\"http://schemas.microsoft.com/2006/09/sip/categories\" uri=\"sip:user%05u@" BENCH_DOMAIN "\">"
+					       "<category name=\"state\" instance=\"1\" publishTime=\"2016-03-01T10:00:00.000Z\" container=\"2\" version=\"3\" expireType=\"endpoint\">"
+					       "<state xmlns=\"http://schemas.microsoft.com/2006/09/sip/state\" manual=\"false\" type=\"aggregateState\">"
+					       "<availability>%u</availability><activity token=\"Available\"/><device>Computer</device>"
+					       "</state></category>"
+					       "<category name=\"note\" instance=\"0\" publishTime=\"2016-03-01T10:00:00.000Z\" container=\"400\" version=\"1\" expireType=\"static\">"
+					       "<note xmlns=\"http://schemas.microsoft.com/2006/09/sip/note\"><body type=\"personal\" uri=\"\">Note of user %u</body></note>"
+					       "</category>"
+					       "</categories>\r\n",
+					       i, i,
+					       (i % 3) ? 3500 : 6500,
+					       i);
+		g_string_append(body, "--BenchBoundary--\r\n");
+
+		corpus_request(corpus,
+			       "BENOTIFY",
+			       "Event: presence\r\n"
+			       "subscription-state: active;expires=27862\r\n"
+			       "Require: eventlist\r\n"
+			       "Content-Type: multipart/related; type=\"application/rlmi+xml\"; start=\"<resourceList>\"; boundary=\"BenchBoundary\"\r\n",
+			       body->str,
+			       body->len);
+		g_string_free(body, TRUE);
+		messages++;
+	}
+
+	return(messages);
+}
+
+static guint corpus_messages(GString *corpus)
+{
+	guint i;
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		gchar *body = g_strdup_printf("Hello, this is instant message %u.", i);
+
+		corpus_request(corpus,
+			       "MESSAGE",
+			       "Supported: ms-dialog-route-set-update\r\n"
+			       "Content-Type: text/plain; charset=UTF-8\r\n",
+			       body,
+			       strlen(body));
+		g_free(body);
+	}
+
+	return(BENCH_MESSAGES);
+}
+
+/* feed data in chunks like a network read would do */
+static void replay(const gchar *data,
+		   gsize length)
+{
+	while (length && bench_connection) {
+		struct sipe_transport_connection *conn = &bench_connection->public;
+		gsize chunk = MIN(length, BENCH_READ_SIZE);
+
+		sipe_core_transport_buffer_reserve(conn, chunk);
+		memcpy(conn->buffer + conn->buffer_used, data, chunk);
+		conn->buffer_used += chunk;
+		conn->buffer[conn->buffer_used] = '\0';
+		bench_connection->input(conn);
+		if (bench_connection)
+			sipe_core_transport_buffer_release(conn);
+
+		data   += chunk;
+		length -= chunk;
+	}
+}
+
+/* 200 OK for a request sent by the core */
+static void bench_response(const gchar *request,
+			   const gchar *headers)
+{
+	struct sipmsg *msg = sipmsg_parse_msg(request);
+	GString *response  = g_string_new("SIP/2.0 200 OK\r\n");
+
+	g_string_append_printf(response,
+			       "Via: %s\r\n"
+			       "From: %s\r\n"
+			       "To: %s;tag=5564f46b2c\r\n"
+			       "Call-ID: %s\r\n"
+			       "CSeq: %s\r\n"
+			       "%s"
+			       "Server: RTC/6.0\r\n"
+			       "Content-Length: 0\r\n"
+			       "\r\n",
+			       sipmsg_find_header(msg, "Via"),
+			       sipmsg_find_header(msg, "From"),
+			       sipmsg_find_header(msg, "To"),
+			       sipmsg_find_header(msg, "Call-ID"),
+			       sipmsg_find_header(msg, "CSeq"),
+			       headers);
+	sipmsg_free(msg);
+
+	replay(response->str, response->len);
+	g_string_free(response, TRUE);
+}
+
+static gboolean bench_login(struct sipe_backend_private *null_private)
+{
+	if (!bench_register) {
+		printf("no REGISTER sent\n");
+		return(FALSE);
+	}
+
+	bench_response(bench_register,
+		       "Expires: 7200\r\n"
+		       "Supported: msrtc-event-categories\r\n"
+		       "Supported: adhoclist\r\n"
+		       "Allow-Events: vnd-microsoft-provisioning,vnd-microsoft-roaming-contacts,vnd-microsoft-roaming-ACL,presence,presence.wpending,vnd-microsoft-roaming-self,vnd-microsoft-provisioning-v2\r\n"
+		       "ms-keep-alive: UAS; tcp=no; hop-hop=yes; end-host=no; timeout=300\r\n");
+
+	if (null_private->state != SIPE_NULL_STATE_CONNECTED) {
+		printf("REGISTER was not accepted\n");
+		return(FALSE);
+	}
+	return(TRUE);
+}
+
+int main(int argc, char *argv[])
+{
+	guint iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1;
+	guint contacts   = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2000;
+	struct sipe_backend_private *null_private;
+	struct sipe_null_statistics start;
+	const gchar *errmsg = NULL;
+	GString *corpus;
+	gchar *request;
+	GTimer *timer;
+	gdouble elapsed;
+	gsize start_allocations;
+	guint messages = 0;
+	guint total;
+	guint i;
+	struct rusage usage;
+	int result = 0;
+
+	/* must be called before any other GLib function */
+	sipe_test_allocations_init();
+
+	sipe_null_debug_init();
+	sipe_core_init(NULL);
+	null_private = sipe_null_connect(BENCH_SELF,
+					 BENCH_SELF,
+					 "password",
+					 SIPE_TRANSPORT_TLS,
+					 SIPE_AUTHENTICATION_TYPE_NTLM,
+					 "sip." BENCH_DOMAIN,
+					 NULL,
+					 NULL,
+					 NULL,
+					 &errmsg);
+	if (!null_private) {
+		printf("sipe_null_connect() failed: %s\n", errmsg);
+		return(1);
+	}
+	if (!bench_login(null_private)) {
+		sipe_null_disconnect(null_private);
+		return(1);
+	}
+
+	/* contact list & initial batched SUBSCRIBE */
+	corpus = g_string_new("");
+	corpus_roaming_contacts(corpus, contacts);
+	timer = g_timer_new();
+	replay(corpus->str, corpus->len);
+	while ((request = g_queue_pop_head(&bench_subscribes)) != NULL) {
+		bench_response(request, "Expires: 36000\r\n");
+		g_free(request);
+	}
+	elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+	g_string_free(corpus, TRUE);
+	printf("contact list: %.3f seconds, batched SUBSCRIBEs: %u resources, %" G_GSIZE_FORMAT " bytes\n",
+	       elapsed, bench_batched_count, bench_batched_bytes);
+
+	corpus = g_string_new("");
+	messages += corpus_roaming_contacts(corpus, contacts);
+	messages += corpus_rlmi_bursts(corpus, contacts);
+	messages += corpus_messages(corpus);
+	printf("corpus: %u messages, %" G_GSIZE_FORMAT " bytes, %u contacts\n",
+	       messages, corpus->len, contacts);
+
+	start_allocations = sipe_test_allocations;
+	start             = null_private->stats;
+	bench_sent_count  = 0;
+	timer = g_timer_new();
+	for (i = 0; i < iterations; i++)
+		replay(corpus->str, corpus->len);
+	elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	total = messages * iterations;
+	printf("%u messages in %.3f seconds: %.0f messages/second\n",
+	       total, elapsed, elapsed > 0 ? total / elapsed : 0.0);
+	printf("%s allocations/message\n",
+	       sipe_test_allocations_per(start_allocations, total));
+	printf("%u messages sent in %u writes, %" G_GUINT64_FORMAT " bytes\n",
+	       bench_sent_count,
+	       null_private->stats.writes - start.writes,
+	       null_private->stats.bytes_written - start.bytes_written);
+
+	/* Linux reports KB, other systems may use different units */
+	getrusage(RUSAGE_SELF, &usage);
+	printf("peak RSS: %ld\n", usage.ru_maxrss);
+
+	/* sanity checks: did the core really process the corpus? */
+	if (null_private->buddy_count != contacts) {
+		printf("FAILED: %u backend buddies, expected %u\n",
+		       null_private->buddy_count, contacts);
+		result = 1;
+	}
+	if (null_private->stats.messages != BENCH_MESSAGES * iterations) {
+		printf("FAILED: %u instant messages, expected %u\n",
+		       null_private->stats.messages, BENCH_MESSAGES * iterations);
+		result = 1;
+	}
+	if (bench_batched_count != contacts) {
+		printf("FAILED: %u resources in batched SUBSCRIBEs, expected %u\n",
+		       bench_batched_count, contacts);
+		result = 1;
+	}
+	if (contacts && !null_private->stats.buddy_status) {
+		printf("FAILED: no buddy status updates\n");
+		result = 1;
+	}
+
+	g_string_free(corpus, TRUE);
+	sipe_null_disconnect(null_private);
+	sipe_core_destroy();
+	g_free(bench_register);
+
+	return(result);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
@@ -0,0 +1,227 @@
+/**
+ * @file null-buddy.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Minimal buddy list: one entry per buddy & group, so that the core sees
+ * the same backend buddy list behaviour as with a real client.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-core.h"
+
+#include "null-private.h"
+
+struct null_buddy {
+	gchar *name;
+	gchar *alias;
+	gchar *server_alias;
+	gchar *group;
+};
+
+static void buddy_free(struct null_buddy *buddy)
+{
+	g_free(buddy->name);
+	g_free(buddy->alias);
+	g_free(buddy->server_alias);
+	g_free(buddy->group);
+	g_free(buddy);
+}
+
+static void buddy_list_free(gpointer data)
+{
+	GSList *list = data;
+	GSList *entry;
+
+	for (entry = list; entry; entry = entry->next)
+		buddy_free(entry->data);
+	g_slist_free(list);
+}
+
+void sipe_null_buddy_init(struct sipe_backend_private *null_private)
+{
+	null_private->buddies = g_hash_table_new_full(g_str_hash, g_str_equal,
+						      g_free, buddy_list_free);
+}
+
+void sipe_null_buddy_free(struct sipe_backend_private *null_private)
+{
+	g_hash_table_destroy(null_private->buddies);
+	null_private->buddies = NULL;
+}
+
+sipe_backend_buddy sipe_backend_buddy_find(struct sipe_core_public *sipe_public,
+					   const gchar *buddy_name,
+					   const gchar *group_name)
+{
+	GSList *entry = g_hash_table_lookup(sipe_public->backend_private->buddies,
+					    buddy_name);
+
+	for (; entry; entry = entry->next) {
+		struct null_buddy *buddy = entry->data;
+		if (!group_name || sipe_strequal(buddy->group, group_name))
+			return(buddy);
+	}
+	return(NULL);
+}
+
+static void buddy_find_all(SIPE_UNUSED_PARAMETER gpointer key,
+			   gpointer value,
+			   gpointer user_data)
+{
+	GSList **result = user_data;
+	GSList *entry;
+
+	for (entry = value; entry; entry = entry->next)
+		*result = g_slist_prepend(*result, entry->data);
+}
+
+GSList *sipe_backend_buddy_find_all(struct sipe_core_public *sipe_public,
+				    const gchar *buddy_name,
+				    const gchar *group_name)
+{
+	GHashTable *buddies = sipe_public->backend_private->buddies;
+	GSList *result      = NULL;
+
+	if (buddy_name) {
+		GSList *entry = g_hash_table_lookup(buddies, buddy_name);
+
+		for (; entry; entry = entry->next) {
+			struct null_buddy *buddy = entry->data;
+			if (!group_name || sipe_strequal(buddy->group, group_name))
+				result = g_slist_prepend(result, buddy);
+		}
+	} else {
+		g_hash_table_foreach(buddies, buddy_find_all, &result);
+	}
+
+	return(result);
+}
+
+gchar *sipe_backend_buddy_get_name(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				   const sipe_backend_buddy who)
+{
+	return(g_strdup(((struct null_buddy *) who)->name));
+}
+
+gchar *sipe_backend_buddy_get_alias(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				    const sipe_backend_buddy who)
+{
+	return(g_strdup(((struct null_buddy *) who)->alias));
+}
+
+gchar *sipe_backend_buddy_get_server_alias(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+					   const sipe_backend_buddy who)
+{
+	return(g_strdup(((struct null_buddy *) who)->server_alias));
+}
+
+gchar *sipe_backend_buddy_get_local_alias(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+					  const sipe_backend_buddy who)
+{
+	return(g_strdup(((struct null_buddy *) who)->alias));
+}
+
+gchar *sipe_backend_buddy_get_group_name(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+					 const sipe_backend_buddy who)
+{
+	return(g_strdup(((struct null_buddy *) who)->group));
+}
+
+void sipe_backend_buddy_set_alias(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				  const sipe_backend_buddy who,
+				  const gchar *alias)
+{
+	struct null_buddy *buddy = who;
+	g_free(buddy->alias);
+	buddy->alias = g_strdup(alias);
+}
+
+void sipe_backend_buddy_set_server_alias(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+					 const sipe_backend_buddy who,
+					 const gchar *alias)
+{
+	struct null_buddy *buddy = who;
+	g_free(buddy->server_alias);
+	buddy->server_alias = g_strdup(alias);
+}
+
+sipe_backend_buddy sipe_backend_buddy_add(struct sipe_core_public *sipe_public,
+					  const gchar *name,
+					  const gchar *alias,
+					  const gchar *groupname)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+	struct null_buddy *buddy = g_new0(struct null_buddy, 1);
+	GSList *entry = g_hash_table_lookup(null_private->buddies, name);
+
+	buddy->name  = g_strdup(name);
+	buddy->alias = g_strdup(alias);
+	buddy->group = g_strdup(groupname);
+
+	/* list head is owned by the hash table */
+	if (entry)
+		entry->next = g_slist_prepend(entry->next, buddy);
+	else
+		g_hash_table_insert(null_private->buddies,
+				    g_strdup(name),
+				    g_slist_prepend(NULL, buddy));
+	null_private->buddy_count++;
+
+	return(buddy);
+}
+
+void sipe_backend_buddy_remove(struct sipe_core_public *sipe_public,
+			       const sipe_backend_buddy who)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+	struct null_buddy *buddy = who;
+	gpointer key, value;
+
+	if (g_hash_table_lookup_extended(null_private->buddies, buddy->name,
+					 &key, &value)) {
+		GSList *entry = g_slist_remove(value, buddy);
+
+		g_hash_table_steal(null_private->buddies, key);
+		if (entry)
+			g_hash_table_insert(null_private->buddies, key, entry);
+		else
+			g_free(key);
+	}
+	buddy_free(buddy);
+	null_private->buddy_count--;
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
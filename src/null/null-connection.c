@@ -0,0 +1,206 @@
+/**
+ * @file null-connection.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-core.h"
+
+#include "null-private.h"
+
+struct sipe_backend_private *sipe_null_connect(const gchar *signin_name,
+					       const gchar *login,
+					       const gchar *password,
+					       guint transport,
+					       guint authentication,
+					       const gchar *server,
+					       const gchar *port,
+					       sipe_null_state_cb *state_cb,
+					       gpointer user_data,
+					       const gchar **errmsg)
+{
+	struct sipe_core_public *sipe_public = sipe_core_allocate(signin_name,
+								  FALSE,
+								  login,
+								  password,
+								  NULL, /* email     */
+								  NULL, /* email_url */
+								  errmsg);
+	struct sipe_backend_private *null_private;
+
+	SIPE_DEBUG_INFO("sipe_null_connect: created %p", sipe_public);
+
+	if (!sipe_public)
+		return(NULL);
+
+	/* initialize backend private data */
+	null_private                 = g_new0(struct sipe_backend_private, 1);
+	sipe_public->backend_private = null_private;
+	null_private->public         = sipe_public;
+	null_private->state_cb       = state_cb;
+	null_private->user_data      = user_data;
+	null_private->state          = SIPE_NULL_STATE_CONNECTING;
+	null_private->connect_start  = g_get_monotonic_time();
+	null_private->activity       = SIPE_ACTIVITY_UNSET;
+	sipe_null_buddy_init(null_private);
+
+	sipe_core_transport_sip_connect(sipe_public,
+					transport,
+					authentication,
+					server,
+					port);
+
+	return(null_private);
+}
+
+/* must not be called from inside the core, e.g. from sipe_null_state_cb */
+void sipe_null_disconnect(struct sipe_backend_private *null_private)
+{
+	struct sipe_core_public *sipe_public = null_private->public;
+
+	SIPE_DEBUG_INFO("sipe_null_disconnect: %p", sipe_public);
+
+	null_private->is_disconnecting = TRUE;
+	sipe_core_deallocate(sipe_public);
+
+	sipe_null_buddy_free(null_private);
+	g_free(null_private->ipaddress);
+	g_free(null_private->message);
+	g_free(null_private->error);
+	g_free(null_private);
+}
+
+static void change_state(struct sipe_backend_private *null_private,
+			 guint state)
+{
+	null_private->state = state;
+	if (null_private->state_cb)
+		(*null_private->state_cb)(null_private,
+					  null_private->user_data);
+}
+
+void sipe_backend_connection_completed(struct sipe_core_public *sipe_public)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+
+	/* we are only allowed to do this once */
+	if (null_private->state == SIPE_NULL_STATE_CONNECTING) {
+		null_private->connect_time = g_get_monotonic_time() -
+			null_private->connect_start;
+		change_state(null_private, SIPE_NULL_STATE_CONNECTED);
+	}
+}
+
+void sipe_backend_connection_error(struct sipe_core_public *sipe_public,
+				   SIPE_UNUSED_PARAMETER sipe_connection_error error,
+				   const gchar *msg)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+
+	SIPE_DEBUG_ERROR("sipe_backend_connection_error: %s", msg);
+
+	null_private->is_disconnecting = TRUE;
+
+	/* only the first error is interesting */
+	if (null_private->state != SIPE_NULL_STATE_FAILED) {
+		null_private->error = g_strdup(msg);
+		change_state(null_private, SIPE_NULL_STATE_FAILED);
+	}
+}
+
+gboolean sipe_backend_connection_is_disconnecting(struct sipe_core_public *sipe_public)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+
+	/* disconnect was requested or transport was already disconnected */
+	return(null_private->is_disconnecting ||
+	       null_private->transport == NULL);
+}
+
+gboolean sipe_backend_connection_is_valid(struct sipe_core_public *sipe_public)
+{
+	return(!sipe_backend_connection_is_disconnecting(sipe_public));
+}
+
+const gchar *sipe_backend_setting(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				  SIPE_UNUSED_PARAMETER sipe_setting type)
+{
+	/* always use the core defaults */
+	return(NULL);
+}
+
+gchar *sipe_backend_secret_get(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+			       SIPE_UNUSED_PARAMETER const gchar *name)
+{
+	return(NULL);
+}
+
+gboolean sipe_backend_secret_set(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				 SIPE_UNUSED_PARAMETER const gchar *name,
+				 SIPE_UNUSED_PARAMETER const gchar *secret)
+{
+	/* load test clients don't persist anything */
+	return(FALSE);
+}
+
+guint sipe_backend_status(struct sipe_core_public *sipe_public)
+{
+	return(sipe_public->backend_private->activity);
+}
+
+gboolean sipe_backend_status_changed(struct sipe_core_public *sipe_public,
+				     guint activity,
+				     const gchar *message)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+
+	if ((activity == null_private->activity) &&
+	    sipe_strequal(message, null_private->message))
+		return(FALSE);
+
+	return(TRUE);
+}
+
+void sipe_backend_status_and_note(struct sipe_core_public *sipe_public,
+				  guint activity,
+				  const gchar *message)
+{
+	struct sipe_backend_private *null_private = sipe_public->backend_private;
+
+	null_private->activity = activity;
+	g_free(null_private->message);
+	null_private->message  = g_strdup(message);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
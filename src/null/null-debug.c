@@ -0,0 +1,111 @@
+/**
+ * @file null-debug.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ******************************************************************************
+ *
+ * How to collect debugging information
+ *
+ *    $ SIPE_DEBUG=1 [SIPE_TIMING=1] sipe-null ...
+ *
+ * SIPE_DEBUG=1  : print all sipe messages to stderr
+ *                 [otherwise only warnings & errors are printed]
+ *
+ * SIPE_TIMING=1 : prepend time stamps
+ *
+ ******************************************************************************
+ */
+
+#include <stdarg.h>
+
+#include <glib.h>
+
+#include "sipe-backend.h"
+
+#include "null-private.h"
+
+static gboolean debug_enabled = FALSE;
+static gboolean debug_timing  = FALSE;
+
+void sipe_null_debug_init(void)
+{
+	const gchar *env_flags = g_getenv("SIPE_DEBUG");
+
+	debug_enabled = env_flags && (*env_flags != '\0');
+	debug_timing  = g_getenv("SIPE_TIMING") != NULL;
+}
+
+static const gchar * const debug_level_names[] = {
+	"INFO",    /* SIPE_DEBUG_LEVEL_INFO    */
+	"WARNING", /* SIPE_DEBUG_LEVEL_WARNING */
+	"ERROR",   /* SIPE_DEBUG_LEVEL_ERROR   */
+};
+
+void sipe_backend_debug_literal(sipe_debug_level level,
+				const gchar *msg)
+{
+	/* warnings & errors are always visible */
+	if (debug_enabled || (level != SIPE_DEBUG_LEVEL_INFO)) {
+		if (debug_timing) {
+			gint64 now = g_get_real_time();
+
+			g_printerr("%" G_GINT64_FORMAT ".%06u %s %s: %s\n",
+				   now / G_USEC_PER_SEC,
+				   (guint) (now % G_USEC_PER_SEC),
+				   SIPE_NULL_DOMAIN,
+				   debug_level_names[level],
+				   msg);
+		} else {
+			g_printerr("%s %s: %s\n",
+				   SIPE_NULL_DOMAIN,
+				   debug_level_names[level],
+				   msg);
+		}
+	}
+}
+
+void sipe_backend_debug(sipe_debug_level level,
+			const gchar *format,
+			...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	if (debug_enabled || (level != SIPE_DEBUG_LEVEL_INFO)) {
+		gchar *msg = g_strdup_vprintf(format, ap);
+		sipe_backend_debug_literal(level, msg);
+		g_free(msg);
+	}
+	va_end(ap);
+}
+
+gboolean sipe_backend_debug_enabled(void)
+{
+	return(debug_enabled);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
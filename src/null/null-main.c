@@ -0,0 +1,392 @@
+/**
+ * @file null-main.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Headless driver for the null backend
+ *
+ * Logs N accounts into a SIP server from one process. Every account is a
+ * separate sipe_core_public instance, all of them share one GMainLoop.
+ *
+ * Usage: sipe-null --server <host> --user user%u@<domain> [options]
+ *
+ * "%u" in the user & login names is replaced with the account index.
+ *
+ * On exit it reports login times, presence update & message rates, the
+ * amount of data transferred, the buddy list memory usage of one account
+ * and the peak memory usage of the process.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-core.h"
+
+#include "null-private.h"
+
+struct null_driver {
+	GMainLoop *loop;
+	struct sipe_backend_private **accounts;
+	guint count;
+	guint started;
+	guint connected;
+	guint failed;
+	guint dropped;
+	guint linger;
+	gboolean done;
+	gint64 start;         /* monotonic time [us] */
+	gint64 end;           /* monotonic time [us] */
+};
+
+/* command line options */
+static gchar   *option_server         = NULL;
+static gchar   *option_port           = NULL;
+static gchar   *option_transport      = NULL;
+static gchar   *option_authentication = NULL;
+static gchar   *option_user           = NULL;
+static gchar   *option_login          = NULL;
+static gchar   *option_password       = NULL;
+static gint     option_accounts       = 1;
+static gint     option_interval       = 0;
+static gint     option_timeout        = 60;
+static gint     option_linger         = 0;
+
+static const GOptionEntry options[] = {
+	{ "server",         's', 0, G_OPTION_ARG_STRING, &option_server,
+	  "SIP server host name", "HOST" },
+	{ "port",           'p', 0, G_OPTION_ARG_STRING, &option_port,
+	  "SIP server port", "PORT" },
+	{ "transport",      't', 0, G_OPTION_ARG_STRING, &option_transport,
+	  "auto, tls or tcp [default: auto]", "TYPE" },
+	{ "authentication", 'a', 0, G_OPTION_ARG_STRING, &option_authentication,
+	  "auto, ntlm, kerberos or tls-dsk [default: ntlm]", "TYPE" },
+	{ "user",           'u', 0, G_OPTION_ARG_STRING, &option_user,
+	  "sign-in name template, e.g. user%u@contoso.com", "NAME" },
+	{ "login",          'l', 0, G_OPTION_ARG_STRING, &option_login,
+	  "login name template, e.g. CONTOSO\\user%u", "NAME" },
+	{ "password",       'w', 0, G_OPTION_ARG_STRING, &option_password,
+	  "password for all accounts", "PASSWORD" },
+	{ "accounts",       'n', 0, G_OPTION_ARG_INT,    &option_accounts,
+	  "number of accounts [default: 1]", "N" },
+	{ "interval",       'i', 0, G_OPTION_ARG_INT,    &option_interval,
+	  "delay between account logins [default: 0]", "MSECS" },
+	{ "timeout",        'T', 0, G_OPTION_ARG_INT,    &option_timeout,
+	  "give up on logins after this time [default: 60]", "SECS" },
+	{ "linger",         'L', 0, G_OPTION_ARG_INT,    &option_linger,
+	  "stay connected after all logins have finished [default: 0]", "SECS" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+gchar *sipe_backend_version(void)
+{
+	return(g_strdup_printf("null/%s", PACKAGE_VERSION));
+}
+
+static gchar *expand_template(const gchar *template,
+			      guint index)
+{
+	gchar *number, *result;
+	gchar **parts;
+
+	if (!template)
+		return(NULL);
+
+	number = g_strdup_printf("%u", index);
+	parts  = g_strsplit(template, "%u", 0);
+	result = g_strjoinv(number, parts);
+	g_strfreev(parts);
+	g_free(number);
+
+	return(result);
+}
+
+static gboolean lookup_option(const gchar *value,
+			      const gchar * const *names,
+			      const guint *types,
+			      guint *type)
+{
+	if (value) {
+		for (; *names; names++, types++)
+			if (g_ascii_strcasecmp(value, *names) == 0) {
+				*type = *types;
+				return(TRUE);
+			}
+		return(FALSE);
+	}
+
+	/* keep default */
+	return(TRUE);
+}
+
+static gboolean finished(gpointer data)
+{
+	struct null_driver *driver = data;
+	driver->end = g_get_monotonic_time();
+	g_main_loop_quit(driver->loop);
+	return(FALSE);
+}
+
+static void check_finished(struct null_driver *driver)
+{
+	/* all logins have finished */
+	if (!driver->done &&
+	    (driver->connected + driver->failed == driver->count)) {
+		driver->done = TRUE;
+		g_timeout_add_seconds(driver->linger, finished, driver);
+	}
+}
+
+static void account_state(struct sipe_backend_private *null_private,
+			  gpointer user_data)
+{
+	struct null_driver *driver = user_data;
+
+	switch (null_private->state) {
+	case SIPE_NULL_STATE_CONNECTED:
+		driver->connected++;
+		break;
+	case SIPE_NULL_STATE_FAILED:
+		SIPE_DEBUG_ERROR("account_state: %p failed: %s",
+				 null_private->public,
+				 null_private->error);
+		if (null_private->connect_time)
+			driver->dropped++;
+		else
+			driver->failed++;
+		break;
+	}
+
+	check_finished(driver);
+}
+
+static void report(struct null_driver *driver)
+{
+	struct sipe_null_statistics totals;
+	gint64 login_min   = G_MAXINT64;
+	gint64 login_max   = 0;
+	gint64 login_total = 0;
+	gdouble seconds    = (driver->end - driver->start) / 1000000.0;
+	guint pending      = 0;
+	guint inflight     = 0;
+	guint failed       = 0;
+	struct rusage usage;
+	guint i;
+
+	memset(&totals, 0, sizeof(totals));
+	for (i = 0; i < driver->started; i++) {
+		struct sipe_backend_private *null_private = driver->accounts[i];
+		guint account_pending, account_inflight, account_failed;
+		gint64 login;
+
+		if (!null_private)
+			continue;
+
+		sipe_core_presence_subscriptions(null_private->public,
+						 &account_pending,
+						 &account_inflight,
+						 &account_failed);
+		pending  += account_pending;
+		inflight += account_inflight;
+		failed   += account_failed;
+
+		totals.bytes_read    += null_private->stats.bytes_read;
+		totals.bytes_written += null_private->stats.bytes_written;
+		totals.reads         += null_private->stats.reads;
+		totals.writes        += null_private->stats.writes;
+		totals.buddy_status  += null_private->stats.buddy_status;
+		totals.messages      += null_private->stats.messages;
+
+		login = null_private->connect_time;
+		if (login) {
+			if (login < login_min)
+				login_min = login;
+			if (login > login_max)
+				login_max = login;
+			login_total += login;
+		}
+	}
+
+	g_print("accounts: %u connected: %u failed: %u dropped: %u\n",
+		driver->count, driver->connected, driver->failed, driver->dropped);
+	if (driver->connected)
+		g_print("login [ms]: min %.1f avg %.1f max %.1f\n",
+			login_min / 1000.0,
+			login_total / 1000.0 / driver->connected,
+			login_max / 1000.0);
+	if (seconds > 0)
+		g_print("run: %.1fs presence updates: %u (%.1f/s) messages: %u (%.1f/s)\n",
+			seconds,
+			totals.buddy_status, totals.buddy_status / seconds,
+			totals.messages,     totals.messages     / seconds);
+	g_print("presence subscriptions: pending %u in-flight %u failed %u\n",
+		pending, inflight, failed);
+	g_print("read: %" G_GUINT64_FORMAT " bytes in %u reads"
+		" written: %" G_GUINT64_FORMAT " bytes in %u writes\n",
+		totals.bytes_read,    totals.reads,
+		totals.bytes_written, totals.writes);
+
+	/* buddy list of the first account, all accounts see the same server */
+	for (i = 0; i < driver->started; i++) {
+		struct sipe_backend_private *null_private = driver->accounts[i];
+
+		if (null_private &&
+		    (null_private->state == SIPE_NULL_STATE_CONNECTED)) {
+			gchar *memory = sipe_core_buddy_memory_usage(null_private->public);
+			g_print("%s\n", memory);
+			g_free(memory);
+			break;
+		}
+	}
+
+	/* ru_maxrss is in kilobytes on Linux */
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		g_print("peak RSS: %ld KB (%ld KB/account)\n",
+			usage.ru_maxrss,
+			usage.ru_maxrss / driver->count);
+}
+
+static guint transport_type      = SIPE_TRANSPORT_AUTO;
+static guint authentication_type = SIPE_AUTHENTICATION_TYPE_NTLM;
+
+static gboolean start_account(gpointer data)
+{
+	struct null_driver *driver = data;
+	guint index                = driver->started++;
+	gchar *user                = expand_template(option_user,  index);
+	gchar *login               = expand_template(option_login, index);
+	const gchar *errmsg        = NULL;
+
+	driver->accounts[index] = sipe_null_connect(user,
+						    login ? login : user,
+						    option_password,
+						    transport_type,
+						    authentication_type,
+						    option_server,
+						    option_port,
+						    account_state,
+						    driver,
+						    &errmsg);
+	if (!driver->accounts[index]) {
+		g_printerr("account %s: %s\n", user, errmsg);
+		driver->failed++;
+		check_finished(driver);
+	}
+
+	g_free(login);
+	g_free(user);
+
+	return(driver->started < driver->count);
+}
+
+int main(int argc, char *argv[])
+{
+	static const gchar * const transport_names[] = {
+		"auto", "tls", "tcp", NULL
+	};
+	static const guint transport_types[] = {
+		SIPE_TRANSPORT_AUTO, SIPE_TRANSPORT_TLS, SIPE_TRANSPORT_TCP
+	};
+	static const gchar * const authentication_names[] = {
+		"auto", "ntlm", "kerberos", "tls-dsk", NULL
+	};
+	static const guint authentication_types[] = {
+		SIPE_AUTHENTICATION_TYPE_AUTOMATIC,
+		SIPE_AUTHENTICATION_TYPE_NTLM,
+		SIPE_AUTHENTICATION_TYPE_KERBEROS,
+		SIPE_AUTHENTICATION_TYPE_TLS_DSK
+	};
+	GOptionContext *context = g_option_context_new("- headless SIPE accounts");
+	GError *error           = NULL;
+	struct null_driver driver;
+	guint i;
+
+	g_option_context_add_main_entries(context, options, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return(1);
+	}
+	g_option_context_free(context);
+
+	if (!option_user || (option_accounts < 1) ||
+	    !lookup_option(option_transport,
+			   transport_names, transport_types,
+			   &transport_type) ||
+	    !lookup_option(option_authentication,
+			   authentication_names, authentication_types,
+			   &authentication_type)) {
+		g_printerr("invalid options, see --help\n");
+		return(1);
+	}
+
+	sipe_null_debug_init();
+	sipe_core_init(LOCALEDIR);
+
+	SIPE_DEBUG_INFO("main: initializing - version %s", PACKAGE_VERSION);
+
+	memset(&driver, 0, sizeof(driver));
+	driver.loop     = g_main_loop_new(NULL, FALSE);
+	driver.count    = option_accounts;
+	driver.accounts = g_new0(struct sipe_backend_private *, driver.count);
+	driver.linger   = option_linger;
+	driver.start    = g_get_monotonic_time();
+
+	if (option_interval > 0)
+		g_timeout_add(option_interval, start_account, &driver);
+	else
+		for (i = 0; i < driver.count; i++)
+			start_account(&driver);
+	g_timeout_add_seconds(option_timeout + option_linger, finished, &driver);
+
+	g_main_loop_run(driver.loop);
+
+	report(&driver);
+
+	for (i = 0; i < driver.started; i++)
+		if (driver.accounts[i])
+			sipe_null_disconnect(driver.accounts[i]);
+	g_free(driver.accounts);
+
+	/* free disconnected transports */
+	while (g_main_context_iteration(NULL, FALSE));
+	g_main_loop_unref(driver.loop);
+
+	sipe_core_destroy();
+	return(((driver.connected == driver.count) && !driver.dropped) ? 0 : 1);
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
@@ -0,0 +1,112 @@
+/**
+ * @file null-private.h
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Forward declarations */
+struct sipe_backend_private;
+struct sipe_core_public;
+struct sipe_transport_null;
+
+/* constants */
+#define SIPE_NULL_DOMAIN "sipe-null"
+
+/* account states */
+#define SIPE_NULL_STATE_CONNECTING 0
+#define SIPE_NULL_STATE_CONNECTED  1
+#define SIPE_NULL_STATE_FAILED     2
+
+/**
+ * Account state has changed
+ *
+ * Called from inside the core. Do *NOT* free the account from the
+ * callback, defer it to the main loop instead.
+ *
+ * @param null_private account
+ * @param user_data    from @c sipe_null_connect()
+ */
+typedef void sipe_null_state_cb(struct sipe_backend_private *null_private,
+				gpointer user_data);
+
+/* per-account statistics */
+struct sipe_null_statistics {
+	guint64 bytes_read;
+	guint64 bytes_written;
+	guint   reads;
+	guint   writes;
+	guint   buddy_status;
+	guint   messages;
+};
+
+struct sipe_backend_private {
+	struct sipe_core_public *public;
+
+	/* connection */
+	sipe_null_state_cb *state_cb;
+	gpointer user_data;
+	guint state;
+	gint64 connect_start; /* monotonic time [us] */
+	gint64 connect_time;  /* login duration [us], 0 until connected */
+	gchar *error;
+	gboolean is_disconnecting;
+
+	/* status */
+	guint activity;
+	gchar *message;
+
+	/* transport */
+	struct sipe_transport_null *transport;
+	gchar *ipaddress;
+
+	/* buddy list */
+	GHashTable *buddies; /* name -> GSList of buddies, one per group */
+	guint buddy_count;
+
+	struct sipe_null_statistics stats;
+};
+
+/* connection */
+struct sipe_backend_private *sipe_null_connect(const gchar *signin_name,
+					       const gchar *login,
+					       const gchar *password,
+					       guint transport,
+					       guint authentication,
+					       const gchar *server,
+					       const gchar *port,
+					       sipe_null_state_cb *state_cb,
+					       gpointer user_data,
+					       const gchar **errmsg);
+void sipe_null_disconnect(struct sipe_backend_private *null_private);
+
+/* buddy list */
+void sipe_null_buddy_init(struct sipe_backend_private *null_private);
+void sipe_null_buddy_free(struct sipe_backend_private *null_private);
+
+/* debug */
+void sipe_null_debug_init(void);
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
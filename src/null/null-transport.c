@@ -0,0 +1,410 @@
+/**
+ * @file null-transport.c
+ *
+ * pidgin-sipe
+ *
+ * Copyright (C) 2016 SIPE Project <http://sipe.sourceforge.net/>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Minimal GIO transport: one TCP or TLS connection per core transport,
+ * no certificate checks and no proxy support. That is all the mock
+ * registrar and test servers need.
+ *
+ * The transport is freed when the core has disconnected it and the last
+ * outstanding asynchronous operation has completed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "sipe-backend.h"
+#include "sipe-common.h"
+#include "sipe-core.h"
+#include "sipe-nls.h"
+
+#include "null-private.h"
+
+struct sipe_transport_null {
+	/* public part shared with core */
+	struct sipe_transport_connection public;
+
+	/* null private part */
+	transport_connected_cb *connected;
+	transport_input_cb *input;
+	transport_error_cb *error;
+	struct sipe_backend_private *private; /* NULL after disconnect */
+	GCancellable *cancel;
+	GSocketConnection *socket;
+	GString *sending;  /* data of the outstanding write */
+	GString *queued;   /* data sent by the core during the write */
+	gsize sent;
+	guint references;  /* core + outstanding asynchronous operations */
+	gboolean do_flush;
+};
+
+#define NULL_TRANSPORT ((struct sipe_transport_null *) conn)
+#define SIPE_TRANSPORT_CONNECTION ((struct sipe_transport_connection *) transport)
+
+#define BUFFER_SIZE_INCREMENT 4096
+
+static void transport_unref(struct sipe_transport_null *transport)
+{
+	if (--transport->references)
+		return;
+
+	SIPE_DEBUG_INFO("transport_unref: freeing %p", transport);
+
+	/* also closes the connection */
+	if (transport->socket)
+		g_object_unref(transport->socket);
+	g_object_unref(transport->cancel);
+	g_string_free(transport->sending, TRUE);
+	g_string_free(transport->queued, TRUE);
+	g_free(transport->public.buffer);
+	g_free(transport);
+}
+
+static void read_completed(GObject *stream,
+			   GAsyncResult *result,
+			   gpointer data);
+static void start_read(struct sipe_transport_null *transport)
+{
+	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
+	gsize readlen = sipe_core_transport_buffer_reserve(conn,
+							   BUFFER_SIZE_INCREMENT);
+
+	transport->references++;
+	g_input_stream_read_async(g_io_stream_get_input_stream(G_IO_STREAM(transport->socket)),
+				  conn->buffer + conn->buffer_used,
+				  readlen,
+				  G_PRIORITY_DEFAULT,
+				  transport->cancel,
+				  read_completed,
+				  transport);
+}
+
+static void read_completed(GObject *stream,
+			   GAsyncResult *result,
+			   gpointer data)
+{
+	struct sipe_transport_null *transport = data;
+	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
+	GError *error = NULL;
+	gssize len    = g_input_stream_read_finish(G_INPUT_STREAM(stream),
+						   result,
+						   &error);
+
+	if (!transport->private) {
+		/* transport was disconnected */
+	} else if (len < 0) {
+		const gchar *msg = error ? error->message : "UNKNOWN";
+		SIPE_DEBUG_ERROR("read_completed: error: %s", msg);
+		transport->error(conn, msg);
+	} else if (len == 0) {
+		SIPE_DEBUG_ERROR_NOFORMAT("read_completed: server has disconnected");
+		transport->error(conn, _("Server has disconnected"));
+	} else {
+		transport->private->stats.bytes_read += len;
+		transport->private->stats.reads++;
+
+		/* Forward data to core */
+		conn->buffer_used               += len;
+		conn->buffer[conn->buffer_used]  = '\0';
+		transport->input(conn);
+
+		/* core may have disconnected the transport */
+		if (transport->private) {
+			sipe_core_transport_buffer_release(conn);
+			start_read(transport);
+		}
+	}
+
+	if (error)
+		g_error_free(error);
+	transport_unref(transport);
+}
+
+static void socket_connected(GObject *client,
+			     GAsyncResult *result,
+			     gpointer data)
+{
+	struct sipe_transport_null *transport = data;
+	GError *error = NULL;
+
+	transport->socket = g_socket_client_connect_finish(G_SOCKET_CLIENT(client),
+							   result,
+							   &error);
+
+	if (!transport->private) {
+		SIPE_DEBUG_INFO_NOFORMAT("socket_connected: cancelled");
+	} else if (transport->socket == NULL) {
+		const gchar *msg = error ? error->message : "UNKNOWN";
+		SIPE_DEBUG_ERROR("socket_connected: failed: %s", msg);
+		transport->error(SIPE_TRANSPORT_CONNECTION, msg);
+	} else {
+		GSocketAddress *saddr = g_socket_connection_get_local_address(transport->socket,
+									      &error);
+
+		if (saddr) {
+			struct sipe_backend_private *null_private = transport->private;
+			GInetSocketAddress *isaddr = G_INET_SOCKET_ADDRESS(saddr);
+
+			SIPE_DEBUG_INFO_NOFORMAT("socket_connected: success");
+
+			transport->public.client_port = g_inet_socket_address_get_port(isaddr);
+
+			/* the first connection is always to the server */
+			if (null_private->transport == NULL)
+				null_private->transport = transport;
+			if (!null_private->ipaddress)
+				null_private->ipaddress = g_inet_address_to_string(g_inet_socket_address_get_address(isaddr));
+			g_object_unref(saddr);
+
+			start_read(transport);
+			transport->connected(SIPE_TRANSPORT_CONNECTION);
+		} else {
+			SIPE_DEBUG_ERROR("socket_connected: failed: %s", error->message);
+			transport->error(SIPE_TRANSPORT_CONNECTION, error->message);
+		}
+	}
+
+	if (error)
+		g_error_free(error);
+	transport_unref(transport);
+}
+
+/*
+ * The null backend is used for testing against local servers with
+ * self-signed certificates, i.e. there is no user to ask for acceptance.
+ */
+static gboolean accept_certificate_signal(SIPE_UNUSED_PARAMETER GTlsConnection *tls,
+					  SIPE_UNUSED_PARAMETER GTlsCertificate *peer_cert,
+					  SIPE_UNUSED_PARAMETER GTlsCertificateFlags errors,
+					  gpointer user_data)
+{
+	SIPE_DEBUG_INFO("accept_certificate_signal: %p", user_data);
+	return(TRUE);
+}
+
+static void tls_handshake_starts(SIPE_UNUSED_PARAMETER GSocketClient *client,
+				 GSocketClientEvent event,
+				 SIPE_UNUSED_PARAMETER GSocketConnectable *connectable,
+				 GIOStream *connection,
+				 gpointer user_data)
+{
+	if (event == G_SOCKET_CLIENT_TLS_HANDSHAKING) {
+		SIPE_DEBUG_INFO("tls_handshake_starts: %p", connection);
+		g_signal_connect(connection, /* is a GTlsConnection */
+				 "accept-certificate",
+				 G_CALLBACK(accept_certificate_signal),
+				 user_data);
+	}
+}
+
+struct sipe_transport_connection *sipe_backend_transport_connect(struct sipe_core_public *sipe_public,
+								 const sipe_connect_setup *setup)
+{
+	struct sipe_transport_null *transport = g_new0(struct sipe_transport_null, 1);
+
+	transport->public.type      = setup->type;
+	transport->public.user_data = setup->user_data;
+	transport->connected        = setup->connected;
+	transport->input            = setup->input;
+	transport->error            = setup->error;
+	transport->private          = sipe_public->backend_private;
+	transport->cancel           = g_cancellable_new();
+	transport->sending          = g_string_new("");
+	transport->queued           = g_string_new("");
+	transport->references       = 1; /* core */
+
+	if ((setup->type == SIPE_TRANSPORT_TLS) ||
+	    (setup->type == SIPE_TRANSPORT_TCP)) {
+		GSocketClient *client = g_socket_client_new();
+		GSocketConnectable *address = g_network_address_new(setup->server_name,
+								     setup->server_port);
+
+		SIPE_DEBUG_INFO("sipe_backend_transport_connect - hostname: %s port: %d",
+				setup->server_name, setup->server_port);
+
+		if (setup->type == SIPE_TRANSPORT_TLS) {
+			g_socket_client_set_tls(client, TRUE);
+			g_signal_connect(client,
+					 "event",
+					 G_CALLBACK(tls_handshake_starts),
+					 transport);
+		}
+
+		transport->references++;
+		g_socket_client_connect_async(client,
+					      address,
+					      transport->cancel,
+					      socket_connected,
+					      transport);
+		g_object_unref(address);
+		g_object_unref(client);
+
+		return(SIPE_TRANSPORT_CONNECTION);
+
+	} else {
+		setup->error(SIPE_TRANSPORT_CONNECTION,
+			     "This should not happen...");
+		sipe_backend_transport_disconnect(SIPE_TRANSPORT_CONNECTION);
+		return(NULL);
+	}
+}
+
+void sipe_backend_transport_disconnect(struct sipe_transport_connection *conn)
+{
+	struct sipe_transport_null *transport = NULL_TRANSPORT;
+
+	if (!transport) return;
+
+	SIPE_DEBUG_INFO("sipe_backend_transport_disconnect: %p", transport);
+
+	/* dropping connection to the server? */
+	if (transport->private->transport == transport)
+		transport->private->transport = NULL;
+
+	/* account can be freed before flushing has completed */
+	transport->private = NULL;
+
+	/* flushing cancels when the outstanding write has completed */
+	if (!(transport->do_flush && transport->sending->len))
+		g_cancellable_cancel(transport->cancel);
+
+	transport_unref(transport);
+}
+
+static void write_completed(GObject *stream,
+			    GAsyncResult *result,
+			    gpointer data);
+static void write_next(struct sipe_transport_null *transport)
+{
+	transport->references++;
+	g_output_stream_write_async(g_io_stream_get_output_stream(G_IO_STREAM(transport->socket)),
+				    transport->sending->str + transport->sent,
+				    transport->sending->len - transport->sent,
+				    G_PRIORITY_DEFAULT,
+				    transport->cancel,
+				    write_completed,
+				    transport);
+}
+
+static void start_write(struct sipe_transport_null *transport)
+{
+	GString *swap      = transport->sending;
+	transport->sending = transport->queued;
+	transport->queued  = swap;
+	transport->sent    = 0;
+	write_next(transport);
+}
+
+static void write_completed(GObject *stream,
+			    GAsyncResult *result,
+			    gpointer data)
+{
+	struct sipe_transport_null *transport = data;
+	GError *error  = NULL;
+	gssize written = g_output_stream_write_finish(G_OUTPUT_STREAM(stream),
+						      result,
+						      &error);
+
+	if (written < 0) {
+		const gchar *msg = error ? error->message : "UNKNOWN";
+		SIPE_DEBUG_ERROR("write_completed: error: %s", msg);
+
+		/* nothing more will be written to this transport */
+		g_string_truncate(transport->sending, 0);
+		g_string_truncate(transport->queued, 0);
+
+		if (transport->private)
+			transport->error(SIPE_TRANSPORT_CONNECTION, msg);
+		else
+			/* error during flush: give up */
+			g_cancellable_cancel(transport->cancel);
+
+	} else {
+		if (transport->private)
+			transport->private->stats.bytes_written += written;
+		transport->sent += written;
+
+		if (transport->sent < transport->sending->len) {
+			/* short write: continue with remainder of the buffer */
+			write_next(transport);
+		} else {
+			g_string_truncate(transport->sending, 0);
+
+			if (transport->queued->len)
+				start_write(transport);
+			else if (!transport->private)
+				/* flush completed */
+				g_cancellable_cancel(transport->cancel);
+		}
+	}
+
+	if (error)
+		g_error_free(error);
+	transport_unref(transport);
+}
+
+void sipe_backend_transport_message(struct sipe_transport_connection *conn,
+				    const gchar *buffer)
+{
+	struct sipe_transport_null *transport = NULL_TRANSPORT;
+
+	/* account has been disconnected from this transport */
+	if (!transport->private) {
+		SIPE_DEBUG_INFO("sipe_backend_transport_message: %p is disconnected, dropping message",
+				transport);
+		return;
+	}
+
+	transport->private->stats.writes++;
+
+	/* buffer is owned by the caller: always write from a copy */
+	g_string_append(transport->queued, buffer);
+	if (!transport->sending->len)
+		start_write(transport);
+}
+
+void sipe_backend_transport_flush(struct sipe_transport_connection *conn)
+{
+	struct sipe_transport_null *transport = NULL_TRANSPORT;
+	transport->do_flush = TRUE;
+}
+
+const gchar *sipe_backend_network_ip_address(struct sipe_core_public *sipe_public)
+{
+	const gchar *ipstr = sipe_public->backend_private->ipaddress;
+
+	/* default until the connection to the server is established */
+	return(ipstr ? ipstr : "127.0.0.1");
+}
+
+/*
+  Local Variables:
+  mode: c
+  c-file-style: "bsd"
+  indent-tabs-mode: t
+  tab-width: 8
+  End:
+*/
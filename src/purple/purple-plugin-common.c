@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -32,8 +32,10 @@
 #include "account.h"
 #include "accountopt.h"
 #include "core.h"
+#include "debug.h"
 #include "notify.h"
 #include "request.h"
+#include "util.h"
 #include "version.h"
 
 /* Backward compatibility when compiling against 2.4.x API */
@@ -821,6 +823,17 @@ static void sipe_purple_reset_status(PurpleProtocolAction *action)
 	}
 }
 
+static void sipe_purple_buddy_memory_usage(PurpleProtocolAction *action)
+{
+	PurpleConnection *gc = SIPE_PURPLE_ACTION_TO_CONNECTION;
+	gchar *report = sipe_core_buddy_memory_usage(PURPLE_GC_TO_SIPE_CORE_PUBLIC);
+	gchar *html   = purple_strdup_withhtml(report);
+
+	purple_notify_formatted(gc, NULL, _("Buddy memory usage"), NULL, html, NULL, NULL);
+	g_free(html);
+	g_free(report);
+}
+
 GList *sipe_purple_actions()
 {
 	GList *menu = NULL;
@@ -849,6 +862,12 @@ GList *sipe_purple_actions()
 	act = purple_protocol_action_new(_("Reset status"), sipe_purple_reset_status);
 	menu = g_list_prepend(menu, act);
 
+	/* debug command */
+	if (purple_debug_is_enabled()) {
+		act = purple_protocol_action_new(_("Buddy memory usage"), sipe_purple_buddy_memory_usage);
+		menu = g_list_prepend(menu, act);
+	}
+
 	return g_list_reverse(menu);
 }
 
@@ -879,6 +898,12 @@ GList * sipe_purple_account_options()
 	option = purple_account_option_string_new(_("User Agent"), "useragent", "");
 	options = g_list_append(options, option);
 
+	option = purple_account_option_string_new(_("Parallel HTTP connections per server\n(leave empty for default)"), "http_connections", "");
+	options = g_list_append(options, option);
+
+	option = purple_account_option_string_new(_("Receive buffer size kept when idle in KB\n(leave empty for default)"), "buffer_high_water", "");
+	options = g_list_append(options, option);
+
 	option = purple_account_option_list_new(_("Authentication scheme"), "authentication", NULL);
 	purple_account_option_add_list_item(option, _("Auto"), "auto");
 	purple_account_option_add_list_item(option, _("NTLM"), "ntlm");
@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2010 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2010-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -39,11 +39,13 @@
  *     purple-plugin.c:init_plugin()
  */
 static const gchar * const setting_name[SIPE_SETTING_LAST] = {
-	"email_url",      /* SIPE_SETTING_EMAIL_URL      */
-	"email_login",    /* SIPE_SETTING_EMAIL_LOGIN    */
-	"email_password", /* SIPE_SETTING_EMAIL_PASSWORD */
-	"groupchat_user", /* SIPE_SETTING_GROUPCHAT_USER */
-	"useragent"       /* SIPE_SETTING_USER_AGENT     */
+	"email_url",         /* SIPE_SETTING_EMAIL_URL         */
+	"email_login",       /* SIPE_SETTING_EMAIL_LOGIN       */
+	"email_password",    /* SIPE_SETTING_EMAIL_PASSWORD    */
+	"groupchat_user",    /* SIPE_SETTING_GROUPCHAT_USER    */
+	"useragent",         /* SIPE_SETTING_USER_AGENT        */
+	"http_connections",  /* SIPE_SETTING_HTTP_CONNECTIONS  */
+	"buffer_high_water"  /* SIPE_SETTING_BUFFER_HIGH_WATER */
 };
 
 const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
@@ -53,6 +55,23 @@ const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
 					 setting_name[type], NULL));
 }
 
+/* purple keeps secrets with the account, like the account password */
+gchar *sipe_backend_secret_get(struct sipe_core_public *sipe_public,
+			       const gchar *name)
+{
+	return(g_strdup(purple_account_get_string(purple_connection_get_account(sipe_public->backend_private->gc),
+						  name, NULL)));
+}
+
+gboolean sipe_backend_secret_set(struct sipe_core_public *sipe_public,
+				 const gchar *name,
+				 const gchar *secret)
+{
+	purple_account_set_string(purple_connection_get_account(sipe_public->backend_private->gc),
+				  name, secret);
+	return(TRUE);
+}
+
 /*
   Local Variables:
   mode: c
@@ -30,6 +30,9 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #include <glib.h>
 
@@ -88,6 +91,7 @@ struct sipe_transport_purple {
 #define SIPE_TRANSPORT_CONNECTION ((struct sipe_transport_connection *) transport)
 
 #define BUFFER_SIZE_INCREMENT 4096
+#define BUFFER_OVERFLOW_SIZE  (64 * 1024)
 #define FLUSH_MAX_RETRIES 5
 
 
@@ -97,32 +101,71 @@ struct sipe_transport_purple {
  * Common transport handling
  *
  *****************************************************************************/
+#ifdef HAVE_SYS_UIO_H
+/*
+ * Read into the spare capacity of the input buffer. Data that doesn't fit
+ * goes to a stack buffer first, i.e. one system call can receive a large
+ * chunk without growing the input buffer in advance.
+ */
+static gssize transport_tcp_read(struct sipe_transport_purple *transport,
+				 gsize *readlen)
+{
+	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
+	gchar overflow[BUFFER_OVERFLOW_SIZE];
+	struct iovec iov[2];
+	gssize len;
+
+	iov[0].iov_base = conn->buffer + conn->buffer_used;
+	iov[0].iov_len  = *readlen;
+	iov[1].iov_base = overflow;
+	iov[1].iov_len  = sizeof(overflow);
+
+	len = readv(transport->socket, iov, 2);
+	if (len > (gssize) *readlen) {
+		gsize excess = len - *readlen;
+
+		/* reserve() keeps the already received data in the buffer */
+		conn->buffer_used += *readlen;
+		sipe_core_transport_buffer_reserve(conn, excess);
+		conn->buffer_used -= *readlen;
+		memcpy(conn->buffer + conn->buffer_used + *readlen,
+		       overflow,
+		       excess);
+	}
+
+	*readlen += sizeof(overflow);
+	return(len);
+}
+#else
+static gssize transport_tcp_read(struct sipe_transport_purple *transport,
+				 gsize *readlen)
+{
+	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
+	return(read(transport->socket,
+		    conn->buffer + conn->buffer_used,
+		    *readlen));
+}
+#endif
+
 static void transport_common_input(struct sipe_transport_purple *transport)
 {
 	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
-	gssize readlen, len;
+	gssize len;
+	gsize readlen;
 	gboolean firstread = TRUE;
 
 	/* Read all available data from the connection */
 	do {
 		/* Increase input buffer size as needed */
-		if (conn->buffer_length < conn->buffer_used + BUFFER_SIZE_INCREMENT) {
-			conn->buffer_length += BUFFER_SIZE_INCREMENT;
-			conn->buffer = g_realloc(conn->buffer, conn->buffer_length);
-			SIPE_DEBUG_INFO("transport_input_common: new buffer length %" G_GSIZE_FORMAT,
-					conn->buffer_length);
-		}
+		readlen = sipe_core_transport_buffer_reserve(conn,
+							     BUFFER_SIZE_INCREMENT);
 
 		/* Try to read as much as there is space left in the buffer */
-		/* minus 1 for the string terminator */
-		readlen = conn->buffer_length - conn->buffer_used - 1;
 		len = transport->gsc ?
 			(gssize) purple_ssl_read(transport->gsc,
 						 conn->buffer + conn->buffer_used,
 						 readlen) :
-			read(transport->socket,
-			     conn->buffer + conn->buffer_used,
-			     readlen);
+			transport_tcp_read(transport, &readlen);
 
 		if (len < 0 && errno == EAGAIN) {
 			/* Try again later */
@@ -141,10 +184,14 @@ static void transport_common_input(struct sipe_transport_purple *transport)
 		firstread = FALSE;
 
 	/* Equivalence indicates that there is possibly more data to read */
-	} while (len == readlen);
+	} while ((gsize) len == readlen);
 
 	conn->buffer[conn->buffer_used] = '\0';
         transport->input(conn);
+
+	/* transport might have been disconnected during input processing */
+	if (transport->is_valid)
+		sipe_core_transport_buffer_release(conn);
 }
 
 static void transport_ssl_input(gpointer data,
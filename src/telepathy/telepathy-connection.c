@@ -3,7 +3,7 @@
  *
  * pidgin-sipe
  *
- * Copyright (C) 2012-2015 SIPE Project <http://sipe.sourceforge.net/>
+ * Copyright (C) 2012-2016 SIPE Project <http://sipe.sourceforge.net/>
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -903,6 +903,20 @@ const gchar *sipe_backend_setting(struct sipe_core_public *sipe_public,
 	return(value);
 }
 
+gchar *sipe_backend_secret_get(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+			       SIPE_UNUSED_PARAMETER const gchar *name)
+{
+	return(NULL);
+}
+
+gboolean sipe_backend_secret_set(SIPE_UNUSED_PARAMETER struct sipe_core_public *sipe_public,
+				 SIPE_UNUSED_PARAMETER const gchar *name,
+				 SIPE_UNUSED_PARAMETER const gchar *secret)
+{
+	/* connection managers have no access to the account storage */
+	return(FALSE);
+}
+
 
 /*
   Local Variables:
@@ -68,59 +68,49 @@ static void read_completed(GObject *stream,
 {
 	struct sipe_transport_telepathy *transport = data;
 	struct sipe_transport_connection *conn = SIPE_TRANSPORT_CONNECTION;
+	gsize readlen;
 
-	do {
-		if (conn->buffer_length < conn->buffer_used + BUFFER_SIZE_INCREMENT) {
-			conn->buffer_length += BUFFER_SIZE_INCREMENT;
-			conn->buffer = g_realloc(conn->buffer, conn->buffer_length);
-			SIPE_DEBUG_INFO("read_completed: new buffer length %" G_GSIZE_FORMAT,
-					conn->buffer_length);
-		}
-
-		/* callback result is valid */
-		if (result) {
-			GError *error = NULL;
-			gssize len    = g_input_stream_read_finish(G_INPUT_STREAM(stream),
-								   result,
-								   &error);
-
-			if (len < 0) {
-				const gchar *msg = error ? error->message : "UNKNOWN";
-				SIPE_DEBUG_ERROR("read_completed: error: %s", msg);
-				if (transport->error)
-					transport->error(conn, msg);
-				g_error_free(error);
-				return;
-			} else if (len == 0) {
-				SIPE_DEBUG_ERROR_NOFORMAT("read_completed: server has disconnected");
-				transport->error(conn, _("Server has disconnected"));
-				return;
-			} else if (transport->do_flush) {
-				/* read completed while disconnected transport is flushing */
-				SIPE_DEBUG_INFO_NOFORMAT("read_completed: ignored during flushing");
-				return;
-			} else if (g_cancellable_is_cancelled(transport->cancel)) {
-				/* read completed when transport was disconnected */
-				SIPE_DEBUG_INFO_NOFORMAT("read_completed: cancelled");
-				return;
-			}
-
-			/* Forward data to core */
-			conn->buffer_used               += len;
-			conn->buffer[conn->buffer_used]  = '\0';
-			transport->input(conn);
+	/* callback result is valid */
+	if (result) {
+		GError *error = NULL;
+		gssize len    = g_input_stream_read_finish(G_INPUT_STREAM(stream),
+							   result,
+							   &error);
 
-			/* we processed the result */
-			result = NULL;
+		if (len < 0) {
+			const gchar *msg = error ? error->message : "UNKNOWN";
+			SIPE_DEBUG_ERROR("read_completed: error: %s", msg);
+			if (transport->error)
+				transport->error(conn, msg);
+			g_error_free(error);
+			return;
+		} else if (len == 0) {
+			SIPE_DEBUG_ERROR_NOFORMAT("read_completed: server has disconnected");
+			transport->error(conn, _("Server has disconnected"));
+			return;
+		} else if (transport->do_flush) {
+			/* read completed while disconnected transport is flushing */
+			SIPE_DEBUG_INFO_NOFORMAT("read_completed: ignored during flushing");
+			return;
+		} else if (g_cancellable_is_cancelled(transport->cancel)) {
+			/* read completed when transport was disconnected */
+			SIPE_DEBUG_INFO_NOFORMAT("read_completed: cancelled");
+			return;
 		}
 
-		/* buffer too short? */
-	} while (conn->buffer_length - conn->buffer_used - 1 == 0);
+		/* Forward data to core */
+		conn->buffer_used               += len;
+		conn->buffer[conn->buffer_used]  = '\0';
+		transport->input(conn);
+		sipe_core_transport_buffer_release(conn);
+	}
 
 	/* setup next read */
+	readlen = sipe_core_transport_buffer_reserve(conn,
+						     BUFFER_SIZE_INCREMENT);
 	g_input_stream_read_async(G_INPUT_STREAM(stream),
 				  conn->buffer + conn->buffer_used,
-				  conn->buffer_length - conn->buffer_used - 1,
+				  readlen,
 				  G_PRIORITY_DEFAULT,
 				  transport->cancel,
 				  read_completed,
@@ -330,6 +320,7 @@ static gboolean free_transport(gpointer data)
 	if (transport->cancel)
 		g_object_unref(transport->cancel);
 
+	g_free(transport->public.buffer);
 	g_free(transport);
 
 	return(FALSE);